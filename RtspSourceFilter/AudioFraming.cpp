@@ -0,0 +1,147 @@
+#include "AudioFraming.h"
+#include "BitstreamReader.h"
+
+namespace
+{
+    template <typename T, size_t N>
+    size_t ArraySize(const T (&)[N])
+    {
+        return N;
+    }
+
+    const unsigned aacSamplingFrequencies[] = {96000, 88200, 64000, 48000, 44100, 32000, 24000,
+                                               22050, 16000, 12000, 11025, 8000,  7350};
+
+    const unsigned ac3SamplingFrequencies[] = {48000, 44100, 32000};
+    // Nominal bit rate in kbps of each pair of frmsizecod values
+    const unsigned ac3BitRates[] = {32,  40,  48,  56,  64,  80,  96,  112, 128, 160,
+                                    192, 224, 256, 320, 384, 448, 512, 576, 640};
+    // Full bandwidth channels by acmod
+    const unsigned ac3Channels[] = {2, 1, 2, 3, 3, 4, 4, 5};
+    // Highest bsid of plain AC-3 (decoders are to accept up to 8, 9 and 10 are half and
+    // quarter rate variants), E-AC-3 starts at 11
+    const unsigned ac3MaxBsid = 10;
+
+    void AppendFrame(std::vector<AudioFrame>& frames, size_t offset, size_t size,
+                     unsigned durationUSecs)
+    {
+        AudioFrame frame = {offset, size, durationUSecs};
+        frames.push_back(frame);
+    }
+
+    unsigned FrameDuration(unsigned samples, unsigned sampleRate)
+    {
+        return sampleRate ? static_cast<unsigned>(samples * 1000000ULL / sampleRate) : 0;
+    }
+
+    void SplitLatm(const uint8_t* data, size_t size, unsigned sampleRate,
+                   std::vector<AudioFrame>& frames)
+    {
+        // PayloadLengthInfo: bytes are added up until one isn't 0xFF
+        size_t payloadSize = 0;
+        size_t i = 0;
+        while (i < size)
+        {
+            payloadSize += data[i];
+            if (data[i++] != 0xFF)
+                break;
+        }
+        // Anything shorter lost a fragment
+        if (payloadSize == 0 || i + payloadSize > size)
+            return;
+        AppendFrame(frames, i, payloadSize, FrameDuration(aacSamplesPerFrame, sampleRate));
+    }
+
+    void SplitAc3(const uint8_t* data, size_t size, std::vector<AudioFrame>& frames)
+    {
+        size_t offset = 0;
+        while (offset + 1 < size)
+        {
+            Ac3FrameHeader header;
+            if (!ParseAc3FrameHeader(data + offset, size - offset, header))
+            {
+                // Resynchronize on the next sync word
+                ++offset;
+                continue;
+            }
+            if (offset + header.frameSize > size)
+                return;
+            AppendFrame(frames, offset, header.frameSize,
+                        FrameDuration(ac3SamplesPerFrame, header.sampleRate));
+            offset += header.frameSize;
+        }
+    }
+}
+
+bool ParseAudioSpecificConfig(const uint8_t* data, size_t size, AudioSpecificConfig& config)
+{
+    BitstreamReader reader(data, size);
+    config.objectType = reader.ReadBits(5);
+    if (config.objectType == 31)
+        config.objectType = 32 + reader.ReadBits(6);
+
+    const unsigned samplingFrequencyIndex = reader.ReadBits(4);
+    if (samplingFrequencyIndex == 0xF)
+        config.sampleRate = reader.ReadBits(24);
+    else if (samplingFrequencyIndex < ArraySize(aacSamplingFrequencies))
+        config.sampleRate = aacSamplingFrequencies[samplingFrequencyIndex];
+    else
+        return false;
+
+    config.channels = reader.ReadBits(4);
+    return !reader.Overrun() && config.objectType != 0 && config.sampleRate != 0;
+}
+
+bool ParseAc3FrameHeader(const uint8_t* data, size_t size, Ac3FrameHeader& header)
+{
+    // syncword, crc1, fscod, frmsizecod, bsid, bsmod, acmod
+    if (size < 7 || data[0] != 0x0B || data[1] != 0x77)
+        return false;
+
+    BitstreamReader reader(data + 4, size - 4);
+    const unsigned fscod = reader.ReadBits(2);
+    const unsigned frmsizecod = reader.ReadBits(6);
+    const unsigned bsid = reader.ReadBits(5);
+    if (fscod >= ArraySize(ac3SamplingFrequencies) || frmsizecod / 2 >= ArraySize(ac3BitRates) ||
+        bsid > ac3MaxBsid)
+    {
+        return false;
+    }
+    reader.SkipBits(3); // bsmod
+    const unsigned acmod = reader.ReadBits(3);
+    if ((acmod & 1) && acmod != 1)
+        reader.SkipBits(2); // cmixlev
+    if (acmod & 4)
+        reader.SkipBits(2); // surmixlev
+    if (acmod == 2)
+        reader.SkipBits(2); // dsurmod
+    const bool lfeon = reader.ReadFlag();
+
+    header.sampleRate = ac3SamplingFrequencies[fscod];
+    // Frames at 44.1 kHz are padded by a word every other frmsizecod to keep the bit rate
+    const unsigned bitRate = ac3BitRates[frmsizecod / 2];
+    const size_t frameWords = bitRate * 96000 / header.sampleRate +
+                              (fscod == 1 ? (frmsizecod & 1) : 0);
+    header.frameSize = frameWords * 2;
+    header.channels = ac3Channels[acmod] + (lfeon ? 1 : 0);
+    return !reader.Overrun();
+}
+
+void SplitAudioFrames(AudioFraming framing, const uint8_t* data, size_t size,
+                      unsigned sampleRate, std::vector<AudioFrame>& frames)
+{
+    frames.clear();
+    switch (framing)
+    {
+    case AudioFramingLatm:
+        SplitLatm(data, size, sampleRate, frames);
+        break;
+    case AudioFramingAc3:
+        SplitAc3(data, size, frames);
+        break;
+    default:
+        if (size > 0)
+            AppendFrame(frames, 0, size, 0);
+        break;
+    }
+}
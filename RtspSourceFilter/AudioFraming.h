@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * How frames delivered by the RTP source are turned into frames a decoder takes
+ */
+enum AudioFraming
+{
+    // One RTP frame is one decoder frame (MPEG4-GENERIC, G.711, Opus)
+    AudioFramingNone,
+    // LATM subframe - PayloadLengthInfo followed by raw AAC frame (RFC 3016)
+    AudioFramingLatm,
+    // One or more AC-3 sync frames (RFC 4184), possibly preceded by garbage after a loss
+    AudioFramingAc3
+};
+
+struct AudioSpecificConfig
+{
+    AudioSpecificConfig() : objectType(0), sampleRate(0), channels(0) {}
+
+    unsigned objectType;
+    // Of the core coder (SBR, if signalled implicitly, doubles the output rate)
+    unsigned sampleRate;
+    // Channel configuration, 0 if defined by program config element
+    unsigned channels;
+};
+
+/**
+ * Leading fields of MPEG-4 AudioSpecificConfig (ISO/IEC 14496-3, 1.6.2.1)
+ */
+bool ParseAudioSpecificConfig(const uint8_t* data, size_t size, AudioSpecificConfig& config);
+
+struct Ac3FrameHeader
+{
+    Ac3FrameHeader() : sampleRate(0), frameSize(0), channels(0) {}
+
+    unsigned sampleRate;
+    // In bytes, sync word included
+    size_t frameSize;
+    // Full bandwidth channels plus LFE
+    unsigned channels;
+};
+
+// Each AC-3 sync frame carries 6 audio blocks of 256 samples
+const unsigned ac3SamplesPerFrame = 1536;
+const unsigned aacSamplesPerFrame = 1024;
+
+/**
+ * AC-3 sync frame header (ATSC A/52, 5.3). Fails on E-AC-3 and anything not starting with
+ * the sync word.
+ */
+bool ParseAc3FrameHeader(const uint8_t* data, size_t size, Ac3FrameHeader& header);
+
+struct AudioFrame
+{
+    size_t offset;
+    size_t size;
+    // Playing time of the frame, 0 if unknown
+    unsigned durationUSecs;
+};
+
+/**
+ * Finds decoder frames within what the RTP source delivered. Frames are given as ranges of
+ * the input - nothing is copied. Malformed or truncated parts are skipped.
+ *
+ * sampleRate is needed for LATM only (AAC frames don't tell their sampling rate).
+ */
+void SplitAudioFrames(AudioFraming framing, const uint8_t* data, size_t size,
+                      unsigned sampleRate, std::vector<AudioFrame>& frames);
@@ -0,0 +1,129 @@
+#include "BitstreamReader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#define BSWAP64(x) _byteswap_uint64(x)
+#else
+#define BSWAP64(x) __builtin_bswap64(x)
+#endif
+
+namespace
+{
+    // Prefix length of Exp-Golomb codes decoded with a single lookup
+    const unsigned shortCodeBits = 9;
+
+    struct ExpGolombTables
+    {
+        ExpGolombTables()
+        {
+            leadingZeros[0] = 8;
+            for (unsigned byte = 1; byte < 256; ++byte)
+            {
+                unsigned zeros = 0;
+                while (!(byte & (0x80 >> zeros)))
+                    ++zeros;
+                leadingZeros[byte] = static_cast<uint8_t>(zeros);
+            }
+
+            // Codes with at most 4 leading zeros fit in 9 bits: 0 (1 bit) .. 30 (9 bits)
+            for (unsigned prefix = 0; prefix < (1 << shortCodeBits); ++prefix)
+            {
+                unsigned zeros = 0;
+                while (zeros < shortCodeBits && !(prefix & (1 << (shortCodeBits - 1 - zeros))))
+                    ++zeros;
+                unsigned length = 2 * zeros + 1;
+                if (length > shortCodeBits)
+                {
+                    shortCodeLength[prefix] = 0;
+                    shortCodeValue[prefix] = 0;
+                    continue;
+                }
+                shortCodeLength[prefix] = static_cast<uint8_t>(length);
+                shortCodeValue[prefix] =
+                    static_cast<uint8_t>((prefix >> (shortCodeBits - length)) - 1);
+            }
+        }
+
+        uint8_t leadingZeros[256];
+        uint8_t shortCodeLength[1 << shortCodeBits];
+        uint8_t shortCodeValue[1 << shortCodeBits];
+    };
+
+    // Built before any filter gets created
+    const ExpGolombTables expGolombTables;
+
+    unsigned CountLeadingZeros(uint32_t value)
+    {
+        if (value >> 24)
+            return expGolombTables.leadingZeros[value >> 24];
+        if (value >> 16)
+            return 8 + expGolombTables.leadingZeros[value >> 16];
+        if (value >> 8)
+            return 16 + expGolombTables.leadingZeros[value >> 8];
+        return 24 + expGolombTables.leadingZeros[value];
+    }
+}
+
+uint64_t BitstreamReader::Load() const
+{
+    const size_t bytePos = _pos >> 3;
+    uint64_t window = 0;
+    if (bytePos + sizeof(window) <= _size)
+    {
+        memcpy(&window, _data + bytePos, sizeof(window));
+        window = BSWAP64(window);
+    }
+    else
+    {
+        // Close to the end - fill what's left with zeros
+        for (size_t i = 0; i < sizeof(window); ++i)
+        {
+            window <<= 8;
+            if (bytePos + i < _size)
+                window |= _data[bytePos + i];
+        }
+    }
+    // At least 57 valid bits left after that
+    return window << (_pos & 7);
+}
+
+uint32_t BitstreamReader::ReadUe()
+{
+    const uint32_t bits = static_cast<uint32_t>(Load() >> 32);
+    if (bits >= (1U << (32 - shortCodeBits + 4)))
+    {
+        const unsigned prefix = bits >> (32 - shortCodeBits);
+        _pos += expGolombTables.shortCodeLength[prefix];
+        return expGolombTables.shortCodeValue[prefix];
+    }
+
+    const unsigned zeros = CountLeadingZeros(bits);
+    if (zeros >= 32)
+    {
+        // Doesn't fit in 32 bits - malformed (or zero padding past the end)
+        _pos = std::max(_pos, _sizeInBits + 1);
+        return 0;
+    }
+    _pos += zeros;
+    return ReadBits(zeros + 1) - 1;
+}
+
+bool BitstreamReader::MoreRbspData() const
+{
+    // Find rbsp_stop_one_bit - the last bit set
+    size_t lastByte = _size;
+    while (lastByte > 0 && _data[lastByte - 1] == 0)
+        --lastByte;
+    if (lastByte == 0)
+        return false;
+
+    uint8_t byte = _data[lastByte - 1];
+    unsigned trailingZeros = 0;
+    while (!(byte & (1 << trailingZeros)))
+        ++trailingZeros;
+    const size_t stopBitPos = lastByte * 8 - 1 - trailingZeros;
+    return _pos < stopBitPos;
+}
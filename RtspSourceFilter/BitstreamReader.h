@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Bit reader for H.264/H.265 RBSP data (emulation prevention bytes already removed).
+ *
+ * Bits are fetched in 64-bit big-endian windows rather than one at a time. Exp-Golomb codes
+ * up to 9 bits long (values 0..30 - most syntax elements) are decoded with a single table
+ * lookup, longer ones count leading zeros a byte at a time with another table.
+ *
+ * Reading past the end yields zeros and marks the reader as overrun - parsers check Overrun()
+ * once they're done instead of checking every read.
+ */
+class BitstreamReader
+{
+public:
+    BitstreamReader(const uint8_t* data, size_t size)
+        : _data(data), _size(size), _sizeInBits(size * 8), _pos(0)
+    {
+    }
+
+    uint32_t ReadBits(unsigned numBits)
+    {
+        // Up to 32 bits at once
+        if (numBits == 0)
+            return 0;
+        uint32_t value = static_cast<uint32_t>(Load() >> (64 - numBits));
+        _pos += numBits;
+        return value;
+    }
+
+    bool ReadFlag() { return ReadBits(1) != 0; }
+
+    void SkipBits(size_t numBits) { _pos += numBits; }
+
+    /**
+     * Unsigned Exp-Golomb code ue(v)
+     */
+    uint32_t ReadUe();
+
+    /**
+     * Signed Exp-Golomb code se(v)
+     */
+    int32_t ReadSe()
+    {
+        uint32_t codeNum = ReadUe();
+        return (codeNum & 1) ? static_cast<int32_t>((codeNum >> 1) + 1)
+                             : -static_cast<int32_t>(codeNum >> 1);
+    }
+
+    /**
+     * more_rbsp_data() - is there anything before the RBSP stop bit
+     */
+    bool MoreRbspData() const;
+
+    size_t BitPosition() const { return _pos; }
+    bool Overrun() const { return _pos > _sizeInBits; }
+
+private:
+    // 64 bits starting at current position, zero-padded past the end
+    uint64_t Load() const;
+
+private:
+    const uint8_t* _data;
+    size_t _size;
+    size_t _sizeInBits;
+    size_t _pos;
+};
+
+/**
+ * Ceil(Log2(value)) as used for u(v) field lengths
+ */
+inline unsigned CeilLog2(uint32_t value)
+{
+    unsigned bits = 0;
+    while (bits < 32 && (uint64_t(1) << bits) < value)
+        ++bits;
+    return bits;
+}
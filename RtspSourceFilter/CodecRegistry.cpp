@@ -0,0 +1,83 @@
+#include "CodecRegistry.h"
+
+#include <cstring>
+
+namespace
+{
+    bool IsAacSupported(MediaSubsession& mediaSubsession);
+    bool IsAacLatmSupported(MediaSubsession& mediaSubsession);
+
+    const RtpCodecInfo rtpCodecs[] = {
+        {RtpCodecH264, "video", "H264", AudioFramingNone, nullptr},
+        {RtpCodecH265, "video", "H265", AudioFramingNone, nullptr},
+        {RtpCodecAac, "audio", "MPEG4-GENERIC", AudioFramingNone, IsAacSupported},
+        {RtpCodecAacLatm, "audio", "MP4A-LATM", AudioFramingLatm, IsAacLatmSupported},
+        {RtpCodecAc3, "audio", "AC3", AudioFramingAc3, nullptr},
+        {RtpCodecPcmu, "audio", "PCMU", AudioFramingNone, nullptr},
+        {RtpCodecPcma, "audio", "PCMA", AudioFramingNone, nullptr},
+        {RtpCodecOpus, "audio", "OPUS", AudioFramingNone, nullptr},
+    };
+
+    bool IsAacSupported(MediaSubsession& mediaSubsession)
+    {
+        // Nothing to build the media type from otherwise
+        std::vector<uint8_t> audioSpecificConfig = GetAudioSpecificConfig(mediaSubsession);
+        AudioSpecificConfig config;
+        return ParseAudioSpecificConfig(audioSpecificConfig.data(), audioSpecificConfig.size(),
+                                        config);
+    }
+
+    bool IsAacLatmSupported(MediaSubsession& mediaSubsession)
+    {
+        // StreamMuxConfig sent in-band isn't byte aligned - only the out-of-band one is taken
+        const char* cpresent = mediaSubsession.attrVal_str("cpresent");
+        if (cpresent[0] != '\0' && strcmp(cpresent, "0"))
+            return false;
+
+        // Single program and layer with all subframes of the same time framing, so each
+        // subframe is PayloadLengthInfo followed by its AAC frame
+        Boolean audioMuxVersion, allStreamsSameTimeFraming;
+        unsigned char numSubFrames, numProgram, numLayer;
+        unsigned char* audioSpecificConfig;
+        unsigned audioSpecificConfigSize;
+        if (!::parseStreamMuxConfigStr(mediaSubsession.fmtp_config(), audioMuxVersion,
+                                       allStreamsSameTimeFraming, numSubFrames, numProgram,
+                                       numLayer, audioSpecificConfig, audioSpecificConfigSize))
+        {
+            return false;
+        }
+        delete[] audioSpecificConfig;
+        return !audioMuxVersion && allStreamsSameTimeFraming && numProgram == 0 &&
+               numLayer == 0 && IsAacSupported(mediaSubsession);
+    }
+}
+
+const RtpCodecInfo* FindRtpCodec(MediaSubsession& mediaSubsession)
+{
+    for (const RtpCodecInfo& rtpCodec : rtpCodecs)
+    {
+        if (!strcmp(mediaSubsession.mediumName(), rtpCodec.mediumName) &&
+            !strcmp(mediaSubsession.codecName(), rtpCodec.codecName))
+        {
+            return !rtpCodec.isSupported || rtpCodec.isSupported(mediaSubsession) ? &rtpCodec
+                                                                                  : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<uint8_t> GetAudioSpecificConfig(MediaSubsession& mediaSubsession)
+{
+    unsigned char* config = nullptr;
+    unsigned configSize = 0;
+    if (!strcmp(mediaSubsession.codecName(), "MPEG4-GENERIC"))
+        config = ::parseGeneralConfigStr(mediaSubsession.fmtp_config(), configSize);
+    else if (!strcmp(mediaSubsession.codecName(), "MP4A-LATM"))
+        config = ::parseStreamMuxConfigStr(mediaSubsession.fmtp_config(), configSize);
+
+    std::vector<uint8_t> audioSpecificConfig;
+    if (config)
+        audioSpecificConfig.assign(config, config + configSize);
+    delete[] config;
+    return audioSpecificConfig;
+}
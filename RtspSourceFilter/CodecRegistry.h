@@ -0,0 +1,49 @@
+#pragma once
+
+#include "liveMedia.hh"
+#include "AudioFraming.h"
+
+#include <cstdint>
+#include <vector>
+
+enum RtpCodec
+{
+    RtpCodecH264,
+    RtpCodecH265,
+    // MPEG4-GENERIC (RFC 3640)
+    RtpCodecAac,
+    // MP4A-LATM (RFC 3016)
+    RtpCodecAacLatm,
+    RtpCodecAc3,
+    // G.711 u-law and A-law
+    RtpCodecPcmu,
+    RtpCodecPcma,
+    RtpCodecOpus
+};
+
+/**
+ * Codec the filter takes from RTSP sessions. Its RTP source (depayloader) is created by
+ * MediaSubsession::initiate() based on the same SDP encoding name - the registry only tells
+ * which ones the filter can make media types for and how their frames are to be cut.
+ */
+struct RtpCodecInfo
+{
+    RtpCodec codec;
+    const char* mediumName;
+    // Encoding name of SDP rtpmap attribute
+    const char* codecName;
+    AudioFraming framing;
+    // Checks SDP format parameters, null if the codec doesn't depend on any
+    bool (*isSupported)(MediaSubsession& mediaSubsession);
+};
+
+/**
+ * Registry entry matching given subsession, null if the filter doesn't support it
+ */
+const RtpCodecInfo* FindRtpCodec(MediaSubsession& mediaSubsession);
+
+/**
+ * AudioSpecificConfig of AAC subsession - config parameter of MPEG4-GENERIC or the one within
+ * StreamMuxConfig of MP4A-LATM. Empty if there's none.
+ */
+std::vector<uint8_t> GetAudioSpecificConfig(MediaSubsession& mediaSubsession);
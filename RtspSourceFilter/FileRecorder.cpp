@@ -0,0 +1,557 @@
+#include "FileRecorder.h"
+#include "H264StreamParser.h"
+#include "H265StreamParser.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <system_error>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <malloc.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // Write-behind buffer - the disk sees writes of that size (aligned for the sake of
+    // the file system cache)
+    const size_t writeBufferSize = 4 * 1024 * 1024;
+    const size_t writeBufferAlignment = 4096;
+    // Buffered samples don't wait for more than that to get to the disk
+    const std::chrono::seconds maxFlushInterval(1);
+    const std::chrono::milliseconds writerPollTime(50);
+    // How far behind the writer can fall before it starts dropping samples
+    const size_t maxQueuedBytes = 64 * 1024 * 1024;
+    // Segments are preallocated in chunks of (up to) that size
+    const uint64_t maxPreallocationChunk = 256 * 1024 * 1024;
+    // No new segment for that long after a write error - the disk is likely full
+    const std::chrono::seconds writeErrorRetryTime(1);
+    // Parameter sets held back until it's known where they're going to
+    const size_t maxPendingParameterSets = 16;
+    const uint8_t startCode[] = {0, 0, 0, 1};
+
+    const intptr_t invalidFile = -1;
+
+#ifdef _WIN32
+    intptr_t CreateSegmentFile(const std::string& path)
+    {
+        const int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+        if (length == 0)
+            return invalidFile;
+        std::vector<wchar_t> widePath(length);
+        MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, widePath.data(), length);
+
+        HANDLE file = CreateFileW(widePath.data(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                                  CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                                  nullptr);
+        return reinterpret_cast<intptr_t>(file);
+    }
+
+    bool WriteToFile(intptr_t file, const uint8_t* data, size_t size)
+    {
+        while (size > 0)
+        {
+            DWORD written = 0;
+            const DWORD toWrite = static_cast<DWORD>(std::min<size_t>(size, 0x40000000));
+            if (!WriteFile(reinterpret_cast<HANDLE>(file), data, toWrite, &written, nullptr))
+                return false;
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    // Reserve disk space up to given size without moving the end of file
+    void PreallocateFile(intptr_t file, uint64_t size)
+    {
+        FILE_ALLOCATION_INFO info;
+        info.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+        SetFileInformationByHandle(reinterpret_cast<HANDLE>(file), FileAllocationInfo, &info,
+                                   sizeof(info));
+    }
+
+    // Space preallocated past what's been written is given back
+    void CloseFile(intptr_t file, uint64_t size)
+    {
+        PreallocateFile(file, size);
+        CloseHandle(reinterpret_cast<HANDLE>(file));
+    }
+
+    uint8_t* AllocateAligned(size_t size, size_t alignment)
+    {
+        return static_cast<uint8_t*>(_aligned_malloc(size, alignment));
+    }
+
+    void FreeAligned(uint8_t* memory) { _aligned_free(memory); }
+#else
+    intptr_t CreateSegmentFile(const std::string& path)
+    {
+        return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+
+    bool WriteToFile(intptr_t file, const uint8_t* data, size_t size)
+    {
+        while (size > 0)
+        {
+            const ssize_t written = ::write(static_cast<int>(file), data, size);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    void PreallocateFile(intptr_t file, uint64_t size)
+    {
+#ifdef __linux__
+        // Not every file system supports it - the file is just written as it comes then
+        fallocate(static_cast<int>(file), FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size));
+#else
+        (void)file;
+        (void)size;
+#endif
+    }
+
+    void CloseFile(intptr_t file, uint64_t size)
+    {
+        if (ftruncate(static_cast<int>(file), static_cast<off_t>(size)) != 0)
+        {
+            // Only the preallocated space isn't given back
+        }
+        close(static_cast<int>(file));
+    }
+
+    uint8_t* AllocateAligned(size_t size, size_t alignment)
+    {
+        void* memory = nullptr;
+        return posix_memalign(&memory, alignment, size) == 0 ? static_cast<uint8_t*>(memory)
+                                                               : nullptr;
+    }
+
+    void FreeAligned(uint8_t* memory) { free(memory); }
+#endif
+
+    FileRecorder::Codec GetCodec(const std::string& codecName)
+    {
+        if (codecName == "H264")
+            return FileRecorder::CodecH264;
+        if (codecName == "H265")
+            return FileRecorder::CodecH265;
+        return FileRecorder::CodecOther;
+    }
+
+    bool IsParameterSet(FileRecorder::Codec codec, const MediaPacketSample& sample)
+    {
+        // Access units carry parameter sets along with the picture
+        if (sample.isAccessUnit() || sample.size() == 0)
+            return false;
+
+        switch (codec)
+        {
+        case FileRecorder::CodecH264:
+        {
+            const unsigned nalType = H264NalType(sample.data());
+            return nalType == H264NalSps || nalType == H264NalPps;
+        }
+        case FileRecorder::CodecH265:
+        {
+            const unsigned nalType = H265NalType(sample.data());
+            return nalType == H265NalVps || nalType == H265NalSps || nalType == H265NalPps;
+        }
+        default:
+            return false;
+        }
+    }
+
+    std::string FileExtension(const std::string& codecName)
+    {
+        std::string extension = codecName.empty() ? "bin" : codecName;
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](char c) { return static_cast<char>(tolower(c)); });
+        return extension;
+    }
+}
+
+FileRecorder::FileRecorder(const char* streamName, size_t queueCapacity)
+    : _streamName(streamName)
+    // No limits - it's up to us to keep it from growing (see record())
+    , _queue(queueCapacity, RtspQueueDropUntilIdr)
+    , _recording(false)
+    , _stopRequested(false)
+    , _producerCodec(CodecOther)
+    , _producerSkipToSyncPoint(false)
+    , _formatGeneration(0)
+    , _segmentMaxBytes(0)
+    , _segmentMaxDuration(0)
+    , _segmentNumber(0)
+    , _writerFormatGeneration(0)
+    , _codec(CodecOther)
+    , _file(invalidFile)
+    , _segmentBytes(0)
+    , _fileBytes(0)
+    , _preallocatedBytes(0)
+    , _buffer(nullptr)
+    , _bufferedBytes(0)
+    , _recordedFrames(0)
+    , _recordedBytes(0)
+    , _skippedFrames(0)
+    , _writeErrors(0)
+    , _segments(0)
+    , _maxWriteMicroseconds(0)
+    , _droppedFrames(0)
+    , _droppedBytes(0)
+    , _overflowEvents(0)
+{
+}
+
+FileRecorder::~FileRecorder()
+{
+    stop();
+    FreeAligned(_buffer);
+}
+
+bool FileRecorder::start(const std::string& pathPrefix, uint64_t segmentMaxBytes,
+                         std::chrono::seconds segmentMaxDuration)
+{
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    stopWriter();
+
+    if (!_buffer)
+    {
+        _buffer = AllocateAligned(writeBufferSize, writeBufferAlignment);
+        if (!_buffer)
+            return false;
+    }
+
+    _pathPrefix = pathPrefix;
+    _segmentMaxBytes = segmentMaxBytes;
+    _segmentMaxDuration = segmentMaxDuration;
+    _segmentNumber = 0;
+    _retryTime = std::chrono::steady_clock::time_point();
+    _lastFlushTime = std::chrono::steady_clock::now();
+    // Whatever the ingest loop managed to queue while we were stopping
+    _queue.clear();
+    // Ingest loop isn't queueing anything while we aren't recording
+    _producerSkipToSyncPoint = false;
+
+    _stopRequested = false;
+    _recording = true;
+    try
+    {
+        _thread = std::thread(&FileRecorder::run, this);
+    }
+    catch (const std::system_error&)
+    {
+        _recording = false;
+        return false;
+    }
+    return true;
+}
+
+void FileRecorder::stop()
+{
+    std::lock_guard<std::mutex> lock(_controlMutex);
+    stopWriter();
+}
+
+void FileRecorder::stopWriter()
+{
+    if (!_thread.joinable())
+        return;
+    // Nothing new gets queued from now on (but for what's being queued right now) - the writer
+    // drains the queue and quits
+    _recording = false;
+    _stopRequested = true;
+    _thread.join();
+}
+
+void FileRecorder::getStats(RtspRecordingStats& stats) const
+{
+    RtspMediaQueueStats queueStats;
+    _queue.getStats(queueStats);
+
+    stats.recordedFrames = _recordedFrames.load(std::memory_order_relaxed);
+    stats.recordedBytes = _recordedBytes.load(std::memory_order_relaxed);
+    // Queue itself drops samples only when it's full to its capacity
+    stats.droppedFrames = queueStats.droppedFrames + _droppedFrames.load(std::memory_order_relaxed);
+    stats.droppedBytes = queueStats.droppedBytes + _droppedBytes.load(std::memory_order_relaxed);
+    stats.overflowEvents =
+        queueStats.overflowEvents + _overflowEvents.load(std::memory_order_relaxed);
+    stats.skippedFrames = _skippedFrames.load(std::memory_order_relaxed);
+    stats.writeErrors = _writeErrors.load(std::memory_order_relaxed);
+    stats.segments = _segments.load(std::memory_order_relaxed);
+    stats.queuedFrames = queueStats.queuedFrames;
+    stats.queuedBytes = queueStats.queuedBytes;
+    stats.maxWriteMicroseconds = _maxWriteMicroseconds.load(std::memory_order_relaxed);
+    stats.recording = recording() ? TRUE : FALSE;
+}
+
+void FileRecorder::setFormat(const char* codecName, const uint8_t* header, size_t headerSize)
+{
+    std::lock_guard<std::mutex> lock(_formatMutex);
+    _codecName = codecName;
+    _header.assign(header, header + headerSize);
+    _formatGeneration.fetch_add(1, std::memory_order_release);
+    _producerCodec = GetCodec(_codecName);
+}
+
+void FileRecorder::record(const MediaPacketSample& sample)
+{
+    if (!_recording.load(std::memory_order_relaxed))
+        return;
+
+    // Writer is that far behind - rather than pinning more slabs, samples are dropped up to
+    // the next sync point. Parameter sets are let through, the sync point is going to need them.
+    if (!IsParameterSet(_producerCodec, sample))
+    {
+        if (_producerSkipToSyncPoint && !sample.isSyncPoint())
+        {
+            countDropped(sample.size());
+            return;
+        }
+        if (_queue.sizeInBytes() + sample.size() > maxQueuedBytes)
+        {
+            if (!_producerSkipToSyncPoint)
+                _overflowEvents.fetch_add(1, std::memory_order_relaxed);
+            _producerSkipToSyncPoint = true;
+            countDropped(sample.size());
+            return;
+        }
+        _producerSkipToSyncPoint = false;
+    }
+
+    // Shares the slab
+    _queue.push(sample.clone());
+}
+
+void FileRecorder::countDropped(size_t sampleSize)
+{
+    _droppedFrames.fetch_add(1, std::memory_order_relaxed);
+    _droppedBytes.fetch_add(sampleSize, std::memory_order_relaxed);
+}
+
+void FileRecorder::run()
+{
+    for (;;)
+    {
+        MediaPacketSample sample;
+        if (_queue.try_pop_for(sample, writerPollTime))
+        {
+            write(std::move(sample));
+        }
+        else if (_stopRequested.load(std::memory_order_relaxed))
+        {
+            break;
+        }
+
+        if (_bufferedBytes > 0 &&
+            std::chrono::steady_clock::now() - _lastFlushTime >= maxFlushInterval)
+        {
+            if (!flush())
+                onWriteError();
+        }
+    }
+
+    _skippedFrames.fetch_add(_pendingParameterSets.size(), std::memory_order_relaxed);
+    _pendingParameterSets.clear();
+    closeSegment();
+}
+
+void FileRecorder::write(MediaPacketSample&& sample)
+{
+    const unsigned formatGeneration = _formatGeneration.load(std::memory_order_acquire);
+    if (formatGeneration != _writerFormatGeneration)
+    {
+        std::lock_guard<std::mutex> lock(_formatMutex);
+        _writerFormatGeneration = _formatGeneration.load(std::memory_order_relaxed);
+        _writerCodecName = _codecName;
+        _writerHeader = _header;
+        _codec = GetCodec(_codecName);
+        // Samples of the new format don't go to the segment of the old one, nor do parameter
+        // sets of the old format
+        _skippedFrames.fetch_add(_pendingParameterSets.size(), std::memory_order_relaxed);
+        _pendingParameterSets.clear();
+        closeSegment();
+    }
+
+    // Parameter sets go wherever the sample following them does - a segment has to start with
+    // the ones ahead of its first sync point
+    if (IsParameterSet(_codec, sample) && _pendingParameterSets.size() < maxPendingParameterSets)
+    {
+        _pendingParameterSets.push_back(std::move(sample));
+        return;
+    }
+
+    if (_file != invalidFile && sample.isSyncPoint())
+    {
+        const bool discontinuity =
+            sample.isDiscontinuity() ||
+            (!_pendingParameterSets.empty() && _pendingParameterSets.front().isDiscontinuity());
+        const bool segmentFull =
+            (_segmentMaxBytes > 0 && _segmentBytes >= _segmentMaxBytes) ||
+            (_segmentMaxDuration.count() > 0 &&
+             sample.arrivalTime() - _segmentStartTime >= _segmentMaxDuration);
+        if (discontinuity || segmentFull)
+            closeSegment();
+    }
+
+    if (_file == invalidFile && (!sample.isSyncPoint() || !openSegment(sample.arrivalTime())))
+    {
+        _skippedFrames.fetch_add(_pendingParameterSets.size() + 1, std::memory_order_relaxed);
+        _pendingParameterSets.clear();
+        return;
+    }
+
+    for (const MediaPacketSample& parameterSet : _pendingParameterSets)
+        writeSample(parameterSet);
+    _pendingParameterSets.clear();
+    writeSample(sample);
+}
+
+bool FileRecorder::openSegment(std::chrono::steady_clock::time_point startTime)
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (now < _retryTime)
+        return false;
+
+    char number[16];
+    snprintf(number, sizeof(number), "%05u", ++_segmentNumber);
+    const std::string path = _pathPrefix + "-" + _streamName + "-" + number + "." +
+                             FileExtension(_writerCodecName);
+
+    _file = CreateSegmentFile(path);
+    recordWriteTime(now);
+    if (_file == invalidFile)
+    {
+        onWriteError();
+        return false;
+    }
+    _segments.fetch_add(1, std::memory_order_relaxed);
+
+    _segmentBytes = 0;
+    _fileBytes = 0;
+    _preallocatedBytes = 0;
+    _segmentStartTime = startTime;
+
+    // Out-of-band parameter sets - in case the stream doesn't repeat them in-band
+    if (!_writerHeader.empty() && !append(_writerHeader.data(), _writerHeader.size()))
+    {
+        onWriteError();
+        return false;
+    }
+    return true;
+}
+
+void FileRecorder::closeSegment()
+{
+    if (_file == invalidFile)
+        return;
+
+    if (!flush())
+        _writeErrors.fetch_add(1, std::memory_order_relaxed);
+    const auto now = std::chrono::steady_clock::now();
+    CloseFile(_file, _fileBytes);
+    recordWriteTime(now);
+    _file = invalidFile;
+    _bufferedBytes = 0;
+}
+
+void FileRecorder::writeSample(const MediaPacketSample& sample)
+{
+    if (_file == invalidFile)
+    {
+        _skippedFrames.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Lone NAL units need start codes of their own
+    const bool prefixStartCode = _codec != CodecOther && !sample.isAccessUnit();
+    if ((prefixStartCode && !append(startCode, sizeof(startCode))) ||
+        !append(sample.data(), sample.size()))
+    {
+        onWriteError();
+        return;
+    }
+    _recordedFrames.fetch_add(1, std::memory_order_relaxed);
+    _recordedBytes.fetch_add(sample.size(), std::memory_order_relaxed);
+}
+
+bool FileRecorder::append(const uint8_t* data, size_t size)
+{
+    _segmentBytes += size;
+    while (size > 0)
+    {
+        const size_t chunk = std::min(size, writeBufferSize - _bufferedBytes);
+        memcpy(_buffer + _bufferedBytes, data, chunk);
+        _bufferedBytes += chunk;
+        data += chunk;
+        size -= chunk;
+        if (_bufferedBytes == writeBufferSize && !flush())
+            return false;
+    }
+    return true;
+}
+
+bool FileRecorder::flush()
+{
+    _lastFlushTime = std::chrono::steady_clock::now();
+    if (_bufferedBytes == 0 || _file == invalidFile)
+        return true;
+
+    // Keep the space ahead of what's written reserved, in chunks
+    if (_fileBytes + _bufferedBytes > _preallocatedBytes)
+    {
+        const uint64_t chunk = _segmentMaxBytes > 0
+                                   ? std::min(_segmentMaxBytes, maxPreallocationChunk)
+                                   : maxPreallocationChunk;
+        _preallocatedBytes = std::max(_fileBytes + _bufferedBytes, _preallocatedBytes + chunk);
+        PreallocateFile(_file, _preallocatedBytes);
+    }
+
+    const bool written = WriteToFile(_file, _buffer, _bufferedBytes);
+    recordWriteTime(_lastFlushTime);
+    if (written)
+        _fileBytes += _bufferedBytes;
+    _bufferedBytes = 0;
+    return written;
+}
+
+void FileRecorder::onWriteError()
+{
+    _writeErrors.fetch_add(1, std::memory_order_relaxed);
+    // Segment is cut short - next one starts with a sync point, once the disk had a break
+    if (_file != invalidFile)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        CloseFile(_file, _fileBytes);
+        recordWriteTime(now);
+        _file = invalidFile;
+    }
+    _bufferedBytes = 0;
+    _retryTime = std::chrono::steady_clock::now() + writeErrorRetryTime;
+}
+
+void FileRecorder::recordWriteTime(std::chrono::steady_clock::time_point since)
+{
+    const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - since)
+                            .count();
+    const uint32_t writeMicroseconds = static_cast<uint32_t>(
+        std::min<int64_t>(micros, std::numeric_limits<uint32_t>::max()));
+    // Single writer
+    if (writeMicroseconds > _maxWriteMicroseconds.load(std::memory_order_relaxed))
+        _maxWriteMicroseconds.store(writeMicroseconds, std::memory_order_relaxed);
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MediaRecorder.h"
+#include "MediaPacketQueue.h"
+#include "RtspSourceFilter.h"
+
+/**
+ * Records a media stream into a series of files (segments) on a writer thread of its own.
+ *
+ * The ingest loop only queues a clone of each sample - it shares the pooled slab - so it's never
+ * held up by the disk. Should the writer fall behind, its queue drops samples up to the next
+ * sync point (like an output pin's queue with RtspQueueDropUntilIdr policy) and counts them.
+ *
+ * The writer gathers samples in a large aligned buffer and writes it out once full (or after
+ * a second of idling), so the disk sees few big sequential writes. Segments are preallocated
+ * ahead of what's written to keep them contiguous and keep writes from growing the file one at
+ * a time. A segment starts with a sync point - along with parameter sets preceding it - and
+ * the out-of-band parameter sets of the stream, so each one is decodable on its own.
+ *
+ * H.264/H.265 is written as Annex B byte stream, other media as the samples come.
+ */
+class FileRecorder : public MediaRecorder
+{
+public:
+    /**
+     * streamName goes into file names, queueCapacity is in samples
+     */
+    FileRecorder(const char* streamName, size_t queueCapacity);
+    ~FileRecorder();
+
+    FileRecorder(const FileRecorder&) = delete;
+    FileRecorder& operator=(const FileRecorder&) = delete;
+
+    /**
+     * Start recording to <pathPrefix>-<stream name>-<segment number>.<codec> (UTF-8 path).
+     * Next segment starts on a sync point once the current one reaches either limit (0 for no
+     * limit). Stops first if recording already. Returns false if the writer couldn't start.
+     */
+    bool start(const std::string& pathPrefix, uint64_t segmentMaxBytes,
+               std::chrono::seconds segmentMaxDuration);
+
+    /**
+     * Write out whatever is queued and close the segment
+     */
+    void stop();
+
+    bool recording() const { return _recording.load(std::memory_order_relaxed); }
+
+    void getStats(RtspRecordingStats& stats) const;
+
+    // MediaRecorder - ingest loop thread
+    void setFormat(const char* codecName, const uint8_t* header, size_t headerSize) override;
+    void record(const MediaPacketSample& sample) override;
+
+    enum Codec
+    {
+        CodecOther,
+        CodecH264,
+        CodecH265
+    };
+
+private:
+    void stopWriter();
+    void countDropped(size_t sampleSize);
+
+    // Writer thread
+    void run();
+    void write(MediaPacketSample&& sample);
+    void writeSample(const MediaPacketSample& sample);
+    bool openSegment(std::chrono::steady_clock::time_point startTime);
+    void closeSegment();
+    // Goes to the write-behind buffer, false if the disk failed to take it once full
+    bool append(const uint8_t* data, size_t size);
+    bool flush();
+    // Segment is given up
+    void onWriteError();
+    void recordWriteTime(std::chrono::steady_clock::time_point since);
+
+private:
+    const std::string _streamName;
+    MediaPacketQueue _queue;
+    std::atomic<bool> _recording;
+    std::atomic<bool> _stopRequested;
+    std::thread _thread;
+    // Serializes start() and stop()
+    std::mutex _controlMutex;
+
+    // Ingest loop thread
+    Codec _producerCodec;
+    // Writer has fallen behind - incoming samples are dropped until the next sync point
+    bool _producerSkipToSyncPoint;
+
+    // Set by the ingest loop, taken over by the writer along with samples following it
+    std::mutex _formatMutex;
+    std::string _codecName;
+    std::vector<uint8_t> _header;
+    std::atomic<unsigned> _formatGeneration;
+
+    // Writer thread (settings are set before it starts)
+    std::string _pathPrefix;
+    uint64_t _segmentMaxBytes;
+    std::chrono::steady_clock::duration _segmentMaxDuration;
+    unsigned _segmentNumber;
+    unsigned _writerFormatGeneration;
+    std::string _writerCodecName;
+    std::vector<uint8_t> _writerHeader;
+    Codec _codec;
+    std::vector<MediaPacketSample> _pendingParameterSets;
+    // Platform file handle
+    intptr_t _file;
+    // Bytes taken into the segment, written to the file and preallocated for it
+    uint64_t _segmentBytes;
+    uint64_t _fileBytes;
+    uint64_t _preallocatedBytes;
+    std::chrono::steady_clock::time_point _segmentStartTime;
+    // No new segment before that after a write error
+    std::chrono::steady_clock::time_point _retryTime;
+    // Write-behind buffer
+    uint8_t* _buffer;
+    size_t _bufferedBytes;
+    std::chrono::steady_clock::time_point _lastFlushTime;
+
+    // Statistics
+    std::atomic<uint64_t> _recordedFrames;
+    std::atomic<uint64_t> _recordedBytes;
+    std::atomic<uint64_t> _skippedFrames;
+    std::atomic<uint64_t> _writeErrors;
+    std::atomic<uint32_t> _segments;
+    std::atomic<uint32_t> _maxWriteMicroseconds;
+    std::atomic<uint64_t> _droppedFrames;
+    std::atomic<uint64_t> _droppedBytes;
+    std::atomic<uint64_t> _overflowEvents;
+};
@@ -0,0 +1,85 @@
+#include "GopCache.h"
+
+void GopCacheCounters::getStats(RtspGopCacheStats& stats) const
+{
+    stats.hits = hits.load(std::memory_order_relaxed);
+    stats.misses = misses.load(std::memory_order_relaxed);
+    stats.cachedFrames = static_cast<DWORD>(cachedFrames.load(std::memory_order_relaxed));
+    stats.cachedBytes = static_cast<DWORD>(cachedBytes.load(std::memory_order_relaxed));
+}
+
+GopCache::GopCache(size_t maxBytes, size_t maxFrames)
+    : _maxBytes(maxBytes), _maxFrames(maxFrames), _gopBytes(0)
+{
+}
+
+void GopCache::add(const MediaPacketSample& sample, int parameterSetId)
+{
+    if (_maxBytes == 0)
+        return;
+
+    // Kept aside - they're replayed ahead of the GOP anyway
+    if (parameterSetId >= 0)
+    {
+        for (auto& parameterSet : _parameterSets)
+        {
+            if (parameterSet.first == parameterSetId)
+            {
+                parameterSet.second = sample.clone();
+                return;
+            }
+        }
+        _parameterSets.push_back(std::make_pair(parameterSetId, sample.clone()));
+        return;
+    }
+
+    if (sample.isSyncPoint())
+    {
+        clear();
+    }
+    // Don't start in the middle of GOP
+    else if (_gop.empty())
+    {
+        return;
+    }
+
+    if ((_maxFrames > 0 && _gop.size() >= _maxFrames) || _gopBytes + sample.size() > _maxBytes)
+    {
+        clear();
+        return;
+    }
+
+    _gopBytes += sample.size();
+    _gop.push_back(sample.clone());
+}
+
+bool GopCache::replay(std::vector<MediaPacketSample>& samples) const
+{
+    if (_gop.empty())
+        return false;
+
+    // As if they all arrived with the newest one
+    const timeval& newest = _gop.back().presentationTime();
+    const auto newestArrival = _gop.back().arrivalTime();
+
+    // Parameter sets may have come long before the GOP started
+    for (const auto& parameterSet : _parameterSets)
+    {
+        samples.push_back(parameterSet.second.clone());
+        samples.back().setPresentationTime(newest);
+        samples.back().setArrivalTime(newestArrival);
+    }
+    for (const MediaPacketSample& sample : _gop)
+    {
+        samples.push_back(sample.clone());
+        samples.back().setPresentationTime(newest);
+        samples.back().setArrivalTime(newestArrival);
+    }
+    return true;
+}
+
+void GopCache::clear()
+{
+    _gop.clear();
+    _gopBytes = 0;
+}
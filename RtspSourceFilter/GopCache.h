@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "MediaPacketSample.h"
+#include "RtspSourceFilter.h"
+
+/**
+ * Counters shared by all GOP caches of a filter. Can be read from any thread.
+ */
+struct GopCacheCounters
+{
+    GopCacheCounters() : hits(0), misses(0), cachedFrames(0), cachedBytes(0) {}
+
+    void getStats(RtspGopCacheStats& stats) const;
+
+    // Consumers started from cached GOP / had to wait for the next sync point
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    // Content of the cache feeding output pins
+    std::atomic<size_t> cachedFrames;
+    std::atomic<size_t> cachedBytes;
+};
+
+/**
+ * Everything since the most recent sync point (IDR for H.264, IRAP for H.265) together with
+ * the parameter sets in effect, so a consumer joining late can start decoding right away
+ * instead of waiting for the next sync point. Cached samples share pooled slabs with the ones passed downstream -
+ * nothing is copied.
+ *
+ * Used from the ingest loop thread only.
+ */
+class GopCache
+{
+public:
+    /**
+     * GOP exceeding any of the limits is dropped and the cache stays empty until the next
+     * sync point. maxBytes of 0 disables caching.
+     */
+    GopCache(size_t maxBytes, size_t maxFrames);
+
+    GopCache(const GopCache&) = delete;
+    GopCache& operator=(const GopCache&) = delete;
+
+    /**
+     * Cache a sample. parameterSetId identifies parameter set samples (f.e. NAL unit type
+     * for H.264) - only the latest one of each kind is kept - and is negative for all others.
+     */
+    void add(const MediaPacketSample& sample, int parameterSetId);
+
+    /**
+     * Append clones of cached samples to given vector, rebased so they're all due at the time
+     * of the newest one - the consumer catches up with live right away.
+     * Returns false if there's no GOP to start from.
+     */
+    bool replay(std::vector<MediaPacketSample>& samples) const;
+
+    void clear();
+
+    bool empty() const { return _gop.empty(); }
+    size_t frames() const { return _gop.size(); }
+    size_t bytes() const { return _gopBytes; }
+
+private:
+    size_t _maxBytes;
+    size_t _maxFrames;
+    // Latest parameter set of each kind
+    std::vector<std::pair<int, MediaPacketSample>> _parameterSets;
+    // Starts with a sync point unless empty
+    std::vector<MediaPacketSample> _gop;
+    size_t _gopBytes;
+};
@@ -1,150 +1,410 @@
 #include "H264StreamParser.h"
+#include "BitstreamReader.h"
 
-#include "BitVector.hh"
 #include "H264or5VideoStreamFramer.hh"
-#define SPS_MAX_SIZE 1000
+
+#include <algorithm>
+#include <vector>
 
 namespace
 {
     const uint8_t subWidthChroma[] = {1, 2, 2, 1};
     const uint8_t subHeightChroma[] = {1, 2, 1, 1};
+
+    // Slice header fields we're interested in are always within that many bytes
+    const size_t sliceHeaderMaxSize = 64;
+
+    // Frame size in macroblocks is kept within the limits of the highest level (6.2), with
+    // a lot of room to spare, so derived values never overflow
+    const unsigned maxPicSizeInMbs = 4096;
+
+    unsigned ToRbsp(std::vector<uint8_t>& rbsp, const uint8_t* nal, size_t nalSize)
+    {
+        rbsp.resize(nalSize);
+        return removeH264or5EmulationBytes(rbsp.data(), static_cast<unsigned>(rbsp.size()), nal,
+                                           static_cast<unsigned>(nalSize));
+    }
+
+    bool SkipScalingList(BitstreamReader& br, unsigned sizeOfScalingList)
+    {
+        int lastScale = 8;
+        int nextScale = 8;
+        for (unsigned j = 0; j < sizeOfScalingList; ++j)
+        {
+            if (nextScale != 0)
+            {
+                int deltaScale = br.ReadSe();
+                if (deltaScale < -128 || deltaScale > 127)
+                    return false;
+                nextScale = (lastScale + deltaScale + 256) % 256;
+            }
+            lastScale = (nextScale == 0) ? lastScale : nextScale;
+        }
+        return true;
+    }
+
+    bool SkipHrdParameters(BitstreamReader& br)
+    {
+        unsigned cpbCnt = br.ReadUe() + 1;
+        if (cpbCnt > 32)
+            return false;
+        br.SkipBits(4); // bit_rate_scale
+        br.SkipBits(4); // cpb_size_scale
+        for (unsigned i = 0; i < cpbCnt; ++i)
+        {
+            br.ReadUe(); // bit_rate_value_minus1
+            br.ReadUe(); // cpb_size_value_minus1
+            br.SkipBits(1); // cbr_flag
+        }
+        br.SkipBits(5); // initial_cpb_removal_delay_length_minus1
+        br.SkipBits(5); // cpb_removal_delay_length_minus1
+        br.SkipBits(5); // dpb_output_delay_length_minus1
+        br.SkipBits(5); // time_offset_length
+        return true;
+    }
+
+    bool ParseVui(BitstreamReader& br, H264Sps& sps)
+    {
+        if (br.ReadFlag()) // aspect_ratio_info_present_flag
+        {
+            sps.aspectRatioIdc = br.ReadBits(8);
+            if (sps.aspectRatioIdc == 255 /*Extended_SAR*/)
+            {
+                sps.sarWidth = br.ReadBits(16);
+                sps.sarHeight = br.ReadBits(16);
+            }
+        }
+        if (br.ReadFlag()) // overscan_info_present_flag
+            br.SkipBits(1); // overscan_appropriate_flag
+        if (br.ReadFlag()) // video_signal_type_present_flag
+        {
+            sps.videoFormat = br.ReadBits(3);
+            sps.videoFullRange = br.ReadFlag();
+            if (br.ReadFlag()) // colour_description_present_flag
+            {
+                sps.colourPrimaries = br.ReadBits(8);
+                sps.transferCharacteristics = br.ReadBits(8);
+                sps.matrixCoefficients = br.ReadBits(8);
+            }
+        }
+        if (br.ReadFlag()) // chroma_loc_info_present_flag
+        {
+            br.ReadUe(); // chroma_sample_loc_type_top_field
+            br.ReadUe(); // chroma_sample_loc_type_bottom_field
+        }
+        if (br.ReadFlag()) // timing_info_present_flag
+        {
+            sps.numUnitsInTick = br.ReadBits(32);
+            sps.timeScale = br.ReadBits(32);
+            sps.fixedFrameRate = br.ReadFlag();
+        }
+        sps.nalHrdParametersPresent = br.ReadFlag();
+        if (sps.nalHrdParametersPresent && !SkipHrdParameters(br))
+            return false;
+        sps.vclHrdParametersPresent = br.ReadFlag();
+        if (sps.vclHrdParametersPresent && !SkipHrdParameters(br))
+            return false;
+        if (sps.nalHrdParametersPresent || sps.vclHrdParametersPresent)
+            br.SkipBits(1); // low_delay_hrd_flag
+        sps.picStructPresent = br.ReadFlag();
+        sps.bitstreamRestriction = br.ReadFlag();
+        if (sps.bitstreamRestriction)
+        {
+            br.SkipBits(1); // motion_vectors_over_pic_boundaries_flag
+            br.ReadUe();    // max_bytes_per_pic_denom
+            br.ReadUe();    // max_bits_per_mb_denom
+            br.ReadUe();    // log2_max_mv_length_horizontal
+            br.ReadUe();    // log2_max_mv_length_vertical
+            sps.maxNumReorderFrames = br.ReadUe();
+            sps.maxDecFrameBuffering = br.ReadUe();
+        }
+        return true;
+    }
 }
 
-H264StreamParser::H264StreamParser(uint8_t* sps, unsigned spsSize)
-    : _sps(SPS_MAX_SIZE), _width(0), _height(0), _framerate(0)
+bool ParseH264Sps(const uint8_t* nal, size_t nalSize, H264Sps& sps)
 {
-    spsSize = removeH264or5EmulationBytes(_sps.data(), _sps.size(), sps, spsSize);
-
-    BitVector bv(_sps.data(), 0, spsSize * 8);
-    bv.skipBits(8); // forbidden_zero_bit; nal_ref_idc; nal_unit_type
-    unsigned profile_idc = bv.getBits(8);
-    bv.skipBits(8); // 6 constraint_setN_flag and "reserved_zero_2bits" at the end
-    bv.skipBits(8); // level_idc
-    unsigned seq_parameter_set_id = bv.get_expGolomb();
-    unsigned chroma_format_idc = 1;
-    Boolean separate_colour_plane_flag = False;
-    if (profile_idc == 100 || // High profile
-        profile_idc == 110 || // High10 profile
-        profile_idc == 122 || // High422 profile
-        profile_idc == 244 || // High444 Predictive profile
-        profile_idc == 44 ||  // Cavlc444 profile
-        profile_idc == 83 ||  // Scalable Constrained High profile (SVC)
-        profile_idc == 86 ||  // Scalable High Intra profile (SVC)
-        profile_idc == 118 || // Stereo High profile (MVC)
-        profile_idc == 128 || // Multiview High profile (MVC)
-        profile_idc == 138 || // Multiview Depth High profile (MVCD)
-        profile_idc == 144)   // old High444 profile
+    sps = H264Sps();
+    if (nalSize < 4 || H264NalType(nal) != H264NalSps)
+        return false;
+
+    std::vector<uint8_t> rbsp;
+    unsigned rbspSize = ToRbsp(rbsp, nal, nalSize);
+    BitstreamReader br(rbsp.data(), rbspSize);
+    br.SkipBits(8); // forbidden_zero_bit; nal_ref_idc; nal_unit_type
+    sps.profileIdc = br.ReadBits(8);
+    sps.constraintFlags = br.ReadBits(8);
+    sps.levelIdc = br.ReadBits(8);
+    sps.spsId = br.ReadUe();
+    if (sps.spsId >= H264MaxSpsCount)
+        return false;
+
+    sps.chromaFormatIdc = 1;
+    sps.bitDepthLuma = 8;
+    sps.bitDepthChroma = 8;
+    if (sps.profileIdc == 100 || // High profile
+        sps.profileIdc == 110 || // High10 profile
+        sps.profileIdc == 122 || // High422 profile
+        sps.profileIdc == 244 || // High444 Predictive profile
+        sps.profileIdc == 44 ||  // Cavlc444 profile
+        sps.profileIdc == 83 ||  // Scalable Constrained High profile (SVC)
+        sps.profileIdc == 86 ||  // Scalable High Intra profile (SVC)
+        sps.profileIdc == 118 || // Stereo High profile (MVC)
+        sps.profileIdc == 128 || // Multiview High profile (MVC)
+        sps.profileIdc == 138 || // Multiview Depth High profile (MVCD)
+        sps.profileIdc == 139 || // Enhanced Multiview Depth High profile (3D-AVC)
+        sps.profileIdc == 134 || // MFC High profile
+        sps.profileIdc == 135 || // MFC Depth High profile
+        sps.profileIdc == 144)   // old High444 profile
     {
-        chroma_format_idc = bv.get_expGolomb();
-        if (chroma_format_idc == 3)
-            separate_colour_plane_flag = bv.get1BitBoolean();
-        bv.get_expGolomb(); // bit_depth_luma_minus8
-        bv.get_expGolomb(); // bit_depth_chroma_minus8
-        bv.skipBits(1);     // qpprime_y_zero_transform_bypass_flag
-        Boolean seq_scaling_matrix_present_flag = bv.get1BitBoolean();
-        if (seq_scaling_matrix_present_flag)
+        sps.chromaFormatIdc = br.ReadUe();
+        if (sps.chromaFormatIdc > 3)
+            return false;
+        if (sps.chromaFormatIdc == 3)
+            sps.separateColourPlane = br.ReadFlag();
+        sps.bitDepthLuma = br.ReadUe() + 8;
+        sps.bitDepthChroma = br.ReadUe() + 8;
+        if (sps.bitDepthLuma > 14 || sps.bitDepthChroma > 14)
+            return false;
+        sps.qpprimeYZeroTransformBypass = br.ReadFlag();
+        sps.seqScalingMatrixPresent = br.ReadFlag();
+        if (sps.seqScalingMatrixPresent)
         {
-            for (int i = 0; i < ((chroma_format_idc != 3) ? 8 : 12); ++i)
+            for (unsigned i = 0; i < ((sps.chromaFormatIdc != 3) ? 8U : 12U); ++i)
             {
-                Boolean seq_scaling_list_present_flag = bv.get1BitBoolean();
-                if (seq_scaling_list_present_flag)
-                {
-                    // Decode scaling matrices
-                    unsigned sizeOfScalingList = i < 6 ? 16 : 64;
-                    unsigned lastScale = 8;
-                    unsigned nextScale = 8;
-                    for (unsigned j = 0; j < sizeOfScalingList; ++j)
-                    {
-                        if (nextScale != 0)
-                        {
-                            unsigned delta_scale = bv.get_expGolomb();
-                            nextScale = (lastScale + delta_scale + 256) % 256;
-                        }
-                        lastScale = (nextScale == 0) ? lastScale : nextScale;
-                    }
-                }
+                // seq_scaling_list_present_flag
+                if (br.ReadFlag() && !SkipScalingList(br, i < 6 ? 16 : 64))
+                    return false;
             }
         }
     }
-    unsigned log2_max_frame_num_minus4 = bv.get_expGolomb();
-    unsigned pic_order_cnt_type = bv.get_expGolomb();
-    if (pic_order_cnt_type == 0)
+
+    sps.log2MaxFrameNum = br.ReadUe() + 4;
+    if (sps.log2MaxFrameNum > 16)
+        return false;
+    sps.picOrderCntType = br.ReadUe();
+    if (sps.picOrderCntType == 0)
+    {
+        sps.log2MaxPicOrderCntLsb = br.ReadUe() + 4;
+        if (sps.log2MaxPicOrderCntLsb > 16)
+            return false;
+    }
+    else if (sps.picOrderCntType == 1)
     {
-        bv.get_expGolomb(); // log2_max_pic_order_cnt_lsb_minus4
+        sps.deltaPicOrderAlwaysZero = br.ReadFlag();
+        sps.offsetForNonRefPic = br.ReadSe();
+        sps.offsetForTopToBottomField = br.ReadSe();
+        sps.numRefFramesInPicOrderCntCycle = br.ReadUe();
+        if (sps.numRefFramesInPicOrderCntCycle > 255)
+            return false;
+        for (unsigned i = 0; i < sps.numRefFramesInPicOrderCntCycle; ++i)
+            br.ReadSe(); // offset_for_ref_frame[i]
     }
-    else if (pic_order_cnt_type == 1)
+    else if (sps.picOrderCntType != 2)
     {
-        bv.skipBits(1);     // delta_pic_order_always_zero_flag
-        bv.get_expGolomb(); // offset_for_non_ref_pic SIGNED!
-        bv.get_expGolomb(); // offset_for_top_to_bottom_field SIGNED!
-        unsigned num_ref_frames_in_pic_order_cnt_cycle = bv.get_expGolomb();
-        for (unsigned i = 0; i < num_ref_frames_in_pic_order_cnt_cycle; ++i)
-            bv.get_expGolomb(); // offset_for_ref_frame[i] SIGNED!
+        return false;
     }
-    unsigned num_ref_frames = bv.get_expGolomb();
-    Boolean gaps_in_frame_num_value_allowed_flag = bv.get1BitBoolean();
-    unsigned pic_width_in_mbs_minus1 = bv.get_expGolomb();
-    unsigned pic_height_in_map_units_minus1 = bv.get_expGolomb();
-    Boolean frame_mbs_only_flag = bv.get1BitBoolean();
-    if (!frame_mbs_only_flag)
-        bv.skipBits(1); // mb_adaptive_frame_field_flag
-    bv.skipBits(1);     // direct_8x8_inference_flag
-    Boolean frame_cropping_flag = bv.get1BitBoolean();
-    unsigned frame_crop_left_offset = 0, frame_crop_right_offset = 0, frame_crop_top_offset = 0,
-             frame_crop_bottom_offset = 0;
-    if (frame_cropping_flag)
+
+    sps.maxNumRefFrames = br.ReadUe();
+    sps.gapsInFrameNumValueAllowed = br.ReadFlag();
+    sps.picWidthInMbs = br.ReadUe() + 1;
+    sps.picHeightInMapUnits = br.ReadUe() + 1;
+    if (sps.picWidthInMbs > maxPicSizeInMbs || sps.picHeightInMapUnits > maxPicSizeInMbs)
+        return false;
+    sps.frameMbsOnly = br.ReadFlag();
+    if (!sps.frameMbsOnly)
+        sps.mbAdaptiveFrameField = br.ReadFlag();
+    sps.direct8x8Inference = br.ReadFlag();
+    if (br.ReadFlag()) // frame_cropping_flag
     {
-        frame_crop_left_offset = bv.get_expGolomb();
-        frame_crop_right_offset = bv.get_expGolomb();
-        frame_crop_top_offset = bv.get_expGolomb();
-        frame_crop_bottom_offset = bv.get_expGolomb();
+        sps.cropLeft = br.ReadUe();
+        sps.cropRight = br.ReadUe();
+        sps.cropTop = br.ReadUe();
+        sps.cropBottom = br.ReadUe();
     }
 
     // Formula taken from MediaInfo
-    _width = (pic_width_in_mbs_minus1 + 1) * 16;
-    _height = (pic_height_in_map_units_minus1 + 1) * 16 * (2 - frame_mbs_only_flag);
-    unsigned chromaArrayType = separate_colour_plane_flag ? 0 : chroma_format_idc;
+    sps.width = sps.picWidthInMbs * 16;
+    sps.height = sps.picHeightInMapUnits * 16 * (2 - sps.frameMbsOnly);
+    unsigned chromaArrayType = sps.separateColourPlane ? 0 : sps.chromaFormatIdc;
     unsigned cropUnitX = subWidthChroma[chromaArrayType];
-    unsigned cropUnitY = subHeightChroma[chromaArrayType] * (2 - frame_mbs_only_flag);
-    _width -= (frame_crop_left_offset + frame_crop_right_offset) * cropUnitX;
-    _height -= (frame_crop_top_offset + frame_crop_bottom_offset) * cropUnitY;
+    unsigned cropUnitY = subHeightChroma[chromaArrayType] * (2 - sps.frameMbsOnly);
+    // Compared in 64 bits - offsets are arbitrary in a malformed SPS
+    if (uint64_t(sps.cropLeft) + sps.cropRight >= sps.width / cropUnitX ||
+        uint64_t(sps.cropTop) + sps.cropBottom >= sps.height / cropUnitY)
+        return false;
+    sps.width -= (sps.cropLeft + sps.cropRight) * cropUnitX;
+    sps.height -= (sps.cropTop + sps.cropBottom) * cropUnitY;
+
+    sps.vuiParametersPresent = br.ReadFlag();
+    if (sps.vuiParametersPresent && !ParseVui(br, sps))
+        return false;
+
+    if (sps.numUnitsInTick != 0 && sps.timeScale != 0)
+        sps.framerate = (double)sps.timeScale / (double)sps.numUnitsInTick / 2.0;
+
+    return !br.Overrun();
+}
+
+bool ParseH264Pps(const uint8_t* nal, size_t nalSize, H264Pps& pps, const H264Sps* sps)
+{
+    pps = H264Pps();
+    if (nalSize < 2 || H264NalType(nal) != H264NalPps)
+        return false;
+
+    std::vector<uint8_t> rbsp;
+    unsigned rbspSize = ToRbsp(rbsp, nal, nalSize);
+    BitstreamReader br(rbsp.data(), rbspSize);
+    br.SkipBits(8); // forbidden_zero_bit; nal_ref_idc; nal_unit_type
+    pps.ppsId = br.ReadUe();
+    pps.spsId = br.ReadUe();
+    if (pps.ppsId >= H264MaxPpsCount || pps.spsId >= H264MaxSpsCount)
+        return false;
+    pps.entropyCodingMode = br.ReadFlag();
+    pps.bottomFieldPicOrderInFramePresent = br.ReadFlag();
 
-    Boolean vui_parameters_present_flag = bv.get1BitBoolean();
-    if (vui_parameters_present_flag)
+    pps.numSliceGroups = br.ReadUe() + 1;
+    if (pps.numSliceGroups == 0 || pps.numSliceGroups > 8)
+        return false;
+    if (pps.numSliceGroups > 1)
     {
-        // Decode VUI
-        Boolean aspect_ratio_info_present_flag = bv.get1BitBoolean();
-        if (aspect_ratio_info_present_flag)
+        pps.sliceGroupMapType = br.ReadUe();
+        switch (pps.sliceGroupMapType)
         {
-            unsigned aspect_ratio_idc = bv.getBits(8);
-            if (aspect_ratio_idc == 255 /*Extended_SAR*/)
-                bv.skipBits(32); // sar_width(16); sar_height(16)
-        }
-        Boolean overscan_info_present_flag = bv.get1BitBoolean();
-        if (overscan_info_present_flag)
-            bv.skipBits(1); // overscan_appropriate_flag
-        Boolean video_signal_type_present_flag = bv.get1BitBoolean();
-        if (video_signal_type_present_flag)
+        case 0:
+            for (unsigned i = 0; i < pps.numSliceGroups; ++i)
+                br.ReadUe(); // run_length_minus1
+            break;
+        case 2:
+            for (unsigned i = 0; i < pps.numSliceGroups - 1; ++i)
+            {
+                br.ReadUe(); // top_left
+                br.ReadUe(); // bottom_right
+            }
+            break;
+        case 3:
+        case 4:
+        case 5:
+            br.SkipBits(1); // slice_group_change_direction_flag
+            br.ReadUe();    // slice_group_change_rate_minus1
+            break;
+        case 6:
         {
-            bv.skipBits(4); // video_format(3); video_full_range_flag(1)
-            Boolean colour_description_present_flag = bv.get1BitBoolean();
-            if (colour_description_present_flag)
-                bv.skipBits(24); // colour_primaries(8); transfer_characteristics(8);
-                                 // matrix_coefficients(8)
+            unsigned picSizeInMapUnits = br.ReadUe() + 1;
+            if (picSizeInMapUnits > maxPicSizeInMbs * maxPicSizeInMbs)
+                return false;
+            // slice_group_id[i]
+            br.SkipBits(size_t(picSizeInMapUnits) * CeilLog2(pps.numSliceGroups));
+            break;
         }
-        Boolean chroma_loc_info_present_flag = bv.get1BitBoolean();
-        if (chroma_loc_info_present_flag)
-        {
-            bv.get_expGolomb(); // chroma_sample_loc_type_top_field
-            bv.get_expGolomb(); // chroma_sample_loc_type_bottom_field
+        case 1:
+            break;
+        default:
+            return false;
         }
-        Boolean timing_info_present_flag = bv.get1BitBoolean();
-        if (timing_info_present_flag)
+    }
+
+    pps.numRefIdxL0DefaultActive = br.ReadUe() + 1;
+    pps.numRefIdxL1DefaultActive = br.ReadUe() + 1;
+    if (pps.numRefIdxL0DefaultActive - 1 >= 32 || pps.numRefIdxL1DefaultActive - 1 >= 32)
+        return false;
+    pps.weightedPred = br.ReadFlag();
+    pps.weightedBipredIdc = br.ReadBits(2);
+    pps.picInitQp = br.ReadSe() + 26;
+    pps.picInitQs = br.ReadSe() + 26;
+    pps.chromaQpIndexOffset = br.ReadSe();
+    if (pps.weightedBipredIdc > 2 || pps.chromaQpIndexOffset < -12 || pps.chromaQpIndexOffset > 12)
+        return false;
+    pps.deblockingFilterControlPresent = br.ReadFlag();
+    pps.constrainedIntraPred = br.ReadFlag();
+    pps.redundantPicCntPresent = br.ReadFlag();
+
+    pps.secondChromaQpIndexOffset = pps.chromaQpIndexOffset;
+    if (br.MoreRbspData())
+    {
+        pps.transform8x8Mode = br.ReadFlag();
+        pps.picScalingMatrixPresent = br.ReadFlag();
+        if (pps.picScalingMatrixPresent)
         {
-            unsigned num_units_in_tick = bv.getBits(32);
-            unsigned time_scale = bv.getBits(32);
-            Boolean fixed_frame_rate_flag = bv.get1BitBoolean();
-            _framerate = (double)time_scale / (double)num_units_in_tick / 2.0;
+            unsigned chromaFormatIdc = sps ? sps->chromaFormatIdc : 1;
+            unsigned numLists =
+                6 + ((chromaFormatIdc != 3) ? 2 : 6) * (pps.transform8x8Mode ? 1 : 0);
+            for (unsigned i = 0; i < numLists; ++i)
+            {
+                // pic_scaling_list_present_flag
+                if (br.ReadFlag() && !SkipScalingList(br, i < 6 ? 16 : 64))
+                    return false;
+            }
         }
+        pps.secondChromaQpIndexOffset = br.ReadSe();
+        if (pps.secondChromaQpIndexOffset < -12 || pps.secondChromaQpIndexOffset > 12)
+            return false;
     }
-}
\ No newline at end of file
+
+    return !br.Overrun();
+}
+
+bool ParseH264SlicePpsId(const uint8_t* nal, size_t nalSize, unsigned& ppsId)
+{
+    if (nalSize < 2)
+        return false;
+
+    uint8_t rbsp[sliceHeaderMaxSize];
+    unsigned rbspSize = removeH264or5EmulationBytes(
+        rbsp, sizeof(rbsp), nal, static_cast<unsigned>(std::min(nalSize, sizeof(rbsp))));
+    BitstreamReader br(rbsp, rbspSize);
+    br.SkipBits(8); // forbidden_zero_bit; nal_ref_idc; nal_unit_type
+    br.ReadUe();    // first_mb_in_slice
+    br.ReadUe();    // slice_type
+    ppsId = br.ReadUe();
+    return !br.Overrun() && ppsId < H264MaxPpsCount;
+}
+
+bool ParseH264SliceHeader(const uint8_t* nal, size_t nalSize, const H264Sps& sps,
+                          const H264Pps& pps, H264SliceHeader& header)
+{
+    header = H264SliceHeader();
+    if (nalSize < 2)
+        return false;
+
+    uint8_t rbsp[sliceHeaderMaxSize];
+    unsigned rbspSize = removeH264or5EmulationBytes(
+        rbsp, sizeof(rbsp), nal, static_cast<unsigned>(std::min(nalSize, sizeof(rbsp))));
+    BitstreamReader br(rbsp, rbspSize);
+    br.SkipBits(1); // forbidden_zero_bit
+    header.nalRefIdc = br.ReadBits(2);
+    header.nalUnitType = br.ReadBits(5);
+    header.firstMbInSlice = br.ReadUe();
+    header.sliceType = br.ReadUe();
+    header.ppsId = br.ReadUe();
+    if (header.sliceType > 9 || header.ppsId != pps.ppsId || pps.spsId != sps.spsId)
+        return false;
+
+    if (sps.separateColourPlane)
+        header.colourPlaneId = br.ReadBits(2);
+    header.frameNum = br.ReadBits(sps.log2MaxFrameNum);
+    if (!sps.frameMbsOnly)
+    {
+        header.fieldPic = br.ReadFlag();
+        if (header.fieldPic)
+            header.bottomField = br.ReadFlag();
+    }
+    if (header.nalUnitType == H264NalSliceIdr)
+        header.idrPicId = br.ReadUe();
+    if (sps.picOrderCntType == 0)
+    {
+        header.picOrderCntLsb = br.ReadBits(sps.log2MaxPicOrderCntLsb);
+        if (pps.bottomFieldPicOrderInFramePresent && !header.fieldPic)
+            header.deltaPicOrderCntBottom = br.ReadSe();
+    }
+    if (sps.picOrderCntType == 1 && !sps.deltaPicOrderAlwaysZero)
+    {
+        header.deltaPicOrderCnt[0] = br.ReadSe();
+        if (pps.bottomFieldPicOrderInFramePresent && !header.fieldPic)
+            header.deltaPicOrderCnt[1] = br.ReadSe();
+    }
+    if (pps.redundantPicCntPresent)
+        header.redundantPicCnt = br.ReadUe();
+
+    return !br.Overrun();
+}
@@ -1,25 +1,152 @@
 #pragma once
 
-#include <vector>
+#include <cstddef>
 #include <cstdint>
 
+// Parameter set id ranges
+const unsigned H264MaxSpsCount = 32;
+const unsigned H264MaxPpsCount = 256;
+
+enum H264NalUnitType
+{
+    H264NalSlice = 1,
+    H264NalSliceIdr = 5,
+    H264NalSei = 6,
+    H264NalSps = 7,
+    H264NalPps = 8,
+    H264NalAud = 9,
+};
+
+inline unsigned H264NalType(const uint8_t* nal) { return nal[0] & 0x1F; }
+
+/**
+ * Sequence parameter set (7.3.2.1.1) with VUI (E.1.1)
+ */
+struct H264Sps
+{
+    unsigned profileIdc;
+    // constraint_set0_flag..constraint_set5_flag and reserved_zero_2bits as in the bitstream
+    unsigned constraintFlags;
+    unsigned levelIdc;
+    unsigned spsId;
+
+    unsigned chromaFormatIdc;
+    bool separateColourPlane;
+    unsigned bitDepthLuma;
+    unsigned bitDepthChroma;
+    bool qpprimeYZeroTransformBypass;
+    bool seqScalingMatrixPresent;
+
+    unsigned log2MaxFrameNum;
+    unsigned picOrderCntType;
+    unsigned log2MaxPicOrderCntLsb;
+    bool deltaPicOrderAlwaysZero;
+    int offsetForNonRefPic;
+    int offsetForTopToBottomField;
+    unsigned numRefFramesInPicOrderCntCycle;
+
+    unsigned maxNumRefFrames;
+    bool gapsInFrameNumValueAllowed;
+    unsigned picWidthInMbs;
+    unsigned picHeightInMapUnits;
+    bool frameMbsOnly;
+    bool mbAdaptiveFrameField;
+    bool direct8x8Inference;
+    unsigned cropLeft;
+    unsigned cropRight;
+    unsigned cropTop;
+    unsigned cropBottom;
+
+    // VUI
+    bool vuiParametersPresent;
+    unsigned aspectRatioIdc;
+    unsigned sarWidth;
+    unsigned sarHeight;
+    unsigned videoFormat;
+    bool videoFullRange;
+    unsigned colourPrimaries;
+    unsigned transferCharacteristics;
+    unsigned matrixCoefficients;
+    unsigned numUnitsInTick;
+    unsigned timeScale;
+    bool fixedFrameRate;
+    bool nalHrdParametersPresent;
+    bool vclHrdParametersPresent;
+    bool picStructPresent;
+    bool bitstreamRestriction;
+    unsigned maxNumReorderFrames;
+    unsigned maxDecFrameBuffering;
+
+    // Derived values
+    unsigned width;
+    unsigned height;
+    double framerate;
+};
+
+/**
+ * Picture parameter set (7.3.2.2)
+ */
+struct H264Pps
+{
+    unsigned ppsId;
+    unsigned spsId;
+    bool entropyCodingMode;
+    bool bottomFieldPicOrderInFramePresent;
+    unsigned numSliceGroups;
+    unsigned sliceGroupMapType;
+    unsigned numRefIdxL0DefaultActive;
+    unsigned numRefIdxL1DefaultActive;
+    bool weightedPred;
+    unsigned weightedBipredIdc;
+    int picInitQp;
+    int picInitQs;
+    int chromaQpIndexOffset;
+    bool deblockingFilterControlPresent;
+    bool constrainedIntraPred;
+    bool redundantPicCntPresent;
+    bool transform8x8Mode;
+    bool picScalingMatrixPresent;
+    int secondChromaQpIndexOffset;
+};
+
 /**
- * Basic SPS parser - extracts video width, height and framerate if applicable
+ * Slice header (7.3.3) up to the fields telling which picture the slice belongs to -
+ * enough to find picture boundaries (7.4.1.2.4) without going into reference lists
  */
-class H264StreamParser
+struct H264SliceHeader
 {
-public:
-    H264StreamParser(uint8_t* sps, unsigned spsSize);
+    unsigned nalUnitType;
+    unsigned nalRefIdc;
+    unsigned firstMbInSlice;
+    unsigned sliceType;
+    unsigned ppsId;
+    unsigned colourPlaneId;
+    unsigned frameNum;
+    bool fieldPic;
+    bool bottomField;
+    unsigned idrPicId;
+    unsigned picOrderCntLsb;
+    int deltaPicOrderCntBottom;
+    int deltaPicOrderCnt[2];
+    unsigned redundantPicCnt;
+};
+
+/**
+ * Parsers take whole NAL units (header included, no start code) with emulation prevention
+ * bytes still in place. They return false on malformed or truncated data.
+ */
+bool ParseH264Sps(const uint8_t* nal, size_t nalSize, H264Sps& sps);
 
-    unsigned GetWidth() const { return _width; }
-    unsigned GetHeight() const { return _height; }
-    double GetFramerate() const { return _framerate; }
+/**
+ * PPS syntax depends on SPS in one place only - scaling lists following transform_8x8_mode_flag.
+ * 4:2:0 is assumed when the SPS isn't known.
+ */
+bool ParseH264Pps(const uint8_t* nal, size_t nalSize, H264Pps& pps, const H264Sps* sps = nullptr);
 
-private:
-    std::vector<uint8_t> _sps;
+/**
+ * pic_parameter_set_id of a slice - needed to pick parameter sets for the rest of the header
+ */
+bool ParseH264SlicePpsId(const uint8_t* nal, size_t nalSize, unsigned& ppsId);
 
-    // Parsed value
-    unsigned _width;
-    unsigned _height;
-    double _framerate;
-};
\ No newline at end of file
+bool ParseH264SliceHeader(const uint8_t* nal, size_t nalSize, const H264Sps& sps,
+                          const H264Pps& pps, H264SliceHeader& header);
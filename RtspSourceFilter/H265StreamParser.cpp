@@ -0,0 +1,681 @@
+#include "H265StreamParser.h"
+#include "BitstreamReader.h"
+
+#include "H264or5VideoStreamFramer.hh"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    // Indexed by chroma_format_idc (ChromaArrayType actually)
+    const uint8_t subWidthChroma[] = {1, 2, 2, 1};
+    const uint8_t subHeightChroma[] = {1, 2, 1, 1};
+
+    // Slice segment header fields we're interested in are always within that many bytes
+    const size_t sliceHeaderMaxSize = 64;
+
+    // Way above the limits of the highest level (6.2) so derived values never overflow
+    const unsigned maxPicSizeInLumaSamples = 65536;
+
+    const unsigned maxSubLayers = 7;
+    const unsigned maxShortTermRefPicSets = 64;
+    const unsigned maxDeltaPocs = 16;
+
+    // The part of st_ref_pic_set() needed to parse following sets predicted from it
+    struct ShortTermRefPicSet
+    {
+        unsigned numNegativePics;
+        unsigned numPositivePics;
+        int deltaPocS0[maxDeltaPocs];
+        int deltaPocS1[maxDeltaPocs];
+    };
+
+    unsigned ToRbsp(std::vector<uint8_t>& rbsp, const uint8_t* nal, size_t nalSize)
+    {
+        rbsp.resize(nalSize);
+        return removeH264or5EmulationBytes(rbsp.data(), static_cast<unsigned>(rbsp.size()), nal,
+                                           static_cast<unsigned>(nalSize));
+    }
+
+    void ParseProfileTierLevel(BitstreamReader& br, unsigned maxSubLayersMinus1,
+                               H265ProfileTierLevel& ptl)
+    {
+        ptl.profileSpace = br.ReadBits(2);
+        ptl.tier = br.ReadFlag();
+        ptl.profileIdc = br.ReadBits(5);
+        ptl.profileCompatibilityFlags = br.ReadBits(32);
+        ptl.constraintIndicatorFlags = uint64_t(br.ReadBits(16)) << 32;
+        ptl.constraintIndicatorFlags |= br.ReadBits(32);
+        ptl.levelIdc = br.ReadBits(8);
+
+        bool subLayerProfilePresent[maxSubLayers];
+        bool subLayerLevelPresent[maxSubLayers];
+        for (unsigned i = 0; i < maxSubLayersMinus1; ++i)
+        {
+            subLayerProfilePresent[i] = br.ReadFlag();
+            subLayerLevelPresent[i] = br.ReadFlag();
+        }
+        if (maxSubLayersMinus1 > 0)
+            br.SkipBits(2 * (8 - maxSubLayersMinus1)); // reserved_zero_2bits
+        for (unsigned i = 0; i < maxSubLayersMinus1; ++i)
+        {
+            // Same layout as the general part
+            if (subLayerProfilePresent[i])
+                br.SkipBits(88);
+            if (subLayerLevelPresent[i])
+                br.SkipBits(8);
+        }
+    }
+
+    bool SkipScalingListData(BitstreamReader& br)
+    {
+        for (unsigned sizeId = 0; sizeId < 4; ++sizeId)
+        {
+            for (unsigned matrixId = 0; matrixId < 6; matrixId += (sizeId == 3) ? 3 : 1)
+            {
+                if (!br.ReadFlag()) // scaling_list_pred_mode_flag
+                {
+                    if (br.ReadUe() > matrixId) // scaling_list_pred_matrix_id_delta
+                        return false;
+                    continue;
+                }
+                unsigned coefNum = std::min(64U, 1U << (4 + (sizeId << 1)));
+                if (sizeId > 1)
+                {
+                    int dcCoef = br.ReadSe(); // scaling_list_dc_coef_minus8
+                    if (dcCoef < -7 || dcCoef > 247)
+                        return false;
+                }
+                for (unsigned i = 0; i < coefNum; ++i)
+                {
+                    int deltaCoef = br.ReadSe(); // scaling_list_delta_coef
+                    if (deltaCoef < -128 || deltaCoef > 127)
+                        return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // st_ref_pic_set(stRpsIdx) of an SPS
+    bool ParseShortTermRefPicSet(BitstreamReader& br, unsigned stRpsIdx,
+                                 ShortTermRefPicSet* sets)
+    {
+        ShortTermRefPicSet& rps = sets[stRpsIdx];
+        rps.numNegativePics = 0;
+        rps.numPositivePics = 0;
+
+        if (stRpsIdx != 0 && br.ReadFlag()) // inter_ref_pic_set_prediction_flag
+        {
+            // Predicted from the previous set (delta_idx_minus1 is present in slice headers only)
+            const ShortTermRefPicSet& ref = sets[stRpsIdx - 1];
+            const unsigned numRefDeltaPocs = ref.numNegativePics + ref.numPositivePics;
+            bool deltaRpsSign = br.ReadFlag();
+            unsigned absDeltaRps = br.ReadUe() + 1;
+            if (absDeltaRps - 1 >= (1U << 15))
+                return false;
+            const int deltaRps =
+                deltaRpsSign ? -static_cast<int>(absDeltaRps) : static_cast<int>(absDeltaRps);
+
+            bool useDelta[2 * maxDeltaPocs + 1];
+            for (unsigned j = 0; j <= numRefDeltaPocs; ++j)
+            {
+                bool usedByCurrPic = br.ReadFlag();
+                useDelta[j] = usedByCurrPic || br.ReadFlag();
+            }
+
+            // (7-61)
+            unsigned i = 0;
+            for (int j = static_cast<int>(ref.numPositivePics) - 1; j >= 0; --j)
+            {
+                int dPoc = ref.deltaPocS1[j] + deltaRps;
+                if (dPoc < 0 && useDelta[ref.numNegativePics + j])
+                {
+                    if (i >= maxDeltaPocs)
+                        return false;
+                    rps.deltaPocS0[i++] = dPoc;
+                }
+            }
+            if (deltaRps < 0 && useDelta[numRefDeltaPocs])
+            {
+                if (i >= maxDeltaPocs)
+                    return false;
+                rps.deltaPocS0[i++] = deltaRps;
+            }
+            for (unsigned j = 0; j < ref.numNegativePics; ++j)
+            {
+                int dPoc = ref.deltaPocS0[j] + deltaRps;
+                if (dPoc < 0 && useDelta[j])
+                {
+                    if (i >= maxDeltaPocs)
+                        return false;
+                    rps.deltaPocS0[i++] = dPoc;
+                }
+            }
+            rps.numNegativePics = i;
+
+            // (7-62)
+            i = 0;
+            for (int j = static_cast<int>(ref.numNegativePics) - 1; j >= 0; --j)
+            {
+                int dPoc = ref.deltaPocS0[j] + deltaRps;
+                if (dPoc > 0 && useDelta[j])
+                {
+                    if (i >= maxDeltaPocs)
+                        return false;
+                    rps.deltaPocS1[i++] = dPoc;
+                }
+            }
+            if (deltaRps > 0 && useDelta[numRefDeltaPocs])
+            {
+                if (i >= maxDeltaPocs)
+                    return false;
+                rps.deltaPocS1[i++] = deltaRps;
+            }
+            for (unsigned j = 0; j < ref.numPositivePics; ++j)
+            {
+                int dPoc = ref.deltaPocS1[j] + deltaRps;
+                if (dPoc > 0 && useDelta[ref.numNegativePics + j])
+                {
+                    if (i >= maxDeltaPocs)
+                        return false;
+                    rps.deltaPocS1[i++] = dPoc;
+                }
+            }
+            rps.numPositivePics = i;
+            if (rps.numNegativePics + rps.numPositivePics > maxDeltaPocs)
+                return false;
+        }
+        else
+        {
+            rps.numNegativePics = br.ReadUe();
+            rps.numPositivePics = br.ReadUe();
+            if (rps.numNegativePics > maxDeltaPocs || rps.numPositivePics > maxDeltaPocs ||
+                rps.numNegativePics + rps.numPositivePics > maxDeltaPocs)
+                return false;
+
+            int poc = 0;
+            for (unsigned i = 0; i < rps.numNegativePics; ++i)
+            {
+                unsigned deltaPoc = br.ReadUe() + 1; // delta_poc_s0_minus1
+                if (deltaPoc - 1 >= (1U << 15))
+                    return false;
+                poc -= static_cast<int>(deltaPoc);
+                rps.deltaPocS0[i] = poc;
+                br.SkipBits(1); // used_by_curr_pic_s0_flag
+            }
+            poc = 0;
+            for (unsigned i = 0; i < rps.numPositivePics; ++i)
+            {
+                unsigned deltaPoc = br.ReadUe() + 1; // delta_poc_s1_minus1
+                if (deltaPoc - 1 >= (1U << 15))
+                    return false;
+                poc += static_cast<int>(deltaPoc);
+                rps.deltaPocS1[i] = poc;
+                br.SkipBits(1); // used_by_curr_pic_s1_flag
+            }
+        }
+        return true;
+    }
+
+    void SkipSubLayerHrdParameters(BitstreamReader& br, unsigned cpbCnt,
+                                   bool subPicHrdParamsPresent)
+    {
+        for (unsigned i = 0; i < cpbCnt; ++i)
+        {
+            br.ReadUe(); // bit_rate_value_minus1
+            br.ReadUe(); // cpb_size_value_minus1
+            if (subPicHrdParamsPresent)
+            {
+                br.ReadUe(); // cpb_size_du_value_minus1
+                br.ReadUe(); // bit_rate_du_value_minus1
+            }
+            br.SkipBits(1); // cbr_flag
+        }
+    }
+
+    // hrd_parameters(1, maxSubLayersMinus1)
+    bool SkipHrdParameters(BitstreamReader& br, unsigned maxSubLayersMinus1)
+    {
+        bool nalHrdParametersPresent = br.ReadFlag();
+        bool vclHrdParametersPresent = br.ReadFlag();
+        bool subPicHrdParamsPresent = false;
+        if (nalHrdParametersPresent || vclHrdParametersPresent)
+        {
+            subPicHrdParamsPresent = br.ReadFlag();
+            if (subPicHrdParamsPresent)
+            {
+                br.SkipBits(8); // tick_divisor_minus2
+                br.SkipBits(5); // du_cpb_removal_delay_increment_length_minus1
+                br.SkipBits(1); // sub_pic_cpb_params_in_pic_timing_sei_flag
+                br.SkipBits(5); // dpb_output_delay_du_length_minus1
+            }
+            br.SkipBits(4); // bit_rate_scale
+            br.SkipBits(4); // cpb_size_scale
+            if (subPicHrdParamsPresent)
+                br.SkipBits(4); // cpb_size_du_scale
+            br.SkipBits(5); // initial_cpb_removal_delay_length_minus1
+            br.SkipBits(5); // au_cpb_removal_delay_length_minus1
+            br.SkipBits(5); // dpb_output_delay_length_minus1
+        }
+
+        for (unsigned i = 0; i <= maxSubLayersMinus1; ++i)
+        {
+            bool fixedPicRateGeneral = br.ReadFlag();
+            bool fixedPicRateWithinCvs = fixedPicRateGeneral || br.ReadFlag();
+            bool lowDelayHrd = false;
+            if (fixedPicRateWithinCvs)
+                br.ReadUe(); // elemental_duration_in_tc_minus1
+            else
+                lowDelayHrd = br.ReadFlag();
+            unsigned cpbCnt = 1;
+            if (!lowDelayHrd)
+            {
+                cpbCnt = br.ReadUe() + 1;
+                if (cpbCnt - 1 >= 32)
+                    return false;
+            }
+            if (nalHrdParametersPresent)
+                SkipSubLayerHrdParameters(br, cpbCnt, subPicHrdParamsPresent);
+            if (vclHrdParametersPresent)
+                SkipSubLayerHrdParameters(br, cpbCnt, subPicHrdParamsPresent);
+        }
+        return true;
+    }
+
+    bool ParseVui(BitstreamReader& br, H265Sps& sps)
+    {
+        if (br.ReadFlag()) // aspect_ratio_info_present_flag
+        {
+            sps.aspectRatioIdc = br.ReadBits(8);
+            if (sps.aspectRatioIdc == 255 /*EXTENDED_SAR*/)
+            {
+                sps.sarWidth = br.ReadBits(16);
+                sps.sarHeight = br.ReadBits(16);
+            }
+        }
+        if (br.ReadFlag()) // overscan_info_present_flag
+            br.SkipBits(1); // overscan_appropriate_flag
+        if (br.ReadFlag()) // video_signal_type_present_flag
+        {
+            sps.videoFormat = br.ReadBits(3);
+            sps.videoFullRange = br.ReadFlag();
+            if (br.ReadFlag()) // colour_description_present_flag
+            {
+                sps.colourPrimaries = br.ReadBits(8);
+                sps.transferCharacteristics = br.ReadBits(8);
+                sps.matrixCoefficients = br.ReadBits(8);
+            }
+        }
+        if (br.ReadFlag()) // chroma_loc_info_present_flag
+        {
+            br.ReadUe(); // chroma_sample_loc_type_top_field
+            br.ReadUe(); // chroma_sample_loc_type_bottom_field
+        }
+        br.SkipBits(1); // neutral_chroma_indication_flag
+        sps.fieldSeq = br.ReadFlag();
+        br.SkipBits(1); // frame_field_info_present_flag
+        if (br.ReadFlag()) // default_display_window_flag
+        {
+            br.ReadUe(); // def_disp_win_left_offset
+            br.ReadUe(); // def_disp_win_right_offset
+            br.ReadUe(); // def_disp_win_top_offset
+            br.ReadUe(); // def_disp_win_bottom_offset
+        }
+        if (br.ReadFlag()) // vui_timing_info_present_flag
+        {
+            sps.numUnitsInTick = br.ReadBits(32);
+            sps.timeScale = br.ReadBits(32);
+            if (br.ReadFlag()) // vui_poc_proportional_to_timing_flag
+                br.ReadUe();   // vui_num_ticks_poc_diff_one_minus1
+            if (br.ReadFlag() && // vui_hrd_parameters_present_flag
+                !SkipHrdParameters(br, sps.maxSubLayers - 1))
+                return false;
+        }
+        sps.bitstreamRestriction = br.ReadFlag();
+        if (sps.bitstreamRestriction)
+        {
+            br.SkipBits(1); // tiles_fixed_structure_flag
+            br.SkipBits(1); // motion_vectors_over_pic_boundaries_flag
+            br.SkipBits(1); // restricted_ref_pic_lists_flag
+            sps.minSpatialSegmentationIdc = br.ReadUe();
+            br.ReadUe(); // max_bytes_per_pic_denom
+            br.ReadUe(); // max_bits_per_min_cu_denom
+            br.ReadUe(); // log2_max_mv_length_horizontal
+            br.ReadUe(); // log2_max_mv_length_vertical
+            if (sps.minSpatialSegmentationIdc >= 4096)
+                return false;
+        }
+        return true;
+    }
+}
+
+bool ParseH265Vps(const uint8_t* nal, size_t nalSize, H265Vps& vps)
+{
+    vps = H265Vps();
+    if (nalSize < 3 || H265NalType(nal) != H265NalVps)
+        return false;
+
+    std::vector<uint8_t> rbsp;
+    unsigned rbspSize = ToRbsp(rbsp, nal, nalSize);
+    BitstreamReader br(rbsp.data(), rbspSize);
+    br.SkipBits(16); // nal_unit_header()
+    vps.vpsId = br.ReadBits(4);
+    br.SkipBits(1); // vps_base_layer_internal_flag
+    br.SkipBits(1); // vps_base_layer_available_flag
+    vps.maxLayers = br.ReadBits(6) + 1;
+    vps.maxSubLayers = br.ReadBits(3) + 1;
+    if (vps.maxSubLayers > maxSubLayers)
+        return false;
+    vps.temporalIdNesting = br.ReadFlag();
+    br.SkipBits(16); // vps_reserved_0xffff_16bits
+    ParseProfileTierLevel(br, vps.maxSubLayers - 1, vps.profileTierLevel);
+
+    bool subLayerOrderingInfoPresent = br.ReadFlag();
+    for (unsigned i = subLayerOrderingInfoPresent ? 0 : vps.maxSubLayers - 1;
+         i < vps.maxSubLayers; ++i)
+    {
+        br.ReadUe(); // vps_max_dec_pic_buffering_minus1
+        br.ReadUe(); // vps_max_num_reorder_pics
+        br.ReadUe(); // vps_max_latency_increase_plus1
+    }
+
+    unsigned maxLayerId = br.ReadBits(6);
+    unsigned numLayerSets = br.ReadUe() + 1;
+    if (numLayerSets - 1 >= 1024)
+        return false;
+    for (unsigned i = 1; i < numLayerSets; ++i)
+        br.SkipBits(maxLayerId + 1); // layer_id_included_flag[i][j]
+
+    if (br.ReadFlag()) // vps_timing_info_present_flag
+    {
+        vps.numUnitsInTick = br.ReadBits(32);
+        vps.timeScale = br.ReadBits(32);
+    }
+    // HRD parameters and extensions follow - nothing we'd need
+
+    return !br.Overrun();
+}
+
+bool ParseH265Sps(const uint8_t* nal, size_t nalSize, H265Sps& sps)
+{
+    sps = H265Sps();
+    if (nalSize < 3 || H265NalType(nal) != H265NalSps)
+        return false;
+
+    std::vector<uint8_t> rbsp;
+    unsigned rbspSize = ToRbsp(rbsp, nal, nalSize);
+    BitstreamReader br(rbsp.data(), rbspSize);
+    br.SkipBits(16); // nal_unit_header()
+    sps.vpsId = br.ReadBits(4);
+    sps.maxSubLayers = br.ReadBits(3) + 1;
+    if (sps.maxSubLayers > maxSubLayers)
+        return false;
+    sps.temporalIdNesting = br.ReadFlag();
+    ParseProfileTierLevel(br, sps.maxSubLayers - 1, sps.profileTierLevel);
+    sps.spsId = br.ReadUe();
+    if (sps.spsId >= H265MaxSpsCount)
+        return false;
+
+    sps.chromaFormatIdc = br.ReadUe();
+    if (sps.chromaFormatIdc > 3)
+        return false;
+    if (sps.chromaFormatIdc == 3)
+        sps.separateColourPlane = br.ReadFlag();
+    sps.picWidthInLumaSamples = br.ReadUe();
+    sps.picHeightInLumaSamples = br.ReadUe();
+    if (sps.picWidthInLumaSamples == 0 || sps.picWidthInLumaSamples > maxPicSizeInLumaSamples ||
+        sps.picHeightInLumaSamples == 0 || sps.picHeightInLumaSamples > maxPicSizeInLumaSamples)
+        return false;
+    if (br.ReadFlag()) // conformance_window_flag
+    {
+        sps.confWinLeft = br.ReadUe();
+        sps.confWinRight = br.ReadUe();
+        sps.confWinTop = br.ReadUe();
+        sps.confWinBottom = br.ReadUe();
+    }
+    sps.bitDepthLuma = br.ReadUe() + 8;
+    sps.bitDepthChroma = br.ReadUe() + 8;
+    sps.log2MaxPicOrderCntLsb = br.ReadUe() + 4;
+    if (sps.bitDepthLuma - 8 > 8 || sps.bitDepthChroma - 8 > 8 ||
+        sps.log2MaxPicOrderCntLsb - 4 > 12)
+        return false;
+
+    bool subLayerOrderingInfoPresent = br.ReadFlag();
+    for (unsigned i = subLayerOrderingInfoPresent ? 0 : sps.maxSubLayers - 1;
+         i < sps.maxSubLayers; ++i)
+    {
+        // Values of the highest sub-layer are kept
+        sps.maxDecPicBuffering = br.ReadUe() + 1;
+        sps.maxNumReorderPics = br.ReadUe();
+        br.ReadUe(); // sps_max_latency_increase_plus1
+    }
+
+    unsigned log2MinCbSizeMinus3 = br.ReadUe();
+    unsigned log2DiffMaxMinCbSize = br.ReadUe();
+    unsigned log2MinTbSizeMinus2 = br.ReadUe();
+    unsigned log2DiffMaxMinTbSize = br.ReadUe();
+    if (log2MinCbSizeMinus3 > 3 || log2DiffMaxMinCbSize > 3 || log2MinTbSizeMinus2 > 3 ||
+        log2DiffMaxMinTbSize > 3)
+        return false;
+    sps.log2MinCbSize = log2MinCbSizeMinus3 + 3;
+    sps.log2CtbSize = sps.log2MinCbSize + log2DiffMaxMinCbSize;
+    sps.log2MinTbSize = log2MinTbSizeMinus2 + 2;
+    sps.log2MaxTbSize = sps.log2MinTbSize + log2DiffMaxMinTbSize;
+    if (sps.log2CtbSize > 6 || sps.log2MaxTbSize > 5)
+        return false;
+    sps.maxTransformHierarchyDepthInter = br.ReadUe();
+    sps.maxTransformHierarchyDepthIntra = br.ReadUe();
+
+    sps.scalingListEnabled = br.ReadFlag();
+    if (sps.scalingListEnabled && br.ReadFlag() && // sps_scaling_list_data_present_flag
+        !SkipScalingListData(br))
+        return false;
+    sps.ampEnabled = br.ReadFlag();
+    sps.sampleAdaptiveOffsetEnabled = br.ReadFlag();
+    sps.pcmEnabled = br.ReadFlag();
+    if (sps.pcmEnabled)
+    {
+        br.SkipBits(4); // pcm_sample_bit_depth_luma_minus1
+        br.SkipBits(4); // pcm_sample_bit_depth_chroma_minus1
+        br.ReadUe();    // log2_min_pcm_luma_coding_block_size_minus3
+        br.ReadUe();    // log2_diff_max_min_pcm_luma_coding_block_size
+        br.SkipBits(1); // pcm_loop_filter_disabled_flag
+    }
+
+    sps.numShortTermRefPicSets = br.ReadUe();
+    if (sps.numShortTermRefPicSets > maxShortTermRefPicSets)
+        return false;
+    ShortTermRefPicSet shortTermRefPicSets[maxShortTermRefPicSets];
+    for (unsigned i = 0; i < sps.numShortTermRefPicSets; ++i)
+    {
+        if (!ParseShortTermRefPicSet(br, i, shortTermRefPicSets))
+            return false;
+    }
+
+    sps.longTermRefPicsPresent = br.ReadFlag();
+    if (sps.longTermRefPicsPresent)
+    {
+        sps.numLongTermRefPicsSps = br.ReadUe();
+        if (sps.numLongTermRefPicsSps > 32)
+            return false;
+        // lt_ref_pic_poc_lsb_sps[i]; used_by_curr_pic_lt_sps_flag[i]
+        br.SkipBits(sps.numLongTermRefPicsSps * (sps.log2MaxPicOrderCntLsb + 1));
+    }
+    sps.temporalMvpEnabled = br.ReadFlag();
+    sps.strongIntraSmoothingEnabled = br.ReadFlag();
+
+    sps.vuiParametersPresent = br.ReadFlag();
+    if (sps.vuiParametersPresent && !ParseVui(br, sps))
+        return false;
+    // Extensions follow - nothing we'd need
+
+    unsigned chromaArrayType = sps.separateColourPlane ? 0 : sps.chromaFormatIdc;
+    unsigned cropUnitX = subWidthChroma[chromaArrayType];
+    unsigned cropUnitY = subHeightChroma[chromaArrayType];
+    // Compared in 64 bits - offsets are arbitrary in a malformed SPS
+    if ((uint64_t(sps.confWinLeft) + sps.confWinRight) * cropUnitX >= sps.picWidthInLumaSamples ||
+        (uint64_t(sps.confWinTop) + sps.confWinBottom) * cropUnitY >= sps.picHeightInLumaSamples)
+        return false;
+    sps.width = sps.picWidthInLumaSamples - (sps.confWinLeft + sps.confWinRight) * cropUnitX;
+    sps.height = sps.picHeightInLumaSamples - (sps.confWinTop + sps.confWinBottom) * cropUnitY;
+
+    const unsigned ctbSize = 1 << sps.log2CtbSize;
+    sps.picSizeInCtbs = ((sps.picWidthInLumaSamples + ctbSize - 1) >> sps.log2CtbSize) *
+                        ((sps.picHeightInLumaSamples + ctbSize - 1) >> sps.log2CtbSize);
+
+    // Unlike H.264 a tick is a picture, not a field
+    if (sps.numUnitsInTick != 0 && sps.timeScale != 0)
+        sps.framerate = (double)sps.timeScale / (double)sps.numUnitsInTick;
+
+    return !br.Overrun();
+}
+
+bool ParseH265Pps(const uint8_t* nal, size_t nalSize, H265Pps& pps)
+{
+    pps = H265Pps();
+    if (nalSize < 3 || H265NalType(nal) != H265NalPps)
+        return false;
+
+    std::vector<uint8_t> rbsp;
+    unsigned rbspSize = ToRbsp(rbsp, nal, nalSize);
+    BitstreamReader br(rbsp.data(), rbspSize);
+    br.SkipBits(16); // nal_unit_header()
+    pps.ppsId = br.ReadUe();
+    pps.spsId = br.ReadUe();
+    if (pps.ppsId >= H265MaxPpsCount || pps.spsId >= H265MaxSpsCount)
+        return false;
+    pps.dependentSliceSegmentsEnabled = br.ReadFlag();
+    pps.outputFlagPresent = br.ReadFlag();
+    pps.numExtraSliceHeaderBits = br.ReadBits(3);
+    pps.signDataHidingEnabled = br.ReadFlag();
+    pps.cabacInitPresent = br.ReadFlag();
+    pps.numRefIdxL0DefaultActive = br.ReadUe() + 1;
+    pps.numRefIdxL1DefaultActive = br.ReadUe() + 1;
+    if (pps.numRefIdxL0DefaultActive - 1 >= 15 || pps.numRefIdxL1DefaultActive - 1 >= 15)
+        return false;
+    pps.initQp = 26 + br.ReadSe();
+    pps.constrainedIntraPred = br.ReadFlag();
+    pps.transformSkipEnabled = br.ReadFlag();
+    pps.cuQpDeltaEnabled = br.ReadFlag();
+    if (pps.cuQpDeltaEnabled)
+        pps.diffCuQpDeltaDepth = br.ReadUe();
+    pps.cbQpOffset = br.ReadSe();
+    pps.crQpOffset = br.ReadSe();
+    if (pps.cbQpOffset < -12 || pps.cbQpOffset > 12 || pps.crQpOffset < -12 ||
+        pps.crQpOffset > 12)
+        return false;
+    pps.sliceChromaQpOffsetsPresent = br.ReadFlag();
+    pps.weightedPred = br.ReadFlag();
+    pps.weightedBipred = br.ReadFlag();
+    pps.transquantBypassEnabled = br.ReadFlag();
+    pps.tilesEnabled = br.ReadFlag();
+    pps.entropyCodingSyncEnabled = br.ReadFlag();
+
+    pps.numTileColumns = 1;
+    pps.numTileRows = 1;
+    if (pps.tilesEnabled)
+    {
+        pps.numTileColumns = br.ReadUe() + 1;
+        pps.numTileRows = br.ReadUe() + 1;
+        if (pps.numTileColumns - 1 >= 64 || pps.numTileRows - 1 >= 64)
+            return false;
+        if (!br.ReadFlag()) // uniform_spacing_flag
+        {
+            for (unsigned i = 0; i < pps.numTileColumns - 1; ++i)
+                br.ReadUe(); // column_width_minus1[i]
+            for (unsigned i = 0; i < pps.numTileRows - 1; ++i)
+                br.ReadUe(); // row_height_minus1[i]
+        }
+        br.SkipBits(1); // loop_filter_across_tiles_enabled_flag
+    }
+    pps.loopFilterAcrossSlicesEnabled = br.ReadFlag();
+
+    pps.deblockingFilterControlPresent = br.ReadFlag();
+    if (pps.deblockingFilterControlPresent)
+    {
+        br.SkipBits(1); // deblocking_filter_override_enabled_flag
+        pps.deblockingFilterDisabled = br.ReadFlag();
+        if (!pps.deblockingFilterDisabled)
+        {
+            br.ReadSe(); // pps_beta_offset_div2
+            br.ReadSe(); // pps_tc_offset_div2
+        }
+    }
+    if (br.ReadFlag() && // pps_scaling_list_data_present_flag
+        !SkipScalingListData(br))
+        return false;
+    pps.listsModificationPresent = br.ReadFlag();
+    pps.log2ParallelMergeLevel = br.ReadUe() + 2;
+    pps.sliceSegmentHeaderExtensionPresent = br.ReadFlag();
+    // Extensions follow - nothing we'd need
+
+    return !br.Overrun();
+}
+
+bool ParseH265SlicePpsId(const uint8_t* nal, size_t nalSize, unsigned& ppsId)
+{
+    if (nalSize < 3)
+        return false;
+
+    uint8_t rbsp[sliceHeaderMaxSize];
+    unsigned rbspSize = removeH264or5EmulationBytes(
+        rbsp, sizeof(rbsp), nal, static_cast<unsigned>(std::min(nalSize, sizeof(rbsp))));
+    BitstreamReader br(rbsp, rbspSize);
+    br.SkipBits(16); // nal_unit_header()
+    br.SkipBits(1);  // first_slice_segment_in_pic_flag
+    if (H265IsIrap(H265NalType(nal)))
+        br.SkipBits(1); // no_output_of_prior_pics_flag
+    ppsId = br.ReadUe();
+    return !br.Overrun() && ppsId < H265MaxPpsCount;
+}
+
+bool ParseH265SliceHeader(const uint8_t* nal, size_t nalSize, const H265Sps& sps,
+                          const H265Pps& pps, H265SliceHeader& header)
+{
+    header = H265SliceHeader();
+    if (nalSize < 3)
+        return false;
+
+    uint8_t rbsp[sliceHeaderMaxSize];
+    unsigned rbspSize = removeH264or5EmulationBytes(
+        rbsp, sizeof(rbsp), nal, static_cast<unsigned>(std::min(nalSize, sizeof(rbsp))));
+    BitstreamReader br(rbsp, rbspSize);
+    br.SkipBits(1); // forbidden_zero_bit
+    header.nalUnitType = br.ReadBits(6);
+    header.nuhLayerId = br.ReadBits(6);
+    header.temporalId = br.ReadBits(3) - 1;
+
+    header.firstSliceSegmentInPic = br.ReadFlag();
+    if (H265IsIrap(header.nalUnitType))
+        header.noOutputOfPriorPics = br.ReadFlag();
+    header.ppsId = br.ReadUe();
+    if (header.ppsId != pps.ppsId || pps.spsId != sps.spsId)
+        return false;
+
+    if (!header.firstSliceSegmentInPic)
+    {
+        if (pps.dependentSliceSegmentsEnabled)
+            header.dependentSliceSegment = br.ReadFlag();
+        header.sliceSegmentAddress = br.ReadBits(CeilLog2(sps.picSizeInCtbs));
+        if (header.sliceSegmentAddress >= sps.picSizeInCtbs)
+            return false;
+    }
+
+    // Dependent slice segments take the rest from the preceding independent one
+    if (!header.dependentSliceSegment)
+    {
+        br.SkipBits(pps.numExtraSliceHeaderBits); // slice_reserved_flag[i]
+        header.sliceType = br.ReadUe();
+        if (header.sliceType > 2)
+            return false;
+        header.picOutput = pps.outputFlagPresent ? br.ReadFlag() : true;
+        if (sps.separateColourPlane)
+            header.colourPlaneId = br.ReadBits(2);
+        if (header.nalUnitType != H265NalIdrWRadl && header.nalUnitType != H265NalIdrNLp)
+            header.picOrderCntLsb = br.ReadBits(sps.log2MaxPicOrderCntLsb);
+    }
+
+    return !br.Overrun();
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Parameter set id ranges
+const unsigned H265MaxVpsCount = 16;
+const unsigned H265MaxSpsCount = 16;
+const unsigned H265MaxPpsCount = 64;
+
+enum H265NalUnitType
+{
+    H265NalBlaWLp = 16,
+    H265NalIdrWRadl = 19,
+    H265NalIdrNLp = 20,
+    H265NalCraNut = 21,
+    H265NalRsvIrapVcl23 = 23,
+    H265NalVps = 32,
+    H265NalSps = 33,
+    H265NalPps = 34,
+    H265NalAud = 35,
+    H265NalPrefixSei = 39,
+    H265NalSuffixSei = 40,
+};
+
+inline unsigned H265NalType(const uint8_t* nal) { return (nal[0] >> 1) & 0x3F; }
+
+// Slice segments - VCL NAL unit types other than reserved ones
+inline bool H265IsSlice(unsigned nalType)
+{
+    return nalType <= 9 || (nalType >= H265NalBlaWLp && nalType <= H265NalCraNut);
+}
+
+// Intra random access point - decoding can start from there
+inline bool H265IsIrap(unsigned nalType)
+{
+    return nalType >= H265NalBlaWLp && nalType <= H265NalRsvIrapVcl23;
+}
+
+/**
+ * General part of profile_tier_level() (7.3.3)
+ */
+struct H265ProfileTierLevel
+{
+    unsigned profileSpace;
+    bool tier;
+    unsigned profileIdc;
+    uint32_t profileCompatibilityFlags;
+    // progressive_source_flag .. general_inbld_flag/reserved bit - 48 bits as in the bitstream
+    uint64_t constraintIndicatorFlags;
+    unsigned levelIdc;
+};
+
+/**
+ * Video parameter set (7.3.2.1)
+ */
+struct H265Vps
+{
+    unsigned vpsId;
+    unsigned maxLayers;
+    unsigned maxSubLayers;
+    bool temporalIdNesting;
+    H265ProfileTierLevel profileTierLevel;
+    unsigned numUnitsInTick;
+    unsigned timeScale;
+};
+
+/**
+ * Sequence parameter set (7.3.2.2) with VUI (E.2.1)
+ */
+struct H265Sps
+{
+    unsigned vpsId;
+    unsigned maxSubLayers;
+    bool temporalIdNesting;
+    H265ProfileTierLevel profileTierLevel;
+    unsigned spsId;
+
+    unsigned chromaFormatIdc;
+    bool separateColourPlane;
+    unsigned picWidthInLumaSamples;
+    unsigned picHeightInLumaSamples;
+    unsigned confWinLeft;
+    unsigned confWinRight;
+    unsigned confWinTop;
+    unsigned confWinBottom;
+    unsigned bitDepthLuma;
+    unsigned bitDepthChroma;
+    unsigned log2MaxPicOrderCntLsb;
+    unsigned maxDecPicBuffering;
+    unsigned maxNumReorderPics;
+
+    unsigned log2MinCbSize;
+    unsigned log2CtbSize;
+    unsigned log2MinTbSize;
+    unsigned log2MaxTbSize;
+    unsigned maxTransformHierarchyDepthInter;
+    unsigned maxTransformHierarchyDepthIntra;
+    bool scalingListEnabled;
+    bool ampEnabled;
+    bool sampleAdaptiveOffsetEnabled;
+    bool pcmEnabled;
+    unsigned numShortTermRefPicSets;
+    bool longTermRefPicsPresent;
+    unsigned numLongTermRefPicsSps;
+    bool temporalMvpEnabled;
+    bool strongIntraSmoothingEnabled;
+
+    // VUI
+    bool vuiParametersPresent;
+    unsigned aspectRatioIdc;
+    unsigned sarWidth;
+    unsigned sarHeight;
+    unsigned videoFormat;
+    bool videoFullRange;
+    unsigned colourPrimaries;
+    unsigned transferCharacteristics;
+    unsigned matrixCoefficients;
+    bool fieldSeq;
+    unsigned numUnitsInTick;
+    unsigned timeScale;
+    bool bitstreamRestriction;
+    unsigned minSpatialSegmentationIdc;
+
+    // Derived values
+    unsigned width;
+    unsigned height;
+    double framerate;
+    unsigned picSizeInCtbs;
+};
+
+/**
+ * Picture parameter set (7.3.2.3)
+ */
+struct H265Pps
+{
+    unsigned ppsId;
+    unsigned spsId;
+    bool dependentSliceSegmentsEnabled;
+    bool outputFlagPresent;
+    unsigned numExtraSliceHeaderBits;
+    bool signDataHidingEnabled;
+    bool cabacInitPresent;
+    unsigned numRefIdxL0DefaultActive;
+    unsigned numRefIdxL1DefaultActive;
+    int initQp;
+    bool constrainedIntraPred;
+    bool transformSkipEnabled;
+    bool cuQpDeltaEnabled;
+    unsigned diffCuQpDeltaDepth;
+    int cbQpOffset;
+    int crQpOffset;
+    bool sliceChromaQpOffsetsPresent;
+    bool weightedPred;
+    bool weightedBipred;
+    bool transquantBypassEnabled;
+    bool tilesEnabled;
+    bool entropyCodingSyncEnabled;
+    unsigned numTileColumns;
+    unsigned numTileRows;
+    bool loopFilterAcrossSlicesEnabled;
+    bool deblockingFilterControlPresent;
+    bool deblockingFilterDisabled;
+    bool listsModificationPresent;
+    unsigned log2ParallelMergeLevel;
+    bool sliceSegmentHeaderExtensionPresent;
+};
+
+/**
+ * Slice segment header (7.3.6.1) up to the fields telling which picture the segment
+ * belongs to
+ */
+struct H265SliceHeader
+{
+    unsigned nalUnitType;
+    unsigned nuhLayerId;
+    unsigned temporalId;
+    bool firstSliceSegmentInPic;
+    bool noOutputOfPriorPics;
+    unsigned ppsId;
+    bool dependentSliceSegment;
+    unsigned sliceSegmentAddress;
+    unsigned sliceType;
+    bool picOutput;
+    unsigned colourPlaneId;
+    unsigned picOrderCntLsb;
+};
+
+/**
+ * Parsers take whole NAL units (2-byte header included, no start code) with emulation
+ * prevention bytes still in place. They return false on malformed or truncated data.
+ */
+bool ParseH265Vps(const uint8_t* nal, size_t nalSize, H265Vps& vps);
+bool ParseH265Sps(const uint8_t* nal, size_t nalSize, H265Sps& sps);
+bool ParseH265Pps(const uint8_t* nal, size_t nalSize, H265Pps& pps);
+
+/**
+ * slice_pic_parameter_set_id of a slice segment - needed to pick parameter sets for the rest
+ * of the header
+ */
+bool ParseH265SlicePpsId(const uint8_t* nal, size_t nalSize, unsigned& ppsId);
+
+bool ParseH265SliceHeader(const uint8_t* nal, size_t nalSize, const H265Sps& sps,
+                          const H265Pps& pps, H265SliceHeader& header);
@@ -0,0 +1,100 @@
+#include "MediaPacketBufferPool.h"
+
+namespace
+{
+    // 4KB, 16KB, 64KB, 256KB and 1MB slabs
+    const size_t sizeClassCapacities[] = {4 * 1024, 16 * 1024, 64 * 1024, 256 * 1024,
+                                          1024 * 1024};
+    // How much memory each free list is allowed to keep for reuse
+    const size_t maxFreeBytesPerClass = 8 * 1024 * 1024;
+
+    // Constructed at module load so there's no race on first use
+    MediaPacketBufferPool defaultPool;
+}
+
+MediaPacketBuffer::MediaPacketBuffer(MediaPacketBufferPool* pool, int sizeClass,
+                                     size_t capacity)
+    : _pool(pool)
+    , _sizeClass(sizeClass)
+    , _capacity(capacity)
+    , _data(new std::uint8_t[capacity])
+    , _refCount(1)
+{
+}
+
+MediaPacketBuffer::~MediaPacketBuffer() { delete[] _data; }
+
+void MediaPacketBuffer::release()
+{
+    if (_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        _pool->recycle(this);
+}
+
+MediaPacketBufferPool& MediaPacketBufferPool::instance() { return defaultPool; }
+
+MediaPacketBufferPool::MediaPacketBufferPool() : _numAcquired(0), _numHeapAllocations(0) {}
+
+MediaPacketBufferPool::~MediaPacketBufferPool()
+{
+    for (auto& freeList : _freeLists)
+    {
+        for (MediaPacketBuffer* buffer : freeList.buffers)
+            delete buffer;
+        freeList.buffers.clear();
+    }
+}
+
+int MediaPacketBufferPool::sizeClassFor(size_t minCapacity)
+{
+    for (int i = 0; i < NumSizeClasses; ++i)
+    {
+        if (minCapacity <= sizeClassCapacities[i])
+            return i;
+    }
+    return -1;
+}
+
+size_t MediaPacketBufferPool::capacityFor(size_t minCapacity)
+{
+    int sizeClass = sizeClassFor(minCapacity);
+    return sizeClass >= 0 ? sizeClassCapacities[sizeClass] : minCapacity;
+}
+
+MediaPacketBufferRef MediaPacketBufferPool::acquire(size_t minCapacity)
+{
+    _numAcquired.fetch_add(1, std::memory_order_relaxed);
+
+    int sizeClass = sizeClassFor(minCapacity);
+    if (sizeClass >= 0)
+    {
+        FreeList& freeList = _freeLists[sizeClass];
+        std::lock_guard<std::mutex> lock(freeList.mutex);
+        if (!freeList.buffers.empty())
+        {
+            MediaPacketBuffer* buffer = freeList.buffers.back();
+            freeList.buffers.pop_back();
+            buffer->_refCount.store(1, std::memory_order_relaxed);
+            return MediaPacketBufferRef(buffer);
+        }
+    }
+
+    _numHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    size_t capacity = sizeClass >= 0 ? sizeClassCapacities[sizeClass] : minCapacity;
+    return MediaPacketBufferRef(new MediaPacketBuffer(this, sizeClass, capacity));
+}
+
+void MediaPacketBufferPool::recycle(MediaPacketBuffer* buffer)
+{
+    if (buffer->_sizeClass >= 0)
+    {
+        FreeList& freeList = _freeLists[buffer->_sizeClass];
+        std::lock_guard<std::mutex> lock(freeList.mutex);
+        if ((freeList.buffers.size() + 1) * buffer->_capacity <= maxFreeBytesPerClass)
+        {
+            freeList.buffers.push_back(buffer);
+            return;
+        }
+    }
+
+    delete buffer;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class MediaPacketBufferPool;
+
+/**
+ * Reference counted slab of memory handed out by MediaPacketBufferPool.
+ * Returns to the pool it came from when the last reference is gone.
+ */
+class MediaPacketBuffer
+{
+public:
+    std::uint8_t* data() { return _data; }
+    const std::uint8_t* data() const { return _data; }
+    size_t capacity() const { return _capacity; }
+
+    MediaPacketBuffer(const MediaPacketBuffer&) = delete;
+    MediaPacketBuffer& operator=(const MediaPacketBuffer&) = delete;
+
+private:
+    friend class MediaPacketBufferPool;
+    friend class MediaPacketBufferRef;
+
+    MediaPacketBuffer(MediaPacketBufferPool* pool, int sizeClass, size_t capacity);
+    ~MediaPacketBuffer();
+
+    void addRef() { _refCount.fetch_add(1, std::memory_order_relaxed); }
+    void release();
+
+private:
+    MediaPacketBufferPool* _pool;
+    int _sizeClass;
+    size_t _capacity;
+    std::uint8_t* _data;
+    std::atomic<long> _refCount;
+};
+
+/**
+ * Smart handle to MediaPacketBuffer. Copying shares the slab, moving transfers ownership.
+ */
+class MediaPacketBufferRef
+{
+public:
+    /**
+     * Construct an empty handle
+     */
+    MediaPacketBufferRef() : _buffer(nullptr) {}
+
+    MediaPacketBufferRef(const MediaPacketBufferRef& other) : _buffer(other._buffer)
+    {
+        if (_buffer)
+            _buffer->addRef();
+    }
+
+    /**
+     * Move constructor
+     */
+    MediaPacketBufferRef(MediaPacketBufferRef&& other) : _buffer(other._buffer)
+    {
+        other._buffer = nullptr;
+    }
+
+    MediaPacketBufferRef& operator=(const MediaPacketBufferRef& other)
+    {
+        if (this != &other)
+        {
+            if (other._buffer)
+                other._buffer->addRef();
+            reset();
+            _buffer = other._buffer;
+        }
+        return *this;
+    }
+
+    /**
+     * Move operator
+     */
+    MediaPacketBufferRef& operator=(MediaPacketBufferRef&& other)
+    {
+        if (this != &other)
+        {
+            reset();
+            _buffer = other._buffer;
+            other._buffer = nullptr;
+        }
+        return *this;
+    }
+
+    ~MediaPacketBufferRef() { reset(); }
+
+    void reset()
+    {
+        if (_buffer)
+        {
+            _buffer->release();
+            _buffer = nullptr;
+        }
+    }
+
+    explicit operator bool() const { return _buffer != nullptr; }
+    std::uint8_t* data() const { return _buffer ? _buffer->data() : nullptr; }
+    size_t capacity() const { return _buffer ? _buffer->capacity() : 0; }
+
+private:
+    friend class MediaPacketBufferPool;
+    explicit MediaPacketBufferRef(MediaPacketBuffer* buffer) : _buffer(buffer) {}
+
+private:
+    MediaPacketBuffer* _buffer;
+};
+
+/**
+ * Size-classed pool of media packet slabs shared by all sinks and pins in the process.
+ * Released slabs are kept on per-class free lists (up to a byte budget) so that the steady
+ * state media path does not touch the heap at all.
+ */
+class MediaPacketBufferPool
+{
+public:
+    /**
+     * Process-wide pool. Slabs may outlive the filter that filled them.
+     */
+    static MediaPacketBufferPool& instance();
+
+    MediaPacketBufferPool();
+    ~MediaPacketBufferPool();
+
+    MediaPacketBufferPool(const MediaPacketBufferPool&) = delete;
+    MediaPacketBufferPool& operator=(const MediaPacketBufferPool&) = delete;
+
+    /**
+     * Hand out a slab of at least minCapacity bytes. Requests above the biggest size class
+     * are served straight from the heap and freed on release.
+     */
+    MediaPacketBufferRef acquire(size_t minCapacity);
+
+    /**
+     * Capacity of the slab acquire() would return for given request
+     */
+    static size_t capacityFor(size_t minCapacity);
+
+    // Counters for diagnostics
+    uint64_t numAcquired() const { return _numAcquired.load(std::memory_order_relaxed); }
+    uint64_t numHeapAllocations() const { return _numHeapAllocations.load(std::memory_order_relaxed); }
+
+private:
+    friend class MediaPacketBuffer;
+    void recycle(MediaPacketBuffer* buffer);
+    static int sizeClassFor(size_t minCapacity);
+
+private:
+    enum
+    {
+        NumSizeClasses = 5
+    };
+
+    struct FreeList
+    {
+        std::mutex mutex;
+        std::vector<MediaPacketBuffer*> buffers;
+    };
+
+    FreeList _freeLists[NumSizeClasses];
+    std::atomic<uint64_t> _numAcquired;
+    std::atomic<uint64_t> _numHeapAllocations;
+};
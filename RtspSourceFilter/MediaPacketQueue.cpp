@@ -0,0 +1,232 @@
+#include "MediaPacketQueue.h"
+
+namespace
+{
+    // Block policy won't stall live555 worker thread for longer than that.
+    // Also protects us from blocking forever if output pin is not connected at all.
+    const std::chrono::milliseconds maxProducerBlockTime(500);
+}
+
+MediaPacketQueue::MediaPacketQueue(size_t capacity, RtspQueueOverflowPolicy policy)
+    : _queue(capacity)
+    , _maxBytes(0)
+    , _maxFrames(0)
+    , _policy(policy)
+    , _queuedBytes(0)
+    , _flushUpTo(0)
+    , _producerSkipToSyncPoint(false)
+    , _consumerSkipToSyncPoint(false)
+    , _producerWaiting(false)
+    , _droppedFrames(0)
+    , _droppedBytes(0)
+    , _overflowEvents(0)
+{
+}
+
+void MediaPacketQueue::setLimits(size_t maxBytes, size_t maxFrames,
+                                 RtspQueueOverflowPolicy policy)
+{
+    _maxBytes.store(maxBytes, std::memory_order_relaxed);
+    _maxFrames.store(maxFrames, std::memory_order_relaxed);
+    _policy.store(policy, std::memory_order_relaxed);
+}
+
+bool MediaPacketQueue::push(MediaPacketSample&& sample)
+{
+    // End-of-stream marker
+    if (sample.invalid())
+        return _queue.push(std::move(sample));
+
+    const size_t sampleSize = sample.size();
+
+    // We've lost something recently - don't feed decoder with packets it can't use
+    if (_producerSkipToSyncPoint)
+    {
+        if (!sample.isSyncPoint())
+        {
+            countDropped(sampleSize);
+            return false;
+        }
+        _producerSkipToSyncPoint = false;
+    }
+
+    const int policy = _policy.load(std::memory_order_relaxed);
+    if (policy == RtspQueueBlock && !waitForRoom(sampleSize))
+    {
+        _overflowEvents.fetch_add(1, std::memory_order_relaxed);
+        countDropped(sampleSize);
+        return false;
+    }
+
+    // Account before publishing so the consumer never sees negative size
+    _queuedBytes.fetch_add(sampleSize, std::memory_order_relaxed);
+    if (!_queue.push(std::move(sample)))
+    {
+        // Queue is full to its capacity - consumer is stalled, there's no room to trim
+        _queuedBytes.fetch_sub(sampleSize, std::memory_order_relaxed);
+        _overflowEvents.fetch_add(1, std::memory_order_relaxed);
+        countDropped(sampleSize);
+        if (policy == RtspQueueDropUntilIdr)
+            _producerSkipToSyncPoint = true;
+        return false;
+    }
+
+    return true;
+}
+
+void MediaPacketQueue::pop(MediaPacketSample& sample)
+{
+    for (;;)
+    {
+        trimOverflow();
+        _queue.pop(sample);
+        if (onPopped(sample))
+            return;
+    }
+}
+
+bool MediaPacketQueue::try_pop_for(MediaPacketSample& sample, std::chrono::milliseconds duration)
+{
+    auto deadline = std::chrono::steady_clock::now() + duration;
+    for (;;)
+    {
+        trimOverflow();
+        auto now = std::chrono::steady_clock::now();
+        auto timeLeft = now < deadline
+                            ? std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now)
+                            : std::chrono::milliseconds(0);
+        if (!_queue.try_pop_for(sample, timeLeft))
+            return false;
+        if (onPopped(sample))
+            return true;
+    }
+}
+
+void MediaPacketQueue::clear()
+{
+    MediaPacketSample sample;
+    while (_queue.try_pop(sample))
+    {
+        _queuedBytes.fetch_sub(sample.size(), std::memory_order_relaxed);
+        sample = MediaPacketSample();
+    }
+    _consumerSkipToSyncPoint = false;
+}
+
+void MediaPacketQueue::flush()
+{
+    _flushUpTo.store(_queue.pushedCount(), std::memory_order_release);
+}
+
+void MediaPacketQueue::getStats(RtspMediaQueueStats& stats) const
+{
+    stats.droppedFrames = _droppedFrames.load(std::memory_order_relaxed);
+    stats.droppedBytes = _droppedBytes.load(std::memory_order_relaxed);
+    stats.overflowEvents = _overflowEvents.load(std::memory_order_relaxed);
+    stats.queuedFrames = static_cast<DWORD>(_queue.size());
+    stats.queuedBytes = static_cast<DWORD>(_queuedBytes.load(std::memory_order_relaxed));
+}
+
+bool MediaPacketQueue::overLimits() const
+{
+    const size_t maxFrames = _maxFrames.load(std::memory_order_relaxed);
+    const size_t maxBytes = _maxBytes.load(std::memory_order_relaxed);
+    return (maxFrames > 0 && _queue.size() > maxFrames) ||
+           (maxBytes > 0 && _queuedBytes.load(std::memory_order_relaxed) > maxBytes);
+}
+
+void MediaPacketQueue::trimOverflow()
+{
+    const int policy = _policy.load(std::memory_order_relaxed);
+    if (policy == RtspQueueBlock || !overLimits())
+        return;
+
+    _overflowEvents.fetch_add(1, std::memory_order_relaxed);
+
+    MediaPacketSample* front;
+    while (overLimits() && (front = _queue.front()) != nullptr && !front->invalid())
+        dropFront();
+
+    if (policy == RtspQueueDropUntilIdr)
+    {
+        while ((front = _queue.front()) != nullptr && !front->invalid() && !front->isSyncPoint())
+            dropFront();
+        // Nothing to resume from yet - continue discarding as packets come
+        if (front == nullptr)
+            _consumerSkipToSyncPoint = true;
+    }
+}
+
+void MediaPacketQueue::dropFront()
+{
+    MediaPacketSample sample;
+    if (_queue.try_pop(sample))
+    {
+        _queuedBytes.fetch_sub(sample.size(), std::memory_order_relaxed);
+        countDropped(sample.size());
+    }
+}
+
+bool MediaPacketQueue::onPopped(MediaPacketSample& sample)
+{
+    _queuedBytes.fetch_sub(sample.size(), std::memory_order_relaxed);
+
+    // Let blocked producer know there's a room now
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_producerWaiting.load(std::memory_order_relaxed))
+    {
+        { std::lock_guard<std::mutex> lock(_mutex); }
+        _condition_variable.notify_one();
+    }
+
+    if (sample.invalid())
+    {
+        _consumerSkipToSyncPoint = false;
+        return true;
+    }
+
+    // Enqueued before the last flush
+    if (_queue.poppedCount() <= _flushUpTo.load(std::memory_order_acquire))
+        return false;
+
+    if (_consumerSkipToSyncPoint)
+    {
+        if (!sample.isSyncPoint())
+        {
+            countDropped(sample.size());
+            return false;
+        }
+        _consumerSkipToSyncPoint = false;
+    }
+
+    return true;
+}
+
+bool MediaPacketQueue::waitForRoom(size_t sampleSize)
+{
+    auto hasRoom = [this, sampleSize]
+    {
+        const size_t maxFrames = _maxFrames.load(std::memory_order_relaxed);
+        const size_t maxBytes = _maxBytes.load(std::memory_order_relaxed);
+        const size_t frames = _queue.size();
+        return frames < _queue.capacity() && (maxFrames == 0 || frames < maxFrames) &&
+               (maxBytes == 0 ||
+                _queuedBytes.load(std::memory_order_relaxed) + sampleSize <= maxBytes);
+    };
+
+    if (hasRoom())
+        return true;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _producerWaiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool status = _condition_variable.wait_for(lock, maxProducerBlockTime, hasRoom);
+    _producerWaiting.store(false, std::memory_order_relaxed);
+    return status;
+}
+
+void MediaPacketQueue::countDropped(size_t sampleSize)
+{
+    _droppedFrames.fetch_add(1, std::memory_order_relaxed);
+    _droppedBytes.fetch_add(sampleSize, std::memory_order_relaxed);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "MediaPacketSample.h"
+#include "SpscRingQueue.h"
+#include "RtspSourceFilter.h"
+
+/**
+ * Media packet queue between live555 worker thread (producer) and output pin thread (consumer)
+ * with latency protection: a cap in bytes and in frames and a policy deciding what happens
+ * when the cap is hit.
+ *
+ * - Block: producer waits (for a limited time) for the consumer to make room
+ * - DropOldest: consumer discards the oldest packets until queue is back under the cap
+ * - DropUntilIdr: like DropOldest but keeps discarding until the head is a sync point
+ *   (IDR for H.264) so the decoder resumes on a clean picture
+ *
+ * Invalid (empty) samples are end-of-stream markers - they bypass limits and are never dropped
+ * by the policy.
+ */
+class MediaPacketQueue
+{
+public:
+    MediaPacketQueue(size_t capacity, RtspQueueOverflowPolicy policy);
+
+    MediaPacketQueue(const MediaPacketQueue&) = delete;
+    MediaPacketQueue& operator=(const MediaPacketQueue&) = delete;
+
+    /**
+     * Set limits (0 means no limit other than queue capacity) and overflow policy.
+     * Can be called from any thread.
+     */
+    void setLimits(size_t maxBytes, size_t maxFrames, RtspQueueOverflowPolicy policy);
+
+    /**
+     * Enqueue a sample - producer side.
+     * Returns false if the sample has been dropped because of overflow.
+     */
+    bool push(MediaPacketSample&& sample);
+
+    /**
+     * Dequeue a sample, block until one becomes available - consumer side
+     */
+    void pop(MediaPacketSample& sample);
+
+    /**
+     * Dequeue a sample, wait for at most given duration - consumer side.
+     * Returns true if successful; false otherwise.
+     */
+    bool try_pop_for(MediaPacketSample& sample, std::chrono::milliseconds duration);
+
+    /**
+     * Drop all queued samples - consumer side
+     */
+    void clear();
+
+    /**
+     * Discard everything enqueued so far - producer side. Samples are dropped by the consumer
+     * as it gets to them, end-of-stream markers are kept.
+     */
+    void flush();
+
+    bool empty() const { return _queue.empty(); }
+    size_t size() const { return _queue.size(); }
+    size_t sizeInBytes() const { return _queuedBytes.load(std::memory_order_relaxed); }
+
+    void getStats(RtspMediaQueueStats& stats) const;
+
+private:
+    bool overLimits() const;
+    void trimOverflow();
+    void dropFront();
+    bool onPopped(MediaPacketSample& sample);
+    bool waitForRoom(size_t sampleSize);
+    void countDropped(size_t sampleSize);
+
+private:
+    SpscRingQueue<MediaPacketSample> _queue;
+
+    std::atomic<size_t> _maxBytes;
+    std::atomic<size_t> _maxFrames;
+    std::atomic<int> _policy;
+
+    std::atomic<size_t> _queuedBytes;
+    // Samples up to this push count are discarded by the consumer (see flush())
+    std::atomic<size_t> _flushUpTo;
+
+    // Producer side: incoming samples are discarded until next sync point
+    bool _producerSkipToSyncPoint;
+    // Consumer side: dequeued samples are discarded until next sync point
+    bool _consumerSkipToSyncPoint;
+
+    // Block policy - producer parking
+    std::atomic<bool> _producerWaiting;
+    std::mutex _mutex;
+    std::condition_variable _condition_variable;
+
+    // Statistics
+    std::atomic<uint64_t> _droppedFrames;
+    std::atomic<uint64_t> _droppedBytes;
+    std::atomic<uint64_t> _overflowEvents;
+};
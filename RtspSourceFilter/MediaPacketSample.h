@@ -1,9 +1,9 @@
 #pragma once
 
-#include <vector>
+#include <chrono>
 #include <cstdint>
 
-#include "ConcurrentQueue.h"
+#include "MediaPacketBufferPool.h"
 // for timeval struct definition
 #include <WinSock2.h>
 
@@ -13,13 +13,35 @@ public:
     /**
       * Construct an invalid media packet sample
       */
-    MediaPacketSample() {}
+    MediaPacketSample()
+        : _data(nullptr)
+        , _size(0)
+        , _presentationTime()
+        , _arrivalTime()
+        , _queuedTime()
+        , _isRtcpSynced(false)
+        , _isSyncPoint(false)
+        , _isDiscontinuity(false)
+        , _isAccessUnit(false)
+    {
+    }
 
-    MediaPacketSample(std::uint8_t* buffer, size_t bufSize, timeval presentationTime,
-                      bool isRtcpSynced)
-        : _buffer(buffer, buffer + bufSize)
+    /**
+     * Construct a media packet sample that references bufSize bytes at given offset of
+     * a pooled buffer. No copy is made.
+     */
+    MediaPacketSample(MediaPacketBufferRef buffer, size_t offset, size_t bufSize,
+                      timeval presentationTime, bool isRtcpSynced, bool isSyncPoint)
+        : _buffer(std::move(buffer))
+        , _data(_buffer.data() + offset)
+        , _size(bufSize)
         , _presentationTime(presentationTime)
+        , _arrivalTime(std::chrono::steady_clock::now())
+        , _queuedTime()
         , _isRtcpSynced(isRtcpSynced)
+        , _isSyncPoint(isSyncPoint)
+        , _isDiscontinuity(false)
+        , _isAccessUnit(false)
     {
     }
 
@@ -31,9 +53,18 @@ public:
      */
     MediaPacketSample(MediaPacketSample&& other)
         : _buffer(std::move(other._buffer))
+        , _data(other._data)
+        , _size(other._size)
         , _presentationTime(other._presentationTime)
+        , _arrivalTime(other._arrivalTime)
+        , _queuedTime(other._queuedTime)
         , _isRtcpSynced(other._isRtcpSynced)
+        , _isSyncPoint(other._isSyncPoint)
+        , _isDiscontinuity(other._isDiscontinuity)
+        , _isAccessUnit(other._isAccessUnit)
     {
+        other._data = nullptr;
+        other._size = 0;
     }
 
     /**
@@ -44,20 +75,66 @@ public:
         if (this != &other)
         {
             _buffer = std::move(other._buffer);
+            _data = other._data;
+            _size = other._size;
+            other._data = nullptr;
+            other._size = 0;
             _presentationTime = other._presentationTime;
+            _arrivalTime = other._arrivalTime;
+            _queuedTime = other._queuedTime;
             _isRtcpSynced = other._isRtcpSynced;
+            _isSyncPoint = other._isSyncPoint;
+            _isDiscontinuity = other._isDiscontinuity;
+            _isAccessUnit = other._isAccessUnit;
         }
         return *this;
     }
 
     ~MediaPacketSample() {}
 
+    /**
+     * Another sample referencing the same data - the pooled buffer is shared, not copied
+     */
+    MediaPacketSample clone() const
+    {
+        MediaPacketSample sample;
+        sample._buffer = _buffer;
+        sample._data = _data;
+        sample._size = _size;
+        sample._presentationTime = _presentationTime;
+        sample._arrivalTime = _arrivalTime;
+        sample._queuedTime = _queuedTime;
+        sample._isRtcpSynced = _isRtcpSynced;
+        sample._isSyncPoint = _isSyncPoint;
+        sample._isDiscontinuity = _isDiscontinuity;
+        sample._isAccessUnit = _isAccessUnit;
+        return sample;
+    }
+
     bool invalid() const { return size() == 0; }
-    size_t size() const { return _buffer.size(); }
-    const std::uint8_t* data() const { return _buffer.data(); }
-    std::uint8_t* data() { return _buffer.data(); }
+    size_t size() const { return _size; }
+    const std::uint8_t* data() const { return _data; }
+    std::uint8_t* data() { return _data; }
     const timeval& presentationTime() const { return _presentationTime; }
+    void setPresentationTime(const timeval& presentationTime) { _presentationTime = presentationTime; }
+    // When the sample has been received - construction time unless the sink knows better
+    // (the first RTP packet of it read off the network)
+    std::chrono::steady_clock::time_point arrivalTime() const { return _arrivalTime; }
+    void setArrivalTime(std::chrono::steady_clock::time_point time) { _arrivalTime = time; }
+    // When the sample has been pushed to the media queue
+    std::chrono::steady_clock::time_point queuedTime() const { return _queuedTime; }
+    void setQueuedTime(std::chrono::steady_clock::time_point time) { _queuedTime = time; }
     bool isRtcpSynced() const { return _isRtcpSynced; }
+    // Decoding can start from this sample (IDR for H.264, IRAP for H.265, every frame for audio)
+    bool isSyncPoint() const { return _isSyncPoint; }
+    // First sample of a different stream (f.e. after switching sessions) - timestamps
+    // don't continue previous ones
+    bool isDiscontinuity() const { return _isDiscontinuity; }
+    void setDiscontinuity(bool discontinuity) { _isDiscontinuity = discontinuity; }
+    // Whole H.264/H.265 access unit - NAL units each preceded by 4-byte start code - rather
+    // than a single NAL unit
+    bool isAccessUnit() const { return _isAccessUnit; }
+    void setAccessUnit(bool accessUnit) { _isAccessUnit = accessUnit; }
 
     int64_t timestamp() const
     {
@@ -67,9 +144,15 @@ public:
     }
 
 private:
-    std::vector<std::uint8_t> _buffer;
+    MediaPacketBufferRef _buffer;
+    std::uint8_t* _data;
+    size_t _size;
     timeval _presentationTime;
+    std::chrono::steady_clock::time_point _arrivalTime;
+    std::chrono::steady_clock::time_point _queuedTime;
     bool _isRtcpSynced;
+    bool _isSyncPoint;
+    bool _isDiscontinuity;
+    bool _isAccessUnit;
 };
 
-typedef ConcurrentQueue<MediaPacketSample> MediaPacketQueue;
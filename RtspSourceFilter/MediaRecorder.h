@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "MediaPacketSample.h"
+
+/**
+ * Recording tap of a media stream. A sink delivering to a consumer with a recorder hands it
+ * every sample it queues for the output pin (see ProxyMediaConsumer) - parameter sets, cached
+ * GOP and discontinuities included - so the recording is what the pin gets, regardless of the
+ * pin's own queue overflowing.
+ *
+ * Called from the ingest loop thread, so implementations must not block nor touch the disk
+ * there: samples share pooled slabs, keeping a clone() is all it takes to write them
+ * elsewhere (see FileRecorder).
+ */
+class MediaRecorder
+{
+public:
+    virtual ~MediaRecorder() {}
+
+    /**
+     * Codec (live555 codec name) of the samples to follow and what a file has to start with
+     * for them to be decodable - out-of-band parameter sets as Annex B byte stream for
+     * H.264/H.265, nothing for others. Called whenever a sink starts delivering.
+     */
+    virtual void setFormat(const char* codecName, const uint8_t* header, size_t headerSize) = 0;
+
+    /**
+     * Sample queued for the output pin
+     */
+    virtual void record(const MediaPacketSample& sample) = 0;
+};
@@ -0,0 +1,286 @@
+#include "ParameterSetTracker.h"
+#include "NALUnitScanner.hh"
+
+#include <cstring>
+
+ParameterSetTracker::ParameterSetTracker(Codec codec) : _codec(codec)
+{
+    if (_codec == CodecH264)
+    {
+        _nals[KindSps].resize(H264MaxSpsCount);
+        _nals[KindPps].resize(H264MaxPpsCount);
+        _h264Sps.resize(H264MaxSpsCount);
+        _h264Pps.resize(H264MaxPpsCount);
+    }
+    else
+    {
+        _nals[KindVps].resize(H265MaxVpsCount);
+        _nals[KindSps].resize(H265MaxSpsCount);
+        _nals[KindPps].resize(H265MaxPpsCount);
+        _h265Vps.resize(H265MaxVpsCount);
+        _h265Sps.resize(H265MaxSpsCount);
+        _h265Pps.resize(H265MaxPpsCount);
+    }
+    Reset();
+}
+
+void ParameterSetTracker::Reset()
+{
+    for (int kind = 0; kind < NumKinds; ++kind)
+    {
+        for (auto& nal : _nals[kind])
+            nal.clear();
+        _lastId[kind] = -1;
+        _activeId[kind] = -1;
+        _activeNals[kind].clear();
+    }
+    _pending = false;
+}
+
+bool ParameterSetTracker::Update(const uint8_t* nal, size_t nalSize)
+{
+    if (nalSize < (_codec == CodecH264 ? 1U : 2U))
+        return false;
+
+    const unsigned nalType = _codec == CodecH264 ? H264NalType(nal) : H265NalType(nal);
+    const int kind = ParameterSetKind(nalType);
+    if (kind >= 0)
+    {
+        Store(kind, nal, nalSize);
+        return false;
+    }
+
+    // Nothing new to activate - the common case
+    if (!_pending)
+        return false;
+    return IsSlice(nal, nalSize) && Activate(nal, nalSize);
+}
+
+bool ParameterSetTracker::UpdateAccessUnit(const uint8_t* accessUnit, size_t size)
+{
+    const uint8_t* end = accessUnit + size;
+    const uint8_t* startCode = findStartCode(accessUnit, end);
+    while (startCode != end)
+    {
+        const uint8_t* nal = startCode + 3;
+        // Only the header of a slice is parsed - no need to look for its end
+        if (IsSlice(nal, end - nal))
+            return Update(nal, end - nal);
+
+        startCode = findStartCode(nal, end);
+        // Leading zero byte of a 4-byte start code doesn't belong to the NAL unit
+        const uint8_t* nalEnd = startCode != end && startCode > nal && startCode[-1] == 0
+                                    ? startCode - 1
+                                    : startCode;
+        Update(nal, nalEnd - nal);
+    }
+    return false;
+}
+
+bool ParameterSetTracker::IsSlice(const uint8_t* nal, size_t nalSize) const
+{
+    if (_codec == CodecH264)
+    {
+        const unsigned nalType = nalSize > 0 ? H264NalType(nal) : 0;
+        return nalType == H264NalSlice || nalType == H264NalSliceIdr;
+    }
+    return nalSize > 1 && H265IsSlice(H265NalType(nal));
+}
+
+int ParameterSetTracker::ParameterSetKind(unsigned nalType) const
+{
+    if (_codec == CodecH264)
+    {
+        switch (nalType)
+        {
+        case H264NalSps:
+            return KindSps;
+        case H264NalPps:
+            return KindPps;
+        }
+    }
+    else
+    {
+        switch (nalType)
+        {
+        case H265NalVps:
+            return KindVps;
+        case H265NalSps:
+            return KindSps;
+        case H265NalPps:
+            return KindPps;
+        }
+    }
+    return -1;
+}
+
+void ParameterSetTracker::Store(int kind, const uint8_t* nal, size_t nalSize)
+{
+    // Same as the previous one of its kind - the usual repetition before IDR
+    const int lastId = _lastId[kind];
+    if (lastId >= 0)
+    {
+        const std::vector<uint8_t>& last = _nals[kind][lastId];
+        if (last.size() == nalSize && !memcmp(last.data(), nal, nalSize))
+            return;
+    }
+
+    // Malformed parameter sets are ignored, the stored ones (if any) stay in effect
+    const int id = _codec == CodecH264 ? ParseH264(kind, nal, nalSize)
+                                       : ParseH265(kind, nal, nalSize);
+    if (id < 0)
+        return;
+
+    _lastId[kind] = id;
+    std::vector<uint8_t>& stored = _nals[kind][id];
+    if (stored.size() != nalSize || memcmp(stored.data(), nal, nalSize))
+    {
+        stored.assign(nal, nal + nalSize);
+        _pending = true;
+    }
+}
+
+int ParameterSetTracker::ParseH264(int kind, const uint8_t* nal, size_t nalSize)
+{
+    if (kind == KindSps)
+    {
+        H264Sps sps;
+        if (!ParseH264Sps(nal, nalSize, sps))
+            return -1;
+        _h264Sps[sps.spsId] = sps;
+        return sps.spsId;
+    }
+
+    H264Pps pps;
+    if (!ParseH264Pps(nal, nalSize, pps))
+        return -1;
+    // Syntax differs for 4:4:4 only (see ParseH264Pps)
+    if (IsStored(KindSps, pps.spsId) && _h264Sps[pps.spsId].chromaFormatIdc == 3 &&
+        !ParseH264Pps(nal, nalSize, pps, &_h264Sps[pps.spsId]))
+        return -1;
+    _h264Pps[pps.ppsId] = pps;
+    return pps.ppsId;
+}
+
+int ParameterSetTracker::ParseH265(int kind, const uint8_t* nal, size_t nalSize)
+{
+    switch (kind)
+    {
+    case KindVps:
+    {
+        H265Vps vps;
+        if (!ParseH265Vps(nal, nalSize, vps))
+            return -1;
+        _h265Vps[vps.vpsId] = vps;
+        return vps.vpsId;
+    }
+    case KindSps:
+    {
+        H265Sps sps;
+        if (!ParseH265Sps(nal, nalSize, sps))
+            return -1;
+        _h265Sps[sps.spsId] = sps;
+        return sps.spsId;
+    }
+    default:
+    {
+        H265Pps pps;
+        if (!ParseH265Pps(nal, nalSize, pps))
+            return -1;
+        _h265Pps[pps.ppsId] = pps;
+        return pps.ppsId;
+    }
+    }
+}
+
+bool ParameterSetTracker::Activate(const uint8_t* nal, size_t nalSize)
+{
+    unsigned ppsId, spsId;
+    int vpsId = -1;
+
+    // Parameter sets can change at the beginning of a picture only
+    if (_codec == CodecH264)
+    {
+        if (!ParseH264SlicePpsId(nal, nalSize, ppsId) || !IsStored(KindPps, ppsId))
+            return false;
+        spsId = _h264Pps[ppsId].spsId;
+        if (!IsStored(KindSps, spsId))
+            return false;
+        H264SliceHeader header;
+        if (!ParseH264SliceHeader(nal, nalSize, _h264Sps[spsId], _h264Pps[ppsId], header) ||
+            header.firstMbInSlice != 0)
+            return false;
+    }
+    else
+    {
+        if (!ParseH265SlicePpsId(nal, nalSize, ppsId) || !IsStored(KindPps, ppsId))
+            return false;
+        spsId = _h265Pps[ppsId].spsId;
+        if (!IsStored(KindSps, spsId))
+            return false;
+        H265SliceHeader header;
+        if (!ParseH265SliceHeader(nal, nalSize, _h265Sps[spsId], _h265Pps[ppsId], header) ||
+            !header.firstSliceSegmentInPic)
+            return false;
+        // VPS is mandatory but decoders don't really need it - do without if it's missing
+        if (IsStored(KindVps, _h265Sps[spsId].vpsId))
+            vpsId = _h265Sps[spsId].vpsId;
+    }
+
+    _pending = false;
+
+    const std::vector<uint8_t> noVps;
+    const std::vector<uint8_t>& vps = vpsId >= 0 ? _nals[KindVps][vpsId] : noVps;
+    const bool changed = _activeId[KindSps] < 0 ||
+                         _activeNals[KindSps] != _nals[KindSps][spsId] ||
+                         _activeNals[KindVps] != vps;
+
+    _activeId[KindVps] = vpsId;
+    _activeId[KindSps] = spsId;
+    _activeId[KindPps] = ppsId;
+    _activeNals[KindVps] = vps;
+    _activeNals[KindSps] = _nals[KindSps][spsId];
+    _activeNals[KindPps] = _nals[KindPps][ppsId];
+    if (_codec == CodecH264)
+    {
+        _activeH264Sps = _h264Sps[spsId];
+    }
+    else
+    {
+        _activeH265Sps = _h265Sps[spsId];
+        if (vpsId >= 0)
+            _activeH265Vps = _h265Vps[vpsId];
+    }
+    return changed;
+}
+
+bool ParameterSetTracker::IsStored(int kind, int id) const
+{
+    return id >= 0 && id < static_cast<int>(_nals[kind].size()) && !_nals[kind][id].empty();
+}
+
+void ParameterSetTracker::GetActiveParameterSets(
+    std::vector<std::vector<uint8_t>>& parameterSets) const
+{
+    parameterSets.clear();
+    for (int kind = 0; kind < NumKinds; ++kind)
+    {
+        if (!_activeNals[kind].empty())
+            parameterSets.push_back(_activeNals[kind]);
+    }
+}
+
+const H264Sps* ParameterSetTracker::ActiveH264Sps() const
+{
+    return _codec == CodecH264 && _activeId[KindSps] >= 0 ? &_activeH264Sps : nullptr;
+}
+
+const H265Vps* ParameterSetTracker::ActiveH265Vps() const
+{
+    return _codec == CodecH265 && _activeId[KindVps] >= 0 ? &_activeH265Vps : nullptr;
+}
+
+const H265Sps* ParameterSetTracker::ActiveH265Sps() const
+{
+    return _codec == CodecH265 && _activeId[KindSps] >= 0 ? &_activeH265Sps : nullptr;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "H264StreamParser.h"
+#include "H265StreamParser.h"
+
+/**
+ * Keeps parameter sets (SPS and PPS, plus VPS for H.265) of a H.264/H.265 stream and tells
+ * when the ones in effect change - f.e. a camera switching resolution mid-stream sends new
+ * in-band SPS before the next IDR.
+ *
+ * Cheap enough to see every NAL unit: slices and other NAL units cost a type check, repeated
+ * parameter sets (usually sent with every IDR) a compare with the previous one. Parameter
+ * sets are parsed only when they differ and slice headers only for the first slice following
+ * such an update - that's when the new parameter sets get activated.
+ *
+ * Used from a single thread.
+ */
+class ParameterSetTracker
+{
+public:
+    enum Codec
+    {
+        CodecH264,
+        CodecH265
+    };
+
+    explicit ParameterSetTracker(Codec codec);
+
+    ParameterSetTracker(const ParameterSetTracker&) = delete;
+    ParameterSetTracker& operator=(const ParameterSetTracker&) = delete;
+
+    /**
+     * Feed a NAL unit (no start code nor length field). Returns true if it's the first slice
+     * of a picture activating a SPS (or VPS) different from the one in effect so far - the
+     * stream format might have changed. The very first activation counts as a change too.
+     */
+    bool Update(const uint8_t* nal, size_t nalSize);
+
+    /**
+     * Same for a whole access unit (NAL units each preceded by start code). Parameter sets
+     * precede the first slice, so the access unit is scanned only that far.
+     */
+    bool UpdateAccessUnit(const uint8_t* accessUnit, size_t size);
+
+    /**
+     * Forget all parameter sets
+     */
+    void Reset();
+
+    Codec GetCodec() const { return _codec; }
+
+    /**
+     * NAL units of parameter sets in effect in decoding order: (VPS,) SPS and PPS.
+     * Empty until the first slice activates them.
+     */
+    void GetActiveParameterSets(std::vector<std::vector<uint8_t>>& parameterSets) const;
+
+    // Parameter sets in effect or nullptr until the first slice activates them
+    const H264Sps* ActiveH264Sps() const;
+    const H265Vps* ActiveH265Vps() const;
+    const H265Sps* ActiveH265Sps() const;
+
+private:
+    enum Kind
+    {
+        KindVps,
+        KindSps,
+        KindPps,
+        NumKinds
+    };
+
+    int ParameterSetKind(unsigned nalType) const;
+    bool IsSlice(const uint8_t* nal, size_t nalSize) const;
+    void Store(int kind, const uint8_t* nal, size_t nalSize);
+    int ParseH264(int kind, const uint8_t* nal, size_t nalSize);
+    int ParseH265(int kind, const uint8_t* nal, size_t nalSize);
+    bool Activate(const uint8_t* nal, size_t nalSize);
+    bool IsStored(int kind, int id) const;
+
+private:
+    Codec _codec;
+
+    // NAL units of each kind indexed by parameter set id, empty if not received yet
+    std::vector<std::vector<uint8_t>> _nals[NumKinds];
+    // Parsed parameter sets, only the ones of our codec are allocated
+    std::vector<H264Sps> _h264Sps;
+    std::vector<H264Pps> _h264Pps;
+    std::vector<H265Vps> _h265Vps;
+    std::vector<H265Sps> _h265Sps;
+    std::vector<H265Pps> _h265Pps;
+    // Id of the latest parameter set of each kind - repeated ones are compared with it
+    int _lastId[NumKinds];
+
+    // A parameter set has been updated since the last activation
+    bool _pending;
+    // Parameter sets in effect: ids and copies as they were when activated - stored ones may
+    // have been replaced since
+    int _activeId[NumKinds];
+    std::vector<uint8_t> _activeNals[NumKinds];
+    H264Sps _activeH264Sps;
+    H265Vps _activeH265Vps;
+    H265Sps _activeH265Sps;
+};
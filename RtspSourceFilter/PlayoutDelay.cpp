@@ -0,0 +1,94 @@
+#include "PlayoutDelay.h"
+
+#include <algorithm>
+
+namespace
+{
+    // Slew rates - delay change per unit of stream time
+    const double growRate = 0.02;
+    const double shrinkRate = 0.005;
+    // RFC 3550 jitter is a mean deviation - a few of them cover nearly all packets
+    const int64_t jitterMultiplier = 4;
+    // Late samples push the target that much past their lateness
+    const int64_t lateHeadroom = 20 * 10000; // 20 ms
+    const int64_t restartThreshold = 1000 * 10000; // 1 s
+    const int64_t minSlewInterval = 10 * 10000; // 10 ms
+}
+
+PlayoutDelay::PlayoutDelay() { configure(0, 0, 0); }
+
+void PlayoutDelay::configure(int64_t delay, int64_t minDelay, int64_t maxDelay)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _minDelay = minDelay;
+    _maxDelay = maxDelay;
+    _delay = isAdaptive() ? std::min(std::max(delay, minDelay), maxDelay) : delay;
+    for (int64_t& jitter : _jitter)
+        jitter = 0;
+    _lateFloor = 0;
+    _lastStreamTime = 0;
+    _started = false;
+    _lateSamples = 0;
+}
+
+void PlayoutDelay::reportJitter(Stream stream, int64_t jitter)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _jitter[stream] = jitter;
+}
+
+void PlayoutDelay::reportLate(int64_t lateness)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_lateSamples;
+    if (isAdaptive())
+        _lateFloor = std::max(_lateFloor, _delay + lateness + lateHeadroom);
+}
+
+int64_t PlayoutDelay::target() const
+{
+    const int64_t jitter = *std::max_element(_jitter, _jitter + NumStreams);
+    const int64_t target = std::max(_minDelay + jitterMultiplier * jitter, _lateFloor);
+    return std::min(target, _maxDelay);
+}
+
+int64_t PlayoutDelay::delay(int64_t streamTime)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!isAdaptive())
+        return _delay;
+
+    // Stream time starts over with each run. Pins may report a bit out of order, though.
+    if (!_started || streamTime < _lastStreamTime - restartThreshold)
+    {
+        _started = true;
+        _lastStreamTime = streamTime;
+        return _delay;
+    }
+    // Samples come in bursts (NAL units of a picture) - slewing by the tiny steps in between
+    // would lose most of it to rounding
+    const int64_t elapsed = streamTime - _lastStreamTime;
+    if (elapsed < minSlewInterval)
+        return _delay;
+    _lastStreamTime = streamTime;
+
+    const int64_t maxShrink = static_cast<int64_t>(elapsed * shrinkRate);
+    _lateFloor = std::max<int64_t>(_lateFloor - maxShrink, 0);
+
+    const int64_t targetDelay = target();
+    if (targetDelay > _delay)
+        _delay = std::min(targetDelay, _delay + static_cast<int64_t>(elapsed * growRate));
+    else
+        _delay = std::max(targetDelay, _delay - maxShrink);
+    return _delay;
+}
+
+void PlayoutDelay::getStats(RtspPlayoutDelayStats& stats)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    stats.delayMicroseconds = static_cast<DWORD>(_delay / 10);
+    stats.targetMicroseconds = static_cast<DWORD>((isAdaptive() ? target() : _delay) / 10);
+    stats.videoJitterMicroseconds = static_cast<DWORD>(_jitter[StreamVideo] / 10);
+    stats.audioJitterMicroseconds = static_cast<DWORD>(_jitter[StreamAudio] / 10);
+    stats.lateSamples = _lateSamples;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+#include "RtspSourceFilter.h"
+
+/**
+ * Playout delay shared by the output pins - how far behind the arrival of the first sample
+ * (RTCP synced one, if any) the stream is played. Times are in 100 ns units (REFERENCE_TIME).
+ *
+ * Fixed unless given a range. Then the target follows interarrival jitter of the streams
+ * (RFC 3550, as tracked by live555) on top of the minimum, and is raised past whatever lateness
+ * the pins run into. The delay itself doesn't jump to the target but slews towards it as stream
+ * time goes by - a couple of percent when growing, half a percent when shrinking - so samples
+ * are re-timed gradually and renderers don't glitch.
+ *
+ * Used from the pins' streaming threads and the ingest loop thread.
+ */
+class PlayoutDelay
+{
+public:
+    enum Stream
+    {
+        StreamVideo,
+        StreamAudio,
+        NumStreams
+    };
+
+    PlayoutDelay();
+
+    /**
+     * Start over with given delay - kept as it is if minDelay isn't less than maxDelay
+     */
+    void configure(int64_t delay, int64_t minDelay, int64_t maxDelay);
+
+    // Current interarrival jitter of given stream
+    void reportJitter(Stream stream, int64_t jitter);
+    // Sample reached the pin that much after it's been due
+    void reportLate(int64_t lateness);
+
+    /**
+     * Delay to apply to samples going out at given stream time
+     */
+    int64_t delay(int64_t streamTime);
+
+    void getStats(RtspPlayoutDelayStats& stats);
+
+private:
+    bool isAdaptive() const { return _minDelay < _maxDelay; }
+    int64_t target() const;
+
+private:
+    std::mutex _mutex;
+    int64_t _delay;
+    int64_t _minDelay;
+    int64_t _maxDelay;
+    int64_t _jitter[NumStreams];
+    // Raised by late samples, sinks back at the shrinking pace
+    int64_t _lateFloor;
+    int64_t _lastStreamTime;
+    bool _started;
+    uint64_t _lateSamples;
+};
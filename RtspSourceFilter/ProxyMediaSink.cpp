@@ -1,16 +1,276 @@
 #include "ProxyMediaSink.h"
+#include "H264StreamParser.h"
+#include "H265StreamParser.h"
+#include "SPropParameterSets.h"
+#include "CodecRegistry.h"
+#include "GroupsockHelper.hh"
+
+#include <algorithm>
+
+namespace
+{
+    const size_t recvBufferVideo = 256 * 1024; // 256KB - H.264 IDR frames can be really big
+    const size_t recvBufferAudio = 4096;       // 4KB
+    const unsigned int packetReorderingThresholdTime = 200 * 1000; // 200 ms
+    // Each slab holds at least that many worst-case frames
+    const size_t framesPerSlab = 4;
+    // Start code preceding each NAL unit of an assembled access unit
+    const size_t startCodeSize = 4;
+    const std::chrono::microseconds bitRateWindow(1000000);
+
+    bool IsIdrFrame(const uint8_t* nal, unsigned nalSize)
+    {
+        // More NAL types:
+        // http://gentlelogic.blogspot.com/2011/11/exploring-h264-part-2-h264-bitstream.html
+        return nalSize > 0 && H264NalType(nal) == H264NalSliceIdr;
+    }
+
+    // IDR, CRA or BLA - decoding can start from there
+    bool IsIrapFrame(const uint8_t* nal, unsigned nalSize)
+    {
+        return nalSize > 1 && H265IsIrap(H265NalType(nal));
+    }
+
+    // SPS and PPS are told apart by their NAL unit type
+    int H264ParameterSetId(const uint8_t* nal, unsigned nalSize)
+    {
+        const unsigned nalType = nalSize > 0 ? H264NalType(nal) : 0;
+        return nalType == H264NalSps || nalType == H264NalPps ? static_cast<int>(nalType) : -1;
+    }
+
+    // So are VPS, SPS and PPS
+    int H265ParameterSetId(const uint8_t* nal, unsigned nalSize)
+    {
+        const unsigned nalType = nalSize > 1 ? H265NalType(nal) : 0;
+        return nalType == H265NalVps || nalType == H265NalSps || nalType == H265NalPps
+                   ? static_cast<int>(nalType)
+                   : -1;
+    }
+
+    // An access unit is complete only once it has a picture
+    bool IsH264Slice(const uint8_t* nal, unsigned nalSize)
+    {
+        const unsigned nalType = nalSize > 0 ? H264NalType(nal) : 0;
+        return nalType >= H264NalSlice && nalType <= H264NalSliceIdr;
+    }
+
+    bool IsH265Slice(const uint8_t* nal, unsigned nalSize)
+    {
+        return nalSize > 1 && H265IsSlice(H265NalType(nal));
+    }
+
+    void WriteStartCode(uint8_t* dst)
+    {
+        dst[0] = 0;
+        dst[1] = 0;
+        dst[2] = 0;
+        dst[3] = 1;
+    }
+
+    ProxyMediaSink::Codec GetCodec(MediaSubsession& subsession)
+    {
+        if (!strcmp(subsession.codecName(), "H264"))
+            return ProxyMediaSink::CodecH264;
+        if (!strcmp(subsession.codecName(), "H265"))
+            return ProxyMediaSink::CodecH265;
+        return ProxyMediaSink::CodecOther;
+    }
+
+    AudioFraming GetAudioFraming(MediaSubsession& subsession)
+    {
+        const RtpCodecInfo* rtpCodec = FindRtpCodec(subsession);
+        return rtpCodec ? rtpCodec->framing : AudioFramingNone;
+    }
+
+    unsigned GetAudioSampleRate(MediaSubsession& subsession)
+    {
+        // AAC frames are of the rate given by AudioSpecificConfig, whatever RTP clock rate is
+        std::vector<uint8_t> audioSpecificConfig = GetAudioSpecificConfig(subsession);
+        AudioSpecificConfig config;
+        if (ParseAudioSpecificConfig(audioSpecificConfig.data(), audioSpecificConfig.size(),
+                                     config))
+        {
+            return config.sampleRate;
+        }
+        return subsession.rtpTimestampFrequency();
+    }
+
+    timeval AddUSecs(timeval time, unsigned uSecs)
+    {
+        time.tv_usec += uSecs;
+        time.tv_sec += time.tv_usec / 1000000;
+        time.tv_usec %= 1000000;
+        return time;
+    }
+
+    // live555 stamps received packets with wall clock time
+    std::chrono::microseconds TimeSince(const timeval& time)
+    {
+        timeval now;
+        gettimeofday(&now, nullptr);
+        const int64_t micros =
+            static_cast<int64_t>(now.tv_sec - time.tv_sec) * 1000000 + (now.tv_usec - time.tv_usec);
+        return std::chrono::microseconds(std::max<int64_t>(micros, 0));
+    }
+
+    // When the first packet of the frame just received was read off the network
+    std::chrono::steady_clock::time_point FrameArrivalTime(RTPSource* rtpSource)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (!rtpSource || rtpSource->curFrameTimeReceived().tv_sec == 0)
+            return now;
+        return now - TimeSince(rtpSource->curFrameTimeReceived());
+    }
+}
+
+size_t ProxyMediaSink::ReceiveBufferSize(MediaSubsession& subsession)
+{
+    if (!strcmp(subsession.mediumName(), "video"))
+        return recvBufferVideo;
+    if (!strcmp(subsession.mediumName(), "audio"))
+        return recvBufferAudio;
+    return 0;
+}
+
+void ProxyMediaSink::ConfigureRtpSource(UsageEnvironment& env, MediaSubsession& subsession)
+{
+    RTPSource* rtpSource = subsession.rtpSource();
+    if (!rtpSource)
+        return;
+
+    rtpSource->setPacketReorderingThresholdTime(packetReorderingThresholdTime);
+
+    // Increase receive buffer for rather big packets (like H.264 IDR)
+    const size_t recvBuffer = ReceiveBufferSize(subsession);
+    if (recvBuffer > 0 && rtpSource->RTPgs())
+    {
+        ::increaseReceiveBufferTo(env, rtpSource->RTPgs()->socketNum(),
+                                  static_cast<unsigned>(recvBuffer));
+    }
+}
 
 ProxyMediaSink::ProxyMediaSink(UsageEnvironment& env, MediaSubsession& subsession,
-                               MediaPacketQueue& mediaPacketQueue, size_t receiveBufferSize)
+                               const ProxyMediaConsumer* consumer, size_t receiveBufferSize,
+                               size_t gopCacheMaxBytes, size_t gopCacheMaxFrames,
+                               bool assembleAccessUnits)
     : MediaSink(env)
     , _receiveBufferSize(receiveBufferSize)
-    , _receiveBuffer(new uint8_t[receiveBufferSize])
+    , _receiveOffset(0)
     , _subsession(subsession)
-    , _mediaPacketQueue(mediaPacketQueue)
+    , _codec(GetCodec(subsession))
+    , _assembleAccessUnits(assembleAccessUnits && _codec != CodecOther)
+    , _accessUnitOffset(0)
+    , _accessUnitTime()
+    , _accessUnitHasPicture(false)
+    , _accessUnitIsSyncPoint(false)
+    , _audioFraming(GetAudioFraming(subsession))
+    , _audioSampleRate(GetAudioSampleRate(subsession))
+    , _packetTimeOffset(0)
+    , _gopCache(gopCacheMaxBytes, gopCacheMaxFrames)
+    , _statsSsrc(0)
+    , _packetsReceived(0)
+    , _packetsLost(0)
+    , _fragmentedFramesLost(0)
+    , _bitRateWindowStart(std::chrono::steady_clock::now())
+    , _bitRateWindowBytes(0)
+{
+    if (consumer)
+    {
+        Consumer first;
+        static_cast<ProxyMediaConsumer&>(first) = *consumer;
+        first.waitForSyncPoint = false;
+        first.pendingDiscontinuity = false;
+        _consumers.push_back(first);
+        startDelivery(_consumers.back());
+    }
+}
+
+ProxyMediaSink::~ProxyMediaSink()
+{
+    while (!_consumers.empty())
+        detach(*_consumers.back().mediaPacketQueue);
+}
+
+void ProxyMediaSink::attach(const ProxyMediaConsumer& consumer)
+{
+    consumer.mediaPacketQueue->flush();
+    if (_consumers.empty())
+    {
+        _bitRateWindowStart = std::chrono::steady_clock::now();
+        _bitRateWindowBytes = 0;
+    }
+
+    Consumer added;
+    static_cast<ProxyMediaConsumer&>(added) = consumer;
+    added.waitForSyncPoint = false;
+    added.pendingDiscontinuity = true;
+    _consumers.push_back(added);
+    startDelivery(_consumers.back());
+}
+
+void ProxyMediaSink::detach(MediaPacketQueue& mediaPacketQueue)
+{
+    auto it = std::find_if(_consumers.begin(), _consumers.end(),
+                           [&mediaPacketQueue](const Consumer& consumer)
+                           {
+                               return consumer.mediaPacketQueue == &mediaPacketQueue;
+                           });
+    if (it == _consumers.end())
+        return;
+
+    if (_codec != CodecOther)
+    {
+        it->gopCacheCounters->cachedFrames.store(0, std::memory_order_relaxed);
+        it->gopCacheCounters->cachedBytes.store(0, std::memory_order_relaxed);
+    }
+    _consumers.erase(it);
+}
+
+void ProxyMediaSink::startDelivery(Consumer& consumer)
+{
+    if (consumer.recorder)
+        setRecordingFormat(consumer);
+
+    // Only video has a GOP to wait for
+    if (_codec == CodecOther)
+        return;
+
+    std::vector<MediaPacketSample> samples;
+    if (_gopCache.replay(samples))
+    {
+        consumer.gopCacheCounters->hits.fetch_add(1, std::memory_order_relaxed);
+        consumer.waitForSyncPoint = false;
+        for (MediaPacketSample& sample : samples)
+            deliver(consumer, std::move(sample));
+    }
+    else
+    {
+        // Decoder couldn't use anything before the next sync point anyway
+        consumer.gopCacheCounters->misses.fetch_add(1, std::memory_order_relaxed);
+        consumer.waitForSyncPoint = true;
+    }
+    updateGopCacheCounters(consumer);
+}
+
+void ProxyMediaSink::setRecordingFormat(const Consumer& consumer)
 {
+    // Recording has to start with the parameter sets the stream may never repeat in-band
+    std::vector<uint8_t> header;
+    for (auto& parameterSet : GetSPropParameterSets(_subsession))
+    {
+        const size_t offset = header.size();
+        header.resize(offset + startCodeSize + parameterSet.size());
+        WriteStartCode(header.data() + offset);
+        memcpy(header.data() + offset + startCodeSize, parameterSet.data(), parameterSet.size());
+    }
+    consumer.recorder->setFormat(_subsession.codecName(), header.data(), header.size());
 }
 
-ProxyMediaSink::~ProxyMediaSink() { delete[] _receiveBuffer; }
+void ProxyMediaSink::updateGopCacheCounters(const Consumer& consumer)
+{
+    consumer.gopCacheCounters->cachedFrames.store(_gopCache.frames(), std::memory_order_relaxed);
+    consumer.gopCacheCounters->cachedBytes.store(_gopCache.bytes(), std::memory_order_relaxed);
+}
 
 void ProxyMediaSink::afterGettingFrame(void* clientData, unsigned frameSize,
                                        unsigned numTruncatedBytes, struct timeval presentationTime,
@@ -24,25 +284,357 @@ void ProxyMediaSink::afterGettingFrame(unsigned frameSize, unsigned numTruncated
                                        struct timeval presentationTime,
                                        unsigned durationInMicroseconds)
 {
+    _frameArrivalTime = FrameArrivalTime(_subsession.rtpSource());
+    if (!_consumers.empty())
+    {
+        for (Consumer& consumer : _consumers)
+        {
+            consumer.metrics->bytesReceived.fetch_add(frameSize + numTruncatedBytes,
+                                                      std::memory_order_relaxed);
+        }
+        _bitRateWindowBytes += frameSize + numTruncatedBytes;
+    }
+
     if (numTruncatedBytes == 0)
     {
-        bool isRtcpSynced =
-            _subsession.rtpSource() && _subsession.rtpSource()->hasBeenSynchronizedUsingRTCP();
-        _mediaPacketQueue.push(
-            MediaPacketSample(_receiveBuffer, frameSize, presentationTime, isRtcpSynced));
+        if (_assembleAccessUnits)
+        {
+            appendToAccessUnit(frameSize, presentationTime);
+        }
+        else if (_codec == CodecOther)
+        {
+            pushAudioFrames(frameSize, presentationTime);
+        }
+        else
+        {
+            bool isSyncPoint = IsSyncPoint(_receiveBuffer.data() + _receiveOffset, frameSize);
+            int parameterSetId = ParameterSetId(_receiveBuffer.data() + _receiveOffset, frameSize);
+            // Sample shares the slab - next frame goes right after this one
+            MediaPacketSample sample(_receiveBuffer, _receiveOffset, frameSize, presentationTime,
+                                     isRtcpSynced(), isSyncPoint);
+            sample.setArrivalTime(_frameArrivalTime);
+            _receiveOffset += frameSize;
+            push(std::move(sample), parameterSetId);
+        }
     }
+    // Frame didn't fit into the receive buffer - it's no use to the decoder
     else
     {
+        for (Consumer& consumer : _consumers)
+        {
+            consumer.metrics->truncatedFrames.fetch_add(1, std::memory_order_relaxed);
+            consumer.metrics->truncatedBytes.fetch_add(numTruncatedBytes,
+                                                       std::memory_order_relaxed);
+        }
     }
 
+    updateReceptionStats();
     continuePlaying();
 }
 
+void ProxyMediaSink::updateReceptionStats()
+{
+    RTPSource* rtpSource = _subsession.rtpSource();
+    if (!rtpSource || !rtpSource->curFrameEndsPacket())
+        return;
+
+    // Counters of live555 are followed even while standby, so only what comes after attaching
+    // adds up. They start over with each SSRC.
+    const unsigned fragmentedFramesLost =
+        rtpSource->numFragmentedFramesLost() - _fragmentedFramesLost;
+    _fragmentedFramesLost = rtpSource->numFragmentedFramesLost();
+    unsigned packetsReceived = 0;
+    unsigned packetsLost = 0;
+    RTPReceptionStats* stats = rtpSource->receptionStatsDB().lookup(rtpSource->lastReceivedSSRC());
+    if (stats)
+    {
+        if (stats->SSRC() != _statsSsrc)
+        {
+            _statsSsrc = stats->SSRC();
+            _packetsReceived = 0;
+            _packetsLost = 0;
+        }
+        packetsReceived = stats->totNumPacketsReceived() - _packetsReceived;
+        _packetsReceived = stats->totNumPacketsReceived();
+        // Goes down when late packets turn up - count only what's lost for good
+        const unsigned expected = stats->totNumPacketsExpected();
+        const unsigned lost = expected > _packetsReceived ? expected - _packetsReceived : 0;
+        packetsLost = lost > _packetsLost ? lost - _packetsLost : 0;
+        _packetsLost = std::max(_packetsLost, lost);
+    }
+
+    // Standby sessions don't play - their network has no say
+    if (_consumers.empty())
+        return;
+
+    const std::chrono::microseconds reorderWait = TimeSince(rtpSource->curPacketTimeReceived());
+    for (Consumer& consumer : _consumers)
+    {
+        StreamMetrics& metrics = *consumer.metrics;
+        metrics.packetsReceived.fetch_add(packetsReceived, std::memory_order_relaxed);
+        metrics.packetsLost.fetch_add(packetsLost, std::memory_order_relaxed);
+        metrics.fragmentedFramesLost.fetch_add(fragmentedFramesLost, std::memory_order_relaxed);
+        metrics.reorderWait.record(reorderWait);
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto elapsed =
+        std::chrono::duration_cast<std::chrono::microseconds>(now - _bitRateWindowStart);
+    if (elapsed >= bitRateWindow)
+    {
+        const uint32_t bitsPerSecond =
+            static_cast<uint32_t>(_bitRateWindowBytes * 8 * 1000000 / elapsed.count());
+        for (Consumer& consumer : _consumers)
+            consumer.metrics->bitsPerSecond.store(bitsPerSecond, std::memory_order_relaxed);
+        _bitRateWindowStart = now;
+        _bitRateWindowBytes = 0;
+    }
+
+    if (!stats || _subsession.rtpTimestampFrequency() == 0)
+        return;
+    // RTP timestamp units to 100 ns
+    const int64_t jitter =
+        static_cast<int64_t>(stats->jitter()) * 10000000 / _subsession.rtpTimestampFrequency();
+    for (Consumer& consumer : _consumers)
+    {
+        consumer.metrics->jitterMicroseconds.store(static_cast<uint32_t>(jitter / 10),
+                                                   std::memory_order_relaxed);
+        consumer.playoutDelay->reportJitter(
+            _codec != CodecOther ? PlayoutDelay::StreamVideo : PlayoutDelay::StreamAudio, jitter);
+    }
+}
+
+void ProxyMediaSink::appendToAccessUnit(unsigned nalSize, const timeval& presentationTime)
+{
+    // New timestamp - previous picture is over even though its marker bit didn't make it
+    if (_receiveOffset > _accessUnitOffset &&
+        (presentationTime.tv_sec != _accessUnitTime.tv_sec ||
+         presentationTime.tv_usec != _accessUnitTime.tv_usec))
+    {
+        flushAccessUnit();
+    }
+    if (nalSize == 0)
+        return;
+
+    if (_receiveOffset == _accessUnitOffset)
+    {
+        _accessUnitTime = presentationTime;
+        _accessUnitArrivalTime = _frameArrivalTime;
+        _accessUnitHasPicture = false;
+        _accessUnitIsSyncPoint = false;
+    }
+
+    // NAL unit has been received right after the room left for its start code
+    uint8_t* startCode = _receiveBuffer.data() + _receiveOffset;
+    const uint8_t* nal = startCode + startCodeSize;
+    WriteStartCode(startCode);
+    _receiveOffset += startCodeSize + nalSize;
+
+    _accessUnitIsSyncPoint = _accessUnitIsSyncPoint || IsSyncPoint(nal, nalSize);
+    _accessUnitHasPicture = _accessUnitHasPicture || (_codec == CodecH264
+                                                          ? IsH264Slice(nal, nalSize)
+                                                          : IsH265Slice(nal, nalSize));
+
+    // Marker bit is set on the last packet of a picture. NAL units of an aggregation packet
+    // share it, so it's only the last of them that completes the picture.
+    RTPSource* rtpSource = _subsession.rtpSource();
+    if (_accessUnitHasPicture && rtpSource && rtpSource->curPacketMarkerBit() &&
+        rtpSource->curFrameEndsPacket())
+    {
+        flushAccessUnit();
+    }
+}
+
+void ProxyMediaSink::flushAccessUnit()
+{
+    if (_receiveOffset == _accessUnitOffset)
+        return;
+
+    MediaPacketSample sample(_receiveBuffer, _accessUnitOffset, _receiveOffset - _accessUnitOffset,
+                             _accessUnitTime, isRtcpSynced(), _accessUnitIsSyncPoint);
+    sample.setAccessUnit(true);
+    sample.setArrivalTime(_accessUnitArrivalTime);
+    _accessUnitOffset = _receiveOffset;
+    // Parameter sets travel inside access units
+    push(std::move(sample), -1);
+}
+
+void ProxyMediaSink::pushAudioFrames(unsigned frameSize, const timeval& presentationTime)
+{
+    SplitAudioFrames(_audioFraming, _receiveBuffer.data() + _receiveOffset, frameSize,
+                     _audioSampleRate, _audioFrames);
+    for (const AudioFrame& frame : _audioFrames)
+    {
+        // Every audio frame is decodable on its own
+        MediaPacketSample sample(_receiveBuffer, _receiveOffset + frame.offset, frame.size,
+                                 AddUSecs(presentationTime, _packetTimeOffset), isRtcpSynced(),
+                                 true);
+        sample.setArrivalTime(_frameArrivalTime);
+        _packetTimeOffset += frame.durationUSecs;
+        push(std::move(sample), -1);
+    }
+    _receiveOffset += frameSize;
+
+    // Frames after the first one of a packet carry the packet's timestamp too
+    RTPSource* rtpSource = _subsession.rtpSource();
+    if (!rtpSource || rtpSource->curFrameEndsPacket())
+        _packetTimeOffset = 0;
+}
+
+void ProxyMediaSink::push(MediaPacketSample&& sample, int parameterSetId)
+{
+    if (_codec != CodecOther)
+    {
+        _gopCache.add(sample, parameterSetId);
+        for (const Consumer& consumer : _consumers)
+            updateGopCacheCounters(consumer);
+    }
+
+    // Standby sink has nowhere to deliver yet - it only keeps the cache warm. Others share the
+    // sample's data - the last consumer takes the sample itself.
+    for (size_t i = 0; i < _consumers.size(); ++i)
+    {
+        deliver(_consumers[i], i + 1 < _consumers.size() ? sample.clone() : std::move(sample));
+    }
+}
+
+bool ProxyMediaSink::isRtcpSynced() const
+{
+    return _subsession.rtpSource() && _subsession.rtpSource()->hasBeenSynchronizedUsingRTCP();
+}
+
 Boolean ProxyMediaSink::continuePlaying()
 {
     if (fSource == nullptr)
         return False;
-    fSource->getNextFrame(_receiveBuffer, _receiveBufferSize, afterGettingFrame, this,
-                          onSourceClosure, this);
+
+    // Not enough room left for a worst-case frame - move on to a fresh slab. The old one goes
+    // back to the pool once all frames carved from it are consumed.
+    const size_t reserved = _assembleAccessUnits ? startCodeSize : 0;
+    if (!_receiveBuffer ||
+        _receiveBuffer.capacity() - _receiveOffset < _receiveBufferSize + reserved)
+    {
+        // Access unit being assembled has to stay contiguous - it moves along (once per slab)
+        const size_t pending = _assembleAccessUnits ? _receiveOffset - _accessUnitOffset : 0;
+        MediaPacketBufferRef buffer = MediaPacketBufferPool::instance().acquire(
+            std::max(_receiveBufferSize * framesPerSlab, pending + _receiveBufferSize + reserved));
+        if (pending > 0)
+            memcpy(buffer.data(), _receiveBuffer.data() + _accessUnitOffset, pending);
+        _receiveBuffer = std::move(buffer);
+        _receiveOffset = pending;
+        _accessUnitOffset = 0;
+    }
+
+    fSource->getNextFrame(_receiveBuffer.data() + _receiveOffset + reserved, _receiveBufferSize,
+                          afterGettingFrame, this, onSourceClosure, this);
     return True;
 }
+
+void ProxyMediaSink::deliver(Consumer& consumer, MediaPacketSample&& sample)
+{
+    if (consumer.waitForSyncPoint)
+    {
+        // Parameter sets are let through - the sync point is going to need them
+        if (!sample.isSyncPoint() && ParameterSetId(sample.data(), sample.size()) < 0)
+            return;
+        if (sample.isSyncPoint())
+            consumer.waitForSyncPoint = false;
+    }
+
+    if (consumer.pendingDiscontinuity)
+    {
+        consumer.pendingDiscontinuity = false;
+        if (_codec != CodecOther)
+        {
+            // Output pin knows only parameter sets of the session it's been created for
+            deliverParameterSets(consumer, sample);
+        }
+        else
+        {
+            sample.setDiscontinuity(true);
+        }
+    }
+
+    enqueue(consumer, std::move(sample));
+}
+
+void ProxyMediaSink::enqueue(Consumer& consumer, MediaPacketSample&& sample)
+{
+    const auto now = std::chrono::steady_clock::now();
+    consumer.metrics->receiveToQueue.record(
+        std::chrono::duration_cast<std::chrono::microseconds>(now - sample.arrivalTime()));
+    consumer.metrics->framesQueued.fetch_add(1, std::memory_order_relaxed);
+    sample.setQueuedTime(now);
+    if (consumer.recorder)
+        consumer.recorder->record(sample);
+    consumer.mediaPacketQueue->push(std::move(sample));
+}
+
+void ProxyMediaSink::deliverParameterSets(Consumer& consumer, const MediaPacketSample& next)
+{
+    ParameterSets parameterSets = GetSPropParameterSets(_subsession);
+
+    const size_t prefixSize = _assembleAccessUnits ? startCodeSize : 0;
+    size_t totalSize = 0;
+    for (auto& parameterSet : parameterSets)
+        totalSize += prefixSize + parameterSet.size();
+    if (totalSize == 0)
+        return;
+
+    MediaPacketBufferRef buffer = MediaPacketBufferPool::instance().acquire(totalSize);
+    size_t offset = 0;
+    for (auto& parameterSet : parameterSets)
+    {
+        if (_assembleAccessUnits)
+            WriteStartCode(buffer.data() + offset);
+        memcpy(buffer.data() + offset + prefixSize, parameterSet.data(), parameterSet.size());
+        // Parameter sets go right before the sync point they belong to - one by one, or as
+        // an access unit of their own
+        if (!_assembleAccessUnits)
+        {
+            MediaPacketSample sample(buffer, offset, parameterSet.size(), next.presentationTime(),
+                                     next.isRtcpSynced(), true);
+            sample.setArrivalTime(next.arrivalTime());
+            sample.setDiscontinuity(offset == 0);
+            enqueue(consumer, std::move(sample));
+        }
+        offset += prefixSize + parameterSet.size();
+    }
+
+    if (_assembleAccessUnits)
+    {
+        MediaPacketSample sample(buffer, 0, totalSize, next.presentationTime(),
+                                 next.isRtcpSynced(), true);
+        sample.setArrivalTime(next.arrivalTime());
+        sample.setAccessUnit(true);
+        sample.setDiscontinuity(true);
+        enqueue(consumer, std::move(sample));
+    }
+}
+
+bool ProxyMediaSink::IsSyncPoint(const uint8_t* frame, unsigned frameSize) const
+{
+    switch (_codec)
+    {
+    case CodecH264:
+        return IsIdrFrame(frame, frameSize);
+    case CodecH265:
+        return IsIrapFrame(frame, frameSize);
+    default:
+        // Every audio frame is decodable on its own
+        return true;
+    }
+}
+
+int ProxyMediaSink::ParameterSetId(const uint8_t* frame, size_t frameSize) const
+{
+    switch (_codec)
+    {
+    case CodecH264:
+        return H264ParameterSetId(frame, static_cast<unsigned>(frameSize));
+    case CodecH265:
+        return H265ParameterSetId(frame, static_cast<unsigned>(frameSize));
+    default:
+        return -1;
+    }
+}
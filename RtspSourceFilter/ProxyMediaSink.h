@@ -3,19 +3,89 @@
 #include "liveMedia.hh"
 #include "BasicUsageEnvironment.hh"
 
-#include "MediaPacketSample.h"
+#include "AudioFraming.h"
+#include "GopCache.h"
+#include "MediaPacketQueue.h"
+#include "MediaRecorder.h"
+#include "PlayoutDelay.h"
 #include "RtspSourceFilter.h"
+#include "StreamMetrics.h"
+
+#include <chrono>
+#include <vector>
+
+/**
+ * Where a sink delivers to: a media queue along with the counters of the stream it feeds
+ */
+struct ProxyMediaConsumer
+{
+    MediaPacketQueue* mediaPacketQueue;
+    StreamMetrics* metrics;
+    PlayoutDelay* playoutDelay;
+    GopCacheCounters* gopCacheCounters;
+    // Gets whatever goes to the queue, if any
+    MediaRecorder* recorder;
+};
 
 /*
- * Media sink that accumulates received frames into given queue
+ * Media sink that accumulates received frames into given queue.
+ * Frames are received straight into pooled slabs - each slab is carved into consecutive frames
+ * which share it by reference, so nothing is copied nor allocated per frame.
+ *
+ * H.264 and H.265 sinks keep the current GOP cached. Whenever delivery starts (new session,
+ * switching to a standby session) the cached GOP is replayed, otherwise nothing but parameter
+ * sets is delivered until the next sync point.
+ *
+ * With access unit assembly, all NAL units of a picture (keyed on RTP marker bit, or the
+ * timestamp change if the marker is lost) are delivered as one sample, each preceded by a start
+ * code. They're received back to back into the slab with room left for start codes, so
+ * assembling doesn't copy anything either.
+ *
+ * Audio frames are cut by codec framing (see AudioFraming.h) - again as ranges of the slab.
+ * Frames sharing an RTP packet get its timestamp advanced by the duration of the ones before.
+ *
+ * Interarrival jitter of the stream is passed on to the playout delay after each packet. So are
+ * reception counters to the stream's metrics, along with the time packets waited for reordering
+ * and frames took from the network to the queue.
+ *
+ * A sink created without a consumer belongs to a standby session - it only keeps its cache warm
+ * until it's attached to a queue. A relayed session's sink (see RtspRelay.h) delivers to any
+ * number of them: each gets its own clone of a sample - the slab is shared - and waits for its
+ * own sync point.
+ *
+ * A consumer's recorder (see MediaRecorder.h) is told the format whenever delivery starts and
+ * then gets every sample queued for the consumer.
  */
 class ProxyMediaSink : public MediaSink
 {
 public:
+    // Codecs with GOP structure, others (audio) are passed as they come
+    enum Codec
+    {
+        CodecOther,
+        CodecH264,
+        CodecH265
+    };
+
     ProxyMediaSink(UsageEnvironment& env, MediaSubsession& subsession,
-                   MediaPacketQueue& mediaPacketQueue, size_t receiveBufferSize);
+                   const ProxyMediaConsumer* consumer, size_t receiveBufferSize,
+                   size_t gopCacheMaxBytes, size_t gopCacheMaxFrames, bool assembleAccessUnits);
     virtual ~ProxyMediaSink();
 
+    /**
+     * Start delivering to given consumer as well: whatever its queue holds is flushed, cached
+     * GOP follows (if any) and the first delivered sample is marked as a discontinuity
+     */
+    void attach(const ProxyMediaConsumer& consumer);
+    // Stop delivering to the consumer of given queue
+    void detach(MediaPacketQueue& mediaPacketQueue);
+    bool hasConsumers() const { return !_consumers.empty(); }
+
+    // Size of the biggest frame taken from given subsession, 0 for media we don't take
+    static size_t ReceiveBufferSize(MediaSubsession& subsession);
+    // Tune RTP source of an initiated subsession for the sink (before SETUP)
+    static void ConfigureRtpSource(UsageEnvironment& env, MediaSubsession& subsession);
+
     static void afterGettingFrame(void* clientData, unsigned frameSize, unsigned numTruncatedBytes,
                                   struct timeval presentationTime, unsigned durationInMicroseconds);
 
@@ -23,11 +93,65 @@ public:
                            struct timeval presentationTime, unsigned durationInMicroseconds);
 
 private:
+    struct Consumer : ProxyMediaConsumer
+    {
+        // Consumer has no sync point to start decoding from yet
+        bool waitForSyncPoint;
+        bool pendingDiscontinuity;
+    };
+
     virtual Boolean continuePlaying();
+    bool IsSyncPoint(const uint8_t* frame, unsigned frameSize) const;
+    // Kind of parameter set NAL unit (see GopCache::add), negative for other frames
+    int ParameterSetId(const uint8_t* frame, size_t frameSize) const;
+    bool isRtcpSynced() const;
+    void appendToAccessUnit(unsigned nalSize, const timeval& presentationTime);
+    void flushAccessUnit();
+    void pushAudioFrames(unsigned frameSize, const timeval& presentationTime);
+    // Cache (video only) and deliver to every consumer (none if standby)
+    void push(MediaPacketSample&& sample, int parameterSetId);
+    void startDelivery(Consumer& consumer);
+    void setRecordingFormat(const Consumer& consumer);
+    void deliver(Consumer& consumer, MediaPacketSample&& sample);
+    void enqueue(Consumer& consumer, MediaPacketSample&& sample);
+    // Parameter sets go ahead of given sample
+    void deliverParameterSets(Consumer& consumer, const MediaPacketSample& next);
+    void updateGopCacheCounters(const Consumer& consumer);
+    void updateReceptionStats();
 
 private:
     size_t _receiveBufferSize;
-    uint8_t* _receiveBuffer;
+    // Slab currently being filled and the offset of the next frame within it
+    MediaPacketBufferRef _receiveBuffer;
+    size_t _receiveOffset;
     MediaSubsession& _subsession;
-    MediaPacketQueue& _mediaPacketQueue;
+    std::vector<Consumer> _consumers;
+    Codec _codec;
+
+    bool _assembleAccessUnits;
+    // Access unit being assembled spans from here to _receiveOffset
+    size_t _accessUnitOffset;
+    timeval _accessUnitTime;
+    std::chrono::steady_clock::time_point _accessUnitArrivalTime;
+    bool _accessUnitHasPicture;
+    bool _accessUnitIsSyncPoint;
+
+    AudioFraming _audioFraming;
+    // Needed by framings whose frames don't tell their sampling rate
+    unsigned _audioSampleRate;
+    std::vector<AudioFrame> _audioFrames;
+    // Playing time of the frames of current RTP packet delivered so far
+    unsigned _packetTimeOffset;
+
+    GopCache _gopCache;
+
+    // Network read time of the first packet of the frame just received
+    std::chrono::steady_clock::time_point _frameArrivalTime;
+    // live555 reception counters taken in so far
+    u_int32_t _statsSsrc;
+    unsigned _packetsReceived;
+    unsigned _packetsLost;
+    unsigned _fragmentedFramesLost;
+    std::chrono::steady_clock::time_point _bitRateWindowStart;
+    uint64_t _bitRateWindowBytes;
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <system_error>
+#include <chrono>
 #include <future>
 #include <string>
 
@@ -20,14 +21,30 @@ public:
         Play,
         Stop,
         Reconnect,
-        Done
+        Done,
+        // Standby sessions (fast switching)
+        AddStandby,
+        RemoveStandby,
+        Switch
+    };
+
+    /**
+     * Request flags
+     */
+    enum Flags
+    {
+        // AddStandby: start playing right away, not only when switched to
+        PrePlay = 1
     };
 
     /**
      * Construct asynchronous RTSP request
      */
-    explicit RtspAsyncRequest(Type request, std::string requestData = "")
-        : _request(request), _requestData(std::move(requestData))
+    explicit RtspAsyncRequest(Type request, std::string requestData = "", unsigned requestFlags = 0)
+        : _request(request)
+        , _requestData(std::move(requestData))
+        , _requestFlags(requestFlags)
+        , _enqueueTime(std::chrono::steady_clock::now())
     {
     }
 
@@ -38,7 +55,7 @@ public:
     /**
      * Construct an invalid RTSP request
      */
-    RtspAsyncRequest() : _request(Unknown) {}
+    RtspAsyncRequest() : _request(Unknown), _requestFlags(0) {}
 
     RtspAsyncRequest(const RtspAsyncRequest&) = delete;
     RtspAsyncRequest& operator=(const RtspAsyncRequest&) = delete;
@@ -58,6 +75,8 @@ public:
             _request = other._request;
             _promise = std::move(other._promise);
             _requestData = std::move(other._requestData);
+            _requestFlags = other._requestFlags;
+            _enqueueTime = other._enqueueTime;
         }
         return *this;
     }
@@ -65,12 +84,24 @@ public:
     RtspAsyncResult GetAsyncResult() { return _promise.get_future(); }
     Type GetRequest() const { return _request; }
     const std::string& GetRequestData() const { return _requestData; }
+    unsigned GetRequestFlags() const { return _requestFlags; }
     void SetValue(RtspResult ec) { _promise.set_value(ec); }
 
+    /**
+     * Time elapsed since the request has been made
+     */
+    std::chrono::microseconds GetAge() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - _enqueueTime);
+    }
+
 private:
     Type _request;
     std::promise<RtspResult> _promise;
     std::string _requestData;
+    unsigned _requestFlags;
+    std::chrono::steady_clock::time_point _enqueueTime;
 };
 
 inline const char* GetRtspAsyncRequestTypeString(RtspAsyncRequest::Type type)
@@ -87,6 +118,12 @@ inline const char* GetRtspAsyncRequestTypeString(RtspAsyncRequest::Type type)
         return "Reconnect";
     case RtspAsyncRequest::Done:
         return "Done";
+    case RtspAsyncRequest::AddStandby:
+        return "AddStandby";
+    case RtspAsyncRequest::RemoveStandby:
+        return "RemoveStandby";
+    case RtspAsyncRequest::Switch:
+        return "Switch";
     case RtspAsyncRequest::Unknown:
     default:
         return "Unknown";
@@ -35,6 +35,10 @@ public:
             return "Failed to start playing session";
         case error::SinkCreationFailed:
             return "";
+        case error::StandbyNotReady:
+            return "No standby session is ready for given URL";
+        case error::StandbyIncompatible:
+            return "Media of the standby session don't match output pins";
         default:
             return "Unknown error";
         }
@@ -55,6 +59,8 @@ public:
         case error::NoSubsessionsSetup:
         case error::PlayFailed:
         case error::SinkCreationFailed:
+        case error::StandbyNotReady:
+        case error::StandbyIncompatible:
             return error::RtspError;
         default:
             return std::error_condition(ev, *this);
@@ -19,7 +19,9 @@ namespace error
         NoSubsessionsSetup,
         PlayFailed,
         SinkCreationFailed,
-        ReconnectFailed
+        ReconnectFailed,
+        StandbyNotReady,
+        StandbyIncompatible
     };
 
     enum ErrorCondition
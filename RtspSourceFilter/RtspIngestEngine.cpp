@@ -0,0 +1,201 @@
+#include "RtspIngestEngine.h"
+#include "GroupsockHelper.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include <Windows.h>
+
+namespace
+{
+    // Engine is shared by all filters but doesn't outlive the last one, so its threads are
+    // never joined from within DllMain
+    std::mutex engineMutex;
+    std::weak_ptr<RtspIngestEngine> engineInstance;
+
+    void SetThreadName(DWORD dwThreadID, const char* threadName);
+    int CreateWakeupSocket();
+}
+
+RtspIngestLoop::RtspIngestLoop(unsigned index)
+    // No scheduler granularity - the loop sleeps until there's a socket event, a due timer
+    // or a notification
+    : _scheduler(BasicTaskScheduler::createNew(0))
+    , _env(MyUsageEnvironment::createNew(*_scheduler))
+    , _index(index)
+    , _load(0)
+    , _done(false)
+    , _wakeupSocket(CreateWakeupSocket())
+    , _wakeupPending(false)
+{
+    if (_wakeupSocket < 0)
+        throw std::runtime_error("Couldn't create ingest loop wakeup socket");
+    _scheduler->setBackgroundHandling(_wakeupSocket, SOCKET_READABLE, WakeupHandler, this);
+    _thread = std::thread(&RtspIngestLoop::Run, this);
+}
+
+RtspIngestLoop::~RtspIngestLoop()
+{
+    _done = true;
+    Notify();
+    _thread.join();
+
+    _scheduler->disableBackgroundHandling(_wakeupSocket);
+    closeSocket(_wakeupSocket);
+}
+
+void RtspIngestLoop::Attach(RtspIngestSession* session)
+{
+    std::lock_guard<std::mutex> lock(_sessionsMutex);
+    _sessions.push_back(session);
+    _load = _sessions.size();
+}
+
+void RtspIngestLoop::Detach(RtspIngestSession* session)
+{
+    // Waits for the loop to finish with this session if it's being processed right now
+    std::lock_guard<std::mutex> lock(_sessionsMutex);
+    _sessions.erase(std::remove(_sessions.begin(), _sessions.end(), session), _sessions.end());
+    _load = _sessions.size();
+}
+
+void RtspIngestLoop::Notify()
+{
+    // Only the first notification since the loop last woke up needs to reach the socket
+    if (!_wakeupPending.exchange(true))
+    {
+        const char wakeup = 0;
+        send(_wakeupSocket, &wakeup, sizeof(wakeup), 0);
+    }
+}
+
+void RtspIngestLoop::Run()
+{
+    char threadName[32];
+    sprintf_s(threadName, sizeof(threadName), "RTSP ingest loop #%u", _index);
+    SetThreadName(-1, threadName);
+
+    while (!_done)
+        _scheduler->SingleStep();
+}
+
+void RtspIngestLoop::ProcessRequests()
+{
+    std::lock_guard<std::mutex> lock(_sessionsMutex);
+    for (RtspIngestSession* session : _sessions)
+        session->ProcessRequests();
+}
+
+void RtspIngestLoop::WakeupHandler(void* clientData, int /*mask*/)
+{
+    RtspIngestLoop* self = static_cast<RtspIngestLoop*>(clientData);
+
+    char buffer[16];
+    while (recv(self->_wakeupSocket, buffer, sizeof(buffer), 0) > 0)
+        ;
+    // Clear before looking at the requests - anything made from now on notifies us again
+    self->_wakeupPending = false;
+    self->ProcessRequests();
+}
+
+std::shared_ptr<RtspIngestEngine> RtspIngestEngine::Instance()
+{
+    std::lock_guard<std::mutex> lock(engineMutex);
+    std::shared_ptr<RtspIngestEngine> engine = engineInstance.lock();
+    if (!engine)
+    {
+        engine = std::make_shared<RtspIngestEngine>();
+        engineInstance = engine;
+    }
+    return engine;
+}
+
+RtspIngestEngine::RtspIngestEngine(unsigned numLoops) : _maxNumLoops(numLoops)
+{
+    if (_maxNumLoops == 0)
+        _maxNumLoops = std::max(1U, std::thread::hardware_concurrency());
+}
+
+RtspIngestEngine::~RtspIngestEngine()
+{
+    // Loops stop and join their threads one by one
+    _loops.clear();
+}
+
+RtspIngestLoop& RtspIngestEngine::Attach(RtspIngestSession* session)
+{
+    std::lock_guard<std::mutex> lock(_loopsMutex);
+
+    RtspIngestLoop* leastLoaded = nullptr;
+    for (auto& loop : _loops)
+    {
+        if (!leastLoaded || loop->Load() < leastLoaded->Load())
+            leastLoaded = loop.get();
+    }
+
+    // Don't start another thread while there's an idle loop already
+    if (_loops.size() < _maxNumLoops && (!leastLoaded || leastLoaded->Load() > 0))
+    {
+        _loops.emplace_back(new RtspIngestLoop(static_cast<unsigned>(_loops.size())));
+        leastLoaded = _loops.back().get();
+    }
+
+    leastLoaded->Attach(session);
+    return *leastLoaded;
+}
+
+void RtspIngestEngine::Detach(RtspIngestLoop& loop, RtspIngestSession* session)
+{
+    std::lock_guard<std::mutex> lock(_loopsMutex);
+    loop.Detach(session);
+}
+
+namespace
+{
+    int CreateWakeupSocket()
+    {
+        int sock = static_cast<int>(socket(AF_INET, SOCK_DGRAM, 0));
+        if (sock < 0)
+            return -1;
+
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        SOCKLEN_T addrLen = sizeof(addr);
+
+        if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+            getsockname(sock, (struct sockaddr*)&addr, &addrLen) != 0 ||
+            connect(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+            !makeSocketNonBlocking(sock))
+        {
+            closeSocket(sock);
+            return -1;
+        }
+        return sock;
+    }
+
+    const DWORD MS_VC_EXCEPTION = 0x406D1388;
+
+#pragma pack(push, 8)
+    typedef struct tagTHREADNAME_INFO
+    {
+        DWORD dwType;     // Must be 0x1000.
+        LPCSTR szName;    // Pointer to name (in user addr space).
+        DWORD dwThreadID; // Thread ID (-1=caller thread).
+        DWORD dwFlags;    // Reserved for future use, must be zero.
+    } THREADNAME_INFO;
+#pragma pack(pop)
+
+    void SetThreadName(DWORD dwThreadID, const char* threadName)
+    {
+        THREADNAME_INFO info = {0x1000, threadName, dwThreadID, 0};
+
+        __try
+        {
+            RaiseException(MS_VC_EXCEPTION, 0, sizeof(info) / sizeof(ULONG_PTR), (ULONG_PTR*)&info);
+        }
+        __except(EXCEPTION_EXECUTE_HANDLER) {}
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "liveMedia.hh"
+#include "BasicUsageEnvironment.hh"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Debug.h"
+
+/**
+ * A party hosted by an ingest loop - typically a single RTSP session (one filter instance).
+ * All calls are made from the loop's thread.
+ */
+class RtspIngestSession
+{
+public:
+    virtual ~RtspIngestSession() {}
+
+    /**
+     * Called whenever the loop is notified (see RtspIngestLoop::Notify) - take pending
+     * requests and drive the session state machine. Must not block.
+     */
+    virtual void ProcessRequests() = 0;
+};
+
+/**
+ * One live555 event loop: a thread with its own task scheduler and usage environment
+ * hosting any number of sessions.
+ */
+class RtspIngestLoop
+{
+public:
+    explicit RtspIngestLoop(unsigned index);
+    ~RtspIngestLoop();
+
+    RtspIngestLoop(const RtspIngestLoop&) = delete;
+    RtspIngestLoop& operator=(const RtspIngestLoop&) = delete;
+
+    TaskScheduler& Scheduler() { return *_scheduler; }
+    UsageEnvironment& Env() { return *_env; }
+
+    void Attach(RtspIngestSession* session);
+    void Detach(RtspIngestSession* session);
+
+    /**
+     * Wake the loop up and let its sessions process their requests.
+     * Can be called from any thread, including the loop's own one.
+     */
+    void Notify();
+
+    /**
+     * Number of sessions currently hosted
+     */
+    size_t Load() const { return _load.load(std::memory_order_relaxed); }
+
+private:
+    void Run();
+    void ProcessRequests();
+
+    static void WakeupHandler(void* clientData, int mask);
+
+private:
+    struct env_deleter
+    {
+        void operator()(MyUsageEnvironment* ptr) const { ptr->reclaim(); }
+    };
+    std::unique_ptr<BasicTaskScheduler0> _scheduler;
+    std::unique_ptr<MyUsageEnvironment, env_deleter> _env;
+
+    unsigned _index;
+    std::mutex _sessionsMutex;
+    std::vector<RtspIngestSession*> _sessions;
+    std::atomic<size_t> _load;
+    std::atomic<bool> _done;
+
+    // Loopback datagram socket connected to itself - a byte sent to it makes the loop's
+    // select() return. At most one byte is in flight at a time.
+    int _wakeupSocket;
+    std::atomic<bool> _wakeupPending;
+
+    std::thread _thread;
+};
+
+/**
+ * Fixed pool of ingest loops shared by all sessions in the process.
+ * Loops are started lazily (up to the pool size) and sessions are assigned to the least
+ * loaded one. The engine lives as long as somebody holds a reference to it.
+ */
+class RtspIngestEngine
+{
+public:
+    /**
+     * Process-wide engine, created on first use and torn down with its last user
+     */
+    static std::shared_ptr<RtspIngestEngine> Instance();
+
+    /**
+     * numLoops equal to 0 means one loop per CPU core
+     */
+    explicit RtspIngestEngine(unsigned numLoops = 0);
+    ~RtspIngestEngine();
+
+    RtspIngestEngine(const RtspIngestEngine&) = delete;
+    RtspIngestEngine& operator=(const RtspIngestEngine&) = delete;
+
+    /**
+     * Host given session on the least loaded loop. The session must be ready to process
+     * requests as soon as this is called.
+     */
+    RtspIngestLoop& Attach(RtspIngestSession* session);
+    void Detach(RtspIngestLoop& loop, RtspIngestSession* session);
+
+private:
+    unsigned _maxNumLoops;
+    std::mutex _loopsMutex;
+    std::vector<std::unique_ptr<RtspIngestLoop>> _loops;
+};
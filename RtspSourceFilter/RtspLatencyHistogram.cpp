@@ -0,0 +1,35 @@
+#include "RtspLatencyHistogram.h"
+
+RtspLatencyHistogram::RtspLatencyHistogram()
+    : _numRequests(0), _totalMicroseconds(0), _maxMicroseconds(0)
+{
+    for (auto& bucket : _buckets)
+        bucket.store(0, std::memory_order_relaxed);
+}
+
+void RtspLatencyHistogram::record(std::chrono::microseconds latency)
+{
+    const uint64_t micros = latency.count() > 0 ? static_cast<uint64_t>(latency.count()) : 0;
+
+    // Bucket 0: < 1 ms, bucket i: [2^(i-1), 2^i) ms
+    int bucket = 0;
+    for (uint64_t millis = micros / 1000; millis > 0 && bucket < RTSP_REQUEST_LATENCY_BUCKETS - 1;
+         millis >>= 1)
+        ++bucket;
+
+    _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    _numRequests.fetch_add(1, std::memory_order_relaxed);
+    _totalMicroseconds.fetch_add(micros, std::memory_order_relaxed);
+    // Single writer - no need for CAS loop
+    if (micros > _maxMicroseconds.load(std::memory_order_relaxed))
+        _maxMicroseconds.store(micros, std::memory_order_relaxed);
+}
+
+void RtspLatencyHistogram::getStats(RtspRequestLatencyStats& stats) const
+{
+    stats.numRequests = _numRequests.load(std::memory_order_relaxed);
+    stats.totalMicroseconds = _totalMicroseconds.load(std::memory_order_relaxed);
+    stats.maxMicroseconds = _maxMicroseconds.load(std::memory_order_relaxed);
+    for (int i = 0; i < RTSP_REQUEST_LATENCY_BUCKETS; ++i)
+        stats.buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "RtspSourceFilter.h"
+
+/**
+ * Log2-bucketed histogram of request latencies (see RtspRequestLatencyStats).
+ * Recorded from the ingest loop thread, read from any thread.
+ */
+class RtspLatencyHistogram
+{
+public:
+    RtspLatencyHistogram();
+
+    RtspLatencyHistogram(const RtspLatencyHistogram&) = delete;
+    RtspLatencyHistogram& operator=(const RtspLatencyHistogram&) = delete;
+
+    void record(std::chrono::microseconds latency);
+    void getStats(RtspRequestLatencyStats& stats) const;
+
+private:
+    std::atomic<uint64_t> _numRequests;
+    std::atomic<uint64_t> _totalMicroseconds;
+    std::atomic<uint64_t> _maxMicroseconds;
+    std::atomic<uint64_t> _buckets[RTSP_REQUEST_LATENCY_BUCKETS];
+};
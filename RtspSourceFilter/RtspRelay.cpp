@@ -0,0 +1,830 @@
+#include "RtspRelay.h"
+#include "RtspError.h"
+#include "CodecRegistry.h"
+#include "Debug.h"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <new>
+#include <tuple>
+
+#ifdef DEBUG
+#define RTSP_CLIENT_VERBOSITY_LEVEL 1
+#else
+#define RTSP_CLIENT_VERBOSITY_LEVEL 0
+#endif
+
+namespace
+{
+    const char* RtspClientAppName = "RtspSourceFilter";
+    const int RtspClientVerbosityLevel = RTSP_CLIENT_VERBOSITY_LEVEL;
+    const int interPacketGapMaxTime = 2000; // 2000 msec
+    const Boolean forceMulticastOnUnspecified = False;
+    const int firstCallTimeoutTime = 2000;
+    // Media a consumer can take
+    const char* const relayedMedia[] = {"video", "audio"};
+
+    // Relays of the process by their session - an entry expires with the last holder
+    std::mutex relaysMutex;
+    std::map<RtspRelayKey, std::weak_ptr<RtspRelay>> relays;
+}
+
+class RelayRtspClient : public ::RTSPClient
+{
+public:
+    static RelayRtspClient* Create(RtspRelay* relay, UsageEnvironment& env, char const* rtspUrl,
+                                   portNumBits tunnelOverHttpPortNum)
+    {
+        return new (std::nothrow) RelayRtspClient(relay, env, rtspUrl, tunnelOverHttpPortNum);
+    }
+
+protected:
+    RelayRtspClient(RtspRelay* relay, UsageEnvironment& env, char const* rtspUrl,
+                    portNumBits tunnelOverHttpPortNum)
+        : ::RTSPClient(env, rtspUrl, RtspClientVerbosityLevel, RtspClientAppName,
+                       tunnelOverHttpPortNum, -1)
+        , relay(relay)
+        , mediaSession(nullptr)
+        , subsession(nullptr)
+        , iter(nullptr)
+    {
+    }
+
+    virtual ~RelayRtspClient()
+    {
+        // If true, we'd have a memleak
+        _ASSERT(!mediaSession);
+        _ASSERT(!subsession);
+        _ASSERT(!iter);
+    }
+
+public:
+    RtspRelay* relay;
+    MediaSession* mediaSession;
+    MediaSubsession* subsession;
+    MediaSubsessionIterator* iter;
+};
+
+bool RtspRelayKey::operator<(const RtspRelayKey& other) const
+{
+    return std::tie(url, streamOverTcp, tunnelOverHttpPort, assembleAccessUnits) <
+           std::tie(other.url, other.streamOverTcp, other.tunnelOverHttpPort,
+                    other.assembleAccessUnits);
+}
+
+std::shared_ptr<RtspRelay> RtspRelay::Acquire(const RtspRelayKey& key,
+                                              const RtspRelaySettings& settings)
+{
+    std::lock_guard<std::mutex> lock(relaysMutex);
+    // Forget relays nobody holds anymore
+    for (auto it = relays.begin(); it != relays.end();)
+        it = it->second.expired() ? relays.erase(it) : std::next(it);
+
+    std::weak_ptr<RtspRelay>& entry = relays[key];
+    std::shared_ptr<RtspRelay> relay = entry.lock();
+    if (!relay)
+    {
+        relay = std::make_shared<RtspRelay>(key, settings);
+        entry = relay;
+    }
+    return relay;
+}
+
+RtspRelay::RtspRelay(const RtspRelayKey& key, const RtspRelaySettings& settings)
+    : _key(key)
+    , _settings(settings)
+    , _ingestEngine(RtspIngestEngine::Instance())
+    , _ingestLoop(nullptr)
+    , _scheduler(nullptr)
+    , _env(nullptr)
+    , _state(State::Initial)
+    , _rtsp(nullptr)
+    , _numSubsessions(0)
+    , _sessionTimeout(60)
+    , _totNumPacketsReceived(0)
+    , _firstCallTimeoutTask(nullptr)
+    , _interPacketGapCheckTimerTask(nullptr)
+    , _livenessCommandTask(nullptr)
+    , _reconnectionTimerTask(nullptr)
+{
+    // Last thing to do - from now on the loop may call us
+    _ingestLoop = &_ingestEngine->Attach(this);
+    _scheduler = &_ingestLoop->Scheduler();
+    _env = &_ingestLoop->Env();
+}
+
+RtspRelay::~RtspRelay()
+{
+    // Tear down the session on the loop thread and leave the loop once it's done
+    MakeRequest(RtspAsyncRequest::Done, nullptr).get();
+    _ingestEngine->Detach(*_ingestLoop, this);
+}
+
+RtspAsyncResult RtspRelay::AsyncOpen(RtspRelayConsumer* consumer)
+{
+    return MakeRequest(RtspAsyncRequest::Open, consumer);
+}
+
+RtspAsyncResult RtspRelay::AsyncPlay(RtspRelayConsumer* consumer)
+{
+    return MakeRequest(RtspAsyncRequest::Play, consumer);
+}
+
+RtspAsyncResult RtspRelay::AsyncStop(RtspRelayConsumer* consumer)
+{
+    return MakeRequest(RtspAsyncRequest::Stop, consumer);
+}
+
+RtspAsyncResult RtspRelay::AsyncLeave(RtspRelayConsumer* consumer)
+{
+    return MakeRequest(RtspAsyncRequest::Done, consumer);
+}
+
+RtspAsyncResult RtspRelay::MakeRequest(RtspAsyncRequest::Type type, RtspRelayConsumer* consumer)
+{
+    Request req;
+    req.request = RtspAsyncRequest(type);
+    req.consumer = consumer;
+    RtspAsyncResult r(req.request.GetAsyncResult());
+    _requestQueue.push(std::move(req));
+    _ingestLoop->Notify();
+    return r;
+}
+
+void RtspRelay::ProcessRequests()
+{
+    // Unlike the filter's, no request has to wait for another one to finish - these which can't
+    // be replied right away are kept pending
+    Request req;
+    while (_requestQueue.try_pop(req))
+        ProcessRequest(req);
+}
+
+void RtspRelay::ProcessRequest(Request& req)
+{
+    DebugLog("Relay %s: processing request %s\n", _key.url.c_str(),
+             GetRtspAsyncRequestTypeString(req.request.GetRequest()));
+
+    switch (req.request.GetRequest())
+    {
+    case RtspAsyncRequest::Open:
+        Open(req);
+        break;
+
+    case RtspAsyncRequest::Play:
+        Play(req);
+        break;
+
+    case RtspAsyncRequest::Stop:
+        Stop(req.consumer);
+        ReplyRequest(req, error::Success);
+        break;
+
+    case RtspAsyncRequest::Done:
+        Leave(req);
+        break;
+
+    default:
+        ReplyRequest(req, error::WrongState);
+        break;
+    }
+}
+
+void RtspRelay::ReplyRequest(Request& req, RtspResult ec)
+{
+    req.request.SetValue(ec);
+}
+
+void RtspRelay::ReplyPending(RtspAsyncRequest::Type type, RtspResult ec)
+{
+    auto replied = std::stable_partition(
+        _pendingRequests.begin(), _pendingRequests.end(), [type](const Request& req) {
+            return type != RtspAsyncRequest::Unknown && req.request.GetRequest() != type;
+        });
+    for (auto it = replied; it != _pendingRequests.end(); ++it)
+        ReplyRequest(*it, ec);
+    _pendingRequests.erase(replied, _pendingRequests.end());
+}
+
+RtspRelay::Consumer* RtspRelay::FindConsumer(RtspRelayConsumer* consumer)
+{
+    auto it = std::find_if(_consumers.begin(), _consumers.end(),
+                           [consumer](const Consumer& c) { return c.consumer == consumer; });
+    return it != _consumers.end() ? &*it : nullptr;
+}
+
+void RtspRelay::Open(Request& req)
+{
+    if (!FindConsumer(req.consumer))
+        _consumers.push_back(Consumer{req.consumer, false});
+
+    switch (_state)
+    {
+    case State::ReadyToPlay:
+    case State::StartingToPlay:
+    case State::Playing:
+        // Already set up by somebody else
+        req.consumer->RelaySetUp(*_rtsp->mediaSession);
+        ReplyRequest(req, error::Success);
+        break;
+
+    case State::Initial:
+        _state = State::SettingUp;
+        _pendingRequests.push_back(std::move(req));
+        OpenUrl();
+        break;
+
+    case State::SettingUp:
+    case State::Reconnecting:
+        _pendingRequests.push_back(std::move(req));
+        break;
+    }
+}
+
+void RtspRelay::Play(Request& req)
+{
+    Consumer* consumer = FindConsumer(req.consumer);
+    // Never opened (or its open failed)
+    if (!consumer)
+    {
+        ReplyRequest(req, error::WrongState);
+        return;
+    }
+
+    if (!consumer->playing)
+    {
+        consumer->playing = true;
+        // Otherwise it's attached once the session is set up
+        if (_state == State::ReadyToPlay || _state == State::StartingToPlay ||
+            _state == State::Playing)
+        {
+            Attach(*req.consumer);
+        }
+    }
+
+    switch (_state)
+    {
+    case State::Playing:
+        ReplyRequest(req, error::Success);
+        break;
+
+    case State::ReadyToPlay:
+        _state = State::StartingToPlay;
+        _pendingRequests.push_back(std::move(req));
+        SendPlay();
+        break;
+
+    case State::Initial:
+        // Session's been torn down since the consumer opened it
+        _state = State::SettingUp;
+        _pendingRequests.push_back(std::move(req));
+        OpenUrl();
+        break;
+
+    case State::SettingUp:
+    case State::StartingToPlay:
+    case State::Reconnecting:
+        _pendingRequests.push_back(std::move(req));
+        break;
+    }
+}
+
+void RtspRelay::Stop(RtspRelayConsumer* consumer)
+{
+    // Play of the consumer, if still pending, won't happen
+    for (auto it = _pendingRequests.begin(); it != _pendingRequests.end();)
+    {
+        if (it->consumer == consumer && it->request.GetRequest() == RtspAsyncRequest::Play)
+        {
+            ReplyRequest(*it, error::WrongState);
+            it = _pendingRequests.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    Consumer* c = FindConsumer(consumer);
+    if (c && c->playing)
+    {
+        Detach(*consumer);
+        c->playing = false;
+    }
+    // Notify its pins we are done with them
+    QueueEndOfStream(*consumer);
+
+    // Nobody to play for and nobody waiting for the session
+    if (!IsAnyonePlaying() && _pendingRequests.empty())
+        StopStreaming();
+}
+
+void RtspRelay::Leave(Request& req)
+{
+    if (req.consumer)
+    {
+        for (auto it = _pendingRequests.begin(); it != _pendingRequests.end();)
+        {
+            if (it->consumer == req.consumer)
+            {
+                ReplyRequest(*it, error::WrongState);
+                it = _pendingRequests.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        Consumer* c = FindConsumer(req.consumer);
+        if (c)
+        {
+            if (c->playing)
+                Detach(*req.consumer);
+            _consumers.erase(_consumers.begin() + (c - _consumers.data()));
+        }
+    }
+    else
+    {
+        // Relay itself is going away
+        ReplyPending(RtspAsyncRequest::Unknown, error::WrongState);
+        _consumers.clear();
+    }
+
+    if (!IsAnyonePlaying() && _pendingRequests.empty())
+        StopStreaming();
+    ReplyRequest(req, error::Success);
+}
+
+void RtspRelay::OpenUrl()
+{
+    // Should never fail (only when out of memory)
+    _rtsp = RelayRtspClient::Create(this, *_env, _key.url.c_str(), _key.tunnelOverHttpPort);
+    if (!_rtsp)
+    {
+        SessionFailed(error::ClientCreateFailed);
+        return;
+    }
+    _firstCallTimeoutTask = _scheduler->scheduleDelayedTask(
+        firstCallTimeoutTime * 1000, &RtspRelay::DescribeRequestTimeout, this);
+    // Returns only CSeq number
+    _rtsp->sendDescribeCommand(HandleDescribeResponse, &_authenticator);
+}
+
+void RtspRelay::HandleDescribeResponse(RTSPClient* client, int resultCode, char* resultString)
+{
+    RelayRtspClient* myClient = static_cast<RelayRtspClient*>(client);
+    myClient->relay->HandleDescribeResponse(resultCode, resultString);
+}
+
+void RtspRelay::HandleDescribeResponse(int resultCode, char* resultString)
+{
+    // Don't need this anymore - we got a response in time
+    if (_firstCallTimeoutTask != nullptr)
+        _scheduler->unscheduleDelayedTask(_firstCallTimeoutTask);
+
+    if (resultCode != 0)
+    {
+        delete[] resultString;
+        SessionFailed(resultCode == -WSAENOTCONN ? error::ServerNotReachable
+                                                 : error::DescribeFailed);
+        return;
+    }
+
+    MediaSession* mediaSession = MediaSession::createNew(*_env, resultString);
+    delete[] resultString;
+    if (!mediaSession) // SDP is invalid or out of memory
+    {
+        SessionFailed(error::SdpInvalid);
+        return;
+    }
+    else if (!mediaSession->hasSubsessions())
+    {
+        // Close media session (don't wait for a response)
+        _rtsp->sendTeardownCommand(*mediaSession, nullptr, &_authenticator);
+        Medium::close(mediaSession);
+        SessionFailed(error::NoSubsessions);
+        return;
+    }
+
+    // Start setuping media session
+    _rtsp->mediaSession = mediaSession;
+    _rtsp->iter = new MediaSubsessionIterator(*mediaSession);
+    _numSubsessions = 0;
+
+    SetupSubsession();
+}
+
+void RtspRelay::SetupSubsession()
+{
+    MediaSubsession* subsession;
+    while ((subsession = _rtsp->iter->next()) != nullptr)
+    {
+        // Ignore unsupported subsessions
+        if (FindRtpCodec(*subsession) != nullptr && subsession->initiate())
+            break;
+    }
+    _rtsp->subsession = subsession;
+
+    if (subsession != nullptr)
+    {
+        ProxyMediaSink::ConfigureRtpSource(*_env, *subsession);
+        _rtsp->sendSetupCommand(*subsession, HandleSetupResponse, False, _key.streamOverTcp,
+                                forceMulticastOnUnspecified && !_key.streamOverTcp,
+                                &_authenticator);
+        return;
+    }
+
+    // We iterated over all available subsessions
+    delete _rtsp->iter;
+    _rtsp->iter = nullptr;
+
+    if (_numSubsessions == 0)
+    {
+        SessionFailed(error::NoSubsessionsSetup);
+        return;
+    }
+
+    SessionSetUp();
+}
+
+void RtspRelay::HandleSetupResponse(RTSPClient* client, int resultCode, char* resultString)
+{
+    RelayRtspClient* myClient = static_cast<RelayRtspClient*>(client);
+    myClient->relay->HandleSetupResponse(resultCode, resultString);
+}
+
+void RtspRelay::HandleSetupResponse(int resultCode, char* resultString)
+{
+    if (resultCode == 0)
+    {
+        delete[] resultString;
+        MediaSubsession* subsession = _rtsp->subsession;
+
+        // Consumers are attached to the sink when they play
+        const size_t receiveBufferSize = ProxyMediaSink::ReceiveBufferSize(*subsession);
+        if (receiveBufferSize > 0)
+        {
+            subsession->sink = new (std::nothrow) ProxyMediaSink(
+                *_env, *subsession, nullptr, receiveBufferSize, _settings.gopCacheMaxBytes,
+                _settings.gopCacheMaxFrames, _key.assembleAccessUnits);
+        }
+
+        if (subsession->sink != nullptr)
+        {
+            subsession->miscPtr = _rtsp;
+            subsession->sink->startPlaying(*(subsession->readSource()), HandleSubsessionFinished,
+                                           subsession);
+            // Set a handler to be called if a RTCP "BYE" arrives for this subsession
+            if (subsession->rtcpInstance() != nullptr)
+                subsession->rtcpInstance()->setByeHandler(HandleSubsessionFinished, subsession);
+
+            ++_numSubsessions;
+        }
+    }
+    else
+    {
+        (*_env) << "SETUP failed, server response: " << resultString;
+        delete[] resultString;
+    }
+
+    SetupSubsession();
+}
+
+void RtspRelay::SessionSetUp()
+{
+    // Everybody's pins follow the new subsessions (after reconnect too), those waiting for the
+    // session get theirs now
+    for (Consumer& consumer : _consumers)
+    {
+        consumer.consumer->RelaySetUp(*_rtsp->mediaSession);
+        if (consumer.playing)
+            Attach(*consumer.consumer);
+    }
+    ReplyPending(RtspAsyncRequest::Open, error::Success);
+
+    if (IsAnyonePlaying())
+    {
+        // Reconnecting until it plays again
+        if (_state != State::Reconnecting)
+            _state = State::StartingToPlay;
+        SendPlay();
+    }
+    else
+    {
+        _state = State::ReadyToPlay;
+    }
+}
+
+void RtspRelay::SessionFailed(RtspResult ec)
+{
+    UnscheduleAllDelayedTasks();
+    CloseSession();
+
+    const bool reconnecting = _state == State::Reconnecting;
+
+    // Those who opened the session for nothing aren't consumers (unless already playing)
+    _consumers.erase(
+        std::remove_if(_consumers.begin(), _consumers.end(),
+                       [this](const Consumer& c) {
+                           return !c.playing &&
+                                  std::any_of(_pendingRequests.begin(), _pendingRequests.end(),
+                                              [&c](const Request& req) {
+                                                  return req.consumer == c.consumer &&
+                                                         req.request.GetRequest() ==
+                                                             RtspAsyncRequest::Open;
+                                              });
+                       }),
+        _consumers.end());
+    ReplyPending(RtspAsyncRequest::Unknown, reconnecting ? error::ReconnectFailed : ec);
+
+    if (_settings.autoReconnectionMSecs > 0 && IsAnyonePlaying())
+    {
+        _state = State::Reconnecting;
+        _reconnectionTimerTask = _scheduler->scheduleDelayedTask(
+            _settings.autoReconnectionMSecs * 1000, &RtspRelay::Reconnect, this);
+        return;
+    }
+
+    EndStreaming();
+}
+
+void RtspRelay::SendPlay()
+{
+    const float scale = 1.0f; // No trick play
+    // Live only - no seeking, no end
+    _rtsp->sendPlayCommand(*_rtsp->mediaSession, HandlePlayResponse, 0.0, -1.0, scale,
+                           &_authenticator);
+}
+
+void RtspRelay::HandlePlayResponse(RTSPClient* client, int resultCode, char* resultString)
+{
+    RelayRtspClient* myClient = static_cast<RelayRtspClient*>(client);
+    myClient->relay->HandlePlayResponse(resultCode, resultString);
+}
+
+void RtspRelay::HandlePlayResponse(int resultCode, char* resultString)
+{
+    delete[] resultString;
+
+    if (resultCode != 0)
+    {
+        SessionFailed(error::PlayFailed);
+        return;
+    }
+
+    _state = State::Playing;
+    ReplyPending(RtspAsyncRequest::Play, error::Success);
+    StartSessionTimers();
+}
+
+void RtspRelay::StartSessionTimers()
+{
+    _totNumPacketsReceived = 0;
+    _sessionTimeout =
+        _rtsp->sessionTimeoutParameter() != 0 ? _rtsp->sessionTimeoutParameter() : 60;
+
+    // Create timerTask for disconnection recognition
+    _interPacketGapCheckTimerTask = _scheduler->scheduleDelayedTask(
+        interPacketGapMaxTime * 1000, &RtspRelay::CheckInterPacketGaps, this);
+    // Create timerTask for session keep-alive (use OPTIONS request to sustain session)
+    if (_settings.sendLivenessCommand)
+    {
+        _livenessCommandTask = _scheduler->scheduleDelayedTask(
+            _sessionTimeout / 3 * 1000000, &RtspRelay::SendLivenessCommand, this);
+    }
+}
+
+void RtspRelay::StopStreaming()
+{
+    UnscheduleAllDelayedTasks();
+    CloseSession();
+    _state = State::Initial;
+}
+
+void RtspRelay::EndStreaming()
+{
+    for (Consumer& consumer : _consumers)
+    {
+        if (!consumer.playing)
+            continue;
+        Detach(*consumer.consumer);
+        QueueEndOfStream(*consumer.consumer);
+        consumer.playing = false;
+    }
+    StopStreaming();
+}
+
+void RtspRelay::CloseSession()
+{
+    if (!_rtsp)
+        return;
+
+    delete _rtsp->iter;
+    _rtsp->iter = nullptr;
+    _rtsp->subsession = nullptr;
+
+    MediaSession* mediaSession = _rtsp->mediaSession;
+    if (mediaSession != nullptr)
+    {
+        // Don't bother waiting for response
+        _rtsp->sendTeardownCommand(*mediaSession, nullptr, &_authenticator);
+        // Close media sinks - consumers still attached are detached by them
+        MediaSubsessionIterator iter(*mediaSession);
+        MediaSubsession* subsession;
+        while ((subsession = iter.next()) != nullptr)
+        {
+            Medium::close(subsession->sink);
+            subsession->sink = nullptr;
+        }
+        // Close media session itself
+        Medium::close(mediaSession);
+        _rtsp->mediaSession = nullptr;
+    }
+
+    // Shutdown RTSP client
+    Medium::close(_rtsp);
+    _rtsp = nullptr;
+}
+
+void RtspRelay::UnscheduleAllDelayedTasks()
+{
+    if (_firstCallTimeoutTask != nullptr)
+        _scheduler->unscheduleDelayedTask(_firstCallTimeoutTask);
+    if (_interPacketGapCheckTimerTask != nullptr)
+        _scheduler->unscheduleDelayedTask(_interPacketGapCheckTimerTask);
+    if (_livenessCommandTask != nullptr)
+        _scheduler->unscheduleDelayedTask(_livenessCommandTask);
+    if (_reconnectionTimerTask != nullptr)
+        _scheduler->unscheduleDelayedTask(_reconnectionTimerTask);
+}
+
+void RtspRelay::Attach(RtspRelayConsumer& consumer)
+{
+    if (!_rtsp || !_rtsp->mediaSession)
+        return;
+
+    MediaSubsessionIterator iter(*_rtsp->mediaSession);
+    MediaSubsession* subsession;
+    while ((subsession = iter.next()) != nullptr)
+    {
+        ProxyMediaConsumer output;
+        if (subsession->sink != nullptr && consumer.RelayOutput(subsession->mediumName(), output))
+            static_cast<ProxyMediaSink*>(subsession->sink)->attach(output);
+    }
+}
+
+void RtspRelay::Detach(RtspRelayConsumer& consumer)
+{
+    if (!_rtsp || !_rtsp->mediaSession)
+        return;
+
+    MediaSubsessionIterator iter(*_rtsp->mediaSession);
+    MediaSubsession* subsession;
+    while ((subsession = iter.next()) != nullptr)
+    {
+        ProxyMediaConsumer output;
+        if (subsession->sink != nullptr && consumer.RelayOutput(subsession->mediumName(), output))
+            static_cast<ProxyMediaSink*>(subsession->sink)->detach(*output.mediaPacketQueue);
+    }
+}
+
+void RtspRelay::QueueEndOfStream(RtspRelayConsumer& consumer)
+{
+    for (const char* mediumName : relayedMedia)
+    {
+        ProxyMediaConsumer output;
+        if (consumer.RelayOutput(mediumName, output))
+            output.mediaPacketQueue->push(MediaPacketSample());
+    }
+}
+
+bool RtspRelay::IsAnyonePlaying() const
+{
+    return std::any_of(_consumers.begin(), _consumers.end(),
+                       [](const Consumer& c) { return c.playing; });
+}
+
+void RtspRelay::HandleSubsessionFinished(void* clientData)
+{
+    MediaSubsession* subsession = static_cast<MediaSubsession*>(clientData);
+    RelayRtspClient* rtsp = static_cast<RelayRtspClient*>(subsession->miscPtr);
+    rtsp->relay->HandleSubsessionFinished(*subsession);
+}
+
+void RtspRelay::HandleSubsessionFinished(MediaSubsession& subsession)
+{
+    // Close finished media subsession (or the one the server said BYE to)
+    Medium::close(subsession.sink);
+    subsession.sink = nullptr;
+    // Check if there's at least one active subsession
+    MediaSubsessionIterator iter(subsession.parentSession());
+    MediaSubsession* other;
+    while ((other = iter.next()) != nullptr)
+    {
+        if (other->sink != nullptr)
+            return;
+    }
+    DebugLog("Relay %s: session finished\n", _key.url.c_str());
+    EndStreaming();
+}
+
+/*
+ * Task:_firstCallTimeoutTask
+ * Viable only in SettingUp and Reconnecting state.
+ */
+void RtspRelay::DescribeRequestTimeout(void* clientData)
+{
+    RtspRelay* self = static_cast<RtspRelay*>(clientData);
+    self->_firstCallTimeoutTask = nullptr;
+    self->SessionFailed(error::ServerNotReachable);
+}
+
+/*
+ * Task:_interPacketGapCheckTimerTask:
+ * Detects connection lost. Viable only in Playing state.
+ */
+void RtspRelay::CheckInterPacketGaps(void* clientData)
+{
+    RtspRelay* self = static_cast<RtspRelay*>(clientData);
+    self->CheckInterPacketGaps();
+}
+
+void RtspRelay::CheckInterPacketGaps()
+{
+    _ASSERT(_state == State::Playing);
+    _interPacketGapCheckTimerTask = nullptr;
+
+    MediaSubsessionIterator iter(*_rtsp->mediaSession);
+    MediaSubsession* subsession;
+    unsigned newTotNumPacketsReceived = 0;
+    while ((subsession = iter.next()) != nullptr)
+    {
+        RTPSource* src = subsession->rtpSource();
+        if (src != nullptr)
+            newTotNumPacketsReceived += src->receptionStatsDB().totNumPacketsReceived();
+    }
+
+    if (newTotNumPacketsReceived != _totNumPacketsReceived)
+    {
+        _totNumPacketsReceived = newTotNumPacketsReceived;
+        // Schedule next inspection
+        _interPacketGapCheckTimerTask = _scheduler->scheduleDelayedTask(
+            interPacketGapMaxTime * 1000, &RtspRelay::CheckInterPacketGaps, this);
+        return;
+    }
+
+    DebugLog("Relay %s: no packets has been received since last time!\n", _key.url.c_str());
+    if (_settings.autoReconnectionMSecs == 0)
+    {
+        // Don't let the consumers wait for packets that most probably won't come
+        EndStreaming();
+        return;
+    }
+
+    // Consumers stay attached to no sink until the session is set up again
+    UnscheduleAllDelayedTasks();
+    CloseSession();
+    _state = State::Reconnecting;
+    _reconnectionTimerTask = _scheduler->scheduleDelayedTask(
+        _settings.autoReconnectionMSecs * 1000, &RtspRelay::Reconnect, this);
+}
+
+/*
+ * Task:_livenessCommandTask:
+ * Periodically requests OPTION command to the server to keep alive the session
+ * Viable only in Playing state.
+ */
+void RtspRelay::SendLivenessCommand(void* clientData)
+{
+    RtspRelay* self = static_cast<RtspRelay*>(clientData);
+    self->_livenessCommandTask = nullptr;
+    self->_rtsp->sendOptionsCommand(HandleOptionsResponse, &self->_authenticator);
+}
+
+void RtspRelay::HandleOptionsResponse(RTSPClient* client, int resultCode, char* resultString)
+{
+    RtspRelay* self = static_cast<RelayRtspClient*>(client)->relay;
+    delete[] resultString;
+    // Schedule next keep-alive request if there wasn't any error along the way
+    if (resultCode == 0)
+    {
+        self->_livenessCommandTask = self->_scheduler->scheduleDelayedTask(
+            self->_sessionTimeout / 3 * 1000000, &RtspRelay::SendLivenessCommand, self);
+    }
+}
+
+/*
+ * Task:_reconnectionTimerTask
+ * Viable only in Reconnecting state.
+ */
+void RtspRelay::Reconnect(void* clientData)
+{
+    RtspRelay* self = static_cast<RtspRelay*>(clientData);
+    _ASSERT(self->_state == State::Reconnecting);
+    self->_reconnectionTimerTask = nullptr;
+    DebugLog("Relay %s: reconnect now!\n", self->_key.url.c_str());
+    self->OpenUrl();
+}
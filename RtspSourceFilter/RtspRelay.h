@@ -0,0 +1,206 @@
+#pragma once
+
+#include "liveMedia.hh"
+#include "BasicUsageEnvironment.hh"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ConcurrentQueue.h"
+#include "ProxyMediaSink.h"
+#include "RtspAsyncRequest.h"
+#include "RtspIngestEngine.h"
+
+/**
+ * What makes an upstream session shareable - the same URL pulled over the same transport.
+ * Access unit assembly belongs to it as well, since it's the relay's sinks that assemble.
+ */
+struct RtspRelayKey
+{
+    std::string url;
+    bool streamOverTcp;
+    uint16_t tunnelOverHttpPort;
+    bool assembleAccessUnits;
+
+    bool operator<(const RtspRelayKey& other) const;
+};
+
+/**
+ * Session settings - these of whoever creates the relay are used
+ */
+struct RtspRelaySettings
+{
+    unsigned autoReconnectionMSecs;
+    bool sendLivenessCommand;
+    size_t gopCacheMaxBytes;
+    size_t gopCacheMaxFrames;
+};
+
+/**
+ * Party receiving samples of a relayed session (typically a filter). Called from the relay's
+ * ingest loop thread.
+ */
+class RtspRelayConsumer
+{
+public:
+    virtual ~RtspRelayConsumer() {}
+
+    /**
+     * Session has been set up (or set up again after reconnect) - time to create output pins
+     * for the subsessions having a sink or to point the existing ones to them. The consumer
+     * opening the session is waiting for its open request meanwhile.
+     */
+    virtual void RelaySetUp(MediaSession& mediaSession) = 0;
+
+    /**
+     * Where samples of given medium ("video", "audio") go, false if the consumer doesn't take
+     * them. Can be called any time - must not depend on the consumer's state.
+     */
+    virtual bool RelayOutput(const char* mediumName, ProxyMediaConsumer& output) = 0;
+};
+
+/**
+ * One upstream RTSP session shared by any number of consumers in the process. Relays are
+ * registered by their key and live as long as somebody holds them.
+ *
+ * The session is set up with the first consumer opening it and plays as long as any consumer
+ * does. Each playing consumer is attached to the sinks of the session - its media queues are
+ * its own bounded cursors over the samples, which all share the same pooled slabs (see
+ * ProxyMediaSink). A consumer joining a playing session starts from the cached GOP. When
+ * nobody plays anymore the session is torn down.
+ *
+ * Live streams only - the session always plays from now on. Lost connection is re-established
+ * (if given a reconnection period) for all consumers at once, the first sample afterwards marked
+ * as a discontinuity. Otherwise, just like when the session ends, end of stream is queued to
+ * every playing consumer.
+ *
+ * The relay is the only producer of its consumers' media queues from the moment they play
+ * until they stop - end of stream included.
+ */
+class RtspRelay : private RtspIngestSession
+{
+public:
+    /**
+     * Relay of given session - the one already registered or a new one
+     */
+    static std::shared_ptr<RtspRelay> Acquire(const RtspRelayKey& key,
+                                              const RtspRelaySettings& settings);
+
+    RtspRelay(const RtspRelayKey& key, const RtspRelaySettings& settings);
+    ~RtspRelay();
+
+    RtspRelay(const RtspRelay&) = delete;
+    RtspRelay& operator=(const RtspRelay&) = delete;
+
+    // Set up the session unless it is already (see RtspRelayConsumer::RelaySetUp)
+    RtspAsyncResult AsyncOpen(RtspRelayConsumer* consumer);
+    // Start delivering to the consumer, the session starts playing with the first one
+    RtspAsyncResult AsyncPlay(RtspRelayConsumer* consumer);
+    // Stop delivering to the consumer and queue end of stream to its outputs
+    RtspAsyncResult AsyncStop(RtspRelayConsumer* consumer);
+    // Stop and forget the consumer
+    RtspAsyncResult AsyncLeave(RtspRelayConsumer* consumer);
+
+    const RtspRelayKey& Key() const { return _key; }
+
+private:
+    struct Request
+    {
+        RtspAsyncRequest request;
+        RtspRelayConsumer* consumer;
+    };
+
+    struct Consumer
+    {
+        RtspRelayConsumer* consumer;
+        bool playing;
+    };
+
+    enum class State
+    {
+        Initial,
+        SettingUp,
+        ReadyToPlay,
+        StartingToPlay,
+        Playing,
+        Reconnecting
+    };
+
+    RtspAsyncResult MakeRequest(RtspAsyncRequest::Type type, RtspRelayConsumer* consumer);
+    void ProcessRequest(Request& req);
+    void ReplyRequest(Request& req, RtspResult ec);
+    // Replies all pending requests of given type (or any type if Unknown)
+    void ReplyPending(RtspAsyncRequest::Type type, RtspResult ec);
+    Consumer* FindConsumer(RtspRelayConsumer* consumer);
+
+    void Open(Request& req);
+    void Play(Request& req);
+    void Stop(RtspRelayConsumer* consumer);
+    void Leave(Request& req);
+
+    void OpenUrl();
+    void SetupSubsession();
+    void SessionSetUp();
+    void SessionFailed(RtspResult ec);
+    void SendPlay();
+    void StartSessionTimers();
+    // Tear the session down, nobody's playing
+    void StopStreaming();
+    // Session is over - end of stream to whoever's playing
+    void EndStreaming();
+    void CloseSession();
+    void UnscheduleAllDelayedTasks();
+
+    void Attach(RtspRelayConsumer& consumer);
+    void Detach(RtspRelayConsumer& consumer);
+    void QueueEndOfStream(RtspRelayConsumer& consumer);
+    bool IsAnyonePlaying() const;
+
+    // live555 handlers
+    static void HandleDescribeResponse(RTSPClient* client, int resultCode, char* resultString);
+    static void HandleSetupResponse(RTSPClient* client, int resultCode, char* resultString);
+    static void HandlePlayResponse(RTSPClient* client, int resultCode, char* resultString);
+    static void HandleOptionsResponse(RTSPClient* client, int resultCode, char* resultString);
+    static void HandleSubsessionFinished(void* clientData);
+    static void DescribeRequestTimeout(void* clientData);
+    static void CheckInterPacketGaps(void* clientData);
+    static void SendLivenessCommand(void* clientData);
+    static void Reconnect(void* clientData);
+
+    void HandleDescribeResponse(int resultCode, char* resultString);
+    void HandleSetupResponse(int resultCode, char* resultString);
+    void HandlePlayResponse(int resultCode, char* resultString);
+    void HandleSubsessionFinished(MediaSubsession& subsession);
+    void CheckInterPacketGaps();
+
+    // RtspIngestSession - called from the ingest loop thread
+    void ProcessRequests() override;
+
+private:
+    RtspRelayKey _key;
+    RtspRelaySettings _settings;
+
+    std::shared_ptr<RtspIngestEngine> _ingestEngine;
+    RtspIngestLoop* _ingestLoop;
+    TaskScheduler* _scheduler;
+    UsageEnvironment* _env;
+
+    // Touched only from the ingest loop thread
+    State _state;
+    std::vector<Consumer> _consumers;
+    // Waiting for the session to be set up or to start playing
+    std::vector<Request> _pendingRequests;
+
+    Authenticator _authenticator;
+    class RelayRtspClient* _rtsp;
+    int _numSubsessions;
+    unsigned _sessionTimeout;
+    unsigned _totNumPacketsReceived;
+    TaskToken _firstCallTimeoutTask;
+    TaskToken _interPacketGapCheckTimerTask;
+    TaskToken _livenessCommandTask;
+    TaskToken _reconnectionTimerTask;
+
+    ConcurrentQueue<Request> _requestQueue;
+};
@@ -2,15 +2,18 @@
 #include "RtspSourceGuids.h"
 #include "RtspError.h"
 #include "ProxyMediaSink.h"
+#include "CodecRegistry.h"
 #include "GroupsockHelper.hh"
 #include "Debug.h"
 
+#include <algorithm>
 #include <new>
 #include <DShow.h>
 
 /*
- * In order to add support for new media format (f.e. HEVC) one needs to:
- * - appropriately modify function IsSubsessionSupported()
+ * In order to add support for new media format one needs to:
+ * - add it to the codec registry (CodecRegistry.cpp), with its framing if frames delivered by
+ * its RTP source aren't the ones a decoder takes (see AudioFraming.h)
  * - based on given MediaSubsession initialize CMediaType (check GetMediaType{codec}() functions)
  * and use it to RtspSourcePin::InitializeMediaType
  * - Modify RtspSourcePin::FilBuffer if needed
@@ -27,16 +30,18 @@ namespace
     const char* RtspClientAppName = "RtspSourceFilter";
     const int RtspClientVerbosityLevel = RTSP_CLIENT_VERBOSITY_LEVEL;
     const uint32_t defaultLatencyMSecs = 500;
-    const int recvBufferVideo = 256 * 1024; // 256KB - H.264 IDR frames can be really big
-    const int recvBufferAudio = 4096;       // 4KB
-    const int recvBufferText = 2048;        // Should be more than enough
-    const unsigned int packetReorderingThresholdTime = 200 * 1000; // 200 ms
+    const size_t videoMediaQueueCapacity = 8192; // NAL units
+    const size_t audioMediaQueueCapacity = 2048; // Audio frames
+    const size_t defaultGopCacheMaxBytes = 8 * 1024 * 1024;
+    const size_t defaultGopCacheMaxFrames = 1024; // NAL units
     const int interPacketGapMaxTime = 2000; // 2000 msec - but effectively it's atleast twice that
     const Boolean forceMulticastOnUnspecified = False;
     const int firstCallTimeoutTime = 2000;
+    const int standbyRetryTime = 5000; // 5000 msec - standby session couldn't be set up or died
 
     bool IsSubsessionSupported(MediaSubsession& mediaSubsession);
-    void SetThreadName(DWORD dwThreadID, char* threadName);
+    bool ConvertUrl(LPCOLESTR url, std::string& out);
+    bool ConvertPath(LPCOLESTR path, std::string& out);
 }
 
 class RtspClient : public ::RTSPClient
@@ -59,6 +64,7 @@ protected:
         , mediaSession(nullptr)
         , subsession(nullptr)
         , iter(nullptr)
+        , standby(nullptr)
     {
     }
 
@@ -75,6 +81,8 @@ public:
     MediaSession* mediaSession;
     MediaSubsession* subsession;
     MediaSubsessionIterator* iter;
+    // Non-null as long as the client belongs to a standby session
+    RtspStandbySession* standby;
 };
 
 CUnknown* WINAPI RtspSourceFilter::CreateInstance(LPUNKNOWN lpunk, HRESULT* phr)
@@ -99,14 +107,28 @@ CUnknown* WINAPI RtspSourceFilter::CreateInstance(LPUNKNOWN lpunk, HRESULT* phr)
 
 RtspSourceFilter::RtspSourceFilter(IUnknown* pUnk, HRESULT* phr)
     : CSource(NAME("RtspSourceFilter"), pUnk, CLSID_RtspSourceFilter)
+    , _videoMediaQueue(videoMediaQueueCapacity, RtspQueueDropUntilIdr)
+    , _audioMediaQueue(audioMediaQueueCapacity, RtspQueueDropOldest)
+    , _videoMetrics(_videoMediaQueue)
+    , _audioMetrics(_audioMediaQueue)
+    , _videoRecorder("video", videoMediaQueueCapacity)
+    , _audioRecorder("audio", audioMediaQueueCapacity)
     , _streamOverTcp(false)
     , _tunnelOverHttpPort(0U)
     , _autoReconnectionMSecs(0)
     , _latencyMSecs(defaultLatencyMSecs)
+    , _minLatencyMSecs(defaultLatencyMSecs)
+    , _maxLatencyMSecs(defaultLatencyMSecs)
     , _sendLivenessCommand(false)
+    , _gopCacheMaxBytes(defaultGopCacheMaxBytes)
+    , _gopCacheMaxFrames(defaultGopCacheMaxFrames)
+    , _assembleAccessUnits(false)
+    , _relayMode(false)
     , _state(State::Initial)
-    , _scheduler(BasicTaskScheduler::createNew())
-    , _env(MyUsageEnvironment::createNew(*_scheduler))
+    , _ingestEngine(RtspIngestEngine::Instance())
+    , _ingestLoop(nullptr)
+    , _scheduler(nullptr)
+    , _env(nullptr)
     , _totNumPacketsReceived(0)
     , _interPacketGapCheckTimerTask(nullptr)
     , _reconnectionTimerTask(nullptr)
@@ -119,14 +141,23 @@ RtspSourceFilter::RtspSourceFilter(IUnknown* pUnk, HRESULT* phr)
     , _sessionDuration(0)
     , _initialSeekTime(0)
     , _endTime(0)
-    , _workerThread(&RtspSourceFilter::WorkerThread, this)
 {
+    // Last thing to do - from now on the loop may call us
+    _ingestLoop = &_ingestEngine->Attach(this);
+    _scheduler = &_ingestLoop->Scheduler();
+    _env = &_ingestLoop->Env();
 }
 
 RtspSourceFilter::~RtspSourceFilter()
 {
-    _requestQueue.push(RtspAsyncRequest(RtspAsyncRequest::Done));
-    _workerThread.join();
+    if (_relay)
+    {
+        _relay->AsyncLeave(this).get();
+        _relay.reset();
+    }
+    // Tear down the session on the loop thread and leave the loop once it's done
+    AsyncDone().get();
+    _ingestEngine->Detach(*_ingestLoop, this);
 }
 
 HRESULT RtspSourceFilter::NonDelegatingQueryInterface(REFIID riid, void** ppv)
@@ -137,6 +168,8 @@ HRESULT RtspSourceFilter::NonDelegatingQueryInterface(REFIID riid, void** ppv)
         return GetInterface((IAMFilterMiscFlags*)this, ppv);
     else if (riid == __uuidof(IRtspSourceConfig))
         return GetInterface((IRtspSourceConfig*)this, ppv);
+    else if (riid == __uuidof(IRtspSourceStatistics))
+        return GetInterface((IRtspSourceStatistics*)this, ppv);
     return __super::NonDelegatingQueryInterface(riid, ppv);
 }
 
@@ -178,15 +211,17 @@ HRESULT RtspSourceFilter::Load(LPCOLESTR inFileName, const AM_MEDIA_TYPE* inMedi
     if (!_rtspUrl.empty())
         return E_FAIL;
     // Convert OLE string to std one
-    size_t converted;
-    errno_t err = wcstombs_s(&converted, nullptr, 0, inFileName, 0);
-    if (err || converted == 0)
+    if (!ConvertUrl(inFileName, _rtspUrl))
         return E_FAIL;
-    _rtspUrl.resize(converted);
-    wcstombs_s(&converted, const_cast<char*>(_rtspUrl.data()), _rtspUrl.size(), inFileName,
-               _TRUNCATE);
+    if (_relayMode)
+    {
+        RtspRelayKey key = {_rtspUrl, _streamOverTcp, _tunnelOverHttpPort, _assembleAccessUnits};
+        RtspRelaySettings settings = {_autoReconnectionMSecs, _sendLivenessCommand,
+                                      _gopCacheMaxBytes, _gopCacheMaxFrames};
+        _relay = RtspRelay::Acquire(key, settings);
+    }
     // Request new URL asynchronously but wait since we need a response now
-    RtspAsyncResult result = AsyncOpenUrl(_rtspUrl);
+    RtspAsyncResult result = _relay ? _relay->AsyncOpen(this) : AsyncOpenUrl(_rtspUrl);
     RtspResult ec = result.get();
     // Check if we're ready to play the media
     if (ec)
@@ -196,6 +231,7 @@ HRESULT RtspSourceFilter::Load(LPCOLESTR inFileName, const AM_MEDIA_TYPE* inMedi
         // so we can't connect it to other filters in a graph
         (*_env) << "Error: " << ec.message().c_str() << "\n";
         _rtspUrl.clear(); // Allow the user to load different rtsp address
+        _relay.reset();
         return E_FAIL;
     }
     else
@@ -236,7 +272,10 @@ HRESULT RtspSourceFilter::Stop()
 
     // Blocking call
     // Guarantees that filter is in initial state when done
-    AsyncShutdown().get();
+    if (_relay)
+        _relay->AsyncStop(this).get();
+    else
+        AsyncShutdown().get();
 
     return __super::Stop();
 }
@@ -250,6 +289,9 @@ HRESULT RtspSourceFilter::Pause()
         // Ensure we won't be showing some old frames
         _videoMediaQueue.clear();
         _audioMediaQueue.clear();
+        _playoutDelay.configure(_latencyMSecs * 10000i64, _minLatencyMSecs * 10000i64,
+                                _maxLatencyMSecs * 10000i64);
+        _sessionClock.reset();
     }
 
     return __super::Pause();
@@ -259,8 +301,19 @@ HRESULT RtspSourceFilter::Run(REFERENCE_TIME tStart)
 {
     DebugLog("%s\n", __FUNCTION__);
 
+    // Relayed session is set up again if nobody kept it - whatever its state, the pins have to
+    // follow its subsessions
+    if (_relay)
+    {
+        RtspResult ec = _relay->AsyncOpen(this).get();
+        if (ec)
+        {
+            (*_env) << "Error: " << ec.message().c_str() << "\n";
+            return E_FAIL;
+        }
+    }
     // Need to reopen the session if we teardowned previous one
-    if (_state == State::Initial)
+    else if (_state == State::Initial)
     {
         // NOTE: We query internal state of a worker thread from different thread thus
         // this is only valid if we assume it's called as a first Run()
@@ -280,8 +333,13 @@ HRESULT RtspSourceFilter::Run(REFERENCE_TIME tStart)
 
     HRESULT hr = __super::Run(tStart);
     if (SUCCEEDED(hr))
+    {
         // Start playing asynchronously
-        AsyncPlay();
+        if (_relay)
+            _relay->AsyncPlay(this);
+        else
+            AsyncPlay();
+    }
     return hr;
 }
 
@@ -322,6 +380,179 @@ void RtspSourceFilter::SetSendLivenessCommand(BOOL sendLiveness)
     _sendLivenessCommand = sendLiveness ? true : false;
 }
 
+void RtspSourceFilter::SetVideoQueueLimits(DWORD maxBytes, DWORD maxFrames,
+                                           RtspQueueOverflowPolicy policy)
+{
+    // Valid at any time
+    _videoMediaQueue.setLimits(maxBytes, maxFrames, policy);
+}
+
+void RtspSourceFilter::SetAudioQueueLimits(DWORD maxBytes, DWORD maxFrames,
+                                           RtspQueueOverflowPolicy policy)
+{
+    // Valid at any time
+    _audioMediaQueue.setLimits(maxBytes, maxFrames, policy);
+}
+
+HRESULT RtspSourceFilter::AddStandbyUrl(LPCOLESTR url, BOOL prePlay)
+{
+    CheckPointer(url, E_POINTER);
+    // Session isn't ours to switch
+    if (_relayMode)
+        return E_FAIL;
+    std::string standbyUrl;
+    if (!ConvertUrl(url, standbyUrl))
+        return E_INVALIDARG;
+    // Standby session is set up in the background
+    MakeRequest(RtspAsyncRequest::AddStandby, standbyUrl,
+                prePlay ? RtspAsyncRequest::PrePlay : 0);
+    return S_OK;
+}
+
+HRESULT RtspSourceFilter::RemoveStandbyUrl(LPCOLESTR url)
+{
+    CheckPointer(url, E_POINTER);
+    if (_relayMode)
+        return E_FAIL;
+    std::string standbyUrl;
+    if (!ConvertUrl(url, standbyUrl))
+        return E_INVALIDARG;
+    MakeRequest(RtspAsyncRequest::RemoveStandby, standbyUrl);
+    return S_OK;
+}
+
+HRESULT RtspSourceFilter::SwitchUrl(LPCOLESTR url)
+{
+    CheckPointer(url, E_POINTER);
+    if (_relayMode)
+        return E_FAIL;
+    std::string standbyUrl;
+    if (!ConvertUrl(url, standbyUrl))
+        return E_INVALIDARG;
+    RtspResult ec = MakeRequest(RtspAsyncRequest::Switch, standbyUrl).get();
+    if (ec)
+    {
+        (*_env) << "Error: " << ec.message().c_str() << "\n";
+        return E_FAIL;
+    }
+    return S_OK;
+}
+
+void RtspSourceFilter::SetGopCacheLimits(DWORD maxBytes, DWORD maxFrames)
+{
+    // Valid for sessions set up afterwards (including standby ones)
+    _gopCacheMaxBytes = maxBytes;
+    _gopCacheMaxFrames = maxFrames;
+}
+
+void RtspSourceFilter::SetAccessUnitAssembly(BOOL assemble)
+{
+    // Valid for sessions set up afterwards (including standby ones)
+    _assembleAccessUnits = assemble ? true : false;
+}
+
+void RtspSourceFilter::SetAdaptiveLatency(DWORD minMSecs, DWORD maxMSecs)
+{
+    // Applied (and whatever has been learned so far forgotten) on the way out of Stopped state
+    _minLatencyMSecs = minMSecs;
+    _maxLatencyMSecs = maxMSecs;
+}
+
+void RtspSourceFilter::SetRelayMode(BOOL relay)
+{
+    // Valid only before Load()
+    _relayMode = relay ? true : false;
+}
+
+HRESULT RtspSourceFilter::StartRecording(LPCOLESTR pathPrefix, DWORD segmentMBytes,
+                                         DWORD segmentSecs)
+{
+    CheckPointer(pathPrefix, E_POINTER);
+    std::string prefix;
+    if (!ConvertPath(pathPrefix, prefix))
+        return E_INVALIDARG;
+
+    // Recorders take samples as soon as they're on, whatever the state of the session
+    const uint64_t segmentMaxBytes = static_cast<uint64_t>(segmentMBytes) * 1024 * 1024;
+    const std::chrono::seconds segmentMaxDuration(segmentSecs);
+    if (!_videoRecorder.start(prefix, segmentMaxBytes, segmentMaxDuration) ||
+        !_audioRecorder.start(prefix, segmentMaxBytes, segmentMaxDuration))
+    {
+        StopRecording();
+        return E_FAIL;
+    }
+    return S_OK;
+}
+
+void RtspSourceFilter::StopRecording()
+{
+    _videoRecorder.stop();
+    _audioRecorder.stop();
+}
+
+HRESULT RtspSourceFilter::GetVideoQueueStats(RtspMediaQueueStats* stats)
+{
+    CheckPointer(stats, E_POINTER);
+    _videoMediaQueue.getStats(*stats);
+    return S_OK;
+}
+
+HRESULT RtspSourceFilter::GetAudioQueueStats(RtspMediaQueueStats* stats)
+{
+    CheckPointer(stats, E_POINTER);
+    _audioMediaQueue.getStats(*stats);
+    return S_OK;
+}
+
+STDMETHODIMP RtspSourceFilter::GetRequestLatencyStats(RtspRequestLatencyStats* stats)
+{
+    CheckPointer(stats, E_POINTER);
+    _requestLatency.getStats(*stats);
+    return S_OK;
+}
+
+STDMETHODIMP RtspSourceFilter::GetGopCacheStats(RtspGopCacheStats* stats)
+{
+    CheckPointer(stats, E_POINTER);
+    _gopCacheCounters.getStats(*stats);
+    return S_OK;
+}
+
+STDMETHODIMP RtspSourceFilter::GetPlayoutDelayStats(RtspPlayoutDelayStats* stats)
+{
+    CheckPointer(stats, E_POINTER);
+    _playoutDelay.getStats(*stats);
+    return S_OK;
+}
+
+STDMETHODIMP RtspSourceFilter::GetVideoStreamStats(RtspStreamStats* stats)
+{
+    CheckPointer(stats, E_POINTER);
+    _videoMetrics.getStats(*stats);
+    return S_OK;
+}
+
+STDMETHODIMP RtspSourceFilter::GetAudioStreamStats(RtspStreamStats* stats)
+{
+    CheckPointer(stats, E_POINTER);
+    _audioMetrics.getStats(*stats);
+    return S_OK;
+}
+
+STDMETHODIMP RtspSourceFilter::GetVideoRecordingStats(RtspRecordingStats* stats)
+{
+    CheckPointer(stats, E_POINTER);
+    _videoRecorder.getStats(*stats);
+    return S_OK;
+}
+
+STDMETHODIMP RtspSourceFilter::GetAudioRecordingStats(RtspRecordingStats* stats)
+{
+    CheckPointer(stats, E_POINTER);
+    _audioRecorder.getStats(*stats);
+    return S_OK;
+}
+
 RtspAsyncResult RtspSourceFilter::AsyncOpenUrl(const std::string& url)
 {
     return MakeRequest(RtspAsyncRequest::Open, url);
@@ -342,16 +573,30 @@ RtspAsyncResult RtspSourceFilter::AsyncReconnect()
     return MakeRequest(RtspAsyncRequest::Reconnect, "");
 }
 
+RtspAsyncResult RtspSourceFilter::AsyncDone()
+{
+    return MakeRequest(RtspAsyncRequest::Done, "");
+}
+
 RtspAsyncResult RtspSourceFilter::MakeRequest(RtspAsyncRequest::Type request,
-                                              const std::string& requestData)
+                                              const std::string& requestData,
+                                              unsigned requestFlags)
 {
-    /// TODO: Check if worker thread is alive
-    RtspAsyncRequest rtspRequest(request, requestData);
+    RtspAsyncRequest rtspRequest(request, requestData, requestFlags);
     RtspAsyncResult r(rtspRequest.GetAsyncResult());
     _requestQueue.push(std::move(rtspRequest));
+    _ingestLoop->Notify();
     return r;
 }
 
+void RtspSourceFilter::ReplyRequest(RtspAsyncRequest& req, RtspResult ec)
+{
+    _requestLatency.record(req.GetAge());
+    req.SetValue(ec);
+    // Requests that came in the meantime may be waiting for this one to finish
+    _ingestLoop->Notify();
+}
+
 void RtspSourceFilter::OpenUrl(const std::string& url)
 {
     // Should never fail (only when out of memory)
@@ -359,7 +604,7 @@ void RtspSourceFilter::OpenUrl(const std::string& url)
                                          RtspClientAppName, _tunnelOverHttpPort);
     if (!_rtsp)
     {
-        _currentRequest.SetValue(error::ClientCreateFailed);
+        ReplyRequest(_currentRequest, error::ClientCreateFailed);
         _state = State::Initial;
         return;
     }
@@ -394,12 +639,12 @@ void RtspSourceFilter::HandleDescribeResponse(int resultCode, char* resultString
         if (resultCode == -WSAENOTCONN)
         {
             _state = State::Initial;
-            _currentRequest.SetValue(error::ServerNotReachable);
+            ReplyRequest(_currentRequest, error::ServerNotReachable);
         }
         else
         {
             _state = State::Initial;
-            _currentRequest.SetValue(error::DescribeFailed);
+            ReplyRequest(_currentRequest, error::DescribeFailed);
         }
 
         return;
@@ -413,7 +658,7 @@ void RtspSourceFilter::HandleDescribeResponse(int resultCode, char* resultString
         if (ScheduleNextReconnect())
             return;
 
-        _currentRequest.SetValue(error::SdpInvalid);
+        ReplyRequest(_currentRequest, error::SdpInvalid);
         _state = State::Initial;
 
         return;
@@ -430,7 +675,7 @@ void RtspSourceFilter::HandleDescribeResponse(int resultCode, char* resultString
         if (ScheduleNextReconnect())
             return;
 
-        _currentRequest.SetValue(error::NoSubsessions);
+        ReplyRequest(_currentRequest, error::NoSubsessions);
         _state = State::Initial;
 
         return;
@@ -466,21 +711,7 @@ void RtspSourceFilter::SetupSubsession()
             return;
         }
 
-        RTPSource* rtpSource = subsession->rtpSource();
-        if (rtpSource)
-        {
-            rtpSource->setPacketReorderingThresholdTime(packetReorderingThresholdTime);
-
-            int recvBuffer = 0;
-            if (!strcmp(subsession->mediumName(), "video"))
-                recvBuffer = recvBufferVideo;
-            else if (!strcmp(subsession->mediumName(), "audio"))
-                recvBuffer = recvBufferAudio;
-
-            // Increase receive buffer for rather big packets (like H.264 IDR)
-            if (recvBuffer > 0 && rtpSource->RTPgs())
-                ::increaseReceiveBufferTo(*_env, rtpSource->RTPgs()->socketNum(), recvBuffer);
-        }
+        ProxyMediaSink::ConfigureRtpSource(*_env, *subsession);
 
         _rtsp->sendSetupCommand(*subsession, HandleSetupResponse, False, _streamOverTcp,
                                 forceMulticastOnUnspecified && !_streamOverTcp, &_authenticator);
@@ -502,7 +733,7 @@ void RtspSourceFilter::SetupSubsession()
             return;
 
         _state = State::Initial;
-        _currentRequest.SetValue(error::NoSubsessionsSetup);
+        ReplyRequest(_currentRequest, error::NoSubsessionsSetup);
 
         return;
     }
@@ -510,7 +741,7 @@ void RtspSourceFilter::SetupSubsession()
     if (_state != State::Reconnecting)
     {
         _state = State::ReadyToPlay;
-        _currentRequest.SetValue(error::Success);
+        ReplyRequest(_currentRequest, error::Success);
     }
     else
     {
@@ -533,35 +764,15 @@ void RtspSourceFilter::HandleSetupResponse(int resultCode, char* resultString)
         delete[] resultString;
         MediaSubsession* subsession = _rtsp->subsession;
 
-        if (!strcmp(subsession->mediumName(), "video"))
-        {
-            HRESULT hr;
-            subsession->sink =
-                new ProxyMediaSink(*_env, *subsession, _videoMediaQueue, recvBufferVideo);
-            if (!_videoPin)
-                _videoPin.reset(new RtspSourcePin(&hr, this, subsession, _videoMediaQueue));
-            else
-                _videoPin->ResetMediaSubsession(subsession);
-        }
-        else if (!strcmp(subsession->mediumName(), "audio"))
-        {
-            HRESULT hr;
-            subsession->sink =
-                new ProxyMediaSink(*_env, *subsession, _audioMediaQueue, recvBufferAudio);
-            if (!_audioPin)
-                _audioPin.reset(new RtspSourcePin(&hr, this, subsession, _audioMediaQueue));
-            else
-                _audioPin->ResetMediaSubsession(subsession);
-        }
-
         // What about text medium ?
-
+        subsession->sink = CreateSink(*subsession, true);
         if (subsession->sink == nullptr)
         {
             // unsupported medium or out of memory
             SetupSubsession();
             return;
         }
+        CreatePin(*subsession);
 
         subsession->miscPtr = _rtsp;
         subsession->sink->startPlaying(*(subsession->readSource()), HandleSubsessionFinished,
@@ -619,33 +830,9 @@ void RtspSourceFilter::HandlePlayResponse(int resultCode, char* resultString)
 {
     if (resultCode == 0)
     {
-        _currentRequest.SetValue(error::Success);
+        ReplyRequest(_currentRequest, error::Success);
         // State is already Playing
-        _totNumPacketsReceived = 0;
-        _sessionTimeout =
-            _rtsp->sessionTimeoutParameter() != 0 ? _rtsp->sessionTimeoutParameter() : 60;
-
-        // Create timerTask for disconnection recognition
-        _interPacketGapCheckTimerTask = _scheduler->scheduleDelayedTask(
-            interPacketGapMaxTime * 1000, &RtspSourceFilter::CheckInterPacketGaps, this);
-        // Create timerTask for session keep-alive (use OPTIONS request to sustain session)
-        if (_sendLivenessCommand)
-        {
-            _livenessCommandTask = _scheduler->scheduleDelayedTask(
-                _sessionTimeout / 3 * 1000000, &RtspSourceFilter::SendLivenessCommand, this);
-        }
-
-        if (_sessionDuration > 0)
-        {
-            double rangeAdjustment =
-                (_rtsp->mediaSession->playEndTime() - _rtsp->mediaSession->playStartTime()) -
-                (_endTime - _initialSeekTime);
-            if (_sessionDuration + rangeAdjustment > 0.0)
-                _sessionDuration += rangeAdjustment;
-            int64_t uSecsToDelay = (int64_t)(_sessionDuration * 1000000.0);
-            _sessionTimerTask = _scheduler->scheduleDelayedTask(
-                uSecsToDelay, &RtspSourceFilter::HandleMediaEnded, this);
-        }
+        StartSessionTimers();
     }
     else
     {
@@ -658,13 +845,13 @@ void RtspSourceFilter::HandlePlayResponse(int resultCode, char* resultString)
             _reconnectionTimerTask = _scheduler->scheduleDelayedTask(
                 _autoReconnectionMSecs * 1000, &RtspSourceFilter::Reconnect, this);
             _state = State::Reconnecting;
-            _currentRequest.SetValue(error::PlayFailed);
+            ReplyRequest(_currentRequest, error::PlayFailed);
         }
         else
         {
 
             _state = State::Initial;
-            _currentRequest.SetValue(error::PlayFailed);
+            ReplyRequest(_currentRequest, error::PlayFailed);
 
             // Notify output pins PLAY command failed
             _videoMediaQueue.push(MediaPacketSample());
@@ -675,6 +862,124 @@ void RtspSourceFilter::HandlePlayResponse(int resultCode, char* resultString)
     delete[] resultString;
 }
 
+MediaSink* RtspSourceFilter::CreateSink(MediaSubsession& subsession, bool consume)
+{
+    const size_t receiveBufferSize = ProxyMediaSink::ReceiveBufferSize(subsession);
+    ProxyMediaConsumer consumer;
+    if (receiveBufferSize == 0 ||
+        (consume && !GetMediaConsumer(subsession.mediumName(), consumer)))
+    {
+        return nullptr;
+    }
+
+    return new (std::nothrow) ProxyMediaSink(*_env, subsession, consume ? &consumer : nullptr,
+                                             receiveBufferSize, _gopCacheMaxBytes,
+                                             _gopCacheMaxFrames, _assembleAccessUnits);
+}
+
+void RtspSourceFilter::CreatePin(MediaSubsession& subsession)
+{
+    std::unique_ptr<RtspSourcePin>* pin;
+    MediaPacketQueue* mediaPacketQueue;
+    if (!strcmp(subsession.mediumName(), "video"))
+    {
+        pin = &_videoPin;
+        mediaPacketQueue = &_videoMediaQueue;
+    }
+    else if (!strcmp(subsession.mediumName(), "audio"))
+    {
+        pin = &_audioPin;
+        mediaPacketQueue = &_audioMediaQueue;
+    }
+    else
+    {
+        return;
+    }
+
+    if (!*pin)
+    {
+        HRESULT hr;
+        pin->reset(new RtspSourcePin(&hr, this, &subsession, *mediaPacketQueue));
+    }
+    else
+    {
+        (*pin)->ResetMediaSubsession(&subsession);
+    }
+}
+
+bool RtspSourceFilter::GetMediaConsumer(const char* mediumName, ProxyMediaConsumer& consumer)
+{
+    if (!strcmp(mediumName, "video"))
+    {
+        consumer.mediaPacketQueue = &_videoMediaQueue;
+        consumer.metrics = &_videoMetrics;
+        consumer.recorder = &_videoRecorder;
+    }
+    else if (!strcmp(mediumName, "audio"))
+    {
+        consumer.mediaPacketQueue = &_audioMediaQueue;
+        consumer.metrics = &_audioMetrics;
+        consumer.recorder = &_audioRecorder;
+    }
+    else
+    {
+        return false;
+    }
+    consumer.playoutDelay = &_playoutDelay;
+    consumer.gopCacheCounters = &_gopCacheCounters;
+    return true;
+}
+
+void RtspSourceFilter::RelaySetUp(MediaSession& mediaSession)
+{
+    MediaSubsessionIterator iter(mediaSession);
+    MediaSubsession* subsession;
+    while ((subsession = iter.next()) != nullptr)
+    {
+        if (subsession->sink != nullptr)
+            CreatePin(*subsession);
+    }
+}
+
+bool RtspSourceFilter::RelayOutput(const char* mediumName, ProxyMediaConsumer& output)
+{
+    // Only media we have a pin for
+    if (!strcmp(mediumName, "video") && !_videoPin)
+        return false;
+    if (!strcmp(mediumName, "audio") && !_audioPin)
+        return false;
+    return GetMediaConsumer(mediumName, output);
+}
+
+void RtspSourceFilter::StartSessionTimers()
+{
+    _totNumPacketsReceived = 0;
+    _sessionTimeout =
+        _rtsp->sessionTimeoutParameter() != 0 ? _rtsp->sessionTimeoutParameter() : 60;
+
+    // Create timerTask for disconnection recognition
+    _interPacketGapCheckTimerTask = _scheduler->scheduleDelayedTask(
+        interPacketGapMaxTime * 1000, &RtspSourceFilter::CheckInterPacketGaps, this);
+    // Create timerTask for session keep-alive (use OPTIONS request to sustain session)
+    if (_sendLivenessCommand)
+    {
+        _livenessCommandTask = _scheduler->scheduleDelayedTask(
+            _sessionTimeout / 3 * 1000000, &RtspSourceFilter::SendLivenessCommand, this);
+    }
+
+    if (_sessionDuration > 0)
+    {
+        double rangeAdjustment =
+            (_rtsp->mediaSession->playEndTime() - _rtsp->mediaSession->playStartTime()) -
+            (_endTime - _initialSeekTime);
+        if (_sessionDuration + rangeAdjustment > 0.0)
+            _sessionDuration += rangeAdjustment;
+        int64_t uSecsToDelay = (int64_t)(_sessionDuration * 1000000.0);
+        _sessionTimerTask = _scheduler->scheduleDelayedTask(
+            uSecsToDelay, &RtspSourceFilter::HandleMediaEnded, this);
+    }
+}
+
 void RtspSourceFilter::CloseSession()
 {
     if (!_rtsp)
@@ -709,6 +1014,12 @@ void RtspSourceFilter::HandleSubsessionFinished(void* clientData)
 {
     MediaSubsession* subsession = static_cast<MediaSubsession*>(clientData);
     RtspClient* rtsp = static_cast<RtspClient*>(subsession->miscPtr);
+    // Standby session died - just set it up again
+    if (rtsp->standby != nullptr)
+    {
+        rtsp->filter->RetryStandby(*rtsp->standby);
+        return;
+    }
     // Close finished media subsession
     Medium::close(subsession->sink);
     subsession->sink = nullptr;
@@ -759,7 +1070,7 @@ void RtspSourceFilter::Shutdown()
     CloseClient();
 
     _state = State::Initial;
-    _currentRequest.SetValue(error::Success);
+    ReplyRequest(_currentRequest, error::Success);
 
     // Notify pins we are tearing down
     _videoMediaQueue.push(MediaPacketSample());
@@ -773,7 +1084,7 @@ bool RtspSourceFilter::ScheduleNextReconnect()
         _reconnectionTimerTask = _scheduler->scheduleDelayedTask(
             _autoReconnectionMSecs * 1000, &RtspSourceFilter::Reconnect, this);
         // state is still Reconnecting
-        _currentRequest.SetValue(error::ReconnectFailed);
+        ReplyRequest(_currentRequest, error::ReconnectFailed);
         return true;
     }
     return false;
@@ -803,7 +1114,7 @@ void RtspSourceFilter::DescribeRequestTimeout()
         return;
 
     _state = State::Initial;
-    _currentRequest.SetValue(error::ServerNotReachable);
+    ReplyRequest(_currentRequest, error::ServerNotReachable);
 }
 
 /*
@@ -971,11 +1282,16 @@ void RtspSourceFilter::HandleMediaEnded(void* clientData)
     self->AsyncShutdown();
 }
 
-void RtspSourceFilter::WorkerThread()
+void RtspSourceFilter::ProcessRequests()
 {
-    SetThreadName(-1, "RTSP source thread");
-    bool done = false;
+    RtspAsyncRequest req;
+    // In the middle of request - leave incoming requests queued untill done
+    while (_state != State::SettingUp && _requestQueue.try_pop(req))
+        ProcessRequest(req);
+}
 
+void RtspSourceFilter::ProcessRequest(RtspAsyncRequest& req)
+{
     // Uses internals of RtspSourceFilter
     auto GetRtspSourceStateString = [](State state)
     {
@@ -996,216 +1312,541 @@ void RtspSourceFilter::WorkerThread()
         }
     };
 
-    RtspAsyncRequest req;
+    DebugLog("[ProcessRequest] -  State: %s, Request: %s]\n", GetRtspSourceStateString(_state),
+             GetRtspAsyncRequestTypeString(req.GetRequest()));
+
+    // Standby sessions don't depend on the state of the main one
+    switch (req.GetRequest())
+    {
+    case RtspAsyncRequest::AddStandby:
+        AddStandby(req.GetRequestData(), (req.GetRequestFlags() & RtspAsyncRequest::PrePlay) != 0);
+        ReplyRequest(req, error::Success);
+        return;
+
+    case RtspAsyncRequest::RemoveStandby:
+        RemoveStandby(req.GetRequestData());
+        ReplyRequest(req, error::Success);
+        return;
 
-    while (!done)
+    // Order from the dtor - nothing may be left on the loop
+    case RtspAsyncRequest::Done:
+        CloseAllStandbySessions();
+        break;
+
+    default:
+        break;
+    }
+
+    // Process requests
+    switch (_state)
     {
-        // In the middle of request - ignore any incoming requests untill done
-        if (_state == State::SettingUp)
+    case State::Initial:
+        switch (req.GetRequest())
         {
-            _scheduler->SingleStep();
-            continue;
+        // Start opening url
+        case RtspAsyncRequest::Open:
+            _currentRequest = std::move(req);
+            _state = State::SettingUp;
+            OpenUrl(_currentRequest.GetRequestData());
+            break;
+
+        // Wrong transitions
+        case RtspAsyncRequest::Play:
+        case RtspAsyncRequest::Reconnect:
+        case RtspAsyncRequest::Switch:
+            ReplyRequest(req, error::WrongState);
+            break;
+
+        case RtspAsyncRequest::Stop:
+            // Needed if filter is re-started and fails to start running for some reason
+            // and also output pins threads are already started and waiting for packets.
+            // This is because Pause() is called before Run() which can fail if filter is
+            // restarted
+            _videoMediaQueue.push(MediaPacketSample());
+            _audioMediaQueue.push(MediaPacketSample());
+            ReplyRequest(req, error::Success);
+            break;
+
+        // Order from the dtor - nothing to tear down
+        case RtspAsyncRequest::Done:
+            ReplyRequest(req, error::Success);
+            break;
         }
+        break;
 
-        if (!_requestQueue.try_pop(req))
+    case State::ReadyToPlay:
+        switch (req.GetRequest())
         {
-            // No requests to process to - make a single step
-            _scheduler->SingleStep();
-            continue;
-        }
+        // Wrong transition
+        case RtspAsyncRequest::Open:
+        case RtspAsyncRequest::Reconnect:
+        case RtspAsyncRequest::Switch:
+            ReplyRequest(req, error::WrongState);
+            break;
 
-        DebugLog("[WorkerThread] -  State: %s, Request: %s]\n", GetRtspSourceStateString(_state),
-                 GetRtspAsyncRequestTypeString(req.GetRequest()));
+        // Start media streaming
+        case RtspAsyncRequest::Play:
+            _currentRequest = std::move(req);
+            _state = State::Playing;
+            Play();
+            break;
 
-        // Process requests
-        switch (_state)
+        // Back down from streaming - close media session and its sink(s)
+        case RtspAsyncRequest::Stop:
+            _currentRequest = std::move(req);
+            Shutdown();
+            break;
+
+        // Order from the dtor - tear down the session
+        case RtspAsyncRequest::Done:
+            _currentRequest = std::move(req);
+            Shutdown();
+            break;
+        }
+        break;
+
+    case State::Playing:
+        switch (req.GetRequest())
         {
-        case State::Initial:
-            switch (req.GetRequest())
-            {
-            // Start opening url
-            case RtspAsyncRequest::Open:
-                _currentRequest = std::move(req);
-                _state = State::SettingUp;
-                OpenUrl(_currentRequest.GetRequestData());
-                break;
-
-            // Wrong transitions
-            case RtspAsyncRequest::Play:
-            case RtspAsyncRequest::Reconnect:
-                req.SetValue(error::WrongState);
-                break;
-
-            case RtspAsyncRequest::Stop:
-                // Needed if filter is re-started and fails to start running for some reason
-                // and also output pins threads are already started and waiting for packets.
-                // This is because Pause() is called before Run() which can fail if filter is
-                // restarted
-                _videoMediaQueue.push(MediaPacketSample());
-                _audioMediaQueue.push(MediaPacketSample());
-                req.SetValue(error::Success);
-                break;
-
-            // Finish this thread
-            case RtspAsyncRequest::Done:
-                done = true;
-                req.SetValue(error::Success);
-                break;
-            }
+        // Wrong transition
+        case RtspAsyncRequest::Open:
+        case RtspAsyncRequest::Play:
+            ReplyRequest(req, error::WrongState);
             break;
 
-        case State::ReadyToPlay:
-            switch (req.GetRequest())
-            {
-            // Wrong transition
-            case RtspAsyncRequest::Open:
-            case RtspAsyncRequest::Reconnect:
-                req.SetValue(error::WrongState);
-                break;
-
-            // Start media streaming
-            case RtspAsyncRequest::Play:
-                _currentRequest = std::move(req);
-                _state = State::Playing;
-                Play();
-                break;
-
-            // Back down from streaming - close media session and its sink(s)
-            case RtspAsyncRequest::Stop:
-                _currentRequest = std::move(req);
-                Shutdown();
-                break;
-
-            // Order from the dtor - finish this thread
-            case RtspAsyncRequest::Done:
-                _currentRequest = std::move(req);
-                Shutdown();
-                done = true;
-                break;
-            }
+        // Replace the session with a standby one
+        case RtspAsyncRequest::Switch:
+            _currentRequest = std::move(req);
+            SwitchToStandby(_currentRequest.GetRequestData());
             break;
 
-        case State::Playing:
-            switch (req.GetRequest())
-            {
-            // Wrong transition
-            case RtspAsyncRequest::Open:
-            case RtspAsyncRequest::Play:
-                req.SetValue(error::WrongState);
-                break;
-
-            // Try to reconnect
-            case RtspAsyncRequest::Reconnect:
-                _currentRequest = std::move(req);
-                _state = State::Reconnecting;
-                UnscheduleAllDelayedTasks();
-                CloseSession();
-                CloseClient();
-                OpenUrl(_rtspUrl);
-                break;
-
-            // Back down from streaming - close media session and its sink(s)
-            case RtspAsyncRequest::Stop:
-                _currentRequest = std::move(req);
-                Shutdown();
-                break;
-
-            // Order from the dtor - finish this thread
-            case RtspAsyncRequest::Done:
-                _currentRequest = std::move(req);
-                Shutdown();
-                done = true;
-                break;
-            }
+        // Try to reconnect
+        case RtspAsyncRequest::Reconnect:
+            _currentRequest = std::move(req);
+            _state = State::Reconnecting;
+            UnscheduleAllDelayedTasks();
+            CloseSession();
+            CloseClient();
+            OpenUrl(_rtspUrl);
             break;
 
-        case State::Reconnecting:
-            switch (req.GetRequest())
-            {
-            // Wrong transition
-            case RtspAsyncRequest::Open:
-            case RtspAsyncRequest::Play:
-                req.SetValue(error::WrongState);
-                break;
-
-            // Try another round
-            case RtspAsyncRequest::Reconnect:
-                _currentRequest = std::move(req);
-                // Session and client should be null here
-                _ASSERT(!_rtsp);
-                OpenUrl(_rtspUrl);
-                break;
-
-            // Giveup trying to reconnect
-            case RtspAsyncRequest::Stop:
-                _currentRequest = std::move(req);
-                Shutdown();
-                break;
-
-            case RtspAsyncRequest::Done:
-                _currentRequest = std::move(req);
-                Shutdown();
-                done = true;
-                break;
-            }
+        // Back down from streaming - close media session and its sink(s)
+        case RtspAsyncRequest::Stop:
+            _currentRequest = std::move(req);
+            Shutdown();
             break;
 
-        default:
-            // should never come here
-            _ASSERT(false);
+        // Order from the dtor - tear down the session
+        case RtspAsyncRequest::Done:
+            _currentRequest = std::move(req);
+            Shutdown();
+            break;
+        }
+        break;
+
+    case State::Reconnecting:
+        switch (req.GetRequest())
+        {
+        // Wrong transition
+        case RtspAsyncRequest::Open:
+        case RtspAsyncRequest::Play:
+        case RtspAsyncRequest::Switch:
+            ReplyRequest(req, error::WrongState);
+            break;
+
+        // Try another round
+        case RtspAsyncRequest::Reconnect:
+            _currentRequest = std::move(req);
+            // Session and client should be null here
+            _ASSERT(!_rtsp);
+            OpenUrl(_rtspUrl);
+            break;
+
+        // Giveup trying to reconnect
+        case RtspAsyncRequest::Stop:
+            _currentRequest = std::move(req);
+            Shutdown();
+            break;
+
+        case RtspAsyncRequest::Done:
+            _currentRequest = std::move(req);
+            Shutdown();
             break;
         }
+        break;
+
+    default:
+        // should never come here
+        _ASSERT(false);
+        break;
     }
 }
 
-namespace
+/*
+ * Standby sessions
+ * Kept described and set up (and optionally playing) on the side so that switching to one of
+ * them is just a matter of re-targeting its sinks to our media queues. They're not affected by
+ * the state of the main session and live until removed or the filter is destroyed.
+ */
+void RtspSourceFilter::AddStandby(const std::string& url, bool prePlay)
 {
-    bool IsSubsessionSupported(MediaSubsession& mediaSubsession)
+    for (auto& standby : _standbySessions)
     {
-        if (!strcmp(mediaSubsession.mediumName(), "video"))
-        {
-            if (!strcmp(mediaSubsession.codecName(), "H264"))
-            {
-                return true;
-            }
-        }
-        else if (!strcmp(mediaSubsession.mediumName(), "audio"))
+        if (standby->url == url)
+            return;
+    }
+
+    std::unique_ptr<RtspStandbySession> standby(new RtspStandbySession());
+    standby->filter = this;
+    standby->url = url;
+    standby->prePlay = prePlay;
+    standby->ready = false;
+    standby->numSubsessions = 0;
+    standby->rtsp = nullptr;
+    standby->task = nullptr;
+    _standbySessions.push_back(std::move(standby));
+
+    OpenStandby(*_standbySessions.back());
+}
+
+void RtspSourceFilter::RemoveStandby(const std::string& url)
+{
+    for (auto it = _standbySessions.begin(); it != _standbySessions.end(); ++it)
+    {
+        if ((*it)->url == url)
         {
-            if (!strcmp(mediaSubsession.codecName(), "MPEG4-GENERIC"))
-            {
-                return true;
-            }
-            else if (!strcmp(mediaSubsession.codecName(), "AC3"))
-            {
-                return false;
-                // TODO: Not completed
-                // return true;
-            }
+            CloseStandby(**it);
+            _standbySessions.erase(it);
+            return;
         }
+    }
+}
 
-        return false;
+void RtspSourceFilter::CloseAllStandbySessions()
+{
+    for (auto& standby : _standbySessions)
+        CloseStandby(*standby);
+    _standbySessions.clear();
+}
+
+void RtspSourceFilter::OpenStandby(void* clientData)
+{
+    RtspStandbySession* standby = static_cast<RtspStandbySession*>(clientData);
+    standby->task = nullptr;
+    standby->filter->OpenStandby(*standby);
+}
+
+void RtspSourceFilter::OpenStandby(RtspStandbySession& standby)
+{
+    standby.rtsp = RtspClient::CreateRtspClient(this, *_env, standby.url.c_str(),
+                                                RtspClientVerbosityLevel, RtspClientAppName,
+                                                _tunnelOverHttpPort);
+    if (!standby.rtsp)
+    {
+        RetryStandby(standby);
+        return;
+    }
+    standby.rtsp->standby = &standby;
+    standby.rtsp->sendDescribeCommand(HandleStandbyDescribeResponse, &_authenticator);
+}
+
+void RtspSourceFilter::HandleStandbyDescribeResponse(RTSPClient* client, int resultCode,
+                                                     char* resultString)
+{
+    RtspClient* myClient = static_cast<RtspClient*>(client);
+    myClient->filter->HandleStandbyDescribeResponse(*myClient->standby, resultCode, resultString);
+}
+
+void RtspSourceFilter::HandleStandbyDescribeResponse(RtspStandbySession& standby, int resultCode,
+                                                     char* resultString)
+{
+    MediaSession* mediaSession =
+        resultCode == 0 ? MediaSession::createNew(*_env, resultString) : nullptr;
+    delete[] resultString;
+
+    if (!mediaSession || !mediaSession->hasSubsessions())
+    {
+        Medium::close(mediaSession);
+        RetryStandby(standby);
+        return;
+    }
+
+    standby.rtsp->mediaSession = mediaSession;
+    standby.rtsp->iter = new MediaSubsessionIterator(*mediaSession);
+    standby.numSubsessions = 0;
+
+    SetupStandbySubsession(standby);
+}
+
+void RtspSourceFilter::SetupStandbySubsession(RtspStandbySession& standby)
+{
+    RtspClient* rtsp = standby.rtsp;
+    MediaSubsession* subsession;
+    // Skip unsupported subsessions and these we couldn't initiate
+    while ((subsession = rtsp->iter->next()) != nullptr)
+    {
+        if (IsSubsessionSupported(*subsession) && subsession->initiate())
+            break;
+    }
+    rtsp->subsession = subsession;
+
+    if (subsession != nullptr)
+    {
+        ProxyMediaSink::ConfigureRtpSource(*_env, *subsession);
+        rtsp->sendSetupCommand(*subsession, HandleStandbySetupResponse, False, _streamOverTcp,
+                               forceMulticastOnUnspecified && !_streamOverTcp, &_authenticator);
+        return;
     }
 
-    const DWORD MS_VC_EXCEPTION = 0x406D1388;
+    delete rtsp->iter;
+    rtsp->iter = nullptr;
 
-#pragma pack(push, 8)
-    typedef struct tagTHREADNAME_INFO
+    if (standby.numSubsessions == 0)
     {
-        DWORD dwType;     // Must be 0x1000.
-        LPCSTR szName;    // Pointer to name (in user addr space).
-        DWORD dwThreadID; // Thread ID (-1=caller thread).
-        DWORD dwFlags;    // Reserved for future use, must be zero.
-    } THREADNAME_INFO;
-#pragma pack(pop)
+        RetryStandby(standby);
+        return;
+    }
 
-    void SetThreadName(DWORD dwThreadID, char* threadName)
+    if (standby.prePlay)
     {
-        THREADNAME_INFO info = {0x1000, threadName, dwThreadID, 0};
+        // Live streams only - no seeking
+        rtsp->sendPlayCommand(*rtsp->mediaSession, HandleStandbyPlayResponse, 0.0, -1.0, 1.0f,
+                              &_authenticator);
+        return;
+    }
 
-        __try
+    StandbyReady(standby);
+}
+
+void RtspSourceFilter::HandleStandbySetupResponse(RTSPClient* client, int resultCode,
+                                                  char* resultString)
+{
+    RtspClient* myClient = static_cast<RtspClient*>(client);
+    myClient->filter->HandleStandbySetupResponse(*myClient->standby, resultCode, resultString);
+}
+
+void RtspSourceFilter::HandleStandbySetupResponse(RtspStandbySession& standby, int resultCode,
+                                                  char* resultString)
+{
+    delete[] resultString;
+
+    if (resultCode == 0)
+    {
+        MediaSubsession* subsession = standby.rtsp->subsession;
+
+        // No queue yet - sink keeps its GOP cache warm until we switch to it
+        subsession->sink = CreateSink(*subsession, false);
+
+        if (subsession->sink != nullptr)
+        {
+            subsession->miscPtr = standby.rtsp;
+            subsession->sink->startPlaying(*(subsession->readSource()), HandleSubsessionFinished,
+                                           subsession);
+            if (subsession->rtcpInstance() != nullptr)
+                subsession->rtcpInstance()->setByeHandler(HandleSubsessionByeHandler, subsession);
+
+            ++standby.numSubsessions;
+        }
+    }
+
+    SetupStandbySubsession(standby);
+}
+
+void RtspSourceFilter::HandleStandbyPlayResponse(RTSPClient* client, int resultCode,
+                                                 char* resultString)
+{
+    RtspClient* myClient = static_cast<RtspClient*>(client);
+    delete[] resultString;
+
+    if (resultCode == 0)
+        myClient->filter->StandbyReady(*myClient->standby);
+    else
+        myClient->filter->RetryStandby(*myClient->standby);
+}
+
+void RtspSourceFilter::StandbyReady(RtspStandbySession& standby)
+{
+    if (!standby.ready)
+        DebugLog("Standby session ready: %s\n", standby.url.c_str());
+    standby.ready = true;
+
+    // Server would time out the session on us while we're waiting
+    unsigned sessionTimeout = standby.rtsp->sessionTimeoutParameter() != 0
+                                  ? standby.rtsp->sessionTimeoutParameter()
+                                  : 60;
+    standby.task = _scheduler->scheduleDelayedTask(
+        sessionTimeout / 3 * 1000000, &RtspSourceFilter::SendStandbyKeepAlive, &standby);
+}
+
+/*
+ * Task: RtspStandbySession::task
+ * Periodically sends OPTIONS command to keep the standby session alive.
+ */
+void RtspSourceFilter::SendStandbyKeepAlive(void* clientData)
+{
+    RtspStandbySession* standby = static_cast<RtspStandbySession*>(clientData);
+    standby->task = nullptr;
+    standby->rtsp->sendOptionsCommand(HandleStandbyKeepAliveResponse,
+                                      &standby->filter->_authenticator);
+}
+
+void RtspSourceFilter::HandleStandbyKeepAliveResponse(RTSPClient* client, int resultCode,
+                                                      char* resultString)
+{
+    RtspClient* myClient = static_cast<RtspClient*>(client);
+    delete[] resultString;
+
+    if (resultCode == 0)
+        myClient->filter->StandbyReady(*myClient->standby);
+    else
+        myClient->filter->RetryStandby(*myClient->standby);
+}
+
+void RtspSourceFilter::RetryStandby(RtspStandbySession& standby)
+{
+    DebugLog("Standby session failed, retrying: %s\n", standby.url.c_str());
+    CloseStandby(standby);
+    standby.task = _scheduler->scheduleDelayedTask(
+        standbyRetryTime * 1000, &RtspSourceFilter::OpenStandby, &standby);
+}
+
+void RtspSourceFilter::CloseStandby(RtspStandbySession& standby)
+{
+    standby.ready = false;
+    if (standby.task != nullptr)
+        _scheduler->unscheduleDelayedTask(standby.task);
+
+    RtspClient* rtsp = standby.rtsp;
+    if (!rtsp)
+        return;
+
+    delete rtsp->iter;
+    rtsp->iter = nullptr;
+    rtsp->subsession = nullptr;
+
+    if (rtsp->mediaSession != nullptr)
+    {
+        // Don't bother waiting for response
+        rtsp->sendTeardownCommand(*rtsp->mediaSession, nullptr, &_authenticator);
+        MediaSubsessionIterator iter(*rtsp->mediaSession);
+        MediaSubsession* subsession;
+        while ((subsession = iter.next()) != nullptr)
         {
-            RaiseException(MS_VC_EXCEPTION, 0, sizeof(info) / sizeof(ULONG_PTR), (ULONG_PTR*)&info);
+            Medium::close(subsession->sink);
+            subsession->sink = nullptr;
         }
-        __except(EXCEPTION_EXECUTE_HANDLER) {}
+        Medium::close(rtsp->mediaSession);
+        rtsp->mediaSession = nullptr;
+    }
+
+    Medium::close(rtsp);
+    standby.rtsp = nullptr;
+}
+
+void RtspSourceFilter::SwitchToStandby(const std::string& url)
+{
+    auto it = std::find_if(_standbySessions.begin(), _standbySessions.end(),
+                           [&url](const std::unique_ptr<RtspStandbySession>& standby)
+                           {
+                               return standby->url == url;
+                           });
+    if (it == _standbySessions.end() || !(*it)->ready)
+    {
+        ReplyRequest(_currentRequest, error::StandbyNotReady);
+        return;
+    }
+
+    RtspStandbySession& standby = **it;
+    MediaSubsession* videoSubsession = nullptr;
+    MediaSubsession* audioSubsession = nullptr;
+    MediaSubsessionIterator iter(*standby.rtsp->mediaSession);
+    MediaSubsession* subsession;
+    while ((subsession = iter.next()) != nullptr)
+    {
+        if (subsession->sink == nullptr)
+            continue;
+        if (!strcmp(subsession->mediumName(), "video"))
+            videoSubsession = subsession;
+        else if (!strcmp(subsession->mediumName(), "audio"))
+            audioSubsession = subsession;
+    }
+
+    // Pins can't change their media types on the fly
+    if (!videoSubsession != !_videoPin || !audioSubsession != !_audioPin)
+    {
+        ReplyRequest(_currentRequest, error::StandbyIncompatible);
+        return;
+    }
+
+    // Tear down the current session - what's left of it in the queues is flushed by the sinks
+    UnscheduleAllDelayedTasks();
+    CloseSession();
+    CloseClient();
+
+    // Adopt standby's client with its media session and running sinks
+    if (standby.task != nullptr)
+        _scheduler->unscheduleDelayedTask(standby.task);
+    _rtsp = standby.rtsp;
+    _rtsp->standby = nullptr;
+    _rtspUrl = standby.url;
+    const bool prePlayed = standby.prePlay;
+    _standbySessions.erase(it);
+
+    ProxyMediaConsumer consumer;
+    if (videoSubsession && GetMediaConsumer("video", consumer))
+    {
+        static_cast<ProxyMediaSink*>(videoSubsession->sink)->attach(consumer);
+        _videoPin->ResetMediaSubsession(videoSubsession);
+    }
+    if (audioSubsession && GetMediaConsumer("audio", consumer))
+    {
+        static_cast<ProxyMediaSink*>(audioSubsession->sink)->attach(consumer);
+        _audioPin->ResetMediaSubsession(audioSubsession);
+    }
+
+    if (prePlayed)
+    {
+        // Already streaming - buffered GOP is on its way to the pins
+        _sessionDuration = 0;
+        _endTime = -1.0;
+        ReplyRequest(_currentRequest, error::Success);
+        StartSessionTimers();
+    }
+    else
+    {
+        // State is still Playing - reply comes with PLAY response
+        Play();
+    }
+}
+
+namespace
+{
+    bool IsSubsessionSupported(MediaSubsession& mediaSubsession)
+    {
+        return FindRtpCodec(mediaSubsession) != nullptr;
+    }
+
+    bool ConvertUrl(LPCOLESTR url, std::string& out)
+    {
+        size_t converted;
+        errno_t err = wcstombs_s(&converted, nullptr, 0, url, 0);
+        if (err || converted == 0)
+            return false;
+        out.resize(converted);
+        wcstombs_s(&converted, const_cast<char*>(out.data()), out.size(), url, _TRUNCATE);
+        return true;
+    }
+
+    // To UTF-8 - file paths aren't limited to the code page like URLs
+    bool ConvertPath(LPCOLESTR path, std::string& out)
+    {
+        const int size = WideCharToMultiByte(CP_UTF8, 0, path, -1, nullptr, 0, nullptr, nullptr);
+        if (size <= 1)
+            return false;
+        out.resize(size);
+        WideCharToMultiByte(CP_UTF8, 0, path, -1, &out[0], size, nullptr, nullptr);
+        // Terminating null
+        out.resize(size - 1);
+        return true;
     }
 }
@@ -9,20 +9,50 @@
 #include <source.h>
 
 #include <string>
-#include <thread>
 #include <memory>
+#include <vector>
 
 #include "ConcurrentQueue.h"
+#include "FileRecorder.h"
 #include "RtspAsyncRequest.h"
-#include "MediaPacketSample.h"
+#include "RtspIngestEngine.h"
+#include "RtspLatencyHistogram.h"
+#include "MediaPacketQueue.h"
+#include "GopCache.h"
+#include "PlayoutDelay.h"
+#include "RtspRelay.h"
+#include "SessionClock.h"
+#include "StreamMetrics.h"
 #include "RtspSourceFilter.h"
 
 #include "Debug.h"
 
+class RtspSourceFilter;
+
+/**
+ * Pre-warmed session (see IRtspSourceConfig::AddStandbyUrl). Owned and driven by the filter
+ * on its ingest loop.
+ */
+struct RtspStandbySession
+{
+    RtspSourceFilter* filter;
+    std::string url;
+    bool prePlay;
+    // Set up (and playing if prePlay) - can be switched to
+    bool ready;
+    int numSubsessions;
+    class RtspClient* rtsp;
+    // Either retry or keep-alive
+    TaskToken task;
+};
+
 class RtspSourceFilter : public CSource,
                          public IFileSourceFilter,
                          public IAMFilterMiscFlags,
-                         public IRtspSourceConfig
+                         public IRtspSourceConfig,
+                         public IRtspSourceStatistics,
+                         private RtspIngestSession,
+                         private RtspRelayConsumer
 {
 public:
     static CUnknown* WINAPI CreateInstance(IUnknown* pUnk, HRESULT* phr);
@@ -53,6 +83,30 @@ public:
     STDMETHODIMP_(void) SetAutoReconnectionPeriod(DWORD dwMSecs);
     STDMETHODIMP_(void) SetLatency(DWORD dwMSecs);
     STDMETHODIMP_(void) SetSendLivenessCommand(BOOL sendLiveness);
+    STDMETHODIMP_(void) SetVideoQueueLimits(DWORD maxBytes, DWORD maxFrames,
+                                            RtspQueueOverflowPolicy policy);
+    STDMETHODIMP_(void) SetAudioQueueLimits(DWORD maxBytes, DWORD maxFrames,
+                                            RtspQueueOverflowPolicy policy);
+    STDMETHODIMP AddStandbyUrl(LPCOLESTR url, BOOL prePlay);
+    STDMETHODIMP RemoveStandbyUrl(LPCOLESTR url);
+    STDMETHODIMP SwitchUrl(LPCOLESTR url);
+    STDMETHODIMP_(void) SetGopCacheLimits(DWORD maxBytes, DWORD maxFrames);
+    STDMETHODIMP_(void) SetAccessUnitAssembly(BOOL assemble);
+    STDMETHODIMP_(void) SetAdaptiveLatency(DWORD minMSecs, DWORD maxMSecs);
+    STDMETHODIMP_(void) SetRelayMode(BOOL relay);
+    STDMETHODIMP StartRecording(LPCOLESTR pathPrefix, DWORD segmentMBytes, DWORD segmentSecs);
+    STDMETHODIMP_(void) StopRecording();
+
+    // IRtspSourceStatistics
+    STDMETHODIMP GetVideoQueueStats(RtspMediaQueueStats* stats);
+    STDMETHODIMP GetAudioQueueStats(RtspMediaQueueStats* stats);
+    STDMETHODIMP GetRequestLatencyStats(RtspRequestLatencyStats* stats);
+    STDMETHODIMP GetGopCacheStats(RtspGopCacheStats* stats);
+    STDMETHODIMP GetPlayoutDelayStats(RtspPlayoutDelayStats* stats);
+    STDMETHODIMP GetVideoStreamStats(RtspStreamStats* stats);
+    STDMETHODIMP GetAudioStreamStats(RtspStreamStats* stats);
+    STDMETHODIMP GetVideoRecordingStats(RtspRecordingStats* stats);
+    STDMETHODIMP GetAudioRecordingStats(RtspRecordingStats* stats);
 
     DECLARE_IUNKNOWN
 
@@ -67,8 +121,12 @@ private:
     RtspAsyncResult AsyncPlay();
     RtspAsyncResult AsyncShutdown();
     RtspAsyncResult AsyncReconnect();
+    RtspAsyncResult AsyncDone();
 
-    RtspAsyncResult MakeRequest(RtspAsyncRequest::Type request, const std::string& requestData);
+    RtspAsyncResult MakeRequest(RtspAsyncRequest::Type request, const std::string& requestData,
+                                unsigned requestFlags = 0);
+    void ProcessRequest(RtspAsyncRequest& req);
+    void ReplyRequest(RtspAsyncRequest& req, RtspResult ec);
 
     void OpenUrl(const std::string& url);
     void Play();
@@ -80,6 +138,23 @@ private:
     bool ScheduleNextReconnect();
     void DescribeRequestTimeout();
     void UnscheduleAllDelayedTasks();
+    void StartSessionTimers();
+    // Sink delivering to the queue of its medium, or to none yet (standby)
+    MediaSink* CreateSink(MediaSubsession& subsession, bool consume);
+    void CreatePin(MediaSubsession& subsession);
+    // Queue and counters of given medium, false if we don't take it
+    bool GetMediaConsumer(const char* mediumName, ProxyMediaConsumer& consumer);
+
+    // Standby sessions
+    void AddStandby(const std::string& url, bool prePlay);
+    void RemoveStandby(const std::string& url);
+    void CloseAllStandbySessions();
+    void OpenStandby(RtspStandbySession& standby);
+    void SetupStandbySubsession(RtspStandbySession& standby);
+    void StandbyReady(RtspStandbySession& standby);
+    void RetryStandby(RtspStandbySession& standby);
+    void CloseStandby(RtspStandbySession& standby);
+    void SwitchToStandby(const std::string& url);
 
     // Thin proxies for real handlers
     static void HandleOptionsResponse_Liveness(RTSPClient* client, int resultCode, char* resultString);
@@ -98,6 +173,12 @@ private:
     static void DescribeRequestTimeout(void* clientData);
     static void SendLivenessCommand(void* clientData);
     static void HandleMediaEnded(void* clientData);
+    static void HandleStandbyDescribeResponse(RTSPClient* client, int resultCode, char* resultString);
+    static void HandleStandbySetupResponse(RTSPClient* client, int resultCode, char* resultString);
+    static void HandleStandbyPlayResponse(RTSPClient* client, int resultCode, char* resultString);
+    static void HandleStandbyKeepAliveResponse(RTSPClient* client, int resultCode, char* resultString);
+    static void OpenStandby(void* clientData);
+    static void SendStandbyKeepAlive(void* clientData);
 
     // "Real" handlers
     void HandleOptionsResponse_Liveness(int resultCode, char* resultString);
@@ -105,21 +186,46 @@ private:
     void HandleSetupResponse(int resultCode, char* resultString);
     void HandlePlayResponse(int resultCode, char* resultString);
     void CheckInterPacketGaps();
+    void HandleStandbyDescribeResponse(RtspStandbySession& standby, int resultCode,
+                                       char* resultString);
+    void HandleStandbySetupResponse(RtspStandbySession& standby, int resultCode,
+                                    char* resultString);
+
+    // RtspIngestSession - called from the ingest loop thread
+    void ProcessRequests() override;
 
-    void WorkerThread();
+    // RtspRelayConsumer - called from the relay's ingest loop thread
+    void RelaySetUp(MediaSession& mediaSession) override;
+    bool RelayOutput(const char* mediumName, ProxyMediaConsumer& output) override;
 
 private:
     std::unique_ptr<RtspSourcePin> _videoPin;
     std::unique_ptr<RtspSourcePin> _audioPin;
     MediaPacketQueue _videoMediaQueue;
     MediaPacketQueue _audioMediaQueue;
+    StreamMetrics _videoMetrics;
+    StreamMetrics _audioMetrics;
+    // Recording taps of the streams - idle unless started
+    FileRecorder _videoRecorder;
+    FileRecorder _audioRecorder;
 
     bool _streamOverTcp;
     uint16_t _tunnelOverHttpPort;
     unsigned _autoReconnectionMSecs;
     std::mutex _criticalSection;
     uint32_t _latencyMSecs;
+    uint32_t _minLatencyMSecs;
+    uint32_t _maxLatencyMSecs;
+    PlayoutDelay _playoutDelay;
+    SessionClock _sessionClock;
     bool _sendLivenessCommand;
+    size_t _gopCacheMaxBytes;
+    size_t _gopCacheMaxFrames;
+    GopCacheCounters _gopCacheCounters;
+    bool _assembleAccessUnits;
+    bool _relayMode;
+    // Session we take samples from in relay mode - we don't run one of our own then
+    std::shared_ptr<RtspRelay> _relay;
 
     // live555 stuff
     enum class State
@@ -132,12 +238,11 @@ private:
     };
     State _state;
 
-    struct env_deleter
-    {
-        void operator()(MyUsageEnvironment* ptr) const { ptr->reclaim(); }
-    };
-    std::unique_ptr<BasicTaskScheduler0> _scheduler;
-    std::unique_ptr<MyUsageEnvironment, env_deleter> _env;
+    // Ingest loop hosting this session - owns scheduler and environment
+    std::shared_ptr<RtspIngestEngine> _ingestEngine;
+    RtspIngestLoop* _ingestLoop;
+    TaskScheduler* _scheduler;
+    UsageEnvironment* _env;
 
     Authenticator _authenticator;
     std::string _rtspUrl;
@@ -159,9 +264,14 @@ private:
 
     ConcurrentQueue<RtspAsyncRequest> _requestQueue;
     RtspAsyncRequest _currentRequest;
-    std::thread _workerThread;
+    RtspLatencyHistogram _requestLatency;
+
+    // Touched only from the ingest loop thread
+    std::vector<std::unique_ptr<RtspStandbySession>> _standbySessions;
 };
 
+class ParameterSetTracker;
+
 class RtspSourcePin : public CSourceStream
 {
 public:
@@ -192,17 +302,23 @@ protected:
 
 private:
     HRESULT InitializeMediaType();
-    REFERENCE_TIME SynchronizeTimestamp(const MediaPacketSample& mediaSample);
+    REFERENCE_TIME SynchronizeTimestamp(const MediaPacketSample& mediaSample,
+                                        REFERENCE_TIME streamTime);
+    // Attaches media type built from new parameter sets to the sample if downstream accepts it
+    void ChangeMediaType(IMediaSample* pSample);
 
 private:
     MediaSubsession* _mediaSubsession;
     MediaPacketQueue& _mediaPacketQueue;
+    // Written by streaming thread on format change
     CMediaType _mediaType;
+    CCritSec _mediaTypeLock;
     DWORD _codecFourCC;
+    // H.264 only - spots in-band SPS changes
+    std::unique_ptr<ParameterSetTracker> _parameterSetTracker;
 
+    PlayoutDelay::Stream _stream;
     REFERENCE_TIME _currentPlayTime;
-    REFERENCE_TIME _rtpPresentationTimeBaseline;
     REFERENCE_TIME _streamTimeBaseline;
     bool _firstSample;
-    bool _rtcpSynced;
 };
\ No newline at end of file
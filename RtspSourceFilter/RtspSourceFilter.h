@@ -3,6 +3,154 @@
 #include <cstdint>
 #include <Windows.h>
 
+/**
+ * What happens when media queue reaches its limits (see IRtspSourceConfig::Set*QueueLimits)
+ */
+enum RtspQueueOverflowPolicy
+{
+    // Stall RTSP worker thread until output pin catches up
+    RtspQueueBlock = 0,
+    // Discard the oldest packets
+    RtspQueueDropOldest = 1,
+    // Discard everything up to the next sync point (IDR frame for video)
+    RtspQueueDropUntilIdr = 2
+};
+
+/**
+ * Snapshot of media queue state and its latency protection counters
+ */
+struct RtspMediaQueueStats
+{
+    ULONGLONG droppedFrames;
+    ULONGLONG droppedBytes;
+    // How many times queue limits were hit
+    ULONGLONG overflowEvents;
+    DWORD queuedFrames;
+    DWORD queuedBytes;
+};
+
+/**
+ * GOP cache effectiveness (see IRtspSourceConfig::SetGopCacheLimits)
+ */
+struct RtspGopCacheStats
+{
+    // Video output started from a cached GOP
+    ULONGLONG hits;
+    // Video output had to wait for the next sync point
+    ULONGLONG misses;
+    DWORD cachedFrames;
+    DWORD cachedBytes;
+};
+
+#define RTSP_REQUEST_LATENCY_BUCKETS 16
+
+/**
+ * Control-plane latency - time from submitting a request (open, play, stop, reconnect)
+ * to the state transition that answers it. Bucket 0 counts requests answered within 1 ms,
+ * bucket i within [2^(i-1), 2^i) ms, the last one everything slower.
+ */
+struct RtspRequestLatencyStats
+{
+    ULONGLONG numRequests;
+    ULONGLONG totalMicroseconds;
+    ULONGLONG maxMicroseconds;
+    ULONGLONG buckets[RTSP_REQUEST_LATENCY_BUCKETS];
+};
+
+/**
+ * Playout delay (see IRtspSourceConfig::SetAdaptiveLatency) - the one in effect, the one it's
+ * heading to and what it's based on. Late samples are those that reached an output pin past
+ * their presentation time while running.
+ */
+struct RtspPlayoutDelayStats
+{
+    DWORD delayMicroseconds;
+    DWORD targetMicroseconds;
+    DWORD videoJitterMicroseconds;
+    DWORD audioJitterMicroseconds;
+    ULONGLONG lateSamples;
+};
+
+#define RTSP_STREAM_LATENCY_BUCKETS 96
+
+/**
+ * Latency histogram of a media stream with buckets of about the same relative width (like
+ * HdrHistogram). Bucket i < 4 counts latencies of i microseconds. Above that every power of two
+ * 2^e (e >= 2) is split in four: bucket 4 + 4 * (e - 2) + s counts [2^e + s * 2^(e-2),
+ * 2^e + (s + 1) * 2^(e-2)) microseconds. The last bucket takes everything slower (~33 s).
+ */
+struct RtspStreamLatencyStats
+{
+    ULONGLONG count;
+    ULONGLONG totalMicroseconds;
+    ULONGLONG maxMicroseconds;
+    ULONGLONG buckets[RTSP_STREAM_LATENCY_BUCKETS];
+};
+
+/**
+ * Metrics of a media stream (video or audio subsession) - they add up across sessions
+ * (reconnects, switching URLs). Latencies are measured from reading the RTP packet (the first
+ * one of a frame) off the network.
+ */
+struct RtspStreamStats
+{
+    ULONGLONG packetsReceived;
+    // Packets expected (by RTP sequence numbers) but not received
+    ULONGLONG packetsLost;
+    // RTP payload
+    ULONGLONG bytesReceived;
+    // Frames handed to the media queue
+    ULONGLONG framesQueued;
+    // Frames not fitting into the receive buffer - they're dropped
+    ULONGLONG truncatedFrames;
+    ULONGLONG truncatedBytes;
+    // Frames dropped by the depacketizer because some of their fragments (f.e. H.264 FU-A)
+    // were lost
+    ULONGLONG fragmentedFramesLost;
+    // RTP payload over the last second or so
+    DWORD bitsPerSecond;
+    // RFC 3550 interarrival jitter
+    DWORD jitterMicroseconds;
+    DWORD queuedFrames;
+    DWORD queuedBytes;
+    // Time packets were held back by the reordering buffer
+    RtspStreamLatencyStats reorderWait;
+    // Network to media queue (reordering, reassembly of frames and access units)
+    RtspStreamLatencyStats receiveToQueue;
+    // Media queue to output pin (FillBuffer)
+    RtspStreamLatencyStats queueToPin;
+    // Network to output pin
+    RtspStreamLatencyStats endToEnd;
+};
+
+/**
+ * Recording of a media stream (see IRtspSourceConfig::StartRecording) - counters add up across
+ * recordings
+ */
+struct RtspRecordingStats
+{
+    // Samples (and bytes) written to files
+    ULONGLONG recordedFrames;
+    ULONGLONG recordedBytes;
+    // Samples the writer didn't keep up with - dropped up to the next sync point
+    ULONGLONG droppedFrames;
+    ULONGLONG droppedBytes;
+    // How many times the writer fell behind that much
+    ULONGLONG overflowEvents;
+    // Samples passed over waiting for a sync point to start a file from
+    ULONGLONG skippedFrames;
+    // Files that couldn't be created, preallocated or written to
+    ULONGLONG writeErrors;
+    // Files started
+    DWORD segments;
+    // Samples waiting for the writer
+    DWORD queuedFrames;
+    DWORD queuedBytes;
+    // Longest time the disk took to take a write (or to preallocate a file)
+    DWORD maxWriteMicroseconds;
+    BOOL recording;
+};
+
 MIDL_INTERFACE("C4D310F4-160D-408D-9A60-3C6275E2D3B2")
 IRtspSourceConfig : public IUnknown
 {
@@ -12,4 +160,58 @@ IRtspSourceConfig : public IUnknown
     STDMETHOD_(void, SetAutoReconnectionPeriod(DWORD dwMSecs)) = 0;
     STDMETHOD_(void, SetLatency(DWORD dwMSecs)) = 0;
     STDMETHOD_(void, SetSendLivenessCommand(BOOL sendLiveness)) = 0;
-};
\ No newline at end of file
+    // Limits of 0 mean no limit
+    STDMETHOD_(void, SetVideoQueueLimits(DWORD maxBytes, DWORD maxFrames,
+                                         RtspQueueOverflowPolicy policy)) = 0;
+    STDMETHOD_(void, SetAudioQueueLimits(DWORD maxBytes, DWORD maxFrames,
+                                         RtspQueueOverflowPolicy policy)) = 0;
+    // Keep a session for given URL described and set up in the background (also playing with
+    // the last GOP buffered if prePlay is set) so SwitchUrl() to it is nearly instant
+    STDMETHOD(AddStandbyUrl(LPCOLESTR url, BOOL prePlay)) = 0;
+    STDMETHOD(RemoveStandbyUrl(LPCOLESTR url)) = 0;
+    // Replace playing session with the standby one for given URL. Fails if the standby isn't
+    // ready yet or its media don't match the output pins.
+    STDMETHOD(SwitchUrl(LPCOLESTR url)) = 0;
+    // Video frames since the most recent IDR are cached so that output can start (or resume
+    // after a switch) from a complete GOP. GOP over the limits isn't cached, maxBytes of 0
+    // disables caching. Takes effect with the next session set up.
+    STDMETHOD_(void, SetGopCacheLimits(DWORD maxBytes, DWORD maxFrames)) = 0;
+    // Deliver whole access units (all NAL units of a picture in one media sample, start codes
+    // in between) of H.264/H.265 video instead of a sample per NAL unit. Audio frames are
+    // delivered whole anyway. Call before Load() - output buffers are sized for it.
+    STDMETHOD_(void, SetAccessUnitAssembly(BOOL assemble)) = 0;
+    // Let latency adapt to network jitter within given bounds, starting from SetLatency() one.
+    // Equal bounds (default) keep it fixed. Takes effect when the graph starts.
+    STDMETHOD_(void, SetAdaptiveLatency(DWORD minMSecs, DWORD maxMSecs)) = 0;
+    // Share the RTSP session with other filters of the process pulling the same URL over the
+    // same transport (and assembling access units alike) - the camera streams once, whatever
+    // the number of filters. Each filter has its own media queues, latency and statistics.
+    // The session is set up with the settings of the filter opening it. Standby URLs and
+    // seeking aren't available. A queue blocking on overflow holds up every filter of the
+    // session. Call before Load().
+    STDMETHOD_(void, SetRelayMode(BOOL relay)) = 0;
+    // Record video and audio as delivered to the output pins, to <pathPrefix>-video-00001.h264
+    // (or .h265), <pathPrefix>-audio-00001.<codec> and so on - video as Annex B byte stream,
+    // audio frames as they come. Each stream is written by a thread of its own through large
+    // write-behind buffers into preallocated files, so a slow disk never holds up reception -
+    // samples it can't keep up with are dropped up to the next sync point (see
+    // Get*RecordingStats). Next file is started on a sync point once the current one reaches
+    // segmentMBytes or segmentSecs (0 for no limit). Restarts recording if it's on already.
+    STDMETHOD(StartRecording(LPCOLESTR pathPrefix, DWORD segmentMBytes, DWORD segmentSecs)) = 0;
+    // Writes out whatever is still queued and closes the files
+    STDMETHOD_(void, StopRecording()) = 0;
+};
+
+MIDL_INTERFACE("9300B99C-8BA0-4395-B619-988FA8B208B9")
+IRtspSourceStatistics : public IUnknown
+{
+    STDMETHOD(GetVideoQueueStats(RtspMediaQueueStats* stats)) = 0;
+    STDMETHOD(GetAudioQueueStats(RtspMediaQueueStats* stats)) = 0;
+    STDMETHOD(GetRequestLatencyStats(RtspRequestLatencyStats* stats)) = 0;
+    STDMETHOD(GetGopCacheStats(RtspGopCacheStats* stats)) = 0;
+    STDMETHOD(GetPlayoutDelayStats(RtspPlayoutDelayStats* stats)) = 0;
+    STDMETHOD(GetVideoStreamStats(RtspStreamStats* stats)) = 0;
+    STDMETHOD(GetAudioStreamStats(RtspStreamStats* stats)) = 0;
+    STDMETHOD(GetVideoRecordingStats(RtspRecordingStats* stats)) = 0;
+    STDMETHOD(GetAudioRecordingStats(RtspRecordingStats* stats)) = 0;
+};
@@ -1,7 +1,11 @@
 #include "RtspSource.h"
-#include "MediaPacketSample.h"
-#include "ConcurrentQueue.h"
+#include "MediaPacketQueue.h"
 #include "H264StreamParser.h"
+#include "H265StreamParser.h"
+#include "ParameterSetTracker.h"
+#include "SPropParameterSets.h"
+#include "CodecRegistry.h"
+#include "NALUnitScanner.hh"
 #include "Debug.h"
 
 #include <Windows.h>
@@ -12,6 +16,8 @@
 
 // Uncomment this to use H.264 without starting codes (AVC1 FOURCC)
 //#define H264_USE_AVC1
+// Uncomment this to use H.265 without starting codes (HVC1 FOURCC)
+//#define H265_USE_HVC1
 
 namespace
 {
@@ -19,12 +25,42 @@ namespace
     const int lengthFieldSize = 4;
     const int startCodesSize = 4;
 
-    HRESULT GetMediaTypeH264(CMediaType& mediaType, MediaSubsession& mediaSubsession);
-    HRESULT GetMediaTypeAVC1(CMediaType& mediaType, MediaSubsession& mediaSubsession);
-    HRESULT GetMediaTypeAAC(CMediaType& mediaType, MediaSubsession& mediaSubsession);
+    // Not defined in older SDKs
+    // {43564548-0000-0010-8000-00AA00389B71}
+    const GUID mediaSubtypeHEVC = {
+        0x43564548, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71}};
+    // {31435648-0000-0010-8000-00AA00389B71}
+    const GUID mediaSubtypeHVC1 = {
+        0x31435648, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71}};
+    // {00000007-0000-0010-8000-00AA00389B71}
+    const GUID mediaSubtypeMulaw = {
+        WAVE_FORMAT_MULAW, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71}};
+    // {00000006-0000-0010-8000-00AA00389B71}
+    const GUID mediaSubtypeAlaw = {
+        WAVE_FORMAT_ALAW, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71}};
+    // Opus as LAV Audio takes it
+    const WORD waveFormatOpus = 0x704F;
+    // {7375704F-0000-0010-8000-00AA00389B71}
+    const GUID mediaSubtypeOpus = {
+        0x7375704F, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71}};
+    // Registered for AC-3 (WAVE_FORMAT_DVM), what most splitters put into AC-3 media types
+    const WORD waveFormatAc3 = 0x2000;
+    // Opus RTP clock rate and channels are fixed regardless of what the stream carries
+    const DWORD opusSampleRate = 48000;
+    const WORD opusChannels = 2;
+
+    // Builds H.264 or H.265 media type for given output format
+    HRESULT GetMediaTypeVideo(CMediaType& mediaType, const ParameterSets& parameterSets,
+                              DWORD codecFourCC);
+    // Access unit with 4-byte start codes to one with 4-byte length fields
+    void StartCodesToLengthFields(uint8_t* accessUnit, size_t size);
+    // Raw AAC frames (LATM ones come de-muxed)
+    HRESULT GetMediaTypeAAC(CMediaType& mediaType, const std::vector<uint8_t>& audioSpecificConfig);
     HRESULT GetMediaTypeAC3(CMediaType& mediaType, MediaSubsession& mediaSubsession);
-
-    bool IsIdrFrame(const MediaPacketSample& mediaPacket);
+    // G.711 u-law or A-law
+    HRESULT GetMediaTypeG711(CMediaType& mediaType, MediaSubsession& mediaSubsession,
+                             WORD formatTag, const GUID& subtype);
+    HRESULT GetMediaTypeOpus(CMediaType& mediaType);
 }
 
 RtspSourcePin::RtspSourcePin(HRESULT* phr, CSource* pFilter, MediaSubsession* mediaSubsession,
@@ -34,11 +70,11 @@ RtspSourcePin::RtspSourcePin(HRESULT* phr, CSource* pFilter, MediaSubsession* me
     , _mediaSubsession(mediaSubsession)
     , _mediaPacketQueue(mediaPacketQueue)
     , _codecFourCC(0)
+    , _stream(!strcmp(mediaSubsession->mediumName(), "video") ? PlayoutDelay::StreamVideo
+                                                              : PlayoutDelay::StreamAudio)
     , _currentPlayTime(0)
-    , _rtpPresentationTimeBaseline(0)
     , _streamTimeBaseline(0)
     , _firstSample(true)
-    , _rtcpSynced(false)
 {
     _ASSERT(dynamic_cast<RtspSourceFilter*>(m_pFilter));
     HRESULT hr = InitializeMediaType();
@@ -71,40 +107,31 @@ void RtspSourcePin::ResetTimeBaselines()
 {
     // Desynchronize with RTP timestamps
     _firstSample = true;
-    _rtcpSynced = false;
-    _rtpPresentationTimeBaseline = 0;
     _streamTimeBaseline = 0;
     _currentPlayTime = 0;
+    static_cast<RtspSourceFilter*>(m_pFilter)->_sessionClock.restart(_stream);
 }
 
-REFERENCE_TIME RtspSourcePin::SynchronizeTimestamp(const MediaPacketSample& mediaSample)
+REFERENCE_TIME RtspSourcePin::SynchronizeTimestamp(const MediaPacketSample& mediaSample,
+                                                  REFERENCE_TIME streamTime)
 {
-    auto SyncWithMediaSample = [this](const MediaPacketSample& mediaSample)
-    {
-        CRefTime streamTime;
-        m_pFilter->StreamTime(streamTime);
-        uint32_t latencyMSecs = static_cast<RtspSourceFilter*>(m_pFilter)->_latencyMSecs;
-        _streamTimeBaseline = streamTime.GetUnits() + latencyMSecs * 10000i64;
-        _rtpPresentationTimeBaseline = mediaSample.timestamp();
-    };
-
     if (_firstSample)
     {
-        SyncWithMediaSample(mediaSample);
-
+        _streamTimeBaseline = streamTime;
         _firstSample = false;
-        // If we're lucky the first sample is also synced using RTCP
-        _rtcpSynced = mediaSample.isRtcpSynced();
-    }
-    // First sample wasn't RTCP sync'ed, try the next time
-    else if (!_rtcpSynced)
-    {
-        _rtcpSynced = mediaSample.isRtcpSynced();
-        if (_rtcpSynced)
-            SyncWithMediaSample(mediaSample);
     }
 
-    return mediaSample.timestamp() - _rtpPresentationTimeBaseline + _streamTimeBaseline;
+    // When the sample arrived in stream time - the session clock tells the sender's clock rate
+    // by it, time spent in the queue aside
+    const auto queued = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - mediaSample.arrivalTime());
+    const REFERENCE_TIME arrivalTime = streamTime - queued.count() * 10;
+
+    // Session clock and playout delay are shared with the other pin - it's how they stay in sync
+    RtspSourceFilter* filter = static_cast<RtspSourceFilter*>(m_pFilter);
+    REFERENCE_TIME timestamp = filter->_sessionClock.toStreamTime(
+        _stream, mediaSample.timestamp(), mediaSample.isRtcpSynced(), streamTime, arrivalTime);
+    return timestamp + filter->_playoutDelay.delay(streamTime);
 }
 
 HRESULT RtspSourcePin::FillBuffer(IMediaSample* pSample)
@@ -117,15 +144,41 @@ HRESULT RtspSourcePin::FillBuffer(IMediaSample* pSample)
         return S_FALSE;
     }
 
+    RtspSourceFilter* filter = static_cast<RtspSourceFilter*>(m_pFilter);
+    StreamMetrics& metrics =
+        _stream == PlayoutDelay::StreamVideo ? filter->_videoMetrics : filter->_audioMetrics;
+    const auto now = std::chrono::steady_clock::now();
+    metrics.queueToPin.record(
+        std::chrono::duration_cast<std::chrono::microseconds>(now - mediaSample.queuedTime()));
+    metrics.endToEnd.record(
+        std::chrono::duration_cast<std::chrono::microseconds>(now - mediaSample.arrivalTime()));
+
+    // Samples from a different session follow - start over with timestamps
+    if (mediaSample.isDiscontinuity())
+    {
+        ResetTimeBaselines();
+        pSample->SetDiscontinuity(TRUE);
+    }
+
+    // New SPS in effect - the camera could have changed resolution
+    if (_parameterSetTracker &&
+        (mediaSample.isAccessUnit()
+             ? _parameterSetTracker->UpdateAccessUnit(mediaSample.data(), mediaSample.size())
+             : _parameterSetTracker->Update(mediaSample.data(), mediaSample.size())))
+    {
+        ChangeMediaType(pSample);
+    }
+
     BYTE* pData;
     HRESULT hr = pSample->GetPointer(&pData);
     if (FAILED(hr))
         return hr;
+    BYTE* pBegin = pData;
     long length = pSample->GetSize();
 
-    if (_codecFourCC == DWORD('h264'))
+    if (_codecFourCC == DWORD('h264') || _codecFourCC == DWORD('hevc'))
     {
-        // Append SPS and PPS to the first packet (they come out-band)
+        // Append parameter sets to the first packet (they come out-band)
         if (_firstSample)
         {
             // Retrieve them from media type format buffer
@@ -137,28 +190,43 @@ HRESULT RtspSourcePin::FillBuffer(IMediaSample* pSample)
         }
 
         // Append 4-byte start code 00 00 00 01 in network byte order that precedes each NALU
-        ((uint32_t*)pData)[0] = 0x01000000;
-        pData += startCodesSize;
-        length -= startCodesSize;
+        // (access units have them already)
+        if (!mediaSample.isAccessUnit())
+        {
+            ((uint32_t*)pData)[0] = 0x01000000;
+            pData += startCodesSize;
+            length -= startCodesSize;
+        }
         // Finally copy media packet contens to IMediaSample
         memcpy_s(pData, length, mediaSample.data(), mediaSample.size());
-        pSample->SetActualDataLength(mediaSample.size() + startCodesSize);
-        pSample->SetSyncPoint(IsIdrFrame(mediaSample));
+        pData += mediaSample.size();
+        pSample->SetActualDataLength(static_cast<long>(pData - pBegin));
+        pSample->SetSyncPoint(mediaSample.isSyncPoint());
     }
-    else if (_codecFourCC == DWORD('avc1'))
+    else if (_codecFourCC == DWORD('avc1') || _codecFourCC == DWORD('hvc1'))
     {
-        // Append 4-byte length field (network byte order) that precedes each NALU
-        uint32_t lengthField = static_cast<uint32_t>(mediaSample.size());
-        pData[0] = ((uint8_t*)&lengthField)[3];
-        pData[1] = ((uint8_t*)&lengthField)[2];
-        pData[2] = ((uint8_t*)&lengthField)[1];
-        pData[3] = ((uint8_t*)&lengthField)[0];
-        pData += lengthFieldSize;
-        length -= lengthFieldSize;
-        // Finally copy media packet contens to IMediaSample
-        memcpy_s(pData, length, mediaSample.data(), mediaSample.size());
-        pSample->SetActualDataLength(mediaSample.size() + lengthFieldSize);
-        pSample->SetSyncPoint(IsIdrFrame(mediaSample));
+        if (mediaSample.isAccessUnit())
+        {
+            // Start codes are of the same size as length fields - swap them in place
+            memcpy_s(pData, length, mediaSample.data(), mediaSample.size());
+            StartCodesToLengthFields(pData, mediaSample.size());
+            pSample->SetActualDataLength(static_cast<long>(mediaSample.size()));
+        }
+        else
+        {
+            // Append 4-byte length field (network byte order) that precedes each NALU
+            uint32_t lengthField = static_cast<uint32_t>(mediaSample.size());
+            pData[0] = ((uint8_t*)&lengthField)[3];
+            pData[1] = ((uint8_t*)&lengthField)[2];
+            pData[2] = ((uint8_t*)&lengthField)[1];
+            pData[3] = ((uint8_t*)&lengthField)[0];
+            pData += lengthFieldSize;
+            length -= lengthFieldSize;
+            // Finally copy media packet contens to IMediaSample
+            memcpy_s(pData, length, mediaSample.data(), mediaSample.size());
+            pSample->SetActualDataLength(mediaSample.size() + lengthFieldSize);
+        }
+        pSample->SetSyncPoint(mediaSample.isSyncPoint());
     }
     else
     {
@@ -168,14 +236,18 @@ HRESULT RtspSourcePin::FillBuffer(IMediaSample* pSample)
         pSample->SetSyncPoint(FALSE);
     }
 
-    REFERENCE_TIME ts = SynchronizeTimestamp(mediaSample);
+    CRefTime streamTime;
+    m_pFilter->StreamTime(streamTime);
+    REFERENCE_TIME ts = SynchronizeTimestamp(mediaSample, streamTime.GetUnits());
     pSample->SetTime(&ts, NULL);
 
+    // Sample is due already - renderer is going to drop it or glitch. Stream time means
+    // nothing unless running.
+    if (ts < streamTime.GetUnits() && filter->m_State == State_Running)
+        filter->_playoutDelay.reportLate(streamTime.GetUnits() - ts);
+
     // Calculate current play time (does not include offset from initial time seek)
-    CRefTime streamTime;
-    m_pFilter->StreamTime(streamTime);
-    uint32_t latencyMSecs = static_cast<RtspSourceFilter*>(m_pFilter)->_latencyMSecs;
-    _currentPlayTime = streamTime.GetUnits() - (_streamTimeBaseline - latencyMSecs * 10000i64);
+    _currentPlayTime = streamTime.GetUnits() - _streamTimeBaseline;
 
     return S_OK;
 }
@@ -184,11 +256,40 @@ HRESULT RtspSourcePin::GetMediaType(CMediaType* pMediaType)
 {
     // We only support one MediaType - the one that is streamed
     CheckPointer(pMediaType, E_POINTER);
-    CAutoLock cAutoLock(m_pFilter->pStateLock());
+    CAutoLock cAutoLock(&_mediaTypeLock);
     FreeMediaType(*pMediaType);
     return CopyMediaType(pMediaType, &_mediaType);
 }
 
+void RtspSourcePin::ChangeMediaType(IMediaSample* pSample)
+{
+    ParameterSets parameterSets;
+    _parameterSetTracker->GetActiveParameterSets(parameterSets);
+
+    CMediaType mediaType;
+    HRESULT hr = GetMediaTypeVideo(mediaType, parameterSets, _codecFourCC);
+    // Nothing's changed as far as media type goes (f.e. SDP had the same parameter sets)
+    if (FAILED(hr) || mediaType == _mediaType)
+        return;
+
+    // Let the decoder reconfigure with the very sample new parameter sets apply to. If it
+    // can't, it's left with in-band parameter sets only - same as it used to be.
+    if (m_Connected && m_Connected->QueryAccept(&mediaType) == S_OK)
+    {
+        DebugLog("%S pin: Dynamic format change\n", m_pName);
+        pSample->SetMediaType(&mediaType);
+        m_mt = mediaType;
+    }
+    else
+    {
+        DebugLog("%S pin: Format change rejected by downstream filter\n", m_pName);
+    }
+
+    // Anyone (re)connecting from now on gets the new one
+    CAutoLock cAutoLock(&_mediaTypeLock);
+    _mediaType = mediaType;
+}
+
 HRESULT RtspSourcePin::DecideBufferSize(IMemAllocator* pAlloc, ALLOCATOR_PROPERTIES* pRequest)
 {
     CheckPointer(pAlloc, E_POINTER);
@@ -203,7 +304,10 @@ HRESULT RtspSourcePin::DecideBufferSize(IMemAllocator* pAlloc, ALLOCATOR_PROPERT
         // Ensure a minimum number of buffers
         if (pRequest->cBuffers == 0)
             pRequest->cBuffers = 10;
-        pRequest->cbBuffer = 256 * 1024; // Should be more than enough
+        // Should be more than enough for a NAL unit, whole access units can take more
+        pRequest->cbBuffer = static_cast<RtspSourceFilter*>(m_pFilter)->_assembleAccessUnits
+                                 ? 1024 * 1024
+                                 : 256 * 1024;
     }
     // Audio pin
     else
@@ -226,54 +330,134 @@ HRESULT RtspSourcePin::DecideBufferSize(IMemAllocator* pAlloc, ALLOCATOR_PROPERT
 
 HRESULT RtspSourcePin::InitializeMediaType()
 {
-    HRESULT hr = E_FAIL;
     _mediaType.InitMediaType();
 
-    if (!strcmp(_mediaSubsession->mediumName(), "video"))
+    const RtpCodecInfo* rtpCodec = FindRtpCodec(*_mediaSubsession);
+    if (!rtpCodec)
+        return E_FAIL;
+
+    switch (rtpCodec->codec)
     {
-        if (!strcmp(_mediaSubsession->codecName(), "H264"))
-        {
+    case RtpCodecH264:
 #if !defined(H264_USE_AVC1)
-            // h264 with start codes are "canonical" in network streaming
-            hr = GetMediaTypeH264(_mediaType, *_mediaSubsession);
-            _codecFourCC = DWORD('h264');
+        // h264 with start codes are "canonical" in network streaming
+        _codecFourCC = DWORD('h264');
 #else
-            hr = GetMediaTypeAVC1(_mediaType, _mediaSubsession);
-            _codecFourCC = DWORD('avc1');
+        _codecFourCC = DWORD('avc1');
 #endif
-        }
+        _parameterSetTracker.reset(new ParameterSetTracker(ParameterSetTracker::CodecH264));
+        return GetMediaTypeVideo(_mediaType, GetSPropParameterSets(*_mediaSubsession),
+                                 _codecFourCC);
+    case RtpCodecH265:
+#if !defined(H265_USE_HVC1)
+        _codecFourCC = DWORD('hevc');
+#else
+        _codecFourCC = DWORD('hvc1');
+#endif
+        _parameterSetTracker.reset(new ParameterSetTracker(ParameterSetTracker::CodecH265));
+        return GetMediaTypeVideo(_mediaType, GetSPropParameterSets(*_mediaSubsession),
+                                 _codecFourCC);
+    case RtpCodecAac:
+    case RtpCodecAacLatm:
+        _codecFourCC = DWORD('mp4a');
+        return GetMediaTypeAAC(_mediaType, GetAudioSpecificConfig(*_mediaSubsession));
+    case RtpCodecAc3:
+        _codecFourCC = DWORD('ac3');
+        return GetMediaTypeAC3(_mediaType, *_mediaSubsession);
+    case RtpCodecPcmu:
+        _codecFourCC = DWORD('ulaw');
+        return GetMediaTypeG711(_mediaType, *_mediaSubsession, WAVE_FORMAT_MULAW,
+                                mediaSubtypeMulaw);
+    case RtpCodecPcma:
+        _codecFourCC = DWORD('alaw');
+        return GetMediaTypeG711(_mediaType, *_mediaSubsession, WAVE_FORMAT_ALAW,
+                                mediaSubtypeAlaw);
+    case RtpCodecOpus:
+        _codecFourCC = DWORD('opus');
+        return GetMediaTypeOpus(_mediaType);
+    default:
+        return E_FAIL;
     }
-    else if (!strcmp(_mediaSubsession->mediumName(), "audio"))
+}
+
+namespace
+{
+    struct VideoInfo
+    {
+        VideoInfo() : width(0), height(0), framerate(0.0), profile(0), level(0) {}
+
+        unsigned width;
+        unsigned height;
+        double framerate;
+        unsigned profile;
+        unsigned level;
+    };
+
+    VideoInfo GetVideoInfoH264(const ParameterSets& parameterSets)
     {
-        if (!strcmp(_mediaSubsession->codecName(), "MPEG4-GENERIC"))
+        VideoInfo videoInfo;
+        for (auto& parameterSet : parameterSets)
         {
-            hr = GetMediaTypeAAC(_mediaType, *_mediaSubsession);
-            _codecFourCC = DWORD('mp4a');
+            // It's SPS (Sequence parameter set)
+            H264Sps sps;
+            if (H264NalType(parameterSet.data()) == H264NalSps &&
+                ParseH264Sps(parameterSet.data(), parameterSet.size(), sps))
+            {
+                videoInfo.width = sps.width;
+                videoInfo.height = sps.height;
+                videoInfo.framerate = sps.framerate;
+                videoInfo.profile = sps.profileIdc;
+                videoInfo.level = sps.levelIdc;
+            }
         }
-        else if (!strcmp(_mediaSubsession->codecName(), "AC3"))
+        return videoInfo;
+    }
+
+    VideoInfo GetVideoInfoH265(const ParameterSets& parameterSets)
+    {
+        VideoInfo videoInfo;
+        double vpsFramerate = 0.0;
+        for (auto& parameterSet : parameterSets)
         {
-            hr = GetMediaTypeAC3(_mediaType, *_mediaSubsession);
-            _codecFourCC = DWORD('ac3');
+            if (parameterSet.size() < 2)
+                continue;
+
+            H265Vps vps;
+            H265Sps sps;
+            const unsigned nalType = H265NalType(parameterSet.data());
+            if (nalType == H265NalVps &&
+                ParseH265Vps(parameterSet.data(), parameterSet.size(), vps) &&
+                vps.numUnitsInTick > 0)
+            {
+                vpsFramerate = static_cast<double>(vps.timeScale) / vps.numUnitsInTick;
+            }
+            else if (nalType == H265NalSps &&
+                     ParseH265Sps(parameterSet.data(), parameterSet.size(), sps))
+            {
+                videoInfo.width = sps.width;
+                videoInfo.height = sps.height;
+                videoInfo.framerate = sps.framerate;
+                videoInfo.profile = sps.profileTierLevel.profileIdc;
+                videoInfo.level = sps.profileTierLevel.levelIdc;
+            }
         }
+        // Timing info is allowed in VPS as well
+        if (videoInfo.framerate == 0.0)
+            videoInfo.framerate = vpsFramerate;
+        return videoInfo;
     }
 
-    return hr;
-}
-
-namespace
-{
-    HRESULT GetMediaTypeH264(CMediaType& mediaType, MediaSubsession& mediaSubsession)
+    HRESULT GetMediaTypeStartCodes(CMediaType& mediaType, const ParameterSets& parameterSets,
+                                   const VideoInfo& videoInfo, const GUID& subtype,
+                                   DWORD compression)
     {
-        // We need to extract SPS and PPS from SDP attribute and append it to VIDEOINFOHEADER2
-        // structure to be used later
+        // We need to append parameter sets (from SDP attribute or in-band ones) to
+        // VIDEOINFOHEADER2 structure to be used later
         // see: http://msdn.microsoft.com/en-us/library/dd757808%28v=vs.85%29.aspx, pg: H.264
         // Bitstream with Start Codes
-        unsigned numSPropRecords;
-        SPropRecord* sPropRecords = ::parseSPropParameterSets(
-            mediaSubsession.attrVal_str("sprop-parameter-sets"), numSPropRecords);
         size_t decoderSpecificSize = 0;
-        for (unsigned i = 0; i < numSPropRecords; ++i)
-            decoderSpecificSize += sPropRecords[i].sPropLength + startCodesSize;
+        for (auto& parameterSet : parameterSets)
+            decoderSpecificSize += parameterSet.size() + startCodesSize;
 
         // "Hide" decoder specific data in FormatBuffer
         VIDEOINFOHEADER2* pVid = (VIDEOINFOHEADER2*)mediaType.AllocFormatBuffer(
@@ -282,48 +466,33 @@ namespace
             return E_OUTOFMEMORY;
         ZeroMemory(pVid, sizeof(VIDEOINFOHEADER2) + decoderSpecificSize);
 
-        unsigned videoWidth = 0, videoHeight = 0;
-        double videoFramerate = 0.0;
-
         // Move decoder specific data after FormatBuffer
         BYTE* decoderSpecific = (BYTE*)(pVid + 1);
-        for (unsigned i = 0; i < numSPropRecords; ++i)
+        for (auto& parameterSet : parameterSets)
         {
-            SPropRecord& prop = sPropRecords[i];
-
-            // It's SPS (Sequence parameter set
-            if ((prop.sPropBytes[0] & 0x1F) == 7)
-            {
-                H264StreamParser h264StreamParser(prop.sPropBytes, prop.sPropLength);
-                videoWidth = h264StreamParser.GetWidth();
-                videoHeight = h264StreamParser.GetHeight();
-                videoFramerate = h264StreamParser.GetFramerate();
-            }
-
             ((uint32_t*)decoderSpecific)[0] = 0x01000000;
             decoderSpecific += 4;
 
-            memcpy(decoderSpecific, prop.sPropBytes, prop.sPropLength);
-            decoderSpecific += prop.sPropLength;
+            memcpy(decoderSpecific, parameterSet.data(), parameterSet.size());
+            decoderSpecific += parameterSet.size();
         }
 
-        delete[] sPropRecords;
-
-        SetRect(&pVid->rcSource, 0, 0, videoWidth, videoHeight);
-        SetRect(&pVid->rcTarget, 0, 0, videoWidth, videoHeight);
+        SetRect(&pVid->rcSource, 0, 0, videoInfo.width, videoInfo.height);
+        SetRect(&pVid->rcTarget, 0, 0, videoInfo.width, videoInfo.height);
 
-        REFERENCE_TIME timePerFrame =
-            std::abs(videoFramerate) > 1e-6 ? (REFERENCE_TIME)(UNITS / videoFramerate) : 0;
+        REFERENCE_TIME timePerFrame = std::abs(videoInfo.framerate) > 1e-6
+                                          ? (REFERENCE_TIME)(UNITS / videoInfo.framerate)
+                                          : 0;
         pVid->AvgTimePerFrame = timePerFrame;
 
         // BITMAPINFOHEADER
         pVid->bmiHeader.biSize = sizeof BITMAPINFOHEADER;
-        pVid->bmiHeader.biWidth = videoWidth;
-        pVid->bmiHeader.biHeight = videoHeight;
-        pVid->bmiHeader.biCompression = MAKEFOURCC('H', '2', '6', '4');
+        pVid->bmiHeader.biWidth = videoInfo.width;
+        pVid->bmiHeader.biHeight = videoInfo.height;
+        pVid->bmiHeader.biCompression = compression;
 
         mediaType.SetType(&MEDIATYPE_Video);
-        mediaType.SetSubtype(&MEDIASUBTYPE_H264);
+        mediaType.SetSubtype(&subtype);
         mediaType.SetFormatType(&FORMAT_VideoInfo2);
         mediaType.SetTemporalCompression(TRUE);
         mediaType.SetSampleSize(0);
@@ -331,18 +500,17 @@ namespace
         return S_OK;
     }
 
-    HRESULT GetMediaTypeAVC1(CMediaType& mediaType, MediaSubsession& mediaSubsession)
+    HRESULT GetMediaTypeLengthPrefixed(CMediaType& mediaType, const ParameterSets& parameterSets,
+                                       const VideoInfo& videoInfo, const GUID& subtype,
+                                       DWORD compression)
     {
-        // We need to extract SPS and PPS from SDP attribute and append it to MPEG2VIDEOINFO
-        // structure
+        // We need to append parameter sets (from SDP attribute or in-band ones) to
+        // MPEG2VIDEOINFO structure
         // see: http://msdn.microsoft.com/en-us/library/dd757808%28v=vs.85%29.aspx, pg: H.264
         // Bitstream Without Start Codes
-        unsigned numSPropRecords;
-        SPropRecord* sPropRecords = parseSPropParameterSets(
-            mediaSubsession.attrVal_str("sprop-parameter-sets"), numSPropRecords);
         size_t decoderSpecificSize = 0;
-        for (unsigned i = 0; i < numSPropRecords; ++i)
-            decoderSpecificSize += sPropRecords[i].sPropLength + sequenceHeaderLengthFieldSize;
+        for (auto& parameterSet : parameterSets)
+            decoderSpecificSize += parameterSet.size() + sequenceHeaderLengthFieldSize;
 
         // Allocate format buffer
         size_t mpeg2VideoInfoBuffer = sizeof(MPEG2VIDEOINFO) + decoderSpecificSize - sizeof(DWORD);
@@ -351,59 +519,43 @@ namespace
             return E_OUTOFMEMORY;
         ZeroMemory(pVid, sizeof(MPEG2VIDEOINFO));
 
-        unsigned videoWidth = 0, videoHeight = 0;
-        double videoFramerate = 0.0;
-
-        // Move SPS and PPS to format buffer (sequence header part)
+        // Move parameter sets to format buffer (sequence header part)
         pVid->cbSequenceHeader = decoderSpecificSize;
         BYTE* dstSequenceHeader = (BYTE*)&pVid->dwSequenceHeader;
-        for (unsigned i = 0; i < numSPropRecords; ++i)
+        for (auto& parameterSet : parameterSets)
         {
-            SPropRecord& prop = sPropRecords[i];
-
-            // It's SPS (Sequence parameter set
-            if ((prop.sPropBytes[0] & 0x1F) == 7)
-            {
-                H264StreamParser h264StreamParser(prop.sPropBytes, prop.sPropLength);
-                videoWidth = h264StreamParser.GetWidth();
-                videoHeight = h264StreamParser.GetHeight();
-                videoFramerate = h264StreamParser.GetFramerate();
-            }
-
             // Two-byte length field in network-byte order
-            uint16_t lengthField = prop.sPropLength;
+            uint16_t lengthField = static_cast<uint16_t>(parameterSet.size());
             dstSequenceHeader[0] = ((uint8_t*)&lengthField)[1];
             dstSequenceHeader[1] = ((uint8_t*)&lengthField)[0];
 
-            memcpy(dstSequenceHeader + sequenceHeaderLengthFieldSize, prop.sPropBytes,
-                   prop.sPropLength);
-            dstSequenceHeader += sequenceHeaderLengthFieldSize + prop.sPropLength;
+            memcpy(dstSequenceHeader + sequenceHeaderLengthFieldSize, parameterSet.data(),
+                   parameterSet.size());
+            dstSequenceHeader += sequenceHeaderLengthFieldSize + parameterSet.size();
         }
 
-        delete[] sPropRecords;
-
-        dstSequenceHeader = (BYTE*)&pVid->dwSequenceHeader;
         pVid->dwStartTimeCode = 0;
-        pVid->dwProfile = dstSequenceHeader[sequenceHeaderLengthFieldSize + 1];
-        pVid->dwLevel = dstSequenceHeader[sequenceHeaderLengthFieldSize + 3];
+        pVid->dwProfile = videoInfo.profile;
+        pVid->dwLevel = videoInfo.level;
         pVid->dwFlags = lengthFieldSize;
 
         // VIDEOINFOHEADER2
-        SetRect(&pVid->hdr.rcSource, 0, 0, videoWidth, videoHeight);
-        SetRect(&pVid->hdr.rcTarget, 0, 0, videoWidth, videoHeight);
+        SetRect(&pVid->hdr.rcSource, 0, 0, videoInfo.width, videoInfo.height);
+        SetRect(&pVid->hdr.rcTarget, 0, 0, videoInfo.width, videoInfo.height);
 
-        REFERENCE_TIME timePerFrame =
-            std::abs(videoFramerate) > 1e-6 ? (REFERENCE_TIME)(UNITS / videoFramerate) : 0;
+        REFERENCE_TIME timePerFrame = std::abs(videoInfo.framerate) > 1e-6
+                                          ? (REFERENCE_TIME)(UNITS / videoInfo.framerate)
+                                          : 0;
         pVid->hdr.AvgTimePerFrame = timePerFrame;
 
         // BITMAPINFOHEADER
         pVid->hdr.bmiHeader.biSize = sizeof BITMAPINFOHEADER;
-        pVid->hdr.bmiHeader.biWidth = videoWidth;
-        pVid->hdr.bmiHeader.biHeight = videoHeight;
-        pVid->hdr.bmiHeader.biCompression = MAKEFOURCC('a', 'v', 'c', '1');
+        pVid->hdr.bmiHeader.biWidth = videoInfo.width;
+        pVid->hdr.bmiHeader.biHeight = videoInfo.height;
+        pVid->hdr.bmiHeader.biCompression = compression;
 
         mediaType.SetType(&MEDIATYPE_Video);
-        mediaType.SetSubtype(&MEDIASUBTYPE_AVC1);
+        mediaType.SetSubtype(&subtype);
         mediaType.SetFormatType(&FORMAT_MPEG2Video);
         mediaType.SetTemporalCompression(TRUE);
         mediaType.SetSampleSize(0);
@@ -411,22 +563,62 @@ namespace
         return S_OK;
     }
 
-    HRESULT GetMediaTypeAAC(CMediaType& mediaType, MediaSubsession& mediaSubsession)
+    void StartCodesToLengthFields(uint8_t* accessUnit, size_t size)
+    {
+        uint8_t* end = accessUnit + size;
+        uint8_t* prefix = accessUnit;
+        while (prefix + lengthFieldSize <= end)
+        {
+            uint8_t* nal = prefix + lengthFieldSize;
+            // Next one is found by its last 3 bytes (00 00 01)
+            const uint8_t* startCode = findStartCode(nal, end);
+            uint8_t* nalEnd = startCode != end ? nal + (startCode - nal) - 1 : end;
+
+            uint32_t lengthField = static_cast<uint32_t>(nalEnd - nal);
+            prefix[0] = ((uint8_t*)&lengthField)[3];
+            prefix[1] = ((uint8_t*)&lengthField)[2];
+            prefix[2] = ((uint8_t*)&lengthField)[1];
+            prefix[3] = ((uint8_t*)&lengthField)[0];
+            prefix = nalEnd;
+        }
+    }
+
+    HRESULT GetMediaTypeVideo(CMediaType& mediaType, const ParameterSets& parameterSets,
+                              DWORD codecFourCC)
     {
-        // fmtp_configuration() looks like 1490. We need to convert it to 0x14 0x90
-        const char* configuration = mediaSubsession.fmtp_configuration();
-        int decoderSpecificSize = strlen(configuration) / 2;
-        std::vector<uint8_t> decoderSpecific(decoderSpecificSize);
-        for (int i = 0; i < decoderSpecificSize; ++i)
+        switch (codecFourCC)
         {
-            char hexStr[] = {configuration[2 * i], configuration[2 * i + 1], '\0'};
-            uint8_t hex = static_cast<uint8_t>(strtoul(hexStr, nullptr, 16));
-            decoderSpecific[i] = hex;
+        case DWORD('h264'):
+            return GetMediaTypeStartCodes(mediaType, parameterSets,
+                                          GetVideoInfoH264(parameterSets), MEDIASUBTYPE_H264,
+                                          MAKEFOURCC('H', '2', '6', '4'));
+        case DWORD('avc1'):
+            return GetMediaTypeLengthPrefixed(mediaType, parameterSets,
+                                              GetVideoInfoH264(parameterSets), MEDIASUBTYPE_AVC1,
+                                              MAKEFOURCC('a', 'v', 'c', '1'));
+        case DWORD('hevc'):
+            return GetMediaTypeStartCodes(mediaType, parameterSets,
+                                          GetVideoInfoH265(parameterSets), mediaSubtypeHEVC,
+                                          MAKEFOURCC('H', 'E', 'V', 'C'));
+        case DWORD('hvc1'):
+            return GetMediaTypeLengthPrefixed(mediaType, parameterSets,
+                                              GetVideoInfoH265(parameterSets), mediaSubtypeHVC1,
+                                              MAKEFOURCC('H', 'V', 'C', '1'));
+        default:
+            return E_FAIL;
         }
+    }
 
-        const int samplingFreqs[] = {96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050,
-                                     16000, 12000, 11025, 8000,  7350,  0,     0,     0};
+    HRESULT GetMediaTypeAAC(CMediaType& mediaType, const std::vector<uint8_t>& audioSpecificConfig)
+    {
+        AudioSpecificConfig config;
+        if (!ParseAudioSpecificConfig(audioSpecificConfig.data(), audioSpecificConfig.size(),
+                                      config))
+        {
+            return E_FAIL;
+        }
 
+        const size_t decoderSpecificSize = audioSpecificConfig.size();
         const size_t waveFormatBufferSize = sizeof(WAVEFORMATEX) + decoderSpecificSize;
         WAVEFORMATEX* pWave = (WAVEFORMATEX*)mediaType.AllocFormatBuffer(waveFormatBufferSize);
         if (!pWave)
@@ -434,14 +626,13 @@ namespace
         ZeroMemory(pWave, waveFormatBufferSize);
 
         pWave->wFormatTag = WAVE_FORMAT_RAW_AAC1;
-        pWave->nChannels = (decoderSpecific[1] & 0x78) >> 3;
-        pWave->nSamplesPerSec =
-            samplingFreqs[((decoderSpecific[0] & 0x7) << 1) + ((decoderSpecific[1] & 0x80) >> 7)];
+        pWave->nChannels = config.channels;
+        pWave->nSamplesPerSec = config.sampleRate;
         pWave->nBlockAlign = 1;
         // pWave->nAvgBytesPerSec = 0;
         // pWave->wBitsPerSample = 16; // Can be 0 I guess
-        pWave->cbSize = decoderSpecificSize;
-        CopyMemory(pWave + 1, decoderSpecific.data(), decoderSpecificSize);
+        pWave->cbSize = static_cast<WORD>(decoderSpecificSize);
+        CopyMemory(pWave + 1, audioSpecificConfig.data(), decoderSpecificSize);
 
         mediaType.SetType(&MEDIATYPE_Audio);
         mediaType.SetSubtype(&MEDIASUBTYPE_RAW_AAC1);
@@ -452,7 +643,6 @@ namespace
         return S_OK;
     }
 
-    /// TODO: Not completed!
     HRESULT GetMediaTypeAC3(CMediaType& mediaType, MediaSubsession& mediaSubsession)
     {
         WAVEFORMATEX* pWave = (WAVEFORMATEX*)mediaType.AllocFormatBuffer(sizeof(WAVEFORMATEX));
@@ -460,7 +650,9 @@ namespace
             return E_OUTOFMEMORY;
         ZeroMemory(pWave, sizeof(WAVEFORMATEX));
 
-        // The RTP timestamp clock rate is equal to the audio sampling rate
+        // The RTP timestamp clock rate is equal to the audio sampling rate. Channel count is
+        // optional in SDP - decoders take the actual one from sync frames anyway.
+        pWave->wFormatTag = waveFormatAc3;
         pWave->nSamplesPerSec = mediaSubsession.rtpTimestampFrequency();
         pWave->nChannels = mediaSubsession.numChannels();
         pWave->nAvgBytesPerSec = mediaSubsession.bandwidth() * 1024 / 8; // kbps to B/s
@@ -476,13 +668,49 @@ namespace
         return S_OK;
     }
 
-    // Works only for H264/AVC1
-    bool IsIdrFrame(const MediaPacketSample& mediaPacket)
+    HRESULT GetMediaTypeG711(CMediaType& mediaType, MediaSubsession& mediaSubsession,
+                             WORD formatTag, const GUID& subtype)
     {
-        const uint8_t* data = mediaPacket.data();
-        // Take 5 LSBs and compare with 5 (IDR)
-        // More NAL types:
-        // http://gentlelogic.blogspot.com/2011/11/exploring-h264-part-2-h264-bitstream.html
-        return (data[0] & 0x1F) == 5;
+        WAVEFORMATEX* pWave = (WAVEFORMATEX*)mediaType.AllocFormatBuffer(sizeof(WAVEFORMATEX));
+        if (!pWave)
+            return E_OUTOFMEMORY;
+        ZeroMemory(pWave, sizeof(WAVEFORMATEX));
+
+        // A byte per sample and channel at RTP clock rate (8000 Hz unless SDP says otherwise)
+        pWave->wFormatTag = formatTag;
+        pWave->nChannels = mediaSubsession.numChannels();
+        pWave->nSamplesPerSec = mediaSubsession.rtpTimestampFrequency();
+        pWave->nBlockAlign = pWave->nChannels;
+        pWave->nAvgBytesPerSec = pWave->nSamplesPerSec * pWave->nBlockAlign;
+        pWave->wBitsPerSample = 8;
+
+        mediaType.SetType(&MEDIATYPE_Audio);
+        mediaType.SetSubtype(&subtype);
+        mediaType.SetFormatType(&FORMAT_WaveFormatEx);
+        mediaType.SetSampleSize(pWave->nBlockAlign);
+        mediaType.SetTemporalCompression(FALSE);
+
+        return S_OK;
+    }
+
+    HRESULT GetMediaTypeOpus(CMediaType& mediaType)
+    {
+        WAVEFORMATEX* pWave = (WAVEFORMATEX*)mediaType.AllocFormatBuffer(sizeof(WAVEFORMATEX));
+        if (!pWave)
+            return E_OUTOFMEMORY;
+        ZeroMemory(pWave, sizeof(WAVEFORMATEX));
+
+        // Each packet tells its channel layout, the decoder outputs stereo unless told otherwise
+        pWave->wFormatTag = waveFormatOpus;
+        pWave->nChannels = opusChannels;
+        pWave->nSamplesPerSec = opusSampleRate;
+        pWave->nBlockAlign = 1;
+
+        mediaType.SetType(&MEDIATYPE_Audio);
+        mediaType.SetSubtype(&mediaSubtypeOpus);
+        mediaType.SetFormatType(&FORMAT_WaveFormatEx);
+        mediaType.SetTemporalCompression(FALSE);
+
+        return S_OK;
     }
 }
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "SPropParameterSets.h"
+
+#include <cstring>
+
+namespace
+{
+    void AppendSPropParameterSets(const char* sPropParameterSets, ParameterSets& parameterSets)
+    {
+        if (sPropParameterSets == nullptr)
+            return;
+
+        unsigned numSPropRecords;
+        SPropRecord* sPropRecords = ::parseSPropParameterSets(sPropParameterSets, numSPropRecords);
+        for (unsigned i = 0; i < numSPropRecords; ++i)
+        {
+            SPropRecord& prop = sPropRecords[i];
+            if (prop.sPropLength > 0)
+                parameterSets.emplace_back(prop.sPropBytes, prop.sPropBytes + prop.sPropLength);
+        }
+        delete[] sPropRecords;
+    }
+}
+
+ParameterSets GetSPropParameterSets(MediaSubsession& mediaSubsession)
+{
+    ParameterSets parameterSets;
+    if (!strcmp(mediaSubsession.codecName(), "H264"))
+    {
+        AppendSPropParameterSets(mediaSubsession.fmtp_spropparametersets(), parameterSets);
+    }
+    else if (!strcmp(mediaSubsession.codecName(), "H265"))
+    {
+        AppendSPropParameterSets(mediaSubsession.fmtp_spropvps(), parameterSets);
+        AppendSPropParameterSets(mediaSubsession.fmtp_spropsps(), parameterSets);
+        AppendSPropParameterSets(mediaSubsession.fmtp_sproppps(), parameterSets);
+    }
+    return parameterSets;
+}
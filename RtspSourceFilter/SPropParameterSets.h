@@ -0,0 +1,15 @@
+#pragma once
+
+#include "liveMedia.hh"
+
+#include <cstdint>
+#include <vector>
+
+// NAL units of parameter sets in decoding order
+typedef std::vector<std::vector<uint8_t>> ParameterSets;
+
+/**
+ * Out-of-band parameter sets of H.264 (sprop-parameter-sets) or H.265 (sprop-vps, sprop-sps
+ * and sprop-pps) subsession. Empty for other codecs or if SDP doesn't carry any.
+ */
+ParameterSets GetSPropParameterSets(MediaSubsession& mediaSubsession);
@@ -0,0 +1,228 @@
+#include "SessionClock.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+    // Correction after switching timelines shrinks by that much per unit of stream time
+    const double slewRate = 0.02;
+    // Anything bigger isn't worth slewing for minutes - samples just jump
+    const int64_t maxSlewedCorrection = 1000 * 10000; // 1 s
+    const int64_t restartThreshold = 1000 * 10000; // 1 s
+    // Synced sample mapped that far away is on a different sender's timeline
+    const int64_t maxAnchorDistance = 10000 * 10000; // 10 s
+
+    const int64_t transitWindow = 5000 * 10000; // 5 s
+    const size_t maxTransitPoints = 12;
+    const size_t minTransitPoints = 3;
+    // Way more than any crystal is off - estimates past it are due to network conditions
+    const double maxSkew = 0.001;
+
+    // Least squares slope of transit time over presentation time
+    template <typename Points>
+    double TransitSlope(const Points& points)
+    {
+        const double n = static_cast<double>(points.size());
+        double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+        for (const auto& point : points)
+        {
+            // Relative to the first point - raw values would lose the precision
+            const double x = static_cast<double>(point.presentationTime -
+                                                 points.front().presentationTime);
+            const double y = static_cast<double>(point.transit - points.front().transit);
+            sumX += x;
+            sumY += y;
+            sumXX += x * x;
+            sumXY += x * y;
+        }
+        const double denominator = n * sumXX - sumX * sumX;
+        return denominator > 0 ? (n * sumXY - sumX * sumY) / denominator : 0;
+    }
+}
+
+SessionClock::SessionClock() { reset(); }
+
+void SessionClock::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    resetAll();
+}
+
+void SessionClock::restart(Stream stream)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    resetStream(_streams[stream]);
+
+    // Keep the anchor as long as the other stream is mapped with it
+    bool anchorInUse = false;
+    for (const StreamState& state : _streams)
+        anchorInUse = anchorInUse || (state.started && state.synced);
+    if (!anchorInUse)
+        _anchored = false;
+}
+
+int64_t SessionClock::toStreamTime(Stream stream, int64_t presentationTime, bool rtcpSynced,
+                                   int64_t streamTime, int64_t arrivalTime)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Stream time starts over with each run. Pins may report a bit out of order, though.
+    if (_started && streamTime < _lastStreamTime - restartThreshold)
+        resetAll();
+    _started = true;
+    _lastStreamTime = streamTime;
+
+    StreamState& state = _streams[stream];
+    const int64_t elapsed = state.started ? streamTime - state.lastStreamTime : 0;
+    // Where the stream would be if its samples went on as they did
+    const int64_t continued = state.started ? state.lastMapped + elapsed : streamTime;
+
+    bool switched = false;
+    int64_t mapped;
+    if (rtcpSynced)
+    {
+        if (!_anchored || std::abs(mapSynced(presentationTime) - streamTime) > maxAnchorDistance)
+            anchor(presentationTime, continued);
+        if (!state.synced)
+        {
+            state.synced = true;
+            state.transitPoints.clear();
+            state.windowOpen = false;
+        }
+        switched = state.started && state.generation != _generation;
+        state.generation = _generation;
+
+        observeTransit(state, presentationTime, arrivalTime);
+        mapped = mapSynced(presentationTime);
+    }
+    else
+    {
+        if (!state.started || state.synced)
+        {
+            state.synced = false;
+            state.ownOffset = continued - presentationTime;
+        }
+        mapped = presentationTime + state.ownOffset;
+    }
+
+    if (switched)
+    {
+        state.correction = continued - mapped;
+        if (std::abs(state.correction) > maxSlewedCorrection)
+            state.correction = 0;
+    }
+    else if (elapsed > 0)
+    {
+        const int64_t step = static_cast<int64_t>(elapsed * slewRate);
+        if (state.correction > 0)
+            state.correction = std::max<int64_t>(state.correction - step, 0);
+        else
+            state.correction = std::min<int64_t>(state.correction + step, 0);
+    }
+
+    state.started = true;
+    state.lastStreamTime = streamTime;
+    state.lastMapped = mapped + state.correction;
+    return state.lastMapped;
+}
+
+int32_t SessionClock::skewPpm()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return static_cast<int32_t>(std::lround(_skew * 1000000));
+}
+
+void SessionClock::resetAll()
+{
+    for (StreamState& state : _streams)
+        resetStream(state);
+    _anchored = false;
+    _generation = 0;
+    _presentationTimeBase = 0;
+    _offset = 0;
+    _skew = 0;
+    _started = false;
+    _lastStreamTime = 0;
+}
+
+void SessionClock::resetStream(StreamState& state)
+{
+    state.started = false;
+    state.synced = false;
+    state.generation = 0;
+    state.ownOffset = 0;
+    state.correction = 0;
+    state.lastMapped = 0;
+    state.lastStreamTime = 0;
+    state.windowOpen = false;
+    state.transitPoints.clear();
+}
+
+void SessionClock::anchor(int64_t presentationTime, int64_t mapped)
+{
+    _anchored = true;
+    ++_generation;
+    _presentationTimeBase = presentationTime;
+    _offset = mapped - presentationTime;
+    _skew = 0;
+    // Transit times of a different sender say nothing about this one
+    for (StreamState& state : _streams)
+    {
+        state.windowOpen = false;
+        state.transitPoints.clear();
+    }
+}
+
+int64_t SessionClock::mapSynced(int64_t presentationTime) const
+{
+    const int64_t sinceBase = presentationTime - _presentationTimeBase;
+    return presentationTime + _offset + static_cast<int64_t>(_skew * sinceBase);
+}
+
+void SessionClock::observeTransit(StreamState& state, int64_t presentationTime,
+                                  int64_t arrivalTime)
+{
+    const TransitPoint point = {presentationTime, arrivalTime - presentationTime};
+    if (state.windowOpen && arrivalTime - state.windowStart < transitWindow)
+    {
+        // Least delayed sample tells the most about the clocks
+        if (point.transit < state.windowMin.transit)
+            state.windowMin = point;
+        return;
+    }
+
+    if (state.windowOpen)
+    {
+        state.transitPoints.push_back(state.windowMin);
+        if (state.transitPoints.size() > maxTransitPoints)
+            state.transitPoints.pop_front();
+        updateSkew(presentationTime);
+    }
+    state.windowOpen = true;
+    state.windowStart = arrivalTime;
+    state.windowMin = point;
+}
+
+void SessionClock::updateSkew(int64_t presentationTime)
+{
+    // Both streams come from the same sender clock - take the mean of their estimates
+    double sum = 0;
+    int count = 0;
+    for (const StreamState& state : _streams)
+    {
+        if (state.synced && state.transitPoints.size() >= minTransitPoints)
+        {
+            sum += TransitSlope(state.transitPoints);
+            ++count;
+        }
+    }
+    if (count == 0)
+        return;
+
+    // Move the base here so the new skew doesn't shift samples going out now
+    _offset += static_cast<int64_t>(_skew * (presentationTime - _presentationTimeBase));
+    _presentationTimeBase = presentationTime;
+    _skew = std::min(std::max(sum / count, -maxSkew), maxSkew);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include "PlayoutDelay.h"
+
+/**
+ * Session clock shared by the output pins - maps presentation times of the streams onto stream
+ * time. Times are in 100 ns units (REFERENCE_TIME).
+ *
+ * Presentation times synced using RTCP sender reports are all on the sender's NTP timeline,
+ * so they're mapped with a single offset - set by the first synced sample of whichever stream -
+ * and keep the relation the sender gave them. Until a stream gets its first sender report its
+ * presentation times are local guesses of live555, mapped on their own relative to the first
+ * sample of the stream like before.
+ *
+ * Switching to another timeline (sender report arrived, anchor moved) doesn't make samples jump.
+ * The difference is kept as a correction that is slewed away as stream time goes by.
+ *
+ * Sender and local clocks drift apart. The lowest transit time (arrival less presentation time)
+ * of every few seconds is recorded and the skew estimated by a line fitted through the recent
+ * ones. Synced samples are then stretched by it, so they don't creep towards being late or
+ * piling up in the queues.
+ *
+ * Used from the pins' streaming threads and the ingest loop thread.
+ */
+class SessionClock
+{
+public:
+    typedef PlayoutDelay::Stream Stream;
+
+    SessionClock();
+
+    // All streams start over
+    void reset();
+    // Stream starts over (f.e. samples from a different session follow)
+    void restart(Stream stream);
+
+    /**
+     * Stream time for sample of given presentation time going out at streamTime. It's arrived
+     * at arrivalTime (stream time as well), the difference being time spent in the queue.
+     */
+    int64_t toStreamTime(Stream stream, int64_t presentationTime, bool rtcpSynced,
+                         int64_t streamTime, int64_t arrivalTime);
+
+    // Estimated rate of the sender's clock relative to stream time, in parts per million
+    int32_t skewPpm();
+
+private:
+    struct TransitPoint
+    {
+        int64_t presentationTime;
+        int64_t transit;
+    };
+
+    struct StreamState
+    {
+        bool started;
+        bool synced;
+        // Anchor the stream has been mapped with so far
+        unsigned generation;
+        // Maps presentation times of the stream until it's synced
+        int64_t ownOffset;
+        int64_t correction;
+        int64_t lastMapped;
+        int64_t lastStreamTime;
+        // Lowest transit time of current window
+        bool windowOpen;
+        int64_t windowStart;
+        TransitPoint windowMin;
+        std::deque<TransitPoint> transitPoints;
+    };
+
+    void resetAll();
+    void resetStream(StreamState& state);
+    void anchor(int64_t presentationTime, int64_t mapped);
+    int64_t mapSynced(int64_t presentationTime) const;
+    void observeTransit(StreamState& state, int64_t presentationTime, int64_t arrivalTime);
+    void updateSkew(int64_t presentationTime);
+
+private:
+    std::mutex _mutex;
+    StreamState _streams[PlayoutDelay::NumStreams];
+    bool _anchored;
+    unsigned _generation;
+    // Synced presentation time p goes out at p + _offset + _skew * (p - _presentationTimeBase)
+    int64_t _presentationTimeBase;
+    int64_t _offset;
+    double _skew;
+    bool _started;
+    int64_t _lastStreamTime;
+};
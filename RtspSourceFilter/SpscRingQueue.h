@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#include <emmintrin.h>
+#define SPSC_CPU_RELAX() _mm_pause()
+#else
+#define SPSC_CPU_RELAX() std::this_thread::yield()
+#endif
+
+/**
+ * Bounded single-producer/single-consumer ring queue.
+ *
+ * push() and try_pop() are wait-free: producer and consumer only touch their own index
+ * and a cached copy of the other side's one, each on its own cache line.
+ * Blocking pop() and try_pop_for() spin for a while before parking the consumer on
+ * a condition variable, spin budget adapts to how often spinning paid off. The producer only
+ * takes the mutex when the consumer is actually parked.
+ *
+ * Exactly one thread may call push(), exactly one (other) thread may call the pop family
+ * and clear().
+ */
+template <typename T>
+class SpscRingQueue
+{
+public:
+    typedef T value_type;
+    typedef T& reference_type;
+    typedef const T& const_reference;
+
+    /**
+     * Construct empty queue able to hold at least given number of items
+     * (rounded up to the power of two)
+     */
+    explicit SpscRingQueue(size_t capacity)
+        : _slots(roundUpToPowerOfTwo(capacity))
+        , _mask(_slots.size() - 1)
+        , _tail(0)
+        , _cachedHead(0)
+        , _head(0)
+        , _cachedTail(0)
+        , _spinLimit(initialSpinLimit)
+        , _consumerWaiting(false)
+    {
+    }
+
+    SpscRingQueue(const SpscRingQueue&) = delete;
+    SpscRingQueue& operator=(const SpscRingQueue&) = delete;
+
+    /**
+     * Enqueue an item at tail of queue.
+     * Returns false (and leaves data untouched) if the queue is full.
+     */
+    bool push(T&& data)
+    {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _cachedHead > _mask)
+        {
+            _cachedHead = _head.load(std::memory_order_acquire);
+            if (tail - _cachedHead > _mask)
+                return false;
+        }
+
+        _slots[tail & _mask] = std::move(data);
+        _tail.store(tail + 1, std::memory_order_release);
+
+        // Pairs with the fence in waitForItem() - either we see the consumer parking or it sees
+        // the new tail
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_consumerWaiting.load(std::memory_order_relaxed))
+        {
+            // Empty critical section so notify can't slip in between consumer's check and wait
+            { std::lock_guard<std::mutex> lock(_mutex); }
+            _condition_variable.notify_one();
+        }
+        return true;
+    }
+
+    /**
+     * Attempt to dequeue an item from head of queue.
+     * Does not wait for item to become available.
+     * Returns true if successful; false otherwise.
+     */
+    bool try_pop(T& value)
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _cachedTail)
+        {
+            _cachedTail = _tail.load(std::memory_order_acquire);
+            if (head == _cachedTail)
+                return false;
+        }
+
+        T& slot = _slots[head & _mask];
+        value = std::move(slot);
+        // Don't keep moved-from item alive in the ring (it may pin pooled memory)
+        slot = T();
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Peek at the head of queue without dequeuing it. Consumer side operation.
+     * Returns nullptr if the queue is empty.
+     */
+    T* front()
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _cachedTail)
+        {
+            _cachedTail = _tail.load(std::memory_order_acquire);
+            if (head == _cachedTail)
+                return nullptr;
+        }
+        return &_slots[head & _mask];
+    }
+
+    /**
+     * Attempt to dequeue an item from head of queue.
+     * Waits for item to become available for specified duration.
+     * Returns true if successful; false otherwise.
+     */
+    bool try_pop_for(T& value, std::chrono::milliseconds duration)
+    {
+        if (try_pop(value))
+            return true;
+        waitForItem(std::chrono::steady_clock::now() + duration, true);
+        return try_pop(value);
+    }
+
+    /**
+     * Dequeue item from head of queue.
+     * Block until an item becomes available, and then dequeue it
+     */
+    void pop(T& value)
+    {
+        while (!try_pop(value))
+            waitForItem(std::chrono::steady_clock::time_point(), false);
+    }
+
+    bool empty() const
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Drop all queued items. Consumer side operation.
+     */
+    void clear()
+    {
+        T dummy;
+        while (try_pop(dummy))
+        {
+        }
+    }
+
+    /**
+     * Approximate number of queued items
+     */
+    size_t size() const
+    {
+        const size_t head = _head.load(std::memory_order_acquire);
+        return _tail.load(std::memory_order_acquire) - head;
+    }
+
+    size_t capacity() const { return _slots.size(); }
+
+    /**
+     * Total number of items ever enqueued. Exact on the producer side.
+     */
+    size_t pushedCount() const { return _tail.load(std::memory_order_relaxed); }
+
+    /**
+     * Total number of items ever dequeued. Exact on the consumer side.
+     */
+    size_t poppedCount() const { return _head.load(std::memory_order_relaxed); }
+
+private:
+    static size_t roundUpToPowerOfTwo(size_t value)
+    {
+        size_t result = 2;
+        while (result < value)
+            result <<= 1;
+        return result;
+    }
+
+    bool hasItem()
+    {
+        return _head.load(std::memory_order_relaxed) != _tail.load(std::memory_order_acquire);
+    }
+
+    void waitForItem(std::chrono::steady_clock::time_point deadline, bool timed)
+    {
+        // Spin phase - cheap when producer is about to push anyway
+        for (unsigned i = 0; i < _spinLimit; ++i)
+        {
+            if (hasItem())
+            {
+                _spinLimit = std::min<unsigned>(_spinLimit * 2, maxSpinLimit);
+                return;
+            }
+            SPSC_CPU_RELAX();
+        }
+        _spinLimit = std::max<unsigned>(_spinLimit / 2, minSpinLimit);
+
+        // Park phase
+        std::unique_lock<std::mutex> lock(_mutex);
+        _consumerWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!hasItem())
+        {
+            if (!timed)
+            {
+                _condition_variable.wait(lock);
+                continue;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now >= deadline)
+                break;
+            _condition_variable.wait_for(lock, deadline - now);
+        }
+        _consumerWaiting.store(false, std::memory_order_relaxed);
+    }
+
+private:
+    enum : unsigned
+    {
+        minSpinLimit = 16,
+        initialSpinLimit = 256,
+        maxSpinLimit = 4096
+    };
+    enum
+    {
+        cacheLineSize = 64
+    };
+
+    std::vector<T> _slots;
+    const size_t _mask;
+    char _pad0[cacheLineSize];
+
+    // Producer side
+    std::atomic<size_t> _tail;
+    size_t _cachedHead;
+    char _pad1[cacheLineSize];
+
+    // Consumer side
+    std::atomic<size_t> _head;
+    size_t _cachedTail;
+    unsigned _spinLimit;
+    char _pad2[cacheLineSize];
+
+    // Parking
+    std::atomic<bool> _consumerWaiting;
+    std::mutex _mutex;
+    std::condition_variable _condition_variable;
+};
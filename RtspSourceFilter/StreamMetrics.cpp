@@ -0,0 +1,84 @@
+#include "StreamMetrics.h"
+
+namespace
+{
+    // Buckets per power of two - resolution of 25% (HdrHistogram with a single significant
+    // binary digit past the leading one)
+    const unsigned subBucketBits = 2;
+    const unsigned subBuckets = 1 << subBucketBits;
+
+    unsigned LatencyBucket(uint64_t micros)
+    {
+        if (micros < subBuckets)
+            return static_cast<unsigned>(micros);
+
+        unsigned exponent = 0;
+        for (uint64_t value = micros; value > 1; value >>= 1)
+            ++exponent;
+        const unsigned subBucket =
+            static_cast<unsigned>(micros >> (exponent - subBucketBits)) & (subBuckets - 1);
+        const unsigned bucket = subBuckets + (exponent - subBucketBits) * subBuckets + subBucket;
+        return bucket < RTSP_STREAM_LATENCY_BUCKETS ? bucket : RTSP_STREAM_LATENCY_BUCKETS - 1;
+    }
+}
+
+StreamLatencyHistogram::StreamLatencyHistogram()
+    : _count(0), _totalMicroseconds(0), _maxMicroseconds(0)
+{
+    for (auto& bucket : _buckets)
+        bucket.store(0, std::memory_order_relaxed);
+}
+
+void StreamLatencyHistogram::record(std::chrono::microseconds latency)
+{
+    const uint64_t micros = latency.count() > 0 ? static_cast<uint64_t>(latency.count()) : 0;
+
+    _buckets[LatencyBucket(micros)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _totalMicroseconds.fetch_add(micros, std::memory_order_relaxed);
+    // Single writer - no need for CAS loop
+    if (micros > _maxMicroseconds.load(std::memory_order_relaxed))
+        _maxMicroseconds.store(micros, std::memory_order_relaxed);
+}
+
+void StreamLatencyHistogram::getStats(RtspStreamLatencyStats& stats) const
+{
+    stats.count = _count.load(std::memory_order_relaxed);
+    stats.totalMicroseconds = _totalMicroseconds.load(std::memory_order_relaxed);
+    stats.maxMicroseconds = _maxMicroseconds.load(std::memory_order_relaxed);
+    for (int i = 0; i < RTSP_STREAM_LATENCY_BUCKETS; ++i)
+        stats.buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+}
+
+StreamMetrics::StreamMetrics(const MediaPacketQueue& mediaPacketQueue)
+    : packetsReceived(0)
+    , packetsLost(0)
+    , bytesReceived(0)
+    , framesQueued(0)
+    , truncatedFrames(0)
+    , truncatedBytes(0)
+    , fragmentedFramesLost(0)
+    , bitsPerSecond(0)
+    , jitterMicroseconds(0)
+    , mediaPacketQueue(mediaPacketQueue)
+{
+}
+
+void StreamMetrics::getStats(RtspStreamStats& stats) const
+{
+    stats.packetsReceived = packetsReceived.load(std::memory_order_relaxed);
+    stats.packetsLost = packetsLost.load(std::memory_order_relaxed);
+    stats.bytesReceived = bytesReceived.load(std::memory_order_relaxed);
+    stats.framesQueued = framesQueued.load(std::memory_order_relaxed);
+    stats.truncatedFrames = truncatedFrames.load(std::memory_order_relaxed);
+    stats.truncatedBytes = truncatedBytes.load(std::memory_order_relaxed);
+    stats.fragmentedFramesLost = fragmentedFramesLost.load(std::memory_order_relaxed);
+    stats.bitsPerSecond = bitsPerSecond.load(std::memory_order_relaxed);
+    stats.jitterMicroseconds = jitterMicroseconds.load(std::memory_order_relaxed);
+    stats.queuedFrames = static_cast<DWORD>(mediaPacketQueue.size());
+    stats.queuedBytes = static_cast<DWORD>(mediaPacketQueue.sizeInBytes());
+    reorderWait.getStats(stats.reorderWait);
+    receiveToQueue.getStats(stats.receiveToQueue);
+    queueToPin.getStats(stats.queueToPin);
+    endToEnd.getStats(stats.endToEnd);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "MediaPacketQueue.h"
+#include "RtspSourceFilter.h"
+
+/**
+ * Latency histogram with about the same relative precision everywhere (see
+ * RtspStreamLatencyStats). Recorded from a single thread, read from any thread.
+ */
+class StreamLatencyHistogram
+{
+public:
+    StreamLatencyHistogram();
+
+    StreamLatencyHistogram(const StreamLatencyHistogram&) = delete;
+    StreamLatencyHistogram& operator=(const StreamLatencyHistogram&) = delete;
+
+    void record(std::chrono::microseconds latency);
+    void getStats(RtspStreamLatencyStats& stats) const;
+
+private:
+    std::atomic<uint64_t> _count;
+    std::atomic<uint64_t> _totalMicroseconds;
+    std::atomic<uint64_t> _maxMicroseconds;
+    std::atomic<uint64_t> _buckets[RTSP_STREAM_LATENCY_BUCKETS];
+};
+
+/**
+ * Metrics of one of the filter's media streams (see RtspStreamStats). Updated by the sink of
+ * whichever session feeds the stream (ingest loop thread) and by the output pin (streaming
+ * thread) - each field by one of them only. Snapshots are lock-free and can be taken from any
+ * thread.
+ */
+struct StreamMetrics
+{
+    explicit StreamMetrics(const MediaPacketQueue& mediaPacketQueue);
+
+    StreamMetrics(const StreamMetrics&) = delete;
+    StreamMetrics& operator=(const StreamMetrics&) = delete;
+
+    void getStats(RtspStreamStats& stats) const;
+
+    // Ingest loop thread
+    std::atomic<uint64_t> packetsReceived;
+    std::atomic<uint64_t> packetsLost;
+    std::atomic<uint64_t> bytesReceived;
+    std::atomic<uint64_t> framesQueued;
+    std::atomic<uint64_t> truncatedFrames;
+    std::atomic<uint64_t> truncatedBytes;
+    std::atomic<uint64_t> fragmentedFramesLost;
+    std::atomic<uint32_t> bitsPerSecond;
+    std::atomic<uint32_t> jitterMicroseconds;
+    StreamLatencyHistogram reorderWait;
+    StreamLatencyHistogram receiveToQueue;
+    // Streaming thread
+    StreamLatencyHistogram queueToPin;
+    StreamLatencyHistogram endToEnd;
+
+    const MediaPacketQueue& mediaPacketQueue;
+};
@@ -29,5 +29,164 @@ namespace RtspSourceWpf.DirectShow
 
         [PreserveSig]
         void SetSendLivenessCommand([In, MarshalAs(UnmanagedType.Bool)] bool sendLiveness);
+
+        [PreserveSig]
+        void SetVideoQueueLimits([In] uint maxBytes, [In] uint maxFrames, [In] RtspQueueOverflowPolicy policy);
+
+        [PreserveSig]
+        void SetAudioQueueLimits([In] uint maxBytes, [In] uint maxFrames, [In] RtspQueueOverflowPolicy policy);
+
+        [PreserveSig]
+        int AddStandbyUrl([In, MarshalAs(UnmanagedType.LPWStr)] string url, [In, MarshalAs(UnmanagedType.Bool)] bool prePlay);
+
+        [PreserveSig]
+        int RemoveStandbyUrl([In, MarshalAs(UnmanagedType.LPWStr)] string url);
+
+        [PreserveSig]
+        int SwitchUrl([In, MarshalAs(UnmanagedType.LPWStr)] string url);
+
+        [PreserveSig]
+        void SetGopCacheLimits([In] uint maxBytes, [In] uint maxFrames);
+
+        [PreserveSig]
+        void SetAccessUnitAssembly([In, MarshalAs(UnmanagedType.Bool)] bool assemble);
+
+        [PreserveSig]
+        void SetAdaptiveLatency([In] uint minMSecs, [In] uint maxMSecs);
+
+        [PreserveSig]
+        void SetRelayMode([In, MarshalAs(UnmanagedType.Bool)] bool relay);
+
+        [PreserveSig]
+        int StartRecording([In, MarshalAs(UnmanagedType.LPWStr)] string pathPrefix, [In] uint segmentMBytes, [In] uint segmentSecs);
+
+        [PreserveSig]
+        void StopRecording();
+    }
+
+    enum RtspQueueOverflowPolicy
+    {
+        Block = 0,
+        DropOldest = 1,
+        DropUntilIdr = 2
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct RtspMediaQueueStats
+    {
+        public ulong DroppedFrames;
+        public ulong DroppedBytes;
+        public ulong OverflowEvents;
+        public uint QueuedFrames;
+        public uint QueuedBytes;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct RtspGopCacheStats
+    {
+        public ulong Hits;
+        public ulong Misses;
+        public uint CachedFrames;
+        public uint CachedBytes;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct RtspPlayoutDelayStats
+    {
+        public uint DelayMicroseconds;
+        public uint TargetMicroseconds;
+        public uint VideoJitterMicroseconds;
+        public uint AudioJitterMicroseconds;
+        public ulong LateSamples;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct RtspRequestLatencyStats
+    {
+        public ulong NumRequests;
+        public ulong TotalMicroseconds;
+        public ulong MaxMicroseconds;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 16)]
+        public ulong[] Buckets;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct RtspStreamLatencyStats
+    {
+        public ulong Count;
+        public ulong TotalMicroseconds;
+        public ulong MaxMicroseconds;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 96)]
+        public ulong[] Buckets;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct RtspStreamStats
+    {
+        public ulong PacketsReceived;
+        public ulong PacketsLost;
+        public ulong BytesReceived;
+        public ulong FramesQueued;
+        public ulong TruncatedFrames;
+        public ulong TruncatedBytes;
+        public ulong FragmentedFramesLost;
+        public uint BitsPerSecond;
+        public uint JitterMicroseconds;
+        public uint QueuedFrames;
+        public uint QueuedBytes;
+        public RtspStreamLatencyStats ReorderWait;
+        public RtspStreamLatencyStats ReceiveToQueue;
+        public RtspStreamLatencyStats QueueToPin;
+        public RtspStreamLatencyStats EndToEnd;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    struct RtspRecordingStats
+    {
+        public ulong RecordedFrames;
+        public ulong RecordedBytes;
+        public ulong DroppedFrames;
+        public ulong DroppedBytes;
+        public ulong OverflowEvents;
+        public ulong SkippedFrames;
+        public ulong WriteErrors;
+        public uint Segments;
+        public uint QueuedFrames;
+        public uint QueuedBytes;
+        public uint MaxWriteMicroseconds;
+        [MarshalAs(UnmanagedType.Bool)]
+        public bool Recording;
+    }
+
+    [Guid("9300B99C-8BA0-4395-B619-988FA8B208B9"),
+     InterfaceType(ComInterfaceType.InterfaceIsIUnknown)]
+    interface IRtspSourceStatistics
+    {
+        [PreserveSig]
+        int GetVideoQueueStats([Out] out RtspMediaQueueStats stats);
+
+        [PreserveSig]
+        int GetAudioQueueStats([Out] out RtspMediaQueueStats stats);
+
+        [PreserveSig]
+        int GetRequestLatencyStats([Out] out RtspRequestLatencyStats stats);
+
+        [PreserveSig]
+        int GetGopCacheStats([Out] out RtspGopCacheStats stats);
+
+        [PreserveSig]
+        int GetPlayoutDelayStats([Out] out RtspPlayoutDelayStats stats);
+
+        [PreserveSig]
+        int GetVideoStreamStats([Out] out RtspStreamStats stats);
+
+        [PreserveSig]
+        int GetAudioStreamStats([Out] out RtspStreamStats stats);
+
+        [PreserveSig]
+        int GetVideoRecordingStats([Out] out RtspRecordingStats stats);
+
+        [PreserveSig]
+        int GetAudioRecordingStats([Out] out RtspRecordingStats stats);
     }
 }
@@ -19,6 +19,7 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 
 #include "BasicUsageEnvironment0.hh"
 #include "HandlerSet.hh"
+#include "HashTable.hh"
 
 ////////// A subclass of DelayQueueEntry,
 //////////     used to implement BasicTaskScheduler0::scheduleDelayedTask()
@@ -142,6 +143,39 @@ void BasicTaskScheduler0::triggerEvent(EventTriggerId eventTriggerId, void* clie
   fTriggersAwaitingHandling |= eventTriggerId;
 }
 
+void BasicTaskScheduler0::handleTriggeredEvents() {
+  if (fTriggersAwaitingHandling != 0) {
+    if (fTriggersAwaitingHandling == fLastUsedTriggerMask) {
+      // Common-case optimization for a single event trigger:
+      fTriggersAwaitingHandling = 0;
+      if (fTriggeredEventHandlers[fLastUsedTriggerNum] != NULL) {
+	(*fTriggeredEventHandlers[fLastUsedTriggerNum])(fTriggeredEventClientDatas[fLastUsedTriggerNum]);
+      }
+    } else {
+      // Look for an event trigger that needs handling (making sure that we make forward progress through all possible triggers):
+      unsigned i = fLastUsedTriggerNum;
+      EventTriggerId mask = fLastUsedTriggerMask;
+
+      do {
+	i = (i+1)%MAX_NUM_EVENT_TRIGGERS;
+	mask >>= 1;
+	if (mask == 0) mask = 0x80000000;
+
+	if ((fTriggersAwaitingHandling&mask) != 0) {
+	  fTriggersAwaitingHandling &=~ mask;
+	  if (fTriggeredEventHandlers[i] != NULL) {
+	    (*fTriggeredEventHandlers[i])(fTriggeredEventClientDatas[i]);
+	  }
+
+	  fLastUsedTriggerMask = mask;
+	  fLastUsedTriggerNum = i;
+	  break;
+	}
+      } while (i != fLastUsedTriggerNum);
+    }
+  }
+}
+
 
 ////////// HandlerSet (etc.) implementation //////////
 
@@ -165,7 +199,7 @@ HandlerDescriptor::~HandlerDescriptor() {
 }
 
 HandlerSet::HandlerSet()
-  : fHandlers(&fHandlers) {
+  : fHandlers(&fHandlers), fHandlersBySocketNum(HashTable::create(ONE_WORD_HASH_KEYS)) {
   fHandlers.socketNum = -1; // shouldn't ever get looked at, but in case...
 }
 
@@ -174,6 +208,7 @@ HandlerSet::~HandlerSet() {
   while (fHandlers.fNextHandler != &fHandlers) {
     delete fHandlers.fNextHandler; // changes fHandlers->fNextHandler
   }
+  delete fHandlersBySocketNum;
 }
 
 void HandlerSet
@@ -183,6 +218,7 @@ void HandlerSet
   if (handler == NULL) { // No existing handler, so create a new descr:
     handler = new HandlerDescriptor(fHandlers.fNextHandler);
     handler->socketNum = socketNum;
+    fHandlersBySocketNum->Add((char const*)(long)socketNum, handler);
   }
 
   handler->conditionSet = conditionSet;
@@ -192,23 +228,24 @@ void HandlerSet
 
 void HandlerSet::clearHandler(int socketNum) {
   HandlerDescriptor* handler = lookupHandler(socketNum);
-  delete handler;
+  if (handler != NULL) {
+    fHandlersBySocketNum->Remove((char const*)(long)socketNum);
+    delete handler;
+  }
 }
 
 void HandlerSet::moveHandler(int oldSocketNum, int newSocketNum) {
   HandlerDescriptor* handler = lookupHandler(oldSocketNum);
   if (handler != NULL) {
+    fHandlersBySocketNum->Remove((char const*)(long)oldSocketNum);
+    clearHandler(newSocketNum); // in case there was one
     handler->socketNum = newSocketNum;
+    fHandlersBySocketNum->Add((char const*)(long)newSocketNum, handler);
   }
 }
 
 HandlerDescriptor* HandlerSet::lookupHandler(int socketNum) {
-  HandlerDescriptor* handler;
-  HandlerIterator iter(*this);
-  while ((handler = iter.next()) != NULL) {
-    if (handler->socketNum == socketNum) break;
-  }
-  return handler;
+  return (HandlerDescriptor*)(fHandlersBySocketNum->Lookup((char const*)(long)socketNum));
 }
 
 HandlerIterator::HandlerIterator(HandlerSet& handlerSet)
@@ -20,6 +20,7 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 
 #include "DelayQueue.hh"
 #include "GroupsockHelper.hh"
+#include "HashTable.hh"
 
 static const int MILLION = 1000000;
 
@@ -95,8 +96,7 @@ const DelayInterval ETERNITY(INT_MAX, MILLION-1);
 intptr_t DelayQueueEntry::tokenCounter = 0;
 
 DelayQueueEntry::DelayQueueEntry(DelayInterval delay)
-  : fDeltaTimeRemaining(delay) {
-  fNext = fPrev = this;
+  : fDeltaTimeRemaining(delay), fSequenceNum(0), fHeapIndex(-1) {
   fToken = ++tokenCounter;
 }
 
@@ -110,34 +110,46 @@ void DelayQueueEntry::handleTimeout() {
 
 ///// DelayQueue /////
 
+#define HEAP_ARITY 4
+#define INITIAL_HEAP_CAPACITY 64
+
 DelayQueue::DelayQueue()
-  : DelayQueueEntry(ETERNITY) {
+  : DelayQueueEntry(ETERNITY), fTimeToNextAlarm(ETERNITY),
+    fHeap(new DelayQueueEntry*[INITIAL_HEAP_CAPACITY]), fHeapSize(0), fHeapCapacity(INITIAL_HEAP_CAPACITY),
+    fSequenceCounter(0), fEntriesByToken(HashTable::create(ONE_WORD_HASH_KEYS)) {
   fLastSyncTime = TimeNow();
 }
 
 DelayQueue::~DelayQueue() {
-  while (fNext != this) {
-    DelayQueueEntry* entryToRemove = fNext;
+  while (fHeapSize > 0) {
+    DelayQueueEntry* entryToRemove = fHeap[fHeapSize-1];
     removeEntry(entryToRemove);
     delete entryToRemove;
   }
+  delete[] fHeap;
+  delete fEntriesByToken;
 }
 
 void DelayQueue::addEntry(DelayQueueEntry* newEntry) {
+  if (newEntry == NULL || newEntry->fHeapIndex >= 0) return; // already queued
+
   synchronize();
 
-  DelayQueueEntry* cur = head();
-  while (newEntry->fDeltaTimeRemaining >= cur->fDeltaTimeRemaining) {
-    newEntry->fDeltaTimeRemaining -= cur->fDeltaTimeRemaining;
-    cur = cur->fNext;
-  }
+  newEntry->fDueTime = fLastSyncTime;
+  newEntry->fDueTime += newEntry->fDeltaTimeRemaining;
+  newEntry->fSequenceNum = ++fSequenceCounter;
 
-  cur->fDeltaTimeRemaining -= newEntry->fDeltaTimeRemaining;
+  if (fHeapSize == fHeapCapacity) {
+    DelayQueueEntry** newHeap = new DelayQueueEntry*[2*fHeapCapacity];
+    for (unsigned i = 0; i < fHeapSize; ++i) newHeap[i] = fHeap[i];
+    delete[] fHeap;
+    fHeap = newHeap;
+    fHeapCapacity *= 2;
+  }
+  placeAt(fHeapSize++, newEntry);
+  siftUp(newEntry->fHeapIndex);
 
-  // Add "newEntry" to the queue, just before "cur":
-  newEntry->fNext = cur;
-  newEntry->fPrev = cur->fPrev;
-  cur->fPrev = newEntry->fPrev->fNext = newEntry;
+  fEntriesByToken->Add((char const*)(newEntry->token()), newEntry);
 }
 
 void DelayQueue::updateEntry(DelayQueueEntry* entry, DelayInterval newDelay) {
@@ -154,13 +166,19 @@ void DelayQueue::updateEntry(intptr_t tokenToFind, DelayInterval newDelay) {
 }
 
 void DelayQueue::removeEntry(DelayQueueEntry* entry) {
-  if (entry == NULL || entry->fNext == NULL) return;
+  if (entry == NULL || entry->fHeapIndex < 0) return;
+
+  fEntriesByToken->Remove((char const*)(entry->token()));
 
-  entry->fNext->fDeltaTimeRemaining += entry->fDeltaTimeRemaining;
-  entry->fPrev->fNext = entry->fNext;
-  entry->fNext->fPrev = entry->fPrev;
-  entry->fNext = entry->fPrev = NULL;
-  // in case we should try to remove it again
+  // Fill the hole with the last entry in the heap, and restore the heap order:
+  unsigned index = (unsigned)entry->fHeapIndex;
+  DelayQueueEntry* last = fHeap[--fHeapSize];
+  if (last != entry) {
+    placeAt(index, last);
+    siftUp(index);
+    siftDown(last->fHeapIndex);
+  }
+  entry->fHeapIndex = -1; // in case we should try to remove it again
 }
 
 DelayQueueEntry* DelayQueue::removeEntry(intptr_t tokenToFind) {
@@ -170,16 +188,18 @@ DelayQueueEntry* DelayQueue::removeEntry(intptr_t tokenToFind) {
 }
 
 DelayInterval const& DelayQueue::timeToNextAlarm() {
-  if (head()->fDeltaTimeRemaining == DELAY_ZERO) return DELAY_ZERO; // a common case
+  if (fHeapSize == 0) return ETERNITY;
 
   synchronize();
-  return head()->fDeltaTimeRemaining;
+  fTimeToNextAlarm = head()->fDueTime - fLastSyncTime;
+  return fTimeToNextAlarm;
 }
 
 void DelayQueue::handleAlarm() {
-  if (head()->fDeltaTimeRemaining != DELAY_ZERO) synchronize();
+  if (fHeapSize == 0) return;
 
-  if (head()->fDeltaTimeRemaining == DELAY_ZERO) {
+  synchronize();
+  if (head()->fDueTime <= fLastSyncTime) {
     // This event is due to be handled:
     DelayQueueEntry* toRemove = head();
     removeEntry(toRemove); // do this first, in case handler accesses queue
@@ -189,34 +209,60 @@ void DelayQueue::handleAlarm() {
 }
 
 DelayQueueEntry* DelayQueue::findEntryByToken(intptr_t tokenToFind) {
-  DelayQueueEntry* cur = head();
-  while (cur != this) {
-    if (cur->token() == tokenToFind) return cur;
-    cur = cur->fNext;
-  }
-
-  return NULL;
+  return (DelayQueueEntry*)(fEntriesByToken->Lookup((char const*)tokenToFind));
 }
 
 void DelayQueue::synchronize() {
-  // First, figure out how much time has elapsed since the last sync:
   EventTime timeNow = TimeNow();
   if (timeNow < fLastSyncTime) {
-    // The system clock has apparently gone back in time; reset our sync time and return:
-    fLastSyncTime  = timeNow;
-    return;
+    // The system clock has apparently gone back in time.  Move all due times back by the same amount,
+    // so that the time remaining for each entry stays the same:
+    DelayInterval timeWentBack = fLastSyncTime - timeNow;
+    for (unsigned i = 0; i < fHeapSize; ++i) fHeap[i]->fDueTime -= timeWentBack;
+    // (Due times that got clamped at zero may now compare differently, so re-heapify.)
+    for (unsigned i = fHeapSize; i-- > 0; ) siftDown(i);
   }
-  DelayInterval timeSinceLastSync = timeNow - fLastSyncTime;
   fLastSyncTime = timeNow;
+}
+
+int DelayQueue::isEarlier(DelayQueueEntry const* entry1, DelayQueueEntry const* entry2) const {
+  if (entry1->fDueTime != entry2->fDueTime) return entry1->fDueTime < entry2->fDueTime;
+  return entry1->fSequenceNum < entry2->fSequenceNum;
+}
+
+void DelayQueue::placeAt(unsigned index, DelayQueueEntry* entry) {
+  fHeap[index] = entry;
+  entry->fHeapIndex = (int)index;
+}
+
+void DelayQueue::siftUp(unsigned index) {
+  DelayQueueEntry* entry = fHeap[index];
+  while (index > 0) {
+    unsigned parent = (index-1)/HEAP_ARITY;
+    if (!isEarlier(entry, fHeap[parent])) break;
+    placeAt(index, fHeap[parent]);
+    index = parent;
+  }
+  placeAt(index, entry);
+}
 
-  // Then, adjust the delay queue for any entries whose time is up:
-  DelayQueueEntry* curEntry = head();
-  while (timeSinceLastSync >= curEntry->fDeltaTimeRemaining) {
-    timeSinceLastSync -= curEntry->fDeltaTimeRemaining;
-    curEntry->fDeltaTimeRemaining = DELAY_ZERO;
-    curEntry = curEntry->fNext;
+void DelayQueue::siftDown(unsigned index) {
+  DelayQueueEntry* entry = fHeap[index];
+  while (1) {
+    unsigned firstChild = HEAP_ARITY*index + 1;
+    if (firstChild >= fHeapSize) break;
+
+    unsigned lastChild = firstChild + HEAP_ARITY - 1;
+    if (lastChild >= fHeapSize) lastChild = fHeapSize - 1;
+    unsigned earliest = firstChild;
+    for (unsigned child = firstChild + 1; child <= lastChild; ++child) {
+      if (isEarlier(fHeap[child], fHeap[earliest])) earliest = child;
+    }
+    if (!isEarlier(fHeap[earliest], entry)) break;
+    placeAt(index, fHeap[earliest]);
+    index = earliest;
   }
-  curEntry->fDeltaTimeRemaining -= timeSinceLastSync;
+  placeAt(index, entry);
 }
 
 
@@ -0,0 +1,190 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// Basic Usage Environment: for a simple, non-scripted, console application
+// Implementation
+
+#include "EpollTaskScheduler.hh"
+
+#if defined(__linux__)
+#include "HandlerSet.hh"
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define MAX_EPOLL_EVENTS_PER_STEP 64
+
+////////// EpollTaskScheduler //////////
+
+EpollTaskScheduler* EpollTaskScheduler::createNew(Boolean edgeTriggered) {
+  int epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd < 0) return NULL;
+
+  int wakeupFd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+  if (wakeupFd < 0) {
+    close(epollFd);
+    return NULL;
+  }
+
+  return new EpollTaskScheduler(epollFd, wakeupFd, edgeTriggered);
+}
+
+EpollTaskScheduler::EpollTaskScheduler(int epollFd, int wakeupFd, Boolean edgeTriggered)
+  : fEpollFd(epollFd), fWakeupFd(wakeupFd), fEdgeTriggered(edgeTriggered) {
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = fWakeupFd;
+  epoll_ctl(fEpollFd, EPOLL_CTL_ADD, fWakeupFd, &event);
+}
+
+EpollTaskScheduler::~EpollTaskScheduler() {
+  close(fWakeupFd);
+  close(fEpollFd);
+}
+
+#ifndef MILLION
+#define MILLION 1000000
+#endif
+
+void EpollTaskScheduler::SingleStep(unsigned maxDelayTime) {
+  DelayInterval const& timeToDelay = fDelayQueue.timeToNextAlarm();
+  // "epoll_wait()" has a granularity of 1 ms; round up, so that we don't busy-wait for an alarm:
+  const long MAX_DELAY_SEC = MILLION; // don't wait any longer than 1 million seconds (11.5 days)
+  long timeoutMs = timeToDelay.seconds() > MAX_DELAY_SEC
+    ? MAX_DELAY_SEC*1000
+    : timeToDelay.seconds()*1000 + (timeToDelay.useconds()+999)/1000;
+  // Also check our "maxDelayTime" parameter (if it's > 0):
+  if (maxDelayTime > 0 && timeoutMs > (long)(maxDelayTime+999)/1000) {
+    timeoutMs = (maxDelayTime+999)/1000;
+  }
+  if (fTriggersAwaitingHandling != 0) timeoutMs = 0;
+
+  // Note: The events array is local (rather than a member), in case a handler calls "doEventLoop()" reentrantly.
+  struct epoll_event events[MAX_EPOLL_EVENTS_PER_STEP];
+  int numEvents = epoll_wait(fEpollFd, events, MAX_EPOLL_EVENTS_PER_STEP, (int)timeoutMs);
+  if (numEvents < 0) {
+    if (errno != EINTR) {
+      // Unexpected error - treat this as fatal:
+      perror("EpollTaskScheduler::SingleStep(): epoll_wait() fails");
+      internalError();
+    }
+    numEvents = 0;
+  }
+
+  // Call the handler function for each ready socket:
+  for (int i = 0; i < numEvents; ++i) {
+    int sock = events[i].data.fd; // alias
+    if (sock == fWakeupFd) {
+      eventfd_t dummy;
+      eventfd_read(fWakeupFd, &dummy);
+      continue;
+    }
+
+    // Look up the handler only now, because an earlier handler in this loop might have
+    // changed or removed it:
+    HandlerDescriptor* handler = fHandlers->lookupHandler(sock);
+    if (handler == NULL || handler->handlerProc == NULL) continue;
+
+    // Report errors and hangups as 'readable' (as "select()" does), so that the handler gets to see them:
+    unsigned ready = events[i].events;
+    int resultConditionSet = 0;
+    if (ready&(EPOLLIN|EPOLLHUP|EPOLLRDHUP|EPOLLERR)) resultConditionSet |= SOCKET_READABLE;
+    if (ready&EPOLLOUT) resultConditionSet |= SOCKET_WRITABLE;
+    if (ready&EPOLLPRI) resultConditionSet |= SOCKET_EXCEPTION;
+    resultConditionSet &= handler->conditionSet;
+    if (resultConditionSet == 0 && (ready&(EPOLLHUP|EPOLLERR)) != 0) {
+      resultConditionSet = handler->conditionSet; // let the handler find out about the error
+    }
+    if (resultConditionSet != 0) {
+      fLastHandledSocketNum = sock;
+      (*handler->handlerProc)(handler->clientData, resultConditionSet);
+    }
+  }
+
+  // Also handle any newly-triggered event (Note that we do this *after* calling socket handlers,
+  // in case the triggered event handler modifies the set of readable sockets.)
+  handleTriggeredEvents();
+
+  // Also handle any delayed event that may have come due.
+  fDelayQueue.handleAlarm();
+}
+
+void EpollTaskScheduler
+  ::setBackgroundHandling(int socketNum, int conditionSet, BackgroundHandlerProc* handlerProc, void* clientData) {
+  if (socketNum < 0) return;
+  if (conditionSet == 0) {
+    if (fHandlers->lookupHandler(socketNum) != NULL) {
+      fHandlers->clearHandler(socketNum);
+      struct epoll_event event; // (ignored, but required by pre-2.6.9 kernels)
+      epoll_ctl(fEpollFd, EPOLL_CTL_DEL, socketNum, &event); // the socket might have been closed already; that's OK
+    }
+  } else {
+    Boolean isNewSocket = fHandlers->lookupHandler(socketNum) == NULL;
+    fHandlers->assignHandler(socketNum, conditionSet, handlerProc, clientData);
+    updateEpollRegistration(socketNum, conditionSet, isNewSocket);
+  }
+}
+
+void EpollTaskScheduler::moveSocketHandling(int oldSocketNum, int newSocketNum) {
+  if (oldSocketNum < 0 || newSocketNum < 0) return; // sanity check
+  HandlerDescriptor* handler = fHandlers->lookupHandler(oldSocketNum);
+  if (handler == NULL) return;
+
+  int conditionSet = handler->conditionSet;
+  Boolean isNewSocket = fHandlers->lookupHandler(newSocketNum) == NULL;
+  fHandlers->moveHandler(oldSocketNum, newSocketNum);
+
+  struct epoll_event event;
+  epoll_ctl(fEpollFd, EPOLL_CTL_DEL, oldSocketNum, &event);
+  updateEpollRegistration(newSocketNum, conditionSet, isNewSocket);
+}
+
+void EpollTaskScheduler::triggerEvent(EventTriggerId eventTriggerId, void* clientData) {
+  BasicTaskScheduler0::triggerEvent(eventTriggerId, clientData);
+
+  // Then, wake up the event loop (which may be blocked in "epoll_wait()" in another thread):
+  eventfd_write(fWakeupFd, 1);
+}
+
+unsigned EpollTaskScheduler::epollEventsFor(int conditionSet) const {
+  unsigned events = 0;
+  if (conditionSet&SOCKET_READABLE) events |= EPOLLIN|EPOLLRDHUP;
+  if (conditionSet&SOCKET_WRITABLE) events |= EPOLLOUT;
+  if (conditionSet&SOCKET_EXCEPTION) events |= EPOLLPRI;
+  if (fEdgeTriggered) events |= EPOLLET;
+  return events;
+}
+
+void EpollTaskScheduler::updateEpollRegistration(int socketNum, int conditionSet, Boolean isNewSocket) {
+  struct epoll_event event;
+  event.events = epollEventsFor(conditionSet);
+  event.data.fd = socketNum;
+
+  int op = isNewSocket ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+  if (epoll_ctl(fEpollFd, op, socketNum, &event) < 0) {
+    // Our idea of what's registered can be out of date if a socket was closed (and its number reused)
+    // without its handling having been turned off first.  In that case, try the other way:
+    if (errno == ENOENT) {
+      epoll_ctl(fEpollFd, EPOLL_CTL_ADD, socketNum, &event);
+    } else if (errno == EEXIST) {
+      epoll_ctl(fEpollFd, EPOLL_CTL_MOD, socketNum, &event);
+    }
+  }
+}
+
+#endif
@@ -95,6 +95,9 @@ public:
 protected:
   BasicTaskScheduler0();
 
+  void handleTriggeredEvents();
+      // Calls the handler of (at most) one event that has been triggered since the last call
+
 protected:
   // To implement delayed operations:
   DelayQueue fDelayQueue;
@@ -147,9 +147,10 @@ protected: // abstract base class
 
 private:
   friend class DelayQueue;
-  DelayQueueEntry* fNext;
-  DelayQueueEntry* fPrev;
-  DelayInterval fDeltaTimeRemaining;
+  DelayInterval fDeltaTimeRemaining; // the delay requested, until the entry gets queued
+  EventTime fDueTime; // while queued
+  intptr_t fSequenceNum; // keeps entries that are due at the same time in FIFO order
+  int fHeapIndex; // -1 if not queued
 
   intptr_t fToken;
   static intptr_t tokenCounter;
@@ -157,6 +158,12 @@ private:
 
 ///// DelayQueue /////
 
+// Entries are kept in a 4-ary min-heap ordered by due time, with a hash table mapping tokens
+// to entries, so that adding, removing (by entry or by token) and rescheduling are all
+// O(log n), and finding the next alarm is O(1).
+
+class HashTable; // forward
+
 class DelayQueue: public DelayQueueEntry {
 public:
   DelayQueue();
@@ -172,11 +179,22 @@ public:
   void handleAlarm();
 
 private:
-  DelayQueueEntry* head() { return fNext; }
+  DelayQueueEntry* head() { return fHeapSize > 0 ? fHeap[0] : NULL; }
   DelayQueueEntry* findEntryByToken(intptr_t token);
-  void synchronize(); // bring the 'time remaining' fields up-to-date
+  void synchronize(); // cope with the system clock having gone back in time
+
+  // Heap operations:
+  int isEarlier(DelayQueueEntry const* entry1, DelayQueueEntry const* entry2) const;
+  void placeAt(unsigned index, DelayQueueEntry* entry);
+  void siftUp(unsigned index);
+  void siftDown(unsigned index);
 
   EventTime fLastSyncTime;
+  DelayInterval fTimeToNextAlarm;
+  DelayQueueEntry** fHeap;
+  unsigned fHeapSize, fHeapCapacity;
+  intptr_t fSequenceCounter;
+  HashTable* fEntriesByToken;
 };
 
 #endif
@@ -0,0 +1,69 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// Basic Usage Environment: for a simple, non-scripted, console application
+// C++ header
+
+#ifndef _EPOLL_TASK_SCHEDULER_HH
+#define _EPOLL_TASK_SCHEDULER_HH
+
+#ifndef _BASIC_USAGE_ENVIRONMENT0_HH
+#include "BasicUsageEnvironment0.hh"
+#endif
+
+#if defined(__linux__)
+
+// A task scheduler that waits for socket events using "epoll" rather than "select()".
+// Unlike "BasicTaskScheduler", it is not limited to FD_SETSIZE sockets, its cost per event loop
+// iteration doesn't grow with the number of sockets being handled, and it calls the handlers
+// of all sockets that are ready (rather than just one) per "SingleStep()".
+// Also, "triggerEvent()" wakes up the event loop immediately (so no 'scheduler tick' is needed).
+class EpollTaskScheduler: public BasicTaskScheduler0 {
+public:
+  static EpollTaskScheduler* createNew(Boolean edgeTriggered = False);
+    // If "edgeTriggered" is True, sockets are registered with EPOLLET; this is cheaper, but
+    // *every* background handler must then read (or write) its socket until it would block,
+    // otherwise remaining data won't get reported again.  Most "liveMedia" handlers (e.g.,
+    // those of "MultiFramedRTPSource") handle just one packet per call, so leave this False
+    // unless you know what you're doing.
+  virtual ~EpollTaskScheduler();
+
+protected:
+  EpollTaskScheduler(int epollFd, int wakeupFd, Boolean edgeTriggered);
+      // called only by "createNew()"
+
+protected:
+  // Redefined virtual functions:
+  virtual void SingleStep(unsigned maxDelayTime);
+
+  virtual void setBackgroundHandling(int socketNum, int conditionSet, BackgroundHandlerProc* handlerProc, void* clientData);
+  virtual void moveSocketHandling(int oldSocketNum, int newSocketNum);
+
+  virtual void triggerEvent(EventTriggerId eventTriggerId, void* clientData = NULL);
+
+private:
+  unsigned epollEventsFor(int conditionSet) const;
+  void updateEpollRegistration(int socketNum, int conditionSet, Boolean isNewSocket);
+
+private:
+  int fEpollFd;
+  int fWakeupFd; // an "eventfd", written by "triggerEvent()"
+  Boolean fEdgeTriggered;
+};
+
+#endif
+
+#endif
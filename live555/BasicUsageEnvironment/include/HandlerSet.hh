@@ -24,6 +24,8 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #include "Boolean.hh"
 #endif
 
+class HashTable; // forward
+
 ////////// HandlerSet (etc.) definition //////////
 
 class HandlerDescriptor {
@@ -53,12 +55,12 @@ public:
   void clearHandler(int socketNum);
   void moveHandler(int oldSocketNum, int newSocketNum);
 
-private:
-  HandlerDescriptor* lookupHandler(int socketNum);
+  HandlerDescriptor* lookupHandler(int socketNum); // returns NULL if none
 
 private:
   friend class HandlerIterator;
   HandlerDescriptor fHandlers;
+  HashTable* fHandlersBySocketNum; // index of the above list, so that lookups are O(1)
 };
 
 class HandlerIterator {
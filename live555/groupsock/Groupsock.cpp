@@ -68,6 +68,34 @@ Boolean OutputSocket::write(netAddressBits address, Port port, u_int8_t ttl,
   return True;
 }
 
+Boolean OutputSocket::writeBatch(struct sockaddr_in const* dests, unsigned numDests, u_int8_t ttl,
+				 unsigned char* packets, unsigned const* packetSizes, unsigned numPackets,
+				 Boolean& useSegmentationOffload) {
+  if ((unsigned)ttl == fLastSentTTL) {
+    // Optimization: Don't do a 'set TTL' system call again
+    if (!writeSocketBatch(env(), socketNum(), dests, numDests,
+			  packets, packetSizes, numPackets, useSegmentationOffload)) return False;
+  } else {
+    if (!writeSocketBatch(env(), socketNum(), dests, numDests, ttl,
+			  packets, packetSizes, numPackets, useSegmentationOffload)) return False;
+    fLastSentTTL = (unsigned)ttl;
+  }
+
+  if (sourcePortNum() == 0) {
+    // Now that we've sent a packet, we can find out what the
+    // kernel chose as our ephemeral source port number:
+    if (!getSourcePort(env(), socketNum(), fSourcePort)) {
+      if (DebugLevel >= 1)
+	env() << *this
+	     << ": failed to get source port: "
+	     << env().getResultMsg() << "\n";
+      return False;
+    }
+  }
+
+  return True;
+}
+
 // By default, we don't do reads:
 Boolean OutputSocket
 ::handleRead(unsigned char* /*buffer*/, unsigned /*bufferMaxSize*/,
@@ -101,7 +129,10 @@ Groupsock::Groupsock(UsageEnvironment& env, struct in_addr const& groupAddr,
 		     Port port, u_int8_t ttl)
   : OutputSocket(env, port),
     deleteIfNoMembers(False), isSlave(False),
-    fIncomingGroupEId(groupAddr, port.num(), ttl), fDests(NULL), fTTL(ttl) {
+    fIncomingGroupEId(groupAddr, port.num(), ttl), fDests(NULL), fTTL(ttl),
+    fIsBatchingOutput(False), fUseSegmentationOffload(False), fSegmentationOffloadWorks(True),
+    fBatchBuffer(NULL), fBatchSize(0), fNumBatchedPackets(0), fBatchTTL(ttl),
+    fDestAddresses(NULL), fDestAddressesSize(0) {
   addDestination(groupAddr, port);
 
   if (!socketJoinGroup(env, socketNum(), groupAddr.s_addr)) {
@@ -129,7 +160,10 @@ Groupsock::Groupsock(UsageEnvironment& env, struct in_addr const& groupAddr,
   : OutputSocket(env, port),
     deleteIfNoMembers(False), isSlave(False),
     fIncomingGroupEId(groupAddr, sourceFilterAddr, port.num()),
-    fDests(NULL), fTTL(255) {
+    fDests(NULL), fTTL(255),
+    fIsBatchingOutput(False), fUseSegmentationOffload(False), fSegmentationOffloadWorks(True),
+    fBatchBuffer(NULL), fBatchSize(0), fNumBatchedPackets(0), fBatchTTL(255),
+    fDestAddresses(NULL), fDestAddressesSize(0) {
   addDestination(groupAddr, port);
 
   // First try a SSM join.  If that fails, try a regular join:
@@ -162,6 +196,8 @@ Groupsock::~Groupsock() {
   }
 
   delete fDests;
+  delete[] fBatchBuffer;
+  delete[] fDestAddresses;
 
   if (DebugLevel >= 2) env() << *this << ": deleting\n";
 }
@@ -249,13 +285,17 @@ Boolean Groupsock::output(UsageEnvironment& env, u_int8_t ttlToSend,
 			  unsigned char* buffer, unsigned bufferSize,
 			  DirectedNetInterface* interfaceNotToFwdBackTo) {
   do {
-    // First, do the datagram send, to each destination:
+    // First, do the datagram send, to each destination (or add it to the batch to be sent):
     Boolean writeSuccess = True;
-    for (destRecord* dests = fDests; dests != NULL; dests = dests->fNext) {
-      if (!write(dests->fGroupEId.groupAddress().s_addr, dests->fPort, ttlToSend,
-		 buffer, bufferSize)) {
-	writeSuccess = False;
-	break;
+    if (fIsBatchingOutput) {
+      writeSuccess = addToOutputBatch(ttlToSend, buffer, bufferSize);
+    } else {
+      for (destRecord* dests = fDests; dests != NULL; dests = dests->fNext) {
+	if (!write(dests->fGroupEId.groupAddress().s_addr, dests->fPort, ttlToSend,
+		   buffer, bufferSize)) {
+	  writeSuccess = False;
+	  break;
+	}
       }
     }
     if (!writeSuccess) break;
@@ -289,6 +329,77 @@ Boolean Groupsock::output(UsageEnvironment& env, u_int8_t ttlToSend,
   return False;
 }
 
+void Groupsock::beginOutputBatch(Boolean useSegmentationOffload) {
+  if (fIsBatchingOutput) return;
+
+  if (fBatchBuffer == NULL) fBatchBuffer = new unsigned char[GROUPSOCK_OUTPUT_BATCH_BUFFER_SIZE];
+  fIsBatchingOutput = True;
+  fUseSegmentationOffload = useSegmentationOffload;
+}
+
+Boolean Groupsock::endOutputBatch(UsageEnvironment& env) {
+  if (!fIsBatchingOutput) return True;
+
+  fIsBatchingOutput = False;
+  if (sendOutputBatch()) return True;
+
+  if (DebugLevel >= 0) { // this is a fatal error
+    env.setResultMsg("Groupsock write failed: ", env.getResultMsg());
+  }
+  return False;
+}
+
+Boolean Groupsock::addToOutputBatch(u_int8_t ttl, unsigned char* buffer, unsigned bufferSize) {
+  if (fNumBatchedPackets > 0
+      && (fNumBatchedPackets == GROUPSOCK_MAX_BATCHED_PACKETS
+	  || fBatchSize + bufferSize > GROUPSOCK_OUTPUT_BATCH_BUFFER_SIZE
+	  || ttl != fBatchTTL)) {
+    // Send the packets that we've collected so far, before collecting more:
+    if (!sendOutputBatch()) return False;
+  }
+
+  if (bufferSize > GROUPSOCK_OUTPUT_BATCH_BUFFER_SIZE) {
+    // This packet (which is unusually large) doesn't fit in our batch, so send it right away:
+    return writeToAllDestinations(ttl, buffer, &bufferSize, 1);
+  }
+
+  memmove(&fBatchBuffer[fBatchSize], buffer, bufferSize);
+  fBatchSize += bufferSize;
+  fBatchPacketSizes[fNumBatchedPackets++] = bufferSize;
+  fBatchTTL = ttl;
+  return True;
+}
+
+Boolean Groupsock::sendOutputBatch() {
+  if (fNumBatchedPackets == 0) return True;
+
+  Boolean result = writeToAllDestinations(fBatchTTL, fBatchBuffer, fBatchPacketSizes, fNumBatchedPackets);
+  fBatchSize = fNumBatchedPackets = 0;
+  return result;
+}
+
+Boolean Groupsock::writeToAllDestinations(u_int8_t ttl,
+					  unsigned char* packets, unsigned const* packetSizes, unsigned numPackets) {
+  unsigned numDests = 0;
+  for (destRecord* dests = fDests; dests != NULL; dests = dests->fNext) ++numDests;
+  if (numDests > fDestAddressesSize) {
+    delete[] fDestAddresses;
+    fDestAddresses = new struct sockaddr_in[numDests];
+    fDestAddressesSize = numDests;
+  }
+
+  unsigned i = 0;
+  for (destRecord* dests = fDests; dests != NULL; dests = dests->fNext) {
+    MAKE_SOCKADDR_IN(dest, dests->fGroupEId.groupAddress().s_addr, dests->fPort.num());
+    fDestAddresses[i++] = dest;
+  }
+
+  Boolean useSegmentationOffload = fUseSegmentationOffload && fSegmentationOffloadWorks;
+  Boolean result = writeBatch(fDestAddresses, numDests, ttl, packets, packetSizes, numPackets, useSegmentationOffload);
+  if (fUseSegmentationOffload && !useSegmentationOffload) fSegmentationOffloadWorks = False; // don't try it again
+  return result;
+}
+
 Boolean Groupsock::handleRead(unsigned char* buffer, unsigned bufferMaxSize,
 			      unsigned& bytesRead,
 			      struct sockaddr_in& fromAddress) {
@@ -308,24 +419,46 @@ Boolean Groupsock::handleRead(unsigned char* buffer, unsigned bufferMaxSize,
     return False;
   }
 
+  bytesRead = handleDatagram(buffer, numBytes, fromAddress);
+  return True;
+}
+
+int Groupsock::handleReadBatch(unsigned char* const* buffers, unsigned bufferMaxSize, unsigned numBuffers,
+			       unsigned* bytesRead) {
+  if (numBuffers > GROUPSOCK_MAX_BATCHED_PACKETS) numBuffers = GROUPSOCK_MAX_BATCHED_PACKETS;
+
+  struct sockaddr_in fromAddresses[GROUPSOCK_MAX_BATCHED_PACKETS];
+  int numRead = readSocketBatch(env(), socketNum(), buffers, bufferMaxSize - TunnelEncapsulationTrailerMaxSize,
+				numBuffers, bytesRead, fromAddresses);
+  if (numRead < 0) {
+    if (DebugLevel >= 0) { // this is a fatal error
+      env().setResultMsg("Groupsock read failed: ",
+			 env().getResultMsg());
+    }
+    return -1;
+  }
+
+  for (int i = 0; i < numRead; ++i) bytesRead[i] = handleDatagram(buffers[i], bytesRead[i], fromAddresses[i]);
+  return numRead;
+}
+
+unsigned Groupsock::handleDatagram(unsigned char* buffer, unsigned numBytes, struct sockaddr_in& fromAddress) {
   // If we're a SSM group, make sure the source address matches:
   if (isSSM()
       && fromAddress.sin_addr.s_addr != sourceFilterAddress().s_addr) {
-    return True;
+    return 0;
   }
 
   // We'll handle this data.
   // Also write it (with the encapsulation trailer) to each member,
   // unless the packet was originally sent by us to begin with.
-  bytesRead = numBytes;
-
   int numMembers = 0;
   if (!wasLoopedBackFromUs(env(), fromAddress)) {
     statsIncoming.countPacket(numBytes);
     statsGroupIncoming.countPacket(numBytes);
     numMembers =
       outputToAllMembersExcept(NULL, ttl(),
-			       buffer, bytesRead,
+			       buffer, numBytes,
 			       fromAddress.sin_addr.s_addr);
     if (numMembers > 0) {
       statsRelayedIncoming.countPacket(numBytes);
@@ -333,14 +466,14 @@ Boolean Groupsock::handleRead(unsigned char* buffer, unsigned bufferMaxSize,
     }
   }
   if (DebugLevel >= 3) {
-    env() << *this << ": read " << bytesRead << " bytes from " << AddressString(fromAddress).val();
+    env() << *this << ": read " << numBytes << " bytes from " << AddressString(fromAddress).val();
     if (numMembers > 0) {
       env() << "; relayed to " << numMembers << " members";
     }
     env() << "\n";
   }
 
-  return True;
+  return numBytes;
 }
 
 Boolean Groupsock::wasLoopedBackFromUs(UsageEnvironment& env,
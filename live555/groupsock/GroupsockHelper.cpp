@@ -264,6 +264,22 @@ int setupStreamSocket(UsageEnvironment& env,
   return newSocket;
 }
 
+#if defined(__linux__) && !defined(NO_MMSG)
+// Datagrams can be sent and received in batches, with "sendmmsg()" and "recvmmsg()":
+#include <netinet/udp.h>
+#define HAVE_MMSG 1
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103 // (older headers lack this, even though the running kernel might support it)
+#endif
+#define MAX_MESSAGES_PER_SENDMMSG 64
+#define MAX_PACKETS_PER_WRITE_BATCH 64 // also the most segments that all kernels will accept in a UDP GSO message
+#define MAX_UDP_GSO_MESSAGE_SIZE 65507 // the most data that fits in a (non-segmented) IPv4 UDP datagram
+#define MAX_MESSAGES_PER_RECVMMSG 64
+#endif
+
 int readSocket(UsageEnvironment& env,
 	       int socket, unsigned char* buffer, unsigned bufferSize,
 	       struct sockaddr_in& fromAddress) {
@@ -300,6 +316,49 @@ int readSocket(UsageEnvironment& env,
   return bytesRead;
 }
 
+int readSocketBatch(UsageEnvironment& env,
+		    int socket, unsigned char* const* buffers, unsigned bufferSize, unsigned numBuffers,
+		    unsigned* bytesRead, struct sockaddr_in* fromAddresses) {
+#ifdef HAVE_MMSG
+  if (numBuffers > MAX_MESSAGES_PER_RECVMMSG) numBuffers = MAX_MESSAGES_PER_RECVMMSG;
+
+  struct mmsghdr msgs[MAX_MESSAGES_PER_RECVMMSG];
+  struct iovec iov[MAX_MESSAGES_PER_RECVMMSG];
+  for (unsigned i = 0; i < numBuffers; ++i) {
+    iov[i].iov_base = buffers[i];
+    iov[i].iov_len = bufferSize;
+    memset(&msgs[i].msg_hdr, 0, sizeof msgs[i].msg_hdr);
+    msgs[i].msg_hdr.msg_name = &fromAddresses[i];
+    msgs[i].msg_hdr.msg_namelen = sizeof fromAddresses[i];
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  int numRead = recvmmsg(socket, msgs, numBuffers, MSG_DONTWAIT, NULL);
+  if (numRead < 0) {
+    // (See the 'HACK' in "readSocket()" above.)
+    int err = env.getErrno();
+    if (err == 111 /*ECONNREFUSED (Linux)*/ || err == EAGAIN || err == EINTR
+	|| err == 113 /*EHOSTUNREACH (Linux)*/) {
+      return 0;
+    }
+    socketErr(env, "recvmmsg() error: ");
+    return -1;
+  }
+
+  for (int i = 0; i < numRead; ++i) bytesRead[i] = msgs[i].msg_len;
+  return numRead;
+#else
+  if (numBuffers == 0) return 0;
+
+  int numBytes = readSocket(env, socket, buffers[0], bufferSize, fromAddresses[0]);
+  if (numBytes <= 0) return numBytes;
+
+  bytesRead[0] = numBytes;
+  return 1;
+#endif
+}
+
 Boolean writeSocket(UsageEnvironment& env,
 		    int socket, struct in_addr address, Port port,
 		    u_int8_t ttlArg,
@@ -340,6 +399,144 @@ Boolean writeSocket(UsageEnvironment& env,
   return False;
 }
 
+#ifdef HAVE_MMSG
+static unsigned sendMessages(int socket, struct mmsghdr* msgs, unsigned numMsgs) {
+  // Returns the number of messages sent before an error (if any) occurred:
+  unsigned numSent = 0;
+  while (numSent < numMsgs) {
+    int result = sendmmsg(socket, &msgs[numSent], numMsgs - numSent, 0);
+    if (result < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    numSent += result;
+  }
+
+  return numSent;
+}
+#endif
+
+Boolean writeSocketBatch(UsageEnvironment& env,
+			 int socket, struct sockaddr_in const* dests, unsigned numDests,
+			 u_int8_t ttlArg,
+			 unsigned char* packets, unsigned const* packetSizes, unsigned numPackets,
+			 Boolean& useSegmentationOffload) {
+  // Before sending, set the socket's TTL:
+  TTL_TYPE ttl = (TTL_TYPE)ttlArg;
+  if (setsockopt(socket, IPPROTO_IP, IP_MULTICAST_TTL,
+		 (const char*)&ttl, sizeof ttl) < 0) {
+    socketErr(env, "setsockopt(IP_MULTICAST_TTL) error: ");
+    return False;
+  }
+
+  return writeSocketBatch(env, socket, dests, numDests, packets, packetSizes, numPackets, useSegmentationOffload);
+}
+
+Boolean writeSocketBatch(UsageEnvironment& env,
+			 int socket, struct sockaddr_in const* dests, unsigned numDests,
+			 unsigned char* packets, unsigned const* packetSizes, unsigned numPackets,
+			 Boolean& useSegmentationOffload) {
+#ifdef HAVE_MMSG
+  if (numPackets > MAX_PACKETS_PER_WRITE_BATCH) {
+    // Send the packets in several batches (each of which goes to every destination):
+    unsigned firstBatchSize = 0;
+    for (unsigned i = 0; i < MAX_PACKETS_PER_WRITE_BATCH; ++i) firstBatchSize += packetSizes[i];
+
+    return writeSocketBatch(env, socket, dests, numDests, packets, packetSizes, MAX_PACKETS_PER_WRITE_BATCH,
+			    useSegmentationOffload)
+      && writeSocketBatch(env, socket, dests, numDests, &packets[firstBatchSize], &packetSizes[MAX_PACKETS_PER_WRITE_BATCH],
+			  numPackets - MAX_PACKETS_PER_WRITE_BATCH, useSegmentationOffload);
+  }
+
+  // Every destination gets the same packets, so they share "iovec"s:
+  struct iovec iov[MAX_PACKETS_PER_WRITE_BATCH];
+  unsigned totalSize = 0;
+  for (unsigned i = 0; i < numPackets; ++i) {
+    iov[i].iov_base = &packets[totalSize];
+    iov[i].iov_len = packetSizes[i];
+    totalSize += packetSizes[i];
+  }
+
+  // Check whether the packets can be sent as one UDP GSO message (to each destination).  The kernel splits such a message
+  // into segments of the same size - so only the last packet may be shorter than the others:
+  unsigned segmentSize = 0;
+  if (useSegmentationOffload && numPackets > 1 && totalSize <= MAX_UDP_GSO_MESSAGE_SIZE) {
+    segmentSize = packetSizes[0];
+    for (unsigned i = 1; i < numPackets; ++i) {
+      if (packetSizes[i] > segmentSize || (packetSizes[i] < segmentSize && i < numPackets-1)) {
+	segmentSize = 0;
+	break;
+      }
+    }
+  }
+  union { // (to get the alignment right)
+    char buf[CMSG_SPACE(sizeof (u_int16_t))];
+    struct cmsghdr align;
+  } control;
+  if (segmentSize > 0) {
+    struct cmsghdr* cmsg = (struct cmsghdr*)control.buf;
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof (u_int16_t));
+    *(u_int16_t*)CMSG_DATA(cmsg) = (u_int16_t)segmentSize;
+  }
+
+  struct mmsghdr msgs[MAX_MESSAGES_PER_SENDMMSG];
+  unsigned numMsgs = 0;
+  unsigned firstDestInMsgs = 0;
+  for (unsigned d = 0; d < numDests; ++d) {
+    unsigned const numMsgsPerDest = segmentSize > 0 ? 1 : numPackets;
+    for (unsigned i = 0; i < numMsgsPerDest; ++i) {
+      struct msghdr& msg = msgs[numMsgs].msg_hdr;
+      memset(&msg, 0, sizeof msg);
+      msg.msg_name = (void*)&dests[d];
+      msg.msg_namelen = sizeof dests[d];
+      if (segmentSize > 0) {
+	msg.msg_iov = iov;
+	msg.msg_iovlen = numPackets;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof control.buf;
+      } else {
+	msg.msg_iov = &iov[i];
+	msg.msg_iovlen = 1;
+      }
+      if (++numMsgs < MAX_MESSAGES_PER_SENDMMSG && !(d == numDests-1 && i == numMsgsPerDest-1)) continue;
+
+      unsigned numSent = sendMessages(socket, msgs, numMsgs);
+      if (numSent < numMsgs) {
+	if (segmentSize > 0 && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP)) {
+	  // The kernel (or the outgoing interface) can't do segmentation offload.  Stop using it, and resend without it
+	  // (to the destinations that haven't been sent to yet - there's one message per destination):
+	  useSegmentationOffload = False;
+	  unsigned const firstUnsentDest = firstDestInMsgs + numSent;
+	  return writeSocketBatch(env, socket, &dests[firstUnsentDest], numDests - firstUnsentDest,
+				  packets, packetSizes, numPackets, useSegmentationOffload);
+	}
+
+	char tmpBuf[100];
+	sprintf(tmpBuf, "writeSocketBatch(%d), sendmmsg() error: sent %u messages instead of %u: ", socket, numSent, numMsgs);
+	socketErr(env, tmpBuf);
+	return False;
+      }
+      numMsgs = 0;
+      firstDestInMsgs = d + 1;
+    }
+  }
+
+  return True;
+#else
+  for (unsigned d = 0; d < numDests; ++d) {
+    unsigned char* packet = packets;
+    for (unsigned i = 0; i < numPackets; ++i) {
+      if (!writeSocket(env, socket, dests[d].sin_addr, Port(ntohs(dests[d].sin_port)), packet, packetSizes[i])) return False;
+      packet += packetSizes[i];
+    }
+  }
+
+  return True;
+#endif
+}
+
 static unsigned getBufferSize(UsageEnvironment& env, int bufOptName,
 			      int socket) {
   unsigned curSize;
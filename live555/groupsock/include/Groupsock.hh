@@ -47,6 +47,11 @@ public:
 protected:
   OutputSocket(UsageEnvironment& env, Port port);
 
+  Boolean writeBatch(struct sockaddr_in const* dests, unsigned numDests, u_int8_t ttl,
+		     unsigned char* packets, unsigned const* packetSizes, unsigned numPackets,
+		     Boolean& useSegmentationOffload);
+      // sends each packet to each destination (see "writeSocketBatch()")
+
   portNumBits sourcePortNum() const {return fSourcePort.num();}
 
 private: // redefined virtual function
@@ -59,6 +64,10 @@ private:
   unsigned fLastSentTTL;
 };
 
+// The most packets (and bytes) that a "Groupsock" collects in an output batch, before sending them:
+#define GROUPSOCK_MAX_BATCHED_PACKETS 64
+#define GROUPSOCK_OUTPUT_BATCH_BUFFER_SIZE 65507
+
 class destRecord {
 public:
   destRecord(struct in_addr const& addr, Port const& port, u_int8_t ttl,
@@ -120,6 +129,13 @@ public:
 		 unsigned char* buffer, unsigned bufferSize,
 		 DirectedNetInterface* interfaceNotToFwdBackTo = NULL);
 
+  void beginOutputBatch(Boolean useSegmentationOffload = False);
+  Boolean endOutputBatch(UsageEnvironment& env);
+      // Between these calls, packets given to "output()" are collected (rather than sent right away), and are then sent -
+      // to every destination - with as few system calls as possible (see "writeSocketBatch()").  (The packets collected
+      // so far are also sent if the batch fills up.)  Errors sending the batch are reported by "endOutputBatch()".
+      // ("beginOutputBatch()" does nothing if a batch has already begun; "endOutputBatch()" does nothing if none has.)
+
   DirectedNetInterfaceSet& members() { return fMembers; }
 
   Boolean deleteIfNoMembers;
@@ -142,17 +158,39 @@ public: // redefined virtual functions
 			     unsigned& bytesRead,
 			     struct sockaddr_in& fromAddress);
 
+  int handleReadBatch(unsigned char* const* buffers, unsigned bufferMaxSize, unsigned numBuffers,
+		      unsigned* bytesRead);
+      // Like "handleRead()", but reads up to "numBuffers" datagrams at once (see "readSocketBatch()").  Returns the
+      // number of buffers filled in (-1 on error); as with "handleRead()", some may have been filled with 0 bytes.
+
 private:
   int outputToAllMembersExcept(DirectedNetInterface* exceptInterface,
 			       u_int8_t ttlToFwd,
 			       unsigned char* data, unsigned size,
 			       netAddressBits sourceAddr);
 
+  unsigned handleDatagram(unsigned char* buffer, unsigned numBytes, struct sockaddr_in& fromAddress);
+      // returns the number of bytes to hand on (0 if the datagram is to be ignored)
+
+  Boolean addToOutputBatch(u_int8_t ttl, unsigned char* buffer, unsigned bufferSize);
+  Boolean sendOutputBatch();
+  Boolean writeToAllDestinations(u_int8_t ttl, unsigned char* packets, unsigned const* packetSizes, unsigned numPackets);
+
 private:
   GroupEId fIncomingGroupEId;
   destRecord* fDests;
   u_int8_t fTTL;
   DirectedNetInterfaceSet fMembers;
+
+  // Batched output:
+  Boolean fIsBatchingOutput, fUseSegmentationOffload, fSegmentationOffloadWorks;
+  unsigned char* fBatchBuffer; // allocated when we first batch
+  unsigned fBatchSize; // bytes
+  unsigned fBatchPacketSizes[GROUPSOCK_MAX_BATCHED_PACKETS];
+  unsigned fNumBatchedPackets;
+  u_int8_t fBatchTTL;
+  struct sockaddr_in* fDestAddresses; // filled in from "fDests" when writing a batch
+  unsigned fDestAddressesSize;
 };
 
 UsageEnvironment& operator<<(UsageEnvironment& s, const Groupsock& g);
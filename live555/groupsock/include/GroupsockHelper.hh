@@ -33,6 +33,13 @@ int readSocket(UsageEnvironment& env,
 	       int socket, unsigned char* buffer, unsigned bufferSize,
 	       struct sockaddr_in& fromAddress);
 
+int readSocketBatch(UsageEnvironment& env,
+		    int socket, unsigned char* const* buffers, unsigned bufferSize, unsigned numBuffers,
+		    unsigned* bytesRead, struct sockaddr_in* fromAddresses);
+    // Reads up to "numBuffers" datagrams - of those that have already arrived - at once.  On Linux, this is done with a
+    // single "recvmmsg()" call; elsewhere, just one datagram is read (using "readSocket()").
+    // Returns the number of datagrams read (0 if none had arrived), or -1 on error.
+
 Boolean writeSocket(UsageEnvironment& env,
 		    int socket, struct in_addr address, Port port,
 		    u_int8_t ttlArg,
@@ -43,6 +50,23 @@ Boolean writeSocket(UsageEnvironment& env,
 		    unsigned char* buffer, unsigned bufferSize);
     // An optimized version of "writeSocket" that omits the "setsockopt()" call to set the TTL.
 
+Boolean writeSocketBatch(UsageEnvironment& env,
+			 int socket, struct sockaddr_in const* dests, unsigned numDests,
+			 u_int8_t ttlArg,
+			 unsigned char* packets, unsigned const* packetSizes, unsigned numPackets,
+			 Boolean& useSegmentationOffload);
+
+Boolean writeSocketBatch(UsageEnvironment& env,
+			 int socket, struct sockaddr_in const* dests, unsigned numDests,
+			 unsigned char* packets, unsigned const* packetSizes, unsigned numPackets,
+			 Boolean& useSegmentationOffload);
+    // Sends each of "numPackets" packets (stored back-to-back in "packets") to each of "numDests" destinations.
+    // On Linux, this is done with as few "sendmmsg()" calls as possible.  If "useSegmentationOffload" is True, and the
+    // packets all have the same size (except perhaps for the last one), then they are sent to each destination as a
+    // single UDP GSO ('generic segmentation offload') message, which the kernel splits up again.  (If the kernel can't
+    // do this, "useSegmentationOffload" is set to False.)
+    // Elsewhere, each packet is sent to each destination with a separate "sendto()".
+
 unsigned getSendBufferSize(UsageEnvironment& env, int socket);
 unsigned getReceiveBufferSize(UsageEnvironment& env, int socket);
 unsigned setSendBufferTo(UsageEnvironment& env,
@@ -20,6 +20,7 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 
 #include "H264or5VideoStreamFramer.hh"
 #include "MPEGVideoStreamParser.hh"
+#include "NALUnitScanner.hh"
 #include "BitVector.hh"
 
 ////////// H264or5VideoStreamParser definition //////////
@@ -925,13 +926,15 @@ unsigned H264or5VideoStreamParser::parse() {
 	fHaveSeenFirstByteOfNALUnit = True;
       }
       while (next4Bytes != 0x00000001 && (next4Bytes&0xFFFFFF00) != 0x00000100) {
-	// We save at least some of "next4Bytes".
-	if ((unsigned)(next4Bytes&0xFF) > 1) {
-	  // Common case: 0x00000001 or 0x000001 definitely doesn't begin anywhere in "next4Bytes", so we save all of it:
-	  save4Bytes(next4Bytes);
-	  skipBytes(4);
+	// Save everything up until the next start code among the bytes that we've already read
+	// (or up until the end of these bytes), in one go:
+	unsigned char const* from;
+	unsigned numBytes = numBytesBeforeStartCode(from);
+	if (numBytes > 0) {
+	  saveBytes(from, numBytes);
+	  skipBytes(numBytes);
 	} else {
-	  // Save the first byte, and continue testing the rest:
+	  // (This shouldn't happen, because "next4Bytes" doesn't begin a start code.)
 	  saveByte(next4Bytes>>24);
 	  skipBytes(1);
 	}
@@ -1081,19 +1084,46 @@ unsigned H264or5VideoStreamParser::parse() {
 }
 
 unsigned removeH264or5EmulationBytes(u_int8_t* to, unsigned toMaxSize,
-                                     u_int8_t* from, unsigned fromSize) {
+                                     u_int8_t const* from, unsigned fromSize) {
+  u_int8_t const* const end = from + fromSize;
   unsigned toSize = 0;
-  unsigned i = 0;
-  while (i < fromSize && toSize+1 < toMaxSize) {
-    if (i+2 < fromSize && from[i] == 0 && from[i+1] == 0 && from[i+2] == 3) {
-      to[toSize] = to[toSize+1] = 0;
-      toSize += 2;
-      i += 3;
-    } else {
-      to[toSize] = from[i];
-      toSize += 1;
-      i += 1;
-    }
+  while (from < end && toSize < toMaxSize) {
+    // Copy everything up to (and including the 0x0000 of) the next 0x000003, then skip the 0x03:
+    u_int8_t const* next = findEmulationBytes(from, end);
+    unsigned numBytes = next == end ? end - from : (next + 2) - from;
+    if (numBytes > toMaxSize - toSize) numBytes = toMaxSize - toSize;
+
+    memmove(&to[toSize], from, numBytes);
+    toSize += numBytes;
+    from = next == end ? end : next + 3;
+  }
+
+  return toSize;
+}
+
+unsigned insertH264or5EmulationBytes(u_int8_t* to, unsigned toMaxSize,
+                                     u_int8_t const* from, unsigned fromSize) {
+  u_int8_t const* const end = from + fromSize;
+  unsigned toSize = 0;
+  while (from < end) {
+    // Copy everything up to (and including) the next 0x0000 that's followed by a byte <= 0x03,
+    // then insert a 0x03.  (The byte that follows is where we carry on from, as it may begin
+    // another such 0x0000.)
+    u_int8_t const* next = findZeroBytePair(from, end, 0, 3);
+    unsigned numBytes = next == end ? end - from : (next + 2) - from;
+    if (toSize + numBytes + 1 > toMaxSize) return 0; // there's not enough space
+
+    memmove(&to[toSize], from, numBytes);
+    toSize += numBytes;
+    if (next == end) break;
+    to[toSize++] = 3;
+    from = next + 2;
+  }
+
+  // A NAL unit can't end with a zero byte (e.g., the 'cabac_zero_word's that may follow a slice):
+  if (toSize > 0 && to[toSize-1] == 0) {
+    if (toSize + 1 > toMaxSize) return 0;
+    to[toSize++] = 3;
   }
 
   return toSize;
@@ -24,7 +24,7 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 
 class LATMBufferedPacket: public BufferedPacket {
 public:
-  LATMBufferedPacket(Boolean includeLATMDataLengthField);
+  LATMBufferedPacket(MPEG4LATMAudioRTPSource& ourSource);
   virtual ~LATMBufferedPacket();
 
 private: // redefined virtual functions
@@ -32,7 +32,7 @@ private: // redefined virtual functions
                                  unsigned dataSize);
 
 private:
-  Boolean fIncludeLATMDataLengthField;
+  MPEG4LATMAudioRTPSource& fOurSource;
 };
 
 class LATMBufferedPacketFactory: public BufferedPacketFactory {
@@ -88,8 +88,8 @@ char const* MPEG4LATMAudioRTPSource::MIMEtype() const {
 
 ////////// LATMBufferedPacket and LATMBufferedPacketFactory implementation
 
-LATMBufferedPacket::LATMBufferedPacket(Boolean includeLATMDataLengthField)
-  : fIncludeLATMDataLengthField(includeLATMDataLengthField) {
+LATMBufferedPacket::LATMBufferedPacket(MPEG4LATMAudioRTPSource& ourSource)
+  : fOurSource(ourSource) {
 }
 
 LATMBufferedPacket::~LATMBufferedPacket() {
@@ -97,6 +97,9 @@ LATMBufferedPacket::~LATMBufferedPacket() {
 
 unsigned LATMBufferedPacket
 ::nextEnclosedFrameSize(unsigned char*& framePtr, unsigned dataSize) {
+  // A continuation fragment is nothing but more of the current payload:
+  if (!fOurSource.curPacketBeginsFrame()) return dataSize;
+
   // Look at the LATM data length byte(s), to determine the size
   // of the LATM payload.
   unsigned resultFrameSize = 0;
@@ -106,7 +109,7 @@ unsigned LATMBufferedPacket
     if (framePtr[i] != 0xFF) break;
   }
   ++i;
-  if (fIncludeLATMDataLengthField) {
+  if (fOurSource.returnedFrameIncludesLATMDataLengthField()) {
     resultFrameSize += i;
   } else {
     framePtr += i;
@@ -119,7 +122,7 @@ unsigned LATMBufferedPacket
 BufferedPacket* LATMBufferedPacketFactory
 ::createNewPacket(MultiFramedRTPSource* ourSource) {
   MPEG4LATMAudioRTPSource* source = (MPEG4LATMAudioRTPSource*)ourSource;
-  return new LATMBufferedPacket(source->returnedFrameIncludesLATMDataLengthField());
+  return new LATMBufferedPacket(*source);
 }
 
 
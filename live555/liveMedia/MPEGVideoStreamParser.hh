@@ -70,6 +70,14 @@ protected:
     *fTo++ = word>>24; *fTo++ = word>>16; *fTo++ = word>>8; *fTo++ = word;
   }
 
+  void saveBytes(unsigned char const* from, unsigned numBytes) {
+    unsigned numBytesToSave = numBytes;
+    if (numBytesToSave > (unsigned)(fLimit - fTo)) numBytesToSave = fLimit - fTo; // there's not enough space left
+    memmove(fTo, from, numBytesToSave);
+    fTo += numBytesToSave;
+    fNumTruncatedBytes += numBytes - numBytesToSave;
+  }
+
   // Save data until we see a sync word (0x000001xx):
   void saveToNextCode(u_int32_t& curWord) {
     saveByte(curWord>>24);
@@ -43,7 +43,7 @@ MultiFramedRTPSink::MultiFramedRTPSink(UsageEnvironment& env,
   : RTPSink(env, rtpGS, rtpPayloadType, rtpTimestampFrequency,
 	    rtpPayloadFormatName, numChannels),
     fOutBuf(NULL), fCurFragmentationOffset(0), fPreviousFrameEndedFragmentation(False),
-    fOnSendErrorFunc(NULL), fOnSendErrorData(NULL) {
+    fOnSendErrorFunc(NULL), fOnSendErrorData(NULL), fBatchOutput(False), fUseSegmentationOffload(False) {
   setPacketSizes(1000, 1448);
       // Default max packet size (1500, minus allowance for IP, UDP, UMTP headers)
       // (Also, make it a multiple of 4 bytes, just in case that matters.)
@@ -154,6 +154,9 @@ Boolean MultiFramedRTPSink::continuePlaying() {
 }
 
 void MultiFramedRTPSink::stopPlaying() {
+  // Send any packets that we've batched:
+  endOutputBatch();
+
   fOutBuf->resetPacketStart();
   fOutBuf->resetOffset();
   fOutBuf->resetOverflowData();
@@ -357,6 +360,7 @@ Boolean MultiFramedRTPSink::isTooBigForAPacket(unsigned numBytes) const {
 void MultiFramedRTPSink::sendPacketIfNecessary() {
   if (fNumFramesUsedSoFar > 0) {
     // Send the packet:
+    if (fBatchOutput) fRTPInterface.gs()->beginOutputBatch(fUseSegmentationOffload);
 #ifdef TEST_LOSS
     if ((our_random()%10) != 0) // simulate 10% packet loss #####
 #endif
@@ -372,6 +376,7 @@ void MultiFramedRTPSink::sendPacketIfNecessary() {
     ++fSeqNo; // for next time
   }
 
+  Boolean frameContinues = fOutBuf->haveOverflowData();
   if (fOutBuf->haveOverflowData()
       && fOutBuf->totalBytesAvailable() > fOutBuf->totalBufferSize()/2) {
     // Efficiency hack: Reset the packet start pointer to just in front of
@@ -390,6 +395,7 @@ void MultiFramedRTPSink::sendPacketIfNecessary() {
 
   if (fNoFramesLeft) {
     // We're done:
+    endOutputBatch();
     onSourceClosure();
   } else {
     // We have more frames left to send.  Figure out when the next frame
@@ -403,6 +409,9 @@ void MultiFramedRTPSink::sendPacketIfNecessary() {
       uSecondsToGo = 0;
     }
 
+    // Unless the next packet (continuing the current frame) is to be sent right away, send any packets that we've batched:
+    if (!frameContinues || uSecondsToGo > 0) endOutputBatch();
+
     // Delay this amount of time:
     nextTask() = envir().taskScheduler().scheduleDelayedTask(uSecondsToGo, (TaskFunc*)sendNext, this);
   }
@@ -414,6 +423,13 @@ void MultiFramedRTPSink::sendNext(void* firstArg) {
   sink->buildAndSendPacket(False);
 }
 
+void MultiFramedRTPSink::endOutputBatch() {
+  if (!fRTPInterface.gs()->endOutputBatch(envir())) {
+    // if failure handler has been specified, call it
+    if (fOnSendErrorFunc != NULL) (*fOnSendErrorFunc)(fOnSendErrorData);
+  }
+}
+
 void MultiFramedRTPSink::ourHandleClosure(void* clientData) {
   MultiFramedRTPSink* sink = (MultiFramedRTPSink*)clientData;
   // There are no frames left, but we may have a partially built packet
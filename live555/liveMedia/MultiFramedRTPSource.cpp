@@ -21,8 +21,24 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 
 #include "MultiFramedRTPSource.hh"
 #include "GroupsockHelper.hh"
+#include "TunnelEncaps.hh"
 #include <string.h>
 
+// Packet buffers start out big enough for a datagram that fits in an Ethernet MTU, and grow
+// (up to "MAX_PACKET_SIZE") for streams that turn out to need more:
+#define INITIAL_PACKET_SIZE 2048
+#define MAX_PACKET_SIZE 65536
+// Room left after the data read over TCP, for payload formats that append to it (e.g. JPEG's EOI
+// marker).  (Datagram reads always leave "TunnelEncapsulationTrailerMaxSize" bytes.)
+#define PACKET_TRAILER_SPACE 16
+
+// The most datagrams read at once (with a single system call, where possible), each time our socket is readable:
+#define MAX_PACKETS_PER_BATCHED_READ 32
+
+// Initial and maximum size of the reordering window (in packets).  Must be powers of 2:
+#define INITIAL_REORDERING_WINDOW 256
+#define MAX_REORDERING_WINDOW 32768
+
 ////////// ReorderingPacketBuffer definition //////////
 
 class ReorderingPacketBuffer {
@@ -36,27 +52,35 @@ public:
   BufferedPacket* getNextCompletedPacket(Boolean& packetLossPreceded);
   void releaseUsedPacket(BufferedPacket* packet);
   void freePacket(BufferedPacket* packet) {
-    if (packet != fSavedPacket) {
-      delete packet;
-    } else {
-      fSavedPacketFree = True;
-    }
+    // Keep the packet (and its buffer) for reuse, rather than deleting it:
+    packet->nextPacket() = fFreePackets;
+    fFreePackets = packet;
   }
-  Boolean isEmpty() const { return fHeadPacket == NULL; }
+  Boolean isEmpty() const { return fNumStoredPackets == 0; }
 
   void setThresholdTime(unsigned uSeconds) { fThresholdTime = uSeconds; }
   void resetHaveSeenFirstPacket() { fHaveSeenFirstPacket = False; }
+  void notePacketTruncated(); // makes the buffers of subsequent packets bigger
+
+private:
+  void freeStoredPackets();
+  Boolean growWindow(unsigned minSize);
+  BufferedPacket*& slotFor(unsigned short seqNo) { return fWindow[seqNo&(fWindowSize-1)]; }
 
 private:
   BufferedPacketFactory* fPacketFactory;
   unsigned fThresholdTime; // uSeconds
   Boolean fHaveSeenFirstPacket; // used to set initial "fNextExpectedSeqNo"
   unsigned short fNextExpectedSeqNo;
-  BufferedPacket* fHeadPacket;
-  BufferedPacket* fTailPacket;
-  BufferedPacket* fSavedPacket;
-      // to avoid calling new/free in the common case
-  Boolean fSavedPacketFree;
+  // Stored packets, indexed by their RTP sequence number (modulo the window size).  All of them
+  // lie within "fWindowSize" of "fNextExpectedSeqNo", so each has a slot of its own:
+  BufferedPacket** fWindow;
+  unsigned fWindowSize;
+  unsigned fNumStoredPackets;
+  unsigned short fHeadSeqNo; // of the earliest stored packet
+  // Packets that are not in use, to avoid calling new/delete at the packet rate:
+  BufferedPacket* fFreePackets;
+  unsigned fPacketSize; // size of the buffers handed out with free packets
 };
 
 
@@ -82,6 +106,7 @@ void MultiFramedRTPSource::reset() {
   fPacketReadInProgress = NULL;
   fNeedDelivery = False;
   fPacketLossInFragmentedFrame = False;
+  fNumNestedDeliveries = 0;
 }
 
 MultiFramedRTPSource::~MultiFramedRTPSource() {
@@ -155,12 +180,14 @@ void MultiFramedRTPSource::doGetNextFrame1() {
       if (packetLossPrecededThis || fPacketLossInFragmentedFrame) {
 	// We didn't get all of the previous frame.
 	// Forget any data that we used from it:
+	if (fFrameSize > 0 && !fPacketLossInFragmentedFrame) ++fNumFragmentedFramesLost;
 	fTo = fSavedTo; fMaxSize = fSavedMaxSize;
 	fFrameSize = 0;
       }
       fPacketLossInFragmentedFrame = False;
     } else if (packetLossPrecededThis) {
       // We're in a multi-packet frame, with preceding packet loss
+      if (!fPacketLossInFragmentedFrame) ++fNumFragmentedFramesLost;
       fPacketLossInFragmentedFrame = True;
     }
     if (fPacketLossInFragmentedFrame) {
@@ -171,6 +198,8 @@ void MultiFramedRTPSource::doGetNextFrame1() {
     }
 
     // The packet is usable. Deliver all or part of it to our caller:
+    if (fFrameSize == 0) fCurFrameTimeReceived = nextPacket->timeReceived();
+    fCurPacketTimeReceived = nextPacket->timeReceived();
     unsigned frameSize;
     nextPacket->use(fTo, fMaxSize, frameSize, fNumTruncatedBytes,
 		    fCurPacketRTPSeqNum, fCurPacketRTPTimestamp,
@@ -178,7 +207,8 @@ void MultiFramedRTPSource::doGetNextFrame1() {
 		    fCurPacketMarkerBit);
     fFrameSize += frameSize;
 
-    if (!nextPacket->hasUsableData()) {
+    fCurFrameEndsPacket = !nextPacket->hasUsableData();
+    if (fCurFrameEndsPacket) {
       // We're completely done with this packet now
       fReorderingBuffer->releaseUsedPacket(nextPacket);
     }
@@ -196,10 +226,16 @@ void MultiFramedRTPSource::doGetNextFrame1() {
 	// executed again without having first returned to the event loop.  Call our 'after getting' function
 	// directly, because there's no risk of a long chain of recursion (and thus stack overflow):
 	afterGetting(this);
+      } else if (fNumNestedDeliveries < MAX_PACKETS_PER_BATCHED_READ) {
+	// There are more queued packets (e.g., the rest of a batch that we just read), so this code may get executed
+	// again - recursively - before we return to the event loop.  That's OK (and saves a trip through the event loop
+	// for each packet), as long as the chain of recursion stays short:
+	++fNumNestedDeliveries;
+	afterGetting(this);
       } else {
 	// Special case: Call our 'after getting' function via the event loop.
 	nextTask() = envir().taskScheduler().scheduleDelayedTask(0,
-								 (TaskFunc*)FramedSource::afterGetting, this);
+								 (TaskFunc*)afterGettingFromEventLoop, this);
       }
     } else {
       // This packet contained fragmented data, and does not complete
@@ -210,6 +246,11 @@ void MultiFramedRTPSource::doGetNextFrame1() {
   }
 }
 
+void MultiFramedRTPSource::afterGettingFromEventLoop(MultiFramedRTPSource* source) {
+  source->fNumNestedDeliveries = 0; // there's no chain of recursion anymore
+  afterGetting(source);
+}
+
 void MultiFramedRTPSource
 ::setPacketReorderingThresholdTime(unsigned uSeconds) {
   fReorderingBuffer->setThresholdTime(uSeconds);
@@ -222,9 +263,17 @@ void MultiFramedRTPSource::networkReadHandler(MultiFramedRTPSource* source, int
 }
 
 void MultiFramedRTPSource::networkReadHandler1() {
+  fNumNestedDeliveries = 0; // we've been called from the event loop
+
+  if (fPacketReadInProgress == NULL && fRTPInterface.nextTCPReadStreamSocketNum() < 0) {
+    // Normal case: Read all of the datagrams that have arrived (up to a limit) at once:
+    readDatagramBatch();
+    return;
+  }
+
   BufferedPacket* bPacket = fPacketReadInProgress;
   if (bPacket == NULL) {
-    // Normal case: Get a free BufferedPacket descriptor to hold the new network packet:
+    // Get a free BufferedPacket descriptor to hold the new network packet:
     bPacket = fReorderingBuffer->getFreePacket(this);
   }
 
@@ -233,7 +282,9 @@ void MultiFramedRTPSource::networkReadHandler1() {
   do {
     Boolean packetReadWasIncomplete = fPacketReadInProgress != NULL;
     if (!bPacket->fillInData(fRTPInterface, packetReadWasIncomplete)) {
-      if (bPacket->bytesAvailable() == 0) {
+      if (bPacket->readWasTruncated()) {
+	fReorderingBuffer->notePacketTruncated();
+      } else if (bPacket->bytesAvailable() == 0) {
 	envir() << "MultiFramedRTPSource error: Hit limit when reading incoming packet over TCP. Increase \"MAX_PACKET_SIZE\"\n";
       }
       fPacketReadInProgress = NULL;
@@ -246,78 +297,10 @@ void MultiFramedRTPSource::networkReadHandler1() {
     } else {
       fPacketReadInProgress = NULL;
     }
-#ifdef TEST_LOSS
-    setPacketReorderingThresholdTime(0);
-       // don't wait for 'lost' packets to arrive out-of-order later
-    if ((our_random()%10) == 0) break; // simulate 10% packet loss
-#endif
-
-    // Check for the 12-byte RTP header:
-    if (bPacket->dataSize() < 12) break;
-    unsigned rtpHdr = ntohl(*(u_int32_t*)(bPacket->data())); ADVANCE(4);
-    Boolean rtpMarkerBit = (rtpHdr&0x00800000) != 0;
-    unsigned rtpTimestamp = ntohl(*(u_int32_t*)(bPacket->data()));ADVANCE(4);
-    unsigned rtpSSRC = ntohl(*(u_int32_t*)(bPacket->data())); ADVANCE(4);
-
-    // Check the RTP version number (it should be 2):
-    if ((rtpHdr&0xC0000000) != 0x80000000) break;
-
-    // Skip over any CSRC identifiers in the header:
-    unsigned cc = (rtpHdr>>24)&0xF;
-    if (bPacket->dataSize() < cc) break;
-    ADVANCE(cc*4);
-
-    // Check for (& ignore) any RTP header extension
-    if (rtpHdr&0x10000000) {
-      if (bPacket->dataSize() < 4) break;
-      unsigned extHdr = ntohl(*(u_int32_t*)(bPacket->data())); ADVANCE(4);
-      unsigned remExtSize = 4*(extHdr&0xFFFF);
-      if (bPacket->dataSize() < remExtSize) break;
-      ADVANCE(remExtSize);
-    }
 
-    // Discard any padding bytes:
-    if (rtpHdr&0x20000000) {
-      if (bPacket->dataSize() == 0) break;
-      unsigned numPaddingBytes
-	= (unsigned)(bPacket->data())[bPacket->dataSize()-1];
-      if (bPacket->dataSize() < numPaddingBytes) break;
-      bPacket->removePadding(numPaddingBytes);
-    }
-    // Check the Payload Type.
-    if ((unsigned char)((rtpHdr&0x007F0000)>>16)
-	!= rtpPayloadFormat()) {
-      break;
-    }
-
-    // The rest of the packet is the usable data.  Record and save it:
-    if (rtpSSRC != fLastReceivedSSRC) {
-      // The SSRC of incoming packets has changed.  Unfortunately we don't yet handle streams that contain multiple SSRCs,
-      // but we can handle a single-SSRC stream where the SSRC changes occasionally:
-      fLastReceivedSSRC = rtpSSRC;
-      fReorderingBuffer->resetHaveSeenFirstPacket();
-    }
-    unsigned short rtpSeqNo = (unsigned short)(rtpHdr&0xFFFF);
-    Boolean usableInJitterCalculation
-      = packetIsUsableInJitterCalculation((bPacket->data()),
-						  bPacket->dataSize());
-    struct timeval presentationTime; // computed by:
-    Boolean hasBeenSyncedUsingRTCP; // computed by:
-    receptionStatsDB()
-      .noteIncomingPacket(rtpSSRC, rtpSeqNo, rtpTimestamp,
-			  timestampFrequency(),
-			  usableInJitterCalculation, presentationTime,
-			  hasBeenSyncedUsingRTCP, bPacket->dataSize());
-
-    // Fill in the rest of the packet descriptor, and store it:
     struct timeval timeNow;
     gettimeofday(&timeNow, NULL);
-    bPacket->assignMiscParams(rtpSeqNo, rtpTimestamp, presentationTime,
-			      hasBeenSyncedUsingRTCP, rtpMarkerBit,
-			      timeNow);
-    if (!fReorderingBuffer->storePacket(bPacket)) break;
-
-    readSuccess = True;
+    readSuccess = storeIncomingPacket(bPacket, timeNow);
   } while (0);
   if (!readSuccess) fReorderingBuffer->freePacket(bPacket);
 
@@ -325,15 +308,105 @@ void MultiFramedRTPSource::networkReadHandler1() {
   // If we didn't get proper data this time, we'll get another chance
 }
 
+void MultiFramedRTPSource::readDatagramBatch() {
+  BufferedPacket* packets[MAX_PACKETS_PER_BATCHED_READ];
+  for (unsigned i = 0; i < MAX_PACKETS_PER_BATCHED_READ; ++i) packets[i] = fReorderingBuffer->getFreePacket(this);
 
-////////// BufferedPacket and BufferedPacketFactory implementation /////
+  unsigned numRead = BufferedPacket::fillInDataBatch(fRTPInterface, packets, MAX_PACKETS_PER_BATCHED_READ);
+
+  // Store the packets that we read (all of which arrived at about the same time), and free the others:
+  struct timeval timeNow;
+  gettimeofday(&timeNow, NULL);
+  for (unsigned i = 0; i < MAX_PACKETS_PER_BATCHED_READ; ++i) {
+    if (i < numRead && packets[i]->readWasTruncated()) fReorderingBuffer->notePacketTruncated();
+    if (i >= numRead || packets[i]->readWasTruncated() || !storeIncomingPacket(packets[i], timeNow)) {
+      fReorderingBuffer->freePacket(packets[i]);
+    }
+  }
+
+  doGetNextFrame1();
+  // If we didn't get proper data this time, we'll get another chance
+}
+
+Boolean MultiFramedRTPSource::storeIncomingPacket(BufferedPacket* bPacket, struct timeval const& timeReceived) {
+  // Perform sanity checks on the RTP header of a packet that we've just read, then store it in our reordering buffer:
+#ifdef TEST_LOSS
+  setPacketReorderingThresholdTime(0);
+     // don't wait for 'lost' packets to arrive out-of-order later
+  if ((our_random()%10) == 0) return False; // simulate 10% packet loss
+#endif
 
-#define MAX_PACKET_SIZE 20000
+  // Check for the 12-byte RTP header:
+  if (bPacket->dataSize() < 12) return False;
+  unsigned rtpHdr = ntohl(*(u_int32_t*)(bPacket->data())); ADVANCE(4);
+  Boolean rtpMarkerBit = (rtpHdr&0x00800000) != 0;
+  unsigned rtpTimestamp = ntohl(*(u_int32_t*)(bPacket->data()));ADVANCE(4);
+  unsigned rtpSSRC = ntohl(*(u_int32_t*)(bPacket->data())); ADVANCE(4);
+
+  // Check the RTP version number (it should be 2):
+  if ((rtpHdr&0xC0000000) != 0x80000000) return False;
+
+  // Skip over any CSRC identifiers in the header:
+  unsigned cc = (rtpHdr>>24)&0xF;
+  if (bPacket->dataSize() < cc) return False;
+  ADVANCE(cc*4);
+
+  // Check for (& ignore) any RTP header extension
+  if (rtpHdr&0x10000000) {
+    if (bPacket->dataSize() < 4) return False;
+    unsigned extHdr = ntohl(*(u_int32_t*)(bPacket->data())); ADVANCE(4);
+    unsigned remExtSize = 4*(extHdr&0xFFFF);
+    if (bPacket->dataSize() < remExtSize) return False;
+    ADVANCE(remExtSize);
+  }
+
+  // Discard any padding bytes:
+  if (rtpHdr&0x20000000) {
+    if (bPacket->dataSize() == 0) return False;
+    unsigned numPaddingBytes
+      = (unsigned)(bPacket->data())[bPacket->dataSize()-1];
+    if (bPacket->dataSize() < numPaddingBytes) return False;
+    bPacket->removePadding(numPaddingBytes);
+  }
+  // Check the Payload Type.
+  if ((unsigned char)((rtpHdr&0x007F0000)>>16)
+      != rtpPayloadFormat()) {
+    return False;
+  }
+
+  // The rest of the packet is the usable data.  Record and save it:
+  if (rtpSSRC != fLastReceivedSSRC) {
+    // The SSRC of incoming packets has changed.  Unfortunately we don't yet handle streams that contain multiple SSRCs,
+    // but we can handle a single-SSRC stream where the SSRC changes occasionally:
+    fLastReceivedSSRC = rtpSSRC;
+    fReorderingBuffer->resetHaveSeenFirstPacket();
+  }
+  unsigned short rtpSeqNo = (unsigned short)(rtpHdr&0xFFFF);
+  Boolean usableInJitterCalculation
+    = packetIsUsableInJitterCalculation((bPacket->data()),
+					bPacket->dataSize());
+  struct timeval presentationTime; // computed by:
+  Boolean hasBeenSyncedUsingRTCP; // computed by:
+  receptionStatsDB()
+    .noteIncomingPacket(rtpSSRC, rtpSeqNo, rtpTimestamp,
+			timestampFrequency(),
+			usableInJitterCalculation, presentationTime,
+			hasBeenSyncedUsingRTCP, bPacket->dataSize());
+
+  // Fill in the rest of the packet descriptor, and store it:
+  bPacket->assignMiscParams(rtpSeqNo, rtpTimestamp, presentationTime,
+			    hasBeenSyncedUsingRTCP, rtpMarkerBit,
+			    timeReceived);
+  return fReorderingBuffer->storePacket(bPacket);
+}
+
+
+////////// BufferedPacket and BufferedPacketFactory implementation /////
 
 BufferedPacket::BufferedPacket()
-  : fPacketSize(MAX_PACKET_SIZE),
-    fBuf(new unsigned char[MAX_PACKET_SIZE]),
-    fNextPacket(NULL) {
+  : fPacketSize(0), fBuf(NULL), fHead(0), fTail(0),
+    fNextPacket(NULL), fReadWasTruncated(False) {
+  // Our buffer gets allocated by "ensureBufferSize()", once we know how big it needs to be
 }
 
 BufferedPacket::~BufferedPacket() {
@@ -371,20 +444,88 @@ void BufferedPacket
   frameDurationInMicroseconds = 0; // by default.  Subclasses should correct this.
 }
 
+Boolean BufferedPacket::ensureBufferSize(unsigned size) {
+  if (size > MAX_PACKET_SIZE) size = MAX_PACKET_SIZE;
+  if (size <= fPacketSize) return True;
+
+  unsigned char* newBuf = new unsigned char[size];
+  if (fTail > 0) memcpy(newBuf, fBuf, fTail); // in case we're in the middle of reading a packet
+  delete[] fBuf;
+  fBuf = newBuf;
+  fPacketSize = size;
+  return True;
+}
+
 Boolean BufferedPacket::fillInData(RTPInterface& rtpInterface, Boolean& packetReadWasIncomplete) {
   if (!packetReadWasIncomplete) reset();
+  fReadWasTruncated = False;
+
+  Boolean const isReadingOverTCP = rtpInterface.nextTCPReadStreamSocketNum() >= 0;
+  if (isReadingOverTCP) {
+    // We know how big the packet is, so make room for (the rest of) it:
+    ensureBufferSize(fTail + rtpInterface.nextTCPReadSize() + PACKET_TRAILER_SPACE);
+  }
 
   unsigned numBytesRead;
   struct sockaddr_in fromAddress;
   unsigned const maxBytesToRead = bytesAvailable();
   if (maxBytesToRead == 0) return False; // exceeded buffer size when reading over TCP
   if (!rtpInterface.handleRead(&fBuf[fTail], maxBytesToRead, numBytesRead, fromAddress, packetReadWasIncomplete)) {
+#if defined(__WIN32__) || defined(_WIN32)
+    // Windows fails datagram reads that don't fit in the buffer:
+    fReadWasTruncated = !isReadingOverTCP && rtpInterface.envir().getErrno() == WSAEMSGSIZE;
+#endif
     return False;
   }
   fTail += numBytesRead;
+
+  if (!isReadingOverTCP && numBytesRead + TunnelEncapsulationTrailerMaxSize >= maxBytesToRead
+      && fPacketSize < MAX_PACKET_SIZE) {
+    // The datagram filled our buffer, so it may have been truncated.  Don't use it:
+    fReadWasTruncated = True;
+    return False;
+  }
   return True;
 }
 
+unsigned BufferedPacket::fillInDataBatch(RTPInterface& rtpInterface, BufferedPacket** packets, unsigned numPackets) {
+  if (numPackets > MAX_PACKETS_PER_BATCHED_READ) numPackets = MAX_PACKETS_PER_BATCHED_READ;
+
+  // Read into the start of each packet's buffer; all of them can take the smallest buffer's worth:
+  unsigned char* buffers[MAX_PACKETS_PER_BATCHED_READ];
+  unsigned maxBytesToRead = MAX_PACKET_SIZE;
+  for (unsigned i = 0; i < numPackets; ++i) {
+    BufferedPacket* packet = packets[i];
+    packet->reset();
+    packet->fReadWasTruncated = False;
+    buffers[i] = packet->fBuf;
+    if (packet->bytesAvailable() < maxBytesToRead) maxBytesToRead = packet->bytesAvailable();
+  }
+
+  unsigned bytesRead[MAX_PACKETS_PER_BATCHED_READ];
+  int numRead = rtpInterface.handleReadBatch(buffers, maxBytesToRead, numPackets, bytesRead);
+  if (numRead < 0) {
+#if defined(__WIN32__) || defined(_WIN32)
+    // Windows fails datagram reads that don't fit in the buffer:
+    if (numPackets > 0 && rtpInterface.envir().getErrno() == WSAEMSGSIZE) {
+      packets[0]->fReadWasTruncated = True;
+      return 1;
+    }
+#endif
+    return 0;
+  }
+
+  for (int i = 0; i < numRead; ++i) {
+    BufferedPacket* packet = packets[i];
+    packet->fTail = bytesRead[i];
+    if (bytesRead[i] + TunnelEncapsulationTrailerMaxSize >= maxBytesToRead && maxBytesToRead < MAX_PACKET_SIZE) {
+      // The datagram filled the buffer, so it may have been truncated.  Don't use it:
+      packet->fReadWasTruncated = True;
+    }
+  }
+  return numRead;
+}
+
 void BufferedPacket
 ::assignMiscParams(unsigned short rtpSeqNo, unsigned rtpTimestamp,
 		   struct timeval presentationTime,
@@ -468,42 +609,85 @@ BufferedPacket* BufferedPacketFactory
 ReorderingPacketBuffer
 ::ReorderingPacketBuffer(BufferedPacketFactory* packetFactory)
   : fThresholdTime(100000) /* default reordering threshold: 100 ms */,
-    fHaveSeenFirstPacket(False), fHeadPacket(NULL), fTailPacket(NULL), fSavedPacket(NULL), fSavedPacketFree(True) {
+    fHaveSeenFirstPacket(False), fNextExpectedSeqNo(0),
+    fWindow(new BufferedPacket*[INITIAL_REORDERING_WINDOW]), fWindowSize(INITIAL_REORDERING_WINDOW),
+    fNumStoredPackets(0), fHeadSeqNo(0),
+    fFreePackets(NULL), fPacketSize(INITIAL_PACKET_SIZE) {
   fPacketFactory = (packetFactory == NULL)
     ? (new BufferedPacketFactory)
     : packetFactory;
+  for (unsigned i = 0; i < fWindowSize; ++i) fWindow[i] = NULL;
 }
 
 ReorderingPacketBuffer::~ReorderingPacketBuffer() {
   reset();
+  delete[] fWindow;
   delete fPacketFactory;
 }
 
 void ReorderingPacketBuffer::reset() {
-  if (fSavedPacketFree) delete fSavedPacket; // because fSavedPacket is not in the list
-  delete fHeadPacket; // will also delete fSavedPacket if it's in the list
+  freeStoredPackets();
   resetHaveSeenFirstPacket();
-  fHeadPacket = fTailPacket = fSavedPacket = NULL;
+
+  while (fFreePackets != NULL) {
+    BufferedPacket* packet = fFreePackets;
+    fFreePackets = packet->nextPacket();
+    packet->nextPacket() = NULL; // so that deleting it doesn't delete the rest of the list
+    delete packet;
+  }
 }
 
-BufferedPacket* ReorderingPacketBuffer::getFreePacket(MultiFramedRTPSource* ourSource) {
-  if (fSavedPacket == NULL) { // we're being called for the first time
-    fSavedPacket = fPacketFactory->createNewPacket(ourSource);
-    fSavedPacketFree = True;
+void ReorderingPacketBuffer::freeStoredPackets() {
+  for (unsigned i = 0; i < fWindowSize && fNumStoredPackets > 0; ++i) {
+    if (fWindow[i] != NULL) {
+      freePacket(fWindow[i]);
+      fWindow[i] = NULL;
+      --fNumStoredPackets;
+    }
   }
+}
 
-  if (fSavedPacketFree == True) {
-    fSavedPacketFree = False;
-    return fSavedPacket;
+BufferedPacket* ReorderingPacketBuffer::getFreePacket(MultiFramedRTPSource* ourSource) {
+  BufferedPacket* packet = fFreePackets;
+  if (packet != NULL) {
+    fFreePackets = packet->nextPacket();
+    packet->nextPacket() = NULL;
   } else {
-    return fPacketFactory->createNewPacket(ourSource);
+    packet = fPacketFactory->createNewPacket(ourSource);
+  }
+
+  packet->ensureBufferSize(fPacketSize);
+  return packet;
+}
+
+void ReorderingPacketBuffer::notePacketTruncated() {
+  if (fPacketSize < MAX_PACKET_SIZE) fPacketSize *= 2;
+}
+
+Boolean ReorderingPacketBuffer::growWindow(unsigned minSize) {
+  unsigned newSize = fWindowSize;
+  while (newSize < minSize) newSize *= 2;
+  if (newSize > MAX_REORDERING_WINDOW) return False;
+
+  BufferedPacket** newWindow = new BufferedPacket*[newSize];
+  for (unsigned i = 0; i < newSize; ++i) newWindow[i] = NULL;
+  for (unsigned i = 0; i < fWindowSize; ++i) {
+    BufferedPacket* packet = fWindow[i];
+    if (packet != NULL) newWindow[packet->rtpSeqNo()&(newSize-1)] = packet;
   }
+
+  delete[] fWindow;
+  fWindow = newWindow;
+  fWindowSize = newSize;
+  return True;
 }
 
 Boolean ReorderingPacketBuffer::storePacket(BufferedPacket* bPacket) {
   unsigned short rtpSeqNo = bPacket->rtpSeqNo();
 
   if (!fHaveSeenFirstPacket) {
+    // Anything still stored belongs to a previous stream (e.g., before a SSRC change):
+    freeStoredPackets();
     fNextExpectedSeqNo = rtpSeqNo; // initialization
     bPacket->isFirstPacket() = True;
     fHaveSeenFirstPacket = True;
@@ -513,76 +697,48 @@ Boolean ReorderingPacketBuffer::storePacket(BufferedPacket* bPacket) {
   // that we're looking for (in this case, it's been excessively delayed).
   if (seqNumLT(rtpSeqNo, fNextExpectedSeqNo)) return False;
 
-  if (fTailPacket == NULL) {
-    // Common case: There are no packets in the queue; this will be the first one:
-    bPacket->nextPacket() = NULL;
-    fHeadPacket = fTailPacket = bPacket;
-    return True;
-  }
-
-  if (seqNumLT(fTailPacket->rtpSeqNo(), rtpSeqNo)) {
-    // The next-most common case: There are packets already in the queue; this packet arrived in order => put it at the tail:
-    bPacket->nextPacket() = NULL;
-    fTailPacket->nextPacket() = bPacket;
-    fTailPacket = bPacket;
-    return True;
-  } 
+  // Make sure that the packet doesn't share its slot with any of those that we're waiting for:
+  unsigned short distance = rtpSeqNo - fNextExpectedSeqNo;
+  if (distance >= fWindowSize && !growWindow(distance + 1)) return False;
 
-  if (rtpSeqNo == fTailPacket->rtpSeqNo()) {
+  BufferedPacket*& slot = slotFor(rtpSeqNo);
+  if (slot != NULL) {
     // This is a duplicate packet - ignore it
     return False;
   }
 
-  // Rare case: This packet is out-of-order.  Run through the list (from the head), to figure out where it belongs:
-  BufferedPacket* beforePtr = NULL;
-  BufferedPacket* afterPtr = fHeadPacket;
-  while (afterPtr != NULL) {
-    if (seqNumLT(rtpSeqNo, afterPtr->rtpSeqNo())) break; // it comes here
-    if (rtpSeqNo == afterPtr->rtpSeqNo()) {
-      // This is a duplicate packet - ignore it
-      return False;
-    }
-
-    beforePtr = afterPtr;
-    afterPtr = afterPtr->nextPacket();
-  }
-
-  // Link our new packet between "beforePtr" and "afterPtr":
-  bPacket->nextPacket() = afterPtr;
-  if (beforePtr == NULL) {
-    fHeadPacket = bPacket;
-  } else {
-    beforePtr->nextPacket() = bPacket;
-  }
-
+  slot = bPacket;
+  if (fNumStoredPackets++ == 0 || seqNumLT(rtpSeqNo, fHeadSeqNo)) fHeadSeqNo = rtpSeqNo;
   return True;
 }
 
 void ReorderingPacketBuffer::releaseUsedPacket(BufferedPacket* packet) {
-  // ASSERT: packet == fHeadPacket
+  // ASSERT: packet is the one stored at fHeadSeqNo
   // ASSERT: fNextExpectedSeqNo == packet->rtpSeqNo()
+  slotFor(fNextExpectedSeqNo) = NULL;
   ++fNextExpectedSeqNo; // because we're finished with this packet now
 
-  fHeadPacket = fHeadPacket->nextPacket();
-  if (!fHeadPacket) { 
-    fTailPacket = NULL;
+  if (--fNumStoredPackets > 0) {
+    // Find the next stored packet.  (Every empty slot that we pass is a packet that's missing.)
+    fHeadSeqNo = fNextExpectedSeqNo;
+    while (slotFor(fHeadSeqNo) == NULL) ++fHeadSeqNo;
   }
-  packet->nextPacket() = NULL;
 
   freePacket(packet);
 }
 
 BufferedPacket* ReorderingPacketBuffer
 ::getNextCompletedPacket(Boolean& packetLossPreceded) {
-  if (fHeadPacket == NULL) return NULL;
+  if (fNumStoredPackets == 0) return NULL;
+  BufferedPacket* headPacket = slotFor(fHeadSeqNo);
 
   // Check whether the next packet we want is already at the head
   // of the queue:
-  // ASSERT: fHeadPacket->rtpSeqNo() >= fNextExpectedSeqNo
-  if (fHeadPacket->rtpSeqNo() == fNextExpectedSeqNo) {
-    packetLossPreceded = fHeadPacket->isFirstPacket();
+  // ASSERT: fHeadSeqNo >= fNextExpectedSeqNo
+  if (fHeadSeqNo == fNextExpectedSeqNo) {
+    packetLossPreceded = headPacket->isFirstPacket();
         // (The very first packet is treated as if there was packet loss beforehand.)
-    return fHeadPacket;
+    return headPacket;
   }
 
   // We're still waiting for our desired packet to arrive.  However, if
@@ -595,15 +751,15 @@ BufferedPacket* ReorderingPacketBuffer
     struct timeval timeNow;
     gettimeofday(&timeNow, NULL);
     unsigned uSecondsSinceReceived
-      = (timeNow.tv_sec - fHeadPacket->timeReceived().tv_sec)*1000000
-      + (timeNow.tv_usec - fHeadPacket->timeReceived().tv_usec);
+      = (timeNow.tv_sec - headPacket->timeReceived().tv_sec)*1000000
+      + (timeNow.tv_usec - headPacket->timeReceived().tv_usec);
     timeThresholdHasBeenExceeded = uSecondsSinceReceived > fThresholdTime;
   }
   if (timeThresholdHasBeenExceeded) {
-    fNextExpectedSeqNo = fHeadPacket->rtpSeqNo();
+    fNextExpectedSeqNo = fHeadSeqNo;
         // we've given up on earlier packets now
     packetLossPreceded = True;
-    return fHeadPacket;
+    return headPacket;
   }
 
   // Otherwise, keep waiting for our desired packet to arrive:
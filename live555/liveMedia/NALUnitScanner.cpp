@@ -0,0 +1,164 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// "liveMedia"
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// Fast scanning of MPEG-style (H.264, H.265, MPEG-1/2/4) byte streams, using SIMD instructions
+// where the CPU supports them
+// Implementation
+
+#include "NALUnitScanner.hh"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define NAL_UNIT_SCANNER_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#include <cpuid.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#if defined(_MSC_VER)
+static unsigned countTrailingZeros(unsigned mask) { // "mask" != 0
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+}
+#else
+#define countTrailingZeros(mask) ((unsigned)__builtin_ctz(mask))
+#endif
+
+typedef u_int8_t const* FindZeroBytePairFunc(u_int8_t const* from, u_int8_t const* to,
+					     u_int8_t minThirdByte, u_int8_t maxThirdByte);
+
+static u_int8_t const* findZeroBytePairScalar(u_int8_t const* from, u_int8_t const* to,
+					      u_int8_t minThirdByte, u_int8_t maxThirdByte) {
+  // Look at the candidates for the third byte.  After a non-zero byte that isn't one, we can
+  // skip ahead by 3, because none of the next two bytes can be preceded by two zero bytes:
+  u_int8_t const* ptr = from + 2;
+  while (ptr < to) {
+    u_int8_t const byte = *ptr;
+    if (byte >= minThirdByte && byte <= maxThirdByte && ptr[-1] == 0 && ptr[-2] == 0) return ptr - 2;
+    ptr += byte == 0 ? 1 : 3;
+  }
+  return to;
+}
+
+#ifdef NAL_UNIT_SCANNER_X86
+
+static u_int8_t const* findZeroBytePairSSE2(u_int8_t const* from, u_int8_t const* to,
+					    u_int8_t minThirdByte, u_int8_t maxThirdByte) {
+  __m128i const zero = _mm_setzero_si128();
+  __m128i const minThird = _mm_set1_epi8((char)minThirdByte);
+  __m128i const thirdRange = _mm_set1_epi8((char)(maxThirdByte - minThirdByte));
+
+  u_int8_t const* ptr = from;
+  // Each step tests 16 candidate positions, which need 18 bytes:
+  while (to - ptr >= 18) {
+    __m128i const b0 = _mm_loadu_si128((__m128i const*)ptr);
+    __m128i const b1 = _mm_loadu_si128((__m128i const*)(ptr + 1));
+    __m128i const b2 = _mm_sub_epi8(_mm_loadu_si128((__m128i const*)(ptr + 2)), minThird);
+    __m128i const thirdInRange = _mm_cmpeq_epi8(_mm_min_epu8(b2, thirdRange), b2); // unsigned b2 <= range
+    __m128i const match = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+					thirdInRange);
+    unsigned const mask = (unsigned)_mm_movemask_epi8(match);
+    if (mask != 0) return ptr + countTrailingZeros(mask);
+    ptr += 16;
+  }
+  return findZeroBytePairScalar(ptr, to, minThirdByte, maxThirdByte);
+}
+
+TARGET_AVX2 static u_int8_t const* findZeroBytePairAVX2(u_int8_t const* from, u_int8_t const* to,
+							u_int8_t minThirdByte, u_int8_t maxThirdByte) {
+  __m256i const zero = _mm256_setzero_si256();
+  __m256i const minThird = _mm256_set1_epi8((char)minThirdByte);
+  __m256i const thirdRange = _mm256_set1_epi8((char)(maxThirdByte - minThirdByte));
+
+  u_int8_t const* ptr = from;
+  // Each step tests 32 candidate positions, which need 34 bytes:
+  while (to - ptr >= 34) {
+    __m256i const b0 = _mm256_loadu_si256((__m256i const*)ptr);
+    __m256i const b1 = _mm256_loadu_si256((__m256i const*)(ptr + 1));
+    __m256i const b2 = _mm256_sub_epi8(_mm256_loadu_si256((__m256i const*)(ptr + 2)), minThird);
+    __m256i const thirdInRange = _mm256_cmpeq_epi8(_mm256_min_epu8(b2, thirdRange), b2);
+    __m256i const match = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(b0, zero), _mm256_cmpeq_epi8(b1, zero)),
+					   thirdInRange);
+    unsigned const mask = (unsigned)_mm256_movemask_epi8(match);
+    if (mask != 0) return ptr + countTrailingZeros(mask);
+    ptr += 32;
+  }
+  return findZeroBytePairSSE2(ptr, to, minThirdByte, maxThirdByte);
+}
+
+static Boolean cpuSupportsAVX2() {
+  unsigned leaf1[4], leaf7[4]; // eax, ebx, ecx, edx
+#if defined(_MSC_VER)
+  int regs[4];
+  __cpuid(regs, 0);
+  if (regs[0] < 7) return False;
+  __cpuid(regs, 1);
+  for (int i = 0; i < 4; ++i) leaf1[i] = (unsigned)regs[i];
+  __cpuidex(regs, 7, 0);
+  for (int i = 0; i < 4; ++i) leaf7[i] = (unsigned)regs[i];
+#else
+  if (__get_cpuid_max(0, NULL) < 7) return False;
+  __cpuid(1, leaf1[0], leaf1[1], leaf1[2], leaf1[3]);
+  __cpuid_count(7, 0, leaf7[0], leaf7[1], leaf7[2], leaf7[3]);
+#endif
+  // The OS must also save the AVX (YMM) state on context switches ("OSXSAVE" and XCR0 bits 1-2):
+  if ((leaf1[2] & (1 << 27)) == 0 || (leaf1[2] & (1 << 28)) == 0) return False;
+#if defined(_MSC_VER)
+  unsigned long long const xcr0 = _xgetbv(0);
+#else
+  unsigned xcr0Low, xcr0High;
+  __asm__ ("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+  unsigned long long const xcr0 = xcr0Low;
+#endif
+  if ((xcr0 & 0x6) != 0x6) return False;
+  return (leaf7[1] & (1 << 5)) != 0; // AVX2
+}
+
+#endif
+
+static FindZeroBytePairFunc* chooseFindZeroBytePair(char const*& instructionSet) {
+#ifdef NAL_UNIT_SCANNER_X86
+  if (cpuSupportsAVX2()) {
+    instructionSet = "AVX2";
+    return findZeroBytePairAVX2;
+  }
+  instructionSet = "SSE2";
+  return findZeroBytePairSSE2;
+#else
+  instructionSet = "scalar";
+  return findZeroBytePairScalar;
+#endif
+}
+
+// Chosen once, during static initialization (so before any thread can use it):
+static char const* ourInstructionSet = "scalar";
+static FindZeroBytePairFunc* const ourFindZeroBytePair = chooseFindZeroBytePair(ourInstructionSet);
+
+u_int8_t const* findZeroBytePair(u_int8_t const* from, u_int8_t const* to,
+				 u_int8_t minThirdByte, u_int8_t maxThirdByte) {
+  return (*ourFindZeroBytePair)(from, to, minThirdByte, maxThirdByte);
+}
+
+char const* nalUnitScannerInstructionSet() {
+  return ourInstructionSet;
+}
@@ -60,9 +60,19 @@ public:
     fServerRequestAlternativeByteHandlerClientData = clientData;
   }
 
+  int readData(u_int8_t* to, unsigned numBytes);
+      // Reads (up to) "numBytes" of packet data, from our read-ahead buffer if possible.
+      // Returns the same as "readSocket()".
+
 private:
   static void tcpReadHandler(SocketDescriptor*, int mask);
+  void tcpReadHandlerLoop(int mask);
   Boolean tcpReadHandler1(int mask);
+  static void continueTCPReading(void* clientData);
+
+  unsigned numBufferedBytes() const { return fReadBufferEnd - fReadBufferStart; }
+  int fillReadBuffer();
+  void handOverBufferedBytes();
 
 private:
   UsageEnvironment& fEnv;
@@ -73,8 +83,15 @@ private:
   u_int8_t fStreamChannelId, fSizeByte1;
   Boolean fReadErrorOccurred, fDeleteMyselfNext, fAreInReadHandlerLoop;
   enum { AWAITING_DOLLAR, AWAITING_STREAM_CHANNEL_ID, AWAITING_SIZE1, AWAITING_SIZE2, AWAITING_PACKET_DATA } fTCPReadingState;
+  // Read-ahead buffer: each "recv()" pulls in as much as is available, and several '$'-framed
+  // RTP/RTCP packets are then parsed out of it, instead of one "recv()" per framing byte:
+  u_int8_t* fReadBuffer;
+  unsigned fReadBufferStart, fReadBufferEnd;
+  TaskToken fContinueReadingTask;
 };
 
+#define TCP_READ_BUFFER_SIZE 65536
+
 static SocketDescriptor* lookupSocketDescriptor(UsageEnvironment& env, int sockNum, Boolean createIfNotFound = True) {
   HashTable* table = socketHashTable(env, createIfNotFound);
   if (table == NULL) return NULL;
@@ -242,15 +259,18 @@ Boolean RTPInterface::handleRead(unsigned char* buffer, unsigned bufferMaxSize,
     // Normal case: read from the (datagram) 'groupsock':
     readSuccess = fGS->handleRead(buffer, bufferMaxSize, bytesRead, fromAddress);
   } else {
-    // Read from the TCP connection:
+    // Read from the TCP connection (through its read-ahead buffer, if any):
     bytesRead = 0;
     unsigned totBytesToRead = fNextTCPReadSize;
     if (totBytesToRead > bufferMaxSize) totBytesToRead = bufferMaxSize;
     unsigned curBytesToRead = totBytesToRead;
+    SocketDescriptor* socketDescriptor
+      = lookupSocketDescriptor(envir(), fNextTCPReadStreamSocketNum, False);
     int curBytesRead;
-    while ((curBytesRead = readSocket(envir(), fNextTCPReadStreamSocketNum,
-				      &buffer[bytesRead], curBytesToRead,
-				      fromAddress)) > 0) {
+    while ((curBytesRead = socketDescriptor != NULL
+	    ? socketDescriptor->readData(&buffer[bytesRead], curBytesToRead)
+	    : readSocket(envir(), fNextTCPReadStreamSocketNum,
+			 &buffer[bytesRead], curBytesToRead, fromAddress)) > 0) {
       bytesRead += curBytesRead;
       if (bytesRead >= totBytesToRead) break;
       curBytesToRead -= curBytesRead;
@@ -278,6 +298,17 @@ Boolean RTPInterface::handleRead(unsigned char* buffer, unsigned bufferMaxSize,
   return readSuccess;
 }
 
+int RTPInterface::handleReadBatch(unsigned char* const* buffers, unsigned bufferMaxSize, unsigned numBuffers,
+				  unsigned* bytesRead) {
+  int numRead = fGS->handleReadBatch(buffers, bufferMaxSize, numBuffers, bytesRead);
+
+  if (fAuxReadHandlerFunc != NULL) {
+    // Also pass each newly-read packet's data to our auxilliary handler:
+    for (int i = 0; i < numRead; ++i) (*fAuxReadHandlerFunc)(fAuxReadHandlerClientData, buffers[i], bytesRead[i]);
+  }
+  return numRead;
+}
+
 void RTPInterface::stopNetworkReading() {
   // Normal case
   envir().taskScheduler().turnOffBackgroundReadHandling(fGS->socketNum());
@@ -353,10 +384,13 @@ SocketDescriptor::SocketDescriptor(UsageEnvironment& env, int socketNum)
   :fEnv(env), fOurSocketNum(socketNum),
     fSubChannelHashTable(HashTable::create(ONE_WORD_HASH_KEYS)),
    fServerRequestAlternativeByteHandler(NULL), fServerRequestAlternativeByteHandlerClientData(NULL),
-   fReadErrorOccurred(False), fDeleteMyselfNext(False), fAreInReadHandlerLoop(False), fTCPReadingState(AWAITING_DOLLAR) {
+   fReadErrorOccurred(False), fDeleteMyselfNext(False), fAreInReadHandlerLoop(False), fTCPReadingState(AWAITING_DOLLAR),
+   fReadBuffer(new u_int8_t[TCP_READ_BUFFER_SIZE]), fReadBufferStart(0), fReadBufferEnd(0),
+   fContinueReadingTask(NULL) {
 }
 
 SocketDescriptor::~SocketDescriptor() {
+  fEnv.taskScheduler().unscheduleDelayedTask(fContinueReadingTask);
   fEnv.taskScheduler().turnOffBackgroundReadHandling(fOurSocketNum);
   removeSocketDescription(fEnv, fOurSocketNum);
 
@@ -381,12 +415,56 @@ SocketDescriptor::~SocketDescriptor() {
 
   // Finally:
   if (fServerRequestAlternativeByteHandler != NULL) {
+    // Any RTSP bytes that we've already read ahead from the socket must not get lost:
+    if (!fReadErrorOccurred) handOverBufferedBytes();
+
     // Hack: Pass a special character to our alternative byte handler, to tell it that either
     // - an error occurred when reading the TCP socket, or
     // - no error occurred, but it needs to take over control of the TCP socket once again.
     u_int8_t specialChar = fReadErrorOccurred ? 0xFF : 0xFE;
     (*fServerRequestAlternativeByteHandler)(fServerRequestAlternativeByteHandlerClientData, specialChar);
   }
+  delete[] fReadBuffer;
+}
+
+int SocketDescriptor::fillReadBuffer() {
+  fReadBufferStart = fReadBufferEnd = 0;
+  struct sockaddr_in fromAddress;
+  int result = readSocket(fEnv, fOurSocketNum, fReadBuffer, TCP_READ_BUFFER_SIZE, fromAddress);
+  if (result > 0) fReadBufferEnd = (unsigned)result;
+  return result;
+}
+
+int SocketDescriptor::readData(u_int8_t* to, unsigned numBytes) {
+  if (numBufferedBytes() == 0) {
+    int result = fillReadBuffer();
+    if (result <= 0) return result;
+  }
+
+  unsigned numBytesToCopy = numBufferedBytes();
+  if (numBytesToCopy > numBytes) numBytesToCopy = numBytes;
+  memmove(to, &fReadBuffer[fReadBufferStart], numBytesToCopy);
+  fReadBufferStart += numBytesToCopy;
+  return (int)numBytesToCopy;
+}
+
+void SocketDescriptor::handOverBufferedBytes() {
+  // Skip complete '$'-framed packets (no-one is interested in them anymore), and pass everything
+  // else to the alternative byte handler:
+  while (numBufferedBytes() > 0) {
+    u_int8_t* p = &fReadBuffer[fReadBufferStart];
+    if (p[0] == '$' && numBufferedBytes() >= 4) {
+      unsigned frameSize = 4 + ((p[2]<<8)|p[3]);
+      if (frameSize <= numBufferedBytes()) {
+	fReadBufferStart += frameSize;
+	continue;
+      }
+    }
+    ++fReadBufferStart;
+    if (p[0] != 0xFF && p[0] != 0xFE) {
+      (*fServerRequestAlternativeByteHandler)(fServerRequestAlternativeByteHandlerClientData, p[0]);
+    }
+  }
 }
 
 void SocketDescriptor::registerRTPInterface(unsigned char streamChannelId,
@@ -431,12 +509,31 @@ void SocketDescriptor
 }
 
 void SocketDescriptor::tcpReadHandler(SocketDescriptor* socketDescriptor, int mask) {
+  socketDescriptor->tcpReadHandlerLoop(mask);
+}
+
+void SocketDescriptor::continueTCPReading(void* clientData) {
+  SocketDescriptor* socketDescriptor = (SocketDescriptor*)clientData;
+  socketDescriptor->fContinueReadingTask = NULL;
+  socketDescriptor->tcpReadHandlerLoop(SOCKET_READABLE);
+}
+
+void SocketDescriptor::tcpReadHandlerLoop(int mask) {
   // Call the read handler until it returns false, with a limit to avoid starving other sockets
   unsigned count = 2000;
-  socketDescriptor->fAreInReadHandlerLoop = True;
-  while (!socketDescriptor->fDeleteMyselfNext && socketDescriptor->tcpReadHandler1(mask) && --count > 0) {}
-  socketDescriptor->fAreInReadHandlerLoop = False;
-  if (socketDescriptor->fDeleteMyselfNext) delete socketDescriptor;
+  fAreInReadHandlerLoop = True;
+  while (!fDeleteMyselfNext && tcpReadHandler1(mask) && --count > 0) {}
+  fAreInReadHandlerLoop = False;
+  if (fDeleteMyselfNext) {
+    delete this;
+    return;
+  }
+
+  if (count == 0 && numBufferedBytes() > 0 && fContinueReadingTask == NULL) {
+    // We stopped early, but the socket may already be drained into our buffer, in which case
+    // it won't be reported as readable again.  Finish the buffered data after other sockets:
+    fContinueReadingTask = fEnv.taskScheduler().scheduleDelayedTask(0, continueTCPReading, this);
+  }
 }
 
 Boolean SocketDescriptor::tcpReadHandler1(int mask) {
@@ -449,19 +546,37 @@ Boolean SocketDescriptor::tcpReadHandler1(int mask) {
   // However, because the socket is being read asynchronously, this data might arrive in pieces.
   
   u_int8_t c;
-  struct sockaddr_in fromAddress;
   if (fTCPReadingState != AWAITING_PACKET_DATA) {
-    int result = readSocket(fEnv, fOurSocketNum, &c, 1, fromAddress);
-    if (result == 0) { // There was no more data to read
-      return False;
-    } else if (result != 1) { // error reading TCP socket, so we will no longer handle it
+    if (numBufferedBytes() == 0) {
+      int result = fillReadBuffer();
+      if (result == 0) { // There was no more data to read
+	return False;
+      } else if (result < 0) { // error reading TCP socket, so we will no longer handle it
 #ifdef DEBUG_RECEIVE
-      fprintf(stderr, "SocketDescriptor(socket %d)::tcpReadHandler(): readSocket(1 byte) returned %d (error)\n", fOurSocketNum, result);
+	fprintf(stderr, "SocketDescriptor(socket %d)::tcpReadHandler(): readSocket() returned %d (error)\n", fOurSocketNum, result);
 #endif
-      fReadErrorOccurred = True;
-      fDeleteMyselfNext = True;
-      return False;
+	fReadErrorOccurred = True;
+	fDeleteMyselfNext = True;
+	return False;
+      }
     }
+
+    // Common case: The whole '$'<streamChannelId><packetSize> header is already buffered:
+    u_int8_t const* header = &fReadBuffer[fReadBufferStart];
+    if (fTCPReadingState == AWAITING_DOLLAR && numBufferedBytes() >= 4 && header[0] == '$') {
+      RTPInterface* rtpInterface = lookupRTPInterface(header[1]);
+      if (rtpInterface != NULL) {
+	fStreamChannelId = header[1];
+	rtpInterface->fNextTCPReadSize = (header[2]<<8)|header[3];
+	rtpInterface->fNextTCPReadStreamSocketNum = fOurSocketNum;
+	rtpInterface->fNextTCPReadStreamChannelId = fStreamChannelId;
+	fReadBufferStart += 4;
+	fTCPReadingState = AWAITING_PACKET_DATA;
+	return True;
+      }
+    }
+
+    c = fReadBuffer[fReadBufferStart++];
   }
 
   Boolean callAgain = True;
@@ -516,13 +631,12 @@ Boolean SocketDescriptor::tcpReadHandler1(int mask) {
       break;
     }
     case AWAITING_PACKET_DATA: {
-      callAgain = False;
       fTCPReadingState = AWAITING_DOLLAR; // the next state, unless we end up having to read more data in the current state
       // Call the appropriate read handler to get the packet data from the TCP stream:
       RTPInterface* rtpInterface = lookupRTPInterface(fStreamChannelId);
       if (rtpInterface != NULL) {
 	if (rtpInterface->fNextTCPReadSize == 0) {
-	  // We've already read all the data for this packet.
+	  // We've already read all the data for this packet.  Go on with the next one (if buffered):
 	  break;
 	}
 	if (rtpInterface->fReadHandlerProc != NULL) {
@@ -531,25 +645,32 @@ Boolean SocketDescriptor::tcpReadHandler1(int mask) {
 #endif
 	  fTCPReadingState = AWAITING_PACKET_DATA;
 	  rtpInterface->fReadHandlerProc(rtpInterface->fOwner, mask);
+	  // (Note that "rtpInterface" might have been deleted by the handler.)
+	  // If data is still buffered, the packet was read completely, so we can carry on parsing.
+	  // Otherwise, let the socket tell us when there's more:
+	  callAgain = numBufferedBytes() > 0;
 	} else {
 #ifdef DEBUG_RECEIVE
 	  fprintf(stderr, "SocketDescriptor(socket %d)::tcpReadHandler(): No handler proc for \"rtpInterface\" for channel %d; need to skip %d remaining bytes\n", fOurSocketNum, fStreamChannelId, rtpInterface->fNextTCPReadSize);
 #endif
-	  int result = readSocket(fEnv, fOurSocketNum, &c, 1, fromAddress);
-	  if (result < 0) { // error reading TCP socket, so we will no longer handle it
+	  fTCPReadingState = AWAITING_PACKET_DATA;
+	  if (numBufferedBytes() == 0) {
+	    int result = fillReadBuffer();
+	    if (result < 0) { // error reading TCP socket, so we will no longer handle it
 #ifdef DEBUG_RECEIVE
-	    fprintf(stderr, "SocketDescriptor(socket %d)::tcpReadHandler(): readSocket(1 byte) returned %d (error)\n", fOurSocketNum, result);
+	      fprintf(stderr, "SocketDescriptor(socket %d)::tcpReadHandler(): readSocket() returned %d (error)\n", fOurSocketNum, result);
 #endif
-	    fReadErrorOccurred = True;
-	    fDeleteMyselfNext = True;
-	    return False;
-	  } else {
-	    fTCPReadingState = AWAITING_PACKET_DATA;
-	    if (result == 1) {
-	      --rtpInterface->fNextTCPReadSize;
-	      callAgain = True;
+	      fReadErrorOccurred = True;
+	      fDeleteMyselfNext = True;
+	      return False;
+	    } else if (result == 0) {
+	      return False;
 	    }
 	  }
+	  unsigned numBytesToSkip = numBufferedBytes();
+	  if (numBytesToSkip > rtpInterface->fNextTCPReadSize) numBytesToSkip = rtpInterface->fNextTCPReadSize;
+	  fReadBufferStart += numBytesToSkip;
+	  rtpInterface->fNextTCPReadSize -= numBytesToSkip;
 	}
       }
 #ifdef DEBUG_RECEIVE
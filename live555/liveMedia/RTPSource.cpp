@@ -53,9 +53,12 @@ RTPSource::RTPSource(UsageEnvironment& env, Groupsock* RTPgs,
 		     u_int32_t rtpTimestampFrequency)
   : FramedSource(env),
     fRTPInterface(this, RTPgs),
+    fCurFrameEndsPacket(True), fNumFragmentedFramesLost(0),
     fCurPacketHasBeenSynchronizedUsingRTCP(False), fLastReceivedSSRC(0),
     fRTPPayloadFormat(rtpPayloadFormat), fTimestampFrequency(rtpTimestampFrequency),
     fSSRC(our_random32()), fEnableRTCPReports(True) {
+  fCurFrameTimeReceived.tv_sec = fCurFrameTimeReceived.tv_usec = 0;
+  fCurPacketTimeReceived = fCurFrameTimeReceived;
   fReceptionStatsDB = new RTPReceptionStatsDB();
 }
 
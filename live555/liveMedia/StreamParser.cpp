@@ -19,6 +19,7 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 // Implementation
 
 #include "StreamParser.hh"
+#include "NALUnitScanner.hh"
 
 #include <string.h>
 #include <stdlib.h>
@@ -65,6 +66,20 @@ void StreamParser::restoreSavedParserState() {
   fRemainingUnparsedBits = fSavedRemainingUnparsedBits;
 }
 
+unsigned StreamParser::numBytesBeforeStartCode(unsigned char const*& ptr) {
+  ptr = nextToParse();
+  unsigned char const* end = &curBank()[fTotNumValidBytes];
+  unsigned char const* startCode = findStartCode(ptr, end);
+  if (startCode == end) {
+    // Keep the last 3 bytes; they might begin a start code that we haven't read all of yet:
+    return end - ptr > 3 ? (end - ptr) - 3 : 0;
+  }
+
+  // Include a preceding zero byte (making this a 4-byte start code), if there is one:
+  if (startCode > ptr && startCode[-1] == 0) --startCode;
+  return startCode - ptr;
+}
+
 void StreamParser::skipBits(unsigned numBits) {
   if (numBits <= fRemainingUnparsedBits) {
     fRemainingUnparsedBits -= numBits;
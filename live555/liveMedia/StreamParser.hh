@@ -93,6 +93,12 @@ protected: // we're a virtual base class
     fCurParserIndex += numBytes;
   }
 
+  // Looks for the next 0x000001 or 0x00000001 start code among the bytes that have already been
+  // read (without reading any more), and returns the number of bytes that precede it - or, if
+  // there's none, the number of bytes that can be skipped without missing one.  "ptr" is set to
+  // the current parse position:
+  unsigned numBytesBeforeStartCode(unsigned char const*& ptr);
+
   void skipBits(unsigned numBits);
   unsigned getBits(unsigned numBits);
       // numBits <= 32; returns data into low-order bits of result
@@ -33,152 +33,116 @@ private: // redefined virtual functions:
   virtual void doStopGettingFrames();
 
 private:
-  static void copyReceivedFrame(StreamReplica* toReplica, StreamReplica* fromReplica);
+  void copyFrame(ReplicatorFrameSlot const& slot);
 
 private:
   StreamReplicator& fOurReplicator;
-  int fFrameIndex; // 0 or 1, depending upon which frame we're currently requesting; could also be -1 if we've stopped playing
-  Boolean fDeliveryInProgress;
+  Boolean fIsActive; // False if we've stopped playing (or haven't started yet)
+  unsigned fCursor; // the next frame we read (when active)
+  Boolean fSkipToKeyFrame; // we fell behind, and lost frames; resume at a key frame
+  Boolean fIsAwaitingFrame; // the frame at our cursor hasn't been read from the input source yet
 
-  // Replicas that are currently awaiting data are kept in a (singly-linked) list:
+  // All replicas of a replicator are kept in a (singly-linked) list:
   StreamReplica* fNext;
 };
 
 
+////////// Definition of "ReplicatorFrameSlot": A frame in the replicator's ring //////////
+
+class ReplicatorFrameSlot {
+public:
+  ReplicatorFrameSlot()
+    : fData(NULL), fBufferSize(0), fFrameSize(0), fNumTruncatedBytes(0), fDurationInMicroseconds(0),
+      fIsKeyFrame(False), fRefCount(0) {
+    fPresentationTime.tv_sec = fPresentationTime.tv_usec = 0;
+  }
+  virtual ~ReplicatorFrameSlot() { delete[] fData; }
+
+  unsigned char* fData;
+  unsigned fBufferSize;
+  unsigned fFrameSize;
+  unsigned fNumTruncatedBytes;
+  struct timeval fPresentationTime;
+  unsigned fDurationInMicroseconds;
+  Boolean fIsKeyFrame;
+  unsigned fRefCount; // the number of active replicas that are yet to read (or skip) this frame
+};
+
+
 ////////// StreamReplicator implementation //////////
 
-StreamReplicator* StreamReplicator::createNew(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies) {
-  return new StreamReplicator(env, inputSource, deleteWhenLastReplicaDies);
+StreamReplicator* StreamReplicator::createNew(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies,
+					      unsigned numBufferedFrames, isKeyFrameFunc* isKeyFrame, void* isKeyFrameClientData) {
+  return new StreamReplicator(env, inputSource, deleteWhenLastReplicaDies, numBufferedFrames, isKeyFrame, isKeyFrameClientData);
 }
 
-StreamReplicator::StreamReplicator(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies)
+StreamReplicator::StreamReplicator(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies,
+				   unsigned numBufferedFrames, isKeyFrameFunc* isKeyFrame, void* isKeyFrameClientData)
   : Medium(env),
     fInputSource(inputSource), fDeleteWhenLastReplicaDies(deleteWhenLastReplicaDies), fInputSourceHasClosed(False),
-    fNumReplicas(0), fNumActiveReplicas(0), fNumDeliveriesMadeSoFar(0),
-    fFrameIndex(0), fMasterReplica(NULL), fReplicasAwaitingCurrentFrame(NULL), fReplicasAwaitingNextFrame(NULL) {
+    fNumReplicas(0), fNumActiveReplicas(0), fNumAwaitingReplicas(0),
+    fIsKeyFrame(isKeyFrame), fIsKeyFrameClientData(isKeyFrameClientData),
+    fSlotBufferSize(0), fNextFrameNumber(0), fReplicas(NULL), fNextReplicaToVisit(NULL), fIsDelivering(False),
+    fNumFramesSkipped(0) {
+  // Use a power of 2 (at least 2) for the number of slots, so that frame numbers map onto them even when they wrap around:
+  unsigned numSlots = 2;
+  while (numSlots < numBufferedFrames) numSlots <<= 1;
+  fSlots = new ReplicatorFrameSlot[numSlots];
+  fSlotMask = numSlots - 1;
 }
 
 StreamReplicator::~StreamReplicator() {
-  Medium::close(fInputSource);
+  Medium::close(fInputSource); // before our slots go away, in case it's still reading into one of them
+  delete[] fSlots;
 }
 
 FramedSource* StreamReplicator::createStreamReplica() {
   ++fNumReplicas;
-  return new StreamReplica(*this);
+  StreamReplica* replica = new StreamReplica(*this);
+  replica->fNext = fReplicas;
+  fReplicas = replica;
+  return replica;
 }
 
 void StreamReplicator::getNextFrame(StreamReplica* replica) {
+  if (replica->fMaxSize > fSlotBufferSize) fSlotBufferSize = replica->fMaxSize;
+
+  if (!replica->fIsActive) {
+    // This replica had stopped playing (or had just been created), but is now actively reading.  It starts with the next
+    // frame to be read:
+    replica->fIsActive = True;
+    replica->fCursor = fNextFrameNumber;
+    replica->fSkipToKeyFrame = False;
+    ++fNumActiveReplicas;
+  }
+
+  // Frames that have already been read are delivered right away (even after our input source has closed):
+  if (deliverBufferedFrame(replica)) return;
+
   if (fInputSourceHasClosed) { // handle closure instead
     replica->handleClosure();
     return;
   }
 
-  if (replica->fFrameIndex == -1) {
-    // This replica had stopped playing (or had just been created), but is now actively reading.  Note this:
-    replica->fFrameIndex = fFrameIndex;
-    ++fNumActiveReplicas;
-  }
-
-  if (fMasterReplica == NULL) {
-    // This is the first replica to request the next unread frame.  Make it the 'master' replica - meaning that we read the frame
-    // into its buffer, and then copy from this into the other replicas' buffers.
-    fMasterReplica = replica;
-
-    // Arrange to read the next frame into this replica's buffer:
-    if (fInputSource != NULL) fInputSource->getNextFrame(fMasterReplica->fTo, fMasterReplica->fMaxSize,
-							 afterGettingFrame, this, onSourceClosure, this);
-  } else if (replica->fFrameIndex != fFrameIndex) {
-    // This replica is already asking for the next frame (because it has already received the current frame).  Enqueue it:
-    replica->fNext = fReplicasAwaitingNextFrame;
-    fReplicasAwaitingNextFrame = replica;
-  } else {
-    // This replica is asking for the current frame.  Enqueue it:
-    replica->fNext = fReplicasAwaitingCurrentFrame;
-    fReplicasAwaitingCurrentFrame = replica;
-
-    if (fInputSource != NULL && !fInputSource->isCurrentlyAwaitingData()) {
-      // The current frame has already arrived, so deliver it to this replica now:
-      deliverReceivedFrame();
-    }
-  }
+  replica->fIsAwaitingFrame = True;
+  ++fNumAwaitingReplicas;
+  readNextFrame();
 }
 
 void StreamReplicator::deactivateStreamReplica(StreamReplica* replicaBeingDeactivated) {
   // Assert: fNumActiveReplicas > 0
-  if (fNumReplicas == 0) fprintf(stderr, "StreamReplicator::deactivateStreamReplica() Internal Error!\n"); // should not happen
+  if (fNumActiveReplicas == 0) fprintf(stderr, "StreamReplicator::deactivateStreamReplica() Internal Error!\n"); // should not happen
   --fNumActiveReplicas;
+  replicaBeingDeactivated->fIsActive = False;
 
-  if (replicaBeingDeactivated->fDeliveryInProgress) --fNumDeliveriesMadeSoFar;
-    // hack in case we're called while in the middle of a frame delivery to us
-
-  // Check whether the replica being deactivated is the 'master' replica, or is enqueued awaiting a frame:
-  if (replicaBeingDeactivated == fMasterReplica) {
-    // We need to replace the 'master replica', if we can:
-    if (fReplicasAwaitingCurrentFrame == NULL) {
-      // There's currently no replacement 'master replica'
-      fMasterReplica = NULL;
-    } else {
-      // There's another replica that we can use as a replacement 'master replica':
-      fMasterReplica = fReplicasAwaitingCurrentFrame;
-      fReplicasAwaitingCurrentFrame = fReplicasAwaitingCurrentFrame->fNext;
-      fMasterReplica->fNext = NULL;
-    }
-
-    // Check whether the read into the old master replica's buffer is still pending, or has completed:
-    if (fInputSource != NULL) {
-      if (fInputSource->isCurrentlyAwaitingData()) {
-	// We have a pending read into the old master replica's buffer.
-	// We need to stop it, and retry the read with a new master (if available)
-	fInputSource->stopGettingFrames();
-
-	if (fMasterReplica != NULL) {
-	  fInputSource->getNextFrame(fMasterReplica->fTo, fMasterReplica->fMaxSize,
-				     afterGettingFrame, this, onSourceClosure, this);
-	}
-      } else {
-	// The read into the old master replica's buffer has already completed.  Copy the data to the new master replica (if any):
-	if (fMasterReplica != NULL) {
-	  StreamReplica::copyReceivedFrame(fMasterReplica, replicaBeingDeactivated);
-	} else {
-	  // We don't have a new master replica, so we can't copy the received frame to any new replica that might ask for it.
-	  // Fortunately this should be a very rare occurrence.
-	}
-      }
-    }
-  } else {
-    // The replica that's being removed was not our 'master replica', but make sure it's not on either of our queues:
-    if (fReplicasAwaitingCurrentFrame != NULL) {
-      if (replicaBeingDeactivated == fReplicasAwaitingCurrentFrame) {
-	fReplicasAwaitingCurrentFrame = replicaBeingDeactivated->fNext;
-	replicaBeingDeactivated->fNext = NULL;
-      }
-      else {
-	for (StreamReplica* r1 = fReplicasAwaitingCurrentFrame; r1->fNext != NULL; r1 = r1->fNext) {
-	  if (r1->fNext == replicaBeingDeactivated) {
-	    r1->fNext = replicaBeingDeactivated->fNext;
-	    replicaBeingDeactivated->fNext = NULL;
-	    break;
-	  }
-	}
-      }
-    }
-    if (fReplicasAwaitingNextFrame != NULL) {
-      if (replicaBeingDeactivated == fReplicasAwaitingNextFrame) {
-	fReplicasAwaitingNextFrame = replicaBeingDeactivated->fNext;
-	replicaBeingDeactivated->fNext = NULL;
-      }
-      else {
-	for (StreamReplica* r2 = fReplicasAwaitingNextFrame; r2->fNext != NULL; r2 = r2->fNext) {
-	  if (r2->fNext == replicaBeingDeactivated) {
-	    r2->fNext = replicaBeingDeactivated->fNext;
-	    replicaBeingDeactivated->fNext = NULL;
-	    break;
-	  }
-	}
-      }
-    }
+  if (replicaBeingDeactivated->fIsAwaitingFrame) {
+    replicaBeingDeactivated->fIsAwaitingFrame = False;
+    --fNumAwaitingReplicas;
   }
 
+  // Release the frames that this replica hasn't read:
+  for (unsigned n = replicaBeingDeactivated->fCursor; n != fNextFrameNumber; ++n) --fSlots[n&fSlotMask].fRefCount;
+
   if (fNumActiveReplicas == 0 && fInputSource != NULL) fInputSource->stopGettingFrames(); // tell our source to stop too
 }
 
@@ -187,15 +151,24 @@ void StreamReplicator::removeStreamReplica(StreamReplica* replicaBeingRemoved) {
   if (fNumReplicas == 0) fprintf(stderr, "StreamReplicator::removeStreamReplica() Internal Error!\n"); // should not happen
   --fNumReplicas;
 
+  // Handle the replica that's being removed the same way that we would if it were merely being deactivated:
+  if (replicaBeingRemoved->fIsActive) { // i.e., we haven't already done this
+    deactivateStreamReplica(replicaBeingRemoved);
+  }
+
+  // Unlink it (keeping any walk through our replicas valid):
+  if (replicaBeingRemoved == fNextReplicaToVisit) fNextReplicaToVisit = replicaBeingRemoved->fNext;
+  for (StreamReplica** r = &fReplicas; *r != NULL; r = &(*r)->fNext) {
+    if (*r == replicaBeingRemoved) {
+      *r = replicaBeingRemoved->fNext;
+      break;
+    }
+  }
+  replicaBeingRemoved->fNext = NULL;
+
   // If this was the last replica, then delete ourselves (if we were set up to do so):
   if (fNumReplicas == 0 && fDeleteWhenLastReplicaDies) {
     delete this;
-    return;
-  }
-
-  // Now handle the replica that's being removed the same way that we would if it were merely being deactivated:
-  if (replicaBeingRemoved->fFrameIndex != -1) { // i.e., we haven't already done this
-    deactivateStreamReplica(replicaBeingRemoved);
   }
 }
 
@@ -206,14 +179,35 @@ void StreamReplicator::afterGettingFrame(void* clientData, unsigned frameSize, u
 
 void StreamReplicator::afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes,
 					 struct timeval presentationTime, unsigned durationInMicroseconds) {
-  // The frame was read into our master replica's buffer.  Update the master replica's state, but don't complete delivery to it
-  // just yet.  We do that later, after we're sure that we've delivered it to all other replicas.
-  fMasterReplica->fFrameSize = frameSize;
-  fMasterReplica->fNumTruncatedBytes = numTruncatedBytes;
-  fMasterReplica->fPresentationTime = presentationTime;
-  fMasterReplica->fDurationInMicroseconds = durationInMicroseconds;
-
-  deliverReceivedFrame();
+  // The frame was read into the next slot of our ring.  Every active replica is to read it (or skip it):
+  ReplicatorFrameSlot& slot = fSlots[fNextFrameNumber&fSlotMask];
+  slot.fFrameSize = frameSize;
+  slot.fNumTruncatedBytes = numTruncatedBytes;
+  slot.fPresentationTime = presentationTime;
+  slot.fDurationInMicroseconds = durationInMicroseconds;
+  slot.fIsKeyFrame = fIsKeyFrame == NULL || (*fIsKeyFrame)(fIsKeyFrameClientData, slot.fData, frameSize);
+  slot.fRefCount = fNumActiveReplicas;
+  ++fNextFrameNumber;
+
+  // Complete delivery to the replicas that have been waiting for this frame:
+  fIsDelivering = True;
+  for (StreamReplica* replica = fReplicas; replica != NULL; replica = fNextReplicaToVisit) {
+    fNextReplicaToVisit = replica->fNext;
+    if (!replica->fIsAwaitingFrame) continue;
+
+    replica->fIsAwaitingFrame = False;
+    --fNumAwaitingReplicas;
+    if (!deliverBufferedFrame(replica)) {
+      // It's still skipping to a key frame - keep it waiting:
+      replica->fIsAwaitingFrame = True;
+      ++fNumAwaitingReplicas;
+    }
+  }
+  fNextReplicaToVisit = NULL;
+  fIsDelivering = False;
+
+  // Replicas may have asked for the next frame meanwhile:
+  readNextFrame();
 }
 
 void StreamReplicator::onSourceClosure(void* clientData) {
@@ -223,76 +217,72 @@ void StreamReplicator::onSourceClosure(void* clientData) {
 void StreamReplicator::onSourceClosure() {
   fInputSourceHasClosed = True;
 
-  // Signal the closure to each replica that is currently awaiting a frame:
-  StreamReplica* replica;
-  while ((replica = fReplicasAwaitingCurrentFrame) != NULL) {
-    fReplicasAwaitingCurrentFrame = replica->fNext;
-    replica->fNext = NULL;
-    replica->handleClosure();
-  }
-  while ((replica = fReplicasAwaitingNextFrame) != NULL) {
-    fReplicasAwaitingNextFrame = replica->fNext;
-    replica->fNext = NULL;
-    replica->handleClosure();
-  }
-  if ((replica = fMasterReplica) != NULL) {
-    fMasterReplica = NULL;
+  // Signal the closure to each replica that is currently awaiting a frame.  (Others will get it once they've read what's
+  // left in our ring.)
+  for (StreamReplica* replica = fReplicas; replica != NULL; replica = fNextReplicaToVisit) {
+    fNextReplicaToVisit = replica->fNext;
+    if (!replica->fIsAwaitingFrame) continue;
+
+    replica->fIsAwaitingFrame = False;
+    --fNumAwaitingReplicas;
     replica->handleClosure();
   }
+  fNextReplicaToVisit = NULL;
 }
 
-void StreamReplicator::deliverReceivedFrame() {
-  // The 'master replica' has received its copy of the current frame.
-  // Copy it (and complete delivery) to any other replica that has requested this frame.
-  // Then, if no more requests for this frame are expected, complete delivery to the 'master replica' itself.
-  StreamReplica* replica;
-  while ((replica = fReplicasAwaitingCurrentFrame) != NULL) {
-    fReplicasAwaitingCurrentFrame = replica->fNext;
-    replica->fNext = NULL;
-    
-    replica->fDeliveryInProgress = True;
-
-    // Assert: fMasterReplica != NULL
-    if (fMasterReplica == NULL) fprintf(stderr, "StreamReplicator::deliverReceivedFrame() Internal Error 1!\n"); // shouldn't happen
-    StreamReplica::copyReceivedFrame(replica, fMasterReplica);
-    replica->fFrameIndex = 1 - replica->fFrameIndex; // toggle it (0<->1), because this replica no longer awaits the current frame
-    ++fNumDeliveriesMadeSoFar;
-
-    // Assert: fNumDeliveriesMadeSoFar < fNumActiveReplicas; // because we still have the 'master replica' to deliver to
-    if (!(fNumDeliveriesMadeSoFar < fNumActiveReplicas)) fprintf(stderr, "StreamReplicator::deliverReceivedFrame() Internal Error 2(%d,%d)!\n", fNumDeliveriesMadeSoFar, fNumActiveReplicas); // should not happen
-
-    // Complete delivery to this replica:
-    FramedSource::afterGetting(replica);
+void StreamReplicator::readNextFrame() {
+  if (fInputSource == NULL || fInputSourceHasClosed || fIsDelivering || fNumAwaitingReplicas == 0
+      || fInputSource->isCurrentlyAwaitingData()) return;
 
-    replica->fDeliveryInProgress = False;
+  ReplicatorFrameSlot& slot = fSlots[fNextFrameNumber&fSlotMask];
+  // If the slot still holds a frame that some replica hasn't read, that replica is a whole ring behind.  Don't wait for it:
+  if (slot.fRefCount > 0) skipLaggingReplicas();
+
+  if (slot.fBufferSize < fSlotBufferSize) {
+    delete[] slot.fData;
+    slot.fData = new unsigned char[fSlotBufferSize];
+    slot.fBufferSize = fSlotBufferSize;
   }
 
-  if (fNumDeliveriesMadeSoFar == fNumActiveReplicas - 1 && fMasterReplica != NULL) {
-    // No more requests for this frame are expected, so complete delivery to the 'master replica':
-    replica = fMasterReplica;
-    fMasterReplica = NULL;
-    replica->fFrameIndex = 1 - replica->fFrameIndex; // toggle it (0<->1), because this replica no longer awaits the current frame
-    fFrameIndex = 1 - fFrameIndex; // toggle it (0<->1) for the next frame
-    fNumDeliveriesMadeSoFar = 0; // reset for the next frame
-
-    if (fReplicasAwaitingNextFrame != NULL) {
-      // One of the other replicas has already requested the next frame, so make it the next 'master replica':
-      fMasterReplica = fReplicasAwaitingNextFrame;
-      fReplicasAwaitingNextFrame = fReplicasAwaitingNextFrame->fNext;
-      fMasterReplica->fNext = NULL;
-
-      // Arrange to read the next frame into this replica's buffer:
-      if (fInputSource != NULL) fInputSource->getNextFrame(fMasterReplica->fTo, fMasterReplica->fMaxSize,
-							   afterGettingFrame, this, onSourceClosure, this);
-    }      
-
-    // Move any other replicas that had already requested the next frame to the 'requesting current frame' list:
-    // Assert: fReplicasAwaitingCurrentFrame == NULL;
-    if (!(fReplicasAwaitingCurrentFrame == NULL)) fprintf(stderr, "StreamReplicator::deliverReceivedFrame() Internal Error 3!\n"); // should not happen
-    fReplicasAwaitingCurrentFrame = fReplicasAwaitingNextFrame;
-    fReplicasAwaitingNextFrame = NULL;
-    
+  fInputSource->getNextFrame(slot.fData, slot.fBufferSize, afterGettingFrame, this, onSourceClosure, this);
+}
+
+Boolean StreamReplicator::deliverBufferedFrame(StreamReplica* replica) {
+  while (replica->fCursor != fNextFrameNumber) {
+    ReplicatorFrameSlot& slot = fSlots[replica->fCursor&fSlotMask];
+    ++replica->fCursor;
+    --slot.fRefCount;
+
+    if (replica->fSkipToKeyFrame && !slot.fIsKeyFrame) {
+      ++fNumFramesSkipped;
+      continue;
+    }
+    replica->fSkipToKeyFrame = False;
+
+    // This is the only copy of the frame that this replica gets - into the buffer that it has been asked to fill:
+    replica->copyFrame(slot);
     FramedSource::afterGetting(replica);
+    return True;
+  }
+
+  return False;
+}
+
+void StreamReplicator::skipLaggingReplicas() {
+  // The oldest frame in our ring is about to be overwritten.  Move each replica that hasn't read it yet forward - to the
+  // next key frame in the ring, if there's one; otherwise it skips frames (as they arrive) until a key frame:
+  unsigned const oldestFrameNumber = fNextFrameNumber - (fSlotMask + 1);
+  unsigned keyFrameNumber = oldestFrameNumber + 1;
+  while (keyFrameNumber != fNextFrameNumber && !fSlots[keyFrameNumber&fSlotMask].fIsKeyFrame) ++keyFrameNumber;
+
+  for (StreamReplica* replica = fReplicas; replica != NULL; replica = replica->fNext) {
+    if (!replica->fIsActive || replica->fCursor != oldestFrameNumber) continue;
+
+    for (; replica->fCursor != keyFrameNumber; ++replica->fCursor) {
+      --fSlots[replica->fCursor&fSlotMask].fRefCount;
+      ++fNumFramesSkipped;
+    }
+    replica->fSkipToKeyFrame = keyFrameNumber == fNextFrameNumber;
   }
 }
 
@@ -302,7 +292,7 @@ void StreamReplicator::deliverReceivedFrame() {
 StreamReplica::StreamReplica(StreamReplicator& ourReplicator)
   : FramedSource(ourReplicator.envir()),
     fOurReplicator(ourReplicator),
-    fFrameIndex(-1/*we haven't started playing yet*/), fDeliveryInProgress(False), fNext(NULL) {
+    fIsActive(False), fCursor(0), fSkipToKeyFrame(False), fIsAwaitingFrame(False), fNext(NULL) {
 }
 
 StreamReplica::~StreamReplica() {
@@ -314,20 +304,18 @@ void StreamReplica::doGetNextFrame() {
 }
 
 void StreamReplica::doStopGettingFrames() {
-  if (fFrameIndex != -1) { // we had been activated
-    fFrameIndex = -1; // When we start reading again, this will tell the replicator that we were previously inactive.
+  if (fIsActive) { // we had been activated
     fOurReplicator.deactivateStreamReplica(this);
   }
 }
 
-void StreamReplica::copyReceivedFrame(StreamReplica* toReplica, StreamReplica* fromReplica) {
-  // First, figure out how much data to copy.  ("toReplica" might have a smaller buffer than "fromReplica".)
-  unsigned numNewBytesToTruncate
-    = toReplica->fMaxSize < fromReplica->fFrameSize ? fromReplica->fFrameSize - toReplica->fMaxSize : 0;
-  toReplica->fFrameSize = fromReplica->fFrameSize - numNewBytesToTruncate;
-  toReplica->fNumTruncatedBytes = fromReplica->fNumTruncatedBytes + numNewBytesToTruncate;
+void StreamReplica::copyFrame(ReplicatorFrameSlot const& slot) {
+  // First, figure out how much data to copy.  (We might have a smaller buffer than the slot.)
+  unsigned numNewBytesToTruncate = fMaxSize < slot.fFrameSize ? slot.fFrameSize - fMaxSize : 0;
+  fFrameSize = slot.fFrameSize - numNewBytesToTruncate;
+  fNumTruncatedBytes = slot.fNumTruncatedBytes + numNewBytesToTruncate;
 
-  memmove(toReplica->fTo, fromReplica->fTo, toReplica->fFrameSize);
-  toReplica->fPresentationTime = fromReplica->fPresentationTime;
-  toReplica->fDurationInMicroseconds = fromReplica->fDurationInMicroseconds;
+  memmove(fTo, slot.fData, fFrameSize);
+  fPresentationTime = slot.fPresentationTime;
+  fDurationInMicroseconds = slot.fDurationInMicroseconds;
 }
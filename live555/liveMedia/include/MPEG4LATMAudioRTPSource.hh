@@ -38,6 +38,10 @@ public:
 
   Boolean returnedFrameIncludesLATMDataLengthField() const { return fIncludeLATMDataLengthField; }
 
+  Boolean curPacketBeginsFrame() const { return fCurrentPacketBeginsFrame; }
+      // False for the 2nd and later fragments of an "audioMuxElement", which carry no
+      // LATM data length field of their own
+
 protected:
   virtual ~MPEG4LATMAudioRTPSource();
 
@@ -37,6 +37,13 @@ public:
     fOnSendErrorData = onSendErrorFuncData;
   }
 
+  void setBatchedOutput(Boolean batchOutput, Boolean useSegmentationOffload = False) {
+    // Can be used to have the packets of each frame collected, and then sent (to each destination) with as few system
+    // calls as possible - see "Groupsock::beginOutputBatch()".  (By default, each packet is sent as soon as it's built.)
+    fBatchOutput = batchOutput;
+    fUseSegmentationOffload = useSegmentationOffload;
+  }
+
 protected:
   MultiFramedRTPSink(UsageEnvironment& env,
 		     Groupsock* rtpgs, unsigned char rtpPayloadType,
@@ -115,6 +122,8 @@ private:
 
   static void ourHandleClosure(void* clientData);
 
+  void endOutputBatch();
+
 private:
   OutPacketBuffer* fOutBuf;
 
@@ -135,6 +144,8 @@ private:
 
   onSendErrorFunc* fOnSendErrorFunc;
   void* fOnSendErrorData;
+
+  Boolean fBatchOutput, fUseSegmentationOffload;
 };
 
 #endif
@@ -63,9 +63,12 @@ private:
 private:
   void reset();
   void doGetNextFrame1();
+  static void afterGettingFromEventLoop(MultiFramedRTPSource* source);
 
   static void networkReadHandler(MultiFramedRTPSource* source, int /*mask*/);
   void networkReadHandler1();
+  void readDatagramBatch();
+  Boolean storeIncomingPacket(BufferedPacket* bPacket, struct timeval const& timeReceived);
 
   Boolean fAreDoingNetworkReads;
   BufferedPacket* fPacketReadInProgress;
@@ -73,6 +76,7 @@ private:
   Boolean fPacketLossInFragmentedFrame;
   unsigned char* fSavedTo;
   unsigned fSavedMaxSize;
+  unsigned fNumNestedDeliveries; // made (recursively) by "doGetNextFrame1()" since we were last called from the event loop
 
   // A buffer to (optionally) hold incoming pkts that have been reorderered
   class ReorderingPacketBuffer* fReorderingBuffer;
@@ -91,7 +95,14 @@ public:
   Boolean hasUsableData() const { return fTail > fHead; }
   unsigned useCount() const { return fUseCount; }
 
+  Boolean ensureBufferSize(unsigned size); // keeps any data read so far
   Boolean fillInData(RTPInterface& rtpInterface, Boolean& packetReadWasIncomplete);
+  static unsigned fillInDataBatch(RTPInterface& rtpInterface, BufferedPacket** packets, unsigned numPackets);
+      // Reads up to "numPackets" packets that have arrived on the datagram socket (not over TCP) into "packets" at once.
+      // Returns how many were read (into the first of "packets").
+  Boolean readWasTruncated() const { return fReadWasTruncated; }
+      // True if "fillInData()" failed (or "fillInDataBatch()" read a packet that can't be used) because the packet
+      // didn't fit in our buffer
   void assignMiscParams(unsigned short rtpSeqNo, unsigned rtpTimestamp,
 			struct timeval presentationTime,
 			Boolean hasBeenSyncedUsingRTCP,
@@ -142,6 +153,7 @@ private:
   Boolean fRTPMarkerBit;
   Boolean fIsFirstPacket;
   struct timeval fTimeReceived;
+  Boolean fReadWasTruncated;
 };
 
 // A 'factory' class for creating "BufferedPacket" objects.
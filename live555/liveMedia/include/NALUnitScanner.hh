@@ -0,0 +1,53 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// "liveMedia"
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// Fast scanning of MPEG-style (H.264, H.265, MPEG-1/2/4) byte streams, using SIMD instructions
+// where the CPU supports them
+// C++ header
+
+#ifndef _NAL_UNIT_SCANNER_HH
+#define _NAL_UNIT_SCANNER_HH
+
+#ifndef _BOOLEAN_HH
+#include "Boolean.hh"
+#endif
+#ifndef _NET_COMMON_H
+#include "NetCommon.h"
+#endif
+
+// Returns a pointer to the first pair of zero bytes in [from, to) that's followed by a byte in
+// [minThirdByte, maxThirdByte], or "to" if there's none.  A match that's cut off by "to" isn't
+// found:
+u_int8_t const* findZeroBytePair(u_int8_t const* from, u_int8_t const* to,
+				 u_int8_t minThirdByte, u_int8_t maxThirdByte);
+
+// Returns a pointer to the first 0x000001 (the last 3 bytes of a 3- or 4-byte start code) in
+// [from, to), or "to" if there's none:
+inline u_int8_t const* findStartCode(u_int8_t const* from, u_int8_t const* to) {
+  return findZeroBytePair(from, to, 1, 1);
+}
+
+// Returns a pointer to the first 0x000003 (an 'emulation prevention' byte following two zero
+// bytes) in [from, to), or "to" if there's none:
+inline u_int8_t const* findEmulationBytes(u_int8_t const* from, u_int8_t const* to) {
+  return findZeroBytePair(from, to, 3, 3);
+}
+
+// The instruction set that the above uses on this CPU: "AVX2", "SSE2" or "scalar":
+char const* nalUnitScannerInstructionSet();
+
+#endif
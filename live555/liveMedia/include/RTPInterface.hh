@@ -71,6 +71,10 @@ public:
                            handlerProc);
   Boolean handleRead(unsigned char* buffer, unsigned bufferMaxSize,
 		     unsigned& bytesRead, struct sockaddr_in& fromAddress, Boolean& packetReadWasIncomplete);
+  int handleReadBatch(unsigned char* const* buffers, unsigned bufferMaxSize, unsigned numBuffers,
+		      unsigned* bytesRead);
+      // Reads up to "numBuffers" packets that have arrived on our datagram socket - not over TCP - at once
+      // (see "Groupsock::handleReadBatch()").  Returns the number of buffers filled in, or -1 on error.
   void stopNetworkReading();
 
   UsageEnvironment& envir() const { return fOwner->envir(); }
@@ -84,6 +88,7 @@ public:
   // A hack for supporting handlers for RTCP packets arriving interleaved over TCP:
   int nextTCPReadStreamSocketNum() const { return fNextTCPReadStreamSocketNum; }
   unsigned char nextTCPReadStreamChannelId() const { return fNextTCPReadStreamChannelId; }
+  unsigned short nextTCPReadSize() const { return fNextTCPReadSize; }
 
 private:
   // Helper functions for sending a RTP or RTCP packet over a TCP connection:
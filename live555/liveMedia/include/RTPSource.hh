@@ -36,6 +36,14 @@ public:
 			      RTPSource*& resultSource);
 
   Boolean curPacketMarkerBit() const { return fCurPacketMarkerBit; }
+  Boolean curFrameEndsPacket() const { return fCurFrameEndsPacket; }
+      // False while more frames from the current (aggregation) packet are yet to be delivered
+  struct timeval const& curFrameTimeReceived() const { return fCurFrameTimeReceived; }
+      // When the first packet of the current frame was read from the network
+  struct timeval const& curPacketTimeReceived() const { return fCurPacketTimeReceived; }
+      // Same for the current packet - the last one of a fragmented frame
+  unsigned numFragmentedFramesLost() const { return fNumFragmentedFramesLost; }
+      // Frames dropped because some of their fragments were lost
 
   unsigned char rtpPayloadFormat() const { return fRTPPayloadFormat; }
 
@@ -91,6 +99,10 @@ protected:
   u_int16_t fCurPacketRTPSeqNum;
   u_int32_t fCurPacketRTPTimestamp;
   Boolean fCurPacketMarkerBit;
+  Boolean fCurFrameEndsPacket;
+  struct timeval fCurFrameTimeReceived;
+  struct timeval fCurPacketTimeReceived;
+  unsigned fNumFragmentedFramesLost;
   Boolean fCurPacketHasBeenSynchronizedUsingRTCP;
   u_int32_t fLastReceivedSSRC;
 
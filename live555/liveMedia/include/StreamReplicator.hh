@@ -26,28 +26,40 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #endif
 
 class StreamReplica; // forward
+class ReplicatorFrameSlot; // forward
 
 class StreamReplicator: public Medium {
 public:
-  static StreamReplicator* createNew(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies = True);
+  typedef Boolean (isKeyFrameFunc)(void* clientData, unsigned char const* frame, unsigned frameSize);
+
+  static StreamReplicator* createNew(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies = True,
+				     unsigned numBufferedFrames = 8,
+				     isKeyFrameFunc* isKeyFrame = NULL, void* isKeyFrameClientData = NULL);
     // If "deleteWhenLastReplicaDies" is True (the default), then the "StreamReplicator" object is deleted when (and only when)
     //   all replicas have been deleted.  (In this case, you must *not* call "Medium::close()" on the "StreamReplicator" object,
     //   unless you never created any replicas from it to begin with.)
     // If "deleteWhenLastReplicaDies" is False, then the "StreamReplicator" object remains in existence, even when all replicas
     //   have been deleted.  (This allows you to create new replicas later, if you wish.)  In this case, you delete the
     //   "StreamReplicator" object by calling "Medium::close()" on it - but you must do so only when "numReplicas()" returns 0.
+    // Frames are read from the input source once, into a ring of "numBufferedFrames" (rounded up to a power of 2) slots,
+    //   and each replica reads them at its own pace - they're copied only into the buffer a replica is asked to fill.
+    //   A replica that falls a whole ring behind doesn't hold up the input: it's moved forward to the next key frame
+    //   (as told by "isKeyFrame"; without it every frame is a key frame, so only the oldest frame is skipped).
 
   FramedSource* createStreamReplica();
 
   unsigned numReplicas() const { return fNumReplicas; }
 
   FramedSource* inputSource() const { return fInputSource; }
+  // Frames skipped so far by replicas that couldn't keep up
+  unsigned numFramesSkipped() const { return fNumFramesSkipped; }
 
   // Call before destruction if you want to prevent the destructor from closing the input source
   void detachInputSource() { fInputSource = NULL; }
 
 protected:
-  StreamReplicator(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies);
+  StreamReplicator(UsageEnvironment& env, FramedSource* inputSource, Boolean deleteWhenLastReplicaDies,
+		   unsigned numBufferedFrames, isKeyFrameFunc* isKeyFrame, void* isKeyFrameClientData);
     // called only by "createNew()"
   virtual ~StreamReplicator();
 
@@ -69,16 +81,23 @@ private:
   static void onSourceClosure(void* clientData);
   void onSourceClosure();
 
-  void deliverReceivedFrame();
+  void readNextFrame();
+  Boolean deliverBufferedFrame(StreamReplica* replica);
+  void skipLaggingReplicas();
 
 private:
   FramedSource* fInputSource;
   Boolean fDeleteWhenLastReplicaDies, fInputSourceHasClosed; 
-  unsigned fNumReplicas, fNumActiveReplicas, fNumDeliveriesMadeSoFar;
-  int fFrameIndex; // 0 or 1; used to figure out if a replica is requesting the current frame, or the next frame
-
-  StreamReplica* fMasterReplica; // the first replica that requests each frame.  We use its buffer when copying to the others.
-  StreamReplica* fReplicasAwaitingCurrentFrame; // other than the 'master' replica
-  StreamReplica* fReplicasAwaitingNextFrame; // replicas that have already received the current frame, and have asked for the next
+  unsigned fNumReplicas, fNumActiveReplicas, fNumAwaitingReplicas;
+  isKeyFrameFunc* fIsKeyFrame;
+  void* fIsKeyFrameClientData;
+  ReplicatorFrameSlot* fSlots;
+  unsigned fSlotMask; // number of slots - 1
+  unsigned fSlotBufferSize; // the biggest buffer a replica has asked to be filled so far
+  unsigned fNextFrameNumber; // the frame that's being (or is to be) read from the input source
+  StreamReplica* fReplicas; // all of them, in a (singly-linked) list
+  StreamReplica* fNextReplicaToVisit; // while walking "fReplicas" - kept valid if replicas get removed meanwhile
+  Boolean fIsDelivering;
+  unsigned fNumFramesSkipped;
 };
 #endif